@@ -0,0 +1,407 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <glog/logging.h>
+#include <iomanip>
+#include <iterator>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+}
+
+#include "asset_cache.hpp"
+#include "image.hpp"
+#include "lifeline.hpp"
+
+const uint32_t AssetCache::format_version;
+std::string AssetCache::directory("../cache");
+
+// Identifies a baked atlas file
+static const char magic[8] = {'P', 'Y', 'L', 'A', 'T', 'L', 'A', 'S'};
+
+// The pages start on a multiple of this, so they are aligned for the
+// pixel kernels
+static const size_t page_alignment = 16;
+
+// Files changed this recently when stamped are hashed on every load
+static const int64_t racy_seconds = 2;
+
+static const uint64_t fnv_offset_basis = 14695981039346656037ull;
+static const uint64_t fnv_prime = 1099511628211ull;
+
+static uint64_t fnv_1a(uint64_t hash, const char *data, size_t size) {
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= uint64_t(static_cast<unsigned char>(data[i]));
+        hash *= fnv_prime;
+    }
+    return hash;
+}
+
+// Files hold numbers in the machine's byte order, as they are only read
+// by the machine which wrote them.
+template <typename T>
+static void write_value(std::string &buffer, T value) {
+    buffer.append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+static void write_string(std::string &buffer, const std::string &value) {
+    write_value(buffer, uint32_t(value.size()));
+    buffer.append(value);
+}
+
+///
+/// Reads values from a mapped file, failing rather than reading past
+/// its end.
+///
+class BakedReader {
+    const char *data;
+    size_t size;
+
+public:
+    size_t offset = 0;
+    bool ok = true;
+
+    BakedReader(const char *data, size_t size): data(data), size(size) {}
+
+    bool skip(size_t bytes) {
+        if (!ok || bytes > size - offset) {
+            ok = false;
+            return false;
+        }
+        offset += bytes;
+        return true;
+    }
+
+    template <typename T>
+    T read_value() {
+        T value = T();
+        if (skip(sizeof(T))) {
+            std::memcpy(&value, data + offset - sizeof(T), sizeof(T));
+        }
+        return value;
+    }
+
+    int read_int() {
+        return int(read_value<uint32_t>());
+    }
+
+    std::string read_string() {
+        uint32_t length(read_value<uint32_t>());
+        if (!skip(length)) {
+            return "";
+        }
+        return std::string(data + offset - length, length);
+    }
+};
+
+uint64_t AssetCache::hash_file(const std::string &path) {
+    std::ifstream file(path, std::ios::binary);
+    if (file.fail()) {
+        return 0;
+    }
+
+    uint64_t hash(fnv_offset_basis);
+    std::vector<char> chunk(64 * 1024);
+    while (file.read(chunk.data(), std::streamsize(chunk.size())) || file.gcount() > 0) {
+        hash = fnv_1a(hash, chunk.data(), size_t(file.gcount()));
+    }
+
+    // Keep 0 for missing files
+    return hash ? hash : 1;
+}
+
+static int64_t get_mtime(const struct stat &file_stat) {
+    return int64_t(file_stat.st_mtim.tv_sec) * 1000000000 + int64_t(file_stat.st_mtim.tv_nsec);
+}
+
+AssetCache::FileStamp AssetCache::stamp_file(const std::string &path) {
+    struct stat file_stat;
+    if (stat(path.c_str(), &file_stat) == -1) {
+        return FileStamp{0, 0, 0};
+    }
+
+    FileStamp stamp;
+    stamp.size  = uint64_t(file_stat.st_size);
+    stamp.mtime = get_mtime(file_stat);
+    stamp.hash  = hash_file(path);
+
+    // Modification times are only as fine as the kernel's clock ticks,
+    // so a file changed again straight after this could keep the same
+    // time. Recently changed files are always hashed instead.
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    if (stamp.mtime > (int64_t(now.tv_sec) - racy_seconds) * 1000000000) {
+        stamp.mtime = 0;
+    }
+
+    return stamp;
+}
+
+bool AssetCache::is_unchanged(const std::string &path, const FileStamp &stamp) {
+    struct stat file_stat;
+    if (stat(path.c_str(), &file_stat) == -1) {
+        return stamp.hash == 0;
+    }
+
+    if (uint64_t(file_stat.st_size) != stamp.size) {
+        return false;
+    }
+
+    if (stamp.mtime != 0 && get_mtime(file_stat) == stamp.mtime) {
+        return true;
+    }
+
+    // Touched, such as by a checkout, but perhaps not changed
+    return hash_file(path) == stamp.hash;
+}
+
+std::string AssetCache::get_names_path(const std::string &image_path) {
+    return image_path.substr(0, image_path.find_last_of('.')) + ".fml";
+}
+
+std::string AssetCache::get_path(const std::vector<std::string> &image_paths) {
+    uint64_t hash(fnv_offset_basis);
+    for (const std::string &image_path : image_paths) {
+        // Include the terminator to separate the paths
+        hash = fnv_1a(hash, image_path.c_str(), image_path.size() + 1);
+    }
+
+    std::stringstream path;
+    path << directory << "/atlas-" << std::hex << std::setw(16) << std::setfill('0') << hash << ".bin";
+    return path.str();
+}
+
+bool AssetCache::load(const std::vector<std::string> &image_paths,
+                      int unit_w, int unit_h, int max_texture_size,
+                      Atlas &atlas) {
+    std::string path(get_path(image_paths));
+
+    int file(open(path.c_str(), O_RDONLY));
+    if (file == -1) {
+        VLOG(1) << "AssetCache::load: No baked atlas at " << path;
+        return false;
+    }
+
+    struct stat file_stat;
+    if (fstat(file, &file_stat) == -1 || file_stat.st_size <= 0) {
+        close(file);
+        return false;
+    }
+    size_t size(size_t(file_stat.st_size));
+
+    // Private and writable, so the pages can be handled as any other
+    // image without writing back to the file
+    void *mapping(mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, file, 0));
+    close(file);
+    if (mapping == MAP_FAILED) {
+        LOG(WARNING) << "AssetCache::load: Cannot map " << path << ": " << std::strerror(errno);
+        return false;
+    }
+
+    // Unmapped when the last copy of the pages is gone
+    Lifeline unmap([mapping, size] () { munmap(mapping, size); });
+
+    const char *data(static_cast<const char *>(mapping));
+    BakedReader reader(data, size);
+
+    if (size < sizeof(magic) || std::memcmp(data, magic, sizeof(magic)) != 0) {
+        LOG(WARNING) << "AssetCache::load: " << path << " is not a baked atlas";
+        return false;
+    }
+    reader.skip(sizeof(magic));
+
+    if (reader.read_value<uint32_t>() != format_version) {
+        LOG(INFO) << "AssetCache::load: " << path << " was baked by another version";
+        return false;
+    }
+
+    atlas.unit_w           = reader.read_int();
+    atlas.unit_h           = reader.read_int();
+    atlas.unit_columns     = reader.read_int();
+    atlas.unit_rows        = reader.read_int();
+    atlas.max_texture_size = reader.read_int();
+
+    int page_count  (reader.read_int());
+    int width       (reader.read_int());
+    int height      (reader.read_int());
+    int store_width (reader.read_int());
+    int store_height(reader.read_int());
+
+    size_t source_count(reader.read_value<uint32_t>());
+    if (!reader.ok || source_count != image_paths.size()) {
+        return false;
+    }
+
+    if (atlas.unit_w != unit_w || atlas.unit_h != unit_h || atlas.max_texture_size != max_texture_size) {
+        LOG(INFO) << "AssetCache::load: " << path << " was baked for other tile or texture sizes";
+        return false;
+    }
+
+    atlas.sources.assign(source_count, Source());
+    auto read_stamp([&] () {
+        FileStamp stamp;
+        stamp.size  = reader.read_value<uint64_t>();
+        stamp.mtime = reader.read_value<int64_t>();
+        stamp.hash  = reader.read_value<uint64_t>();
+        return stamp;
+    });
+
+    for (Source &source : atlas.sources) {
+        source.image_path   = reader.read_string();
+        source.image_stamp  = read_stamp();
+        source.names_stamp  = read_stamp();
+        source.width        = reader.read_int();
+        source.height       = reader.read_int();
+        source.index_offset = reader.read_int();
+
+        size_t name_count(reader.read_value<uint32_t>());
+        for (size_t name = 0; name < name_count && reader.ok; ++name) {
+            std::string tile_name(reader.read_string());
+            source.names_to_indexes[tile_name] = reader.read_int();
+        }
+
+    }
+
+    if (!reader.ok) {
+        LOG(WARNING) << "AssetCache::load: " << path << " is truncated or corrupt";
+        return false;
+    }
+
+    // Sources are in the order they were merged
+    std::vector<std::string> source_paths;
+    for (const Source &source : atlas.sources) {
+        source_paths.push_back(source.image_path);
+    }
+    std::sort(std::begin(source_paths), std::end(source_paths));
+    if (source_paths != image_paths) {
+        return false;
+    }
+
+    for (const Source &source : atlas.sources) {
+        if (!is_unchanged(source.image_path, source.image_stamp) ||
+            !is_unchanged(get_names_path(source.image_path), source.names_stamp)) {
+            LOG(INFO) << "AssetCache::load: " << source.image_path << " has changed since " << path << " was baked";
+            return false;
+        }
+    }
+
+    reader.skip((page_alignment - reader.offset % page_alignment) % page_alignment);
+
+    size_t page_bytes(size_t(store_width) * size_t(store_height) * sizeof(Image::Pixel));
+    if (!reader.ok || page_count <= 0 || width <= 0 || height <= 0 ||
+        store_width < width || store_height < height ||
+        (size - reader.offset) / page_bytes < size_t(page_count)) {
+        LOG(WARNING) << "AssetCache::load: " << path << " is truncated or corrupt";
+        return false;
+    }
+
+    atlas.pages.clear();
+    for (int page = 0; page < page_count; ++page) {
+        Image::Pixel *pixels(reinterpret_cast<Image::Pixel *>(static_cast<char *>(mapping) + reader.offset));
+        atlas.pages.emplace_back(width, height, store_width, store_height, pixels, unmap);
+        reader.offset += page_bytes;
+    }
+
+    LOG(INFO) << "AssetCache::load: Mapped " << path << ": " << source_count << " atlases on "
+              << page_count << " pages";
+    return true;
+}
+
+bool AssetCache::save(Atlas &atlas) {
+    if (atlas.pages.empty()) {
+        return false;
+    }
+
+    std::vector<std::string> image_paths;
+    for (Source &source : atlas.sources) {
+        source.image_stamp = stamp_file(source.image_path);
+        source.names_stamp = stamp_file(get_names_path(source.image_path));
+        image_paths.push_back(source.image_path);
+    }
+    std::sort(std::begin(image_paths), std::end(image_paths));
+
+    const Image &first_page(atlas.pages[0]);
+
+    std::string header(magic, sizeof(magic));
+    write_value(header, format_version);
+    write_value(header, uint32_t(atlas.unit_w));
+    write_value(header, uint32_t(atlas.unit_h));
+    write_value(header, uint32_t(atlas.unit_columns));
+    write_value(header, uint32_t(atlas.unit_rows));
+    write_value(header, uint32_t(atlas.max_texture_size));
+    write_value(header, uint32_t(atlas.pages.size()));
+    write_value(header, uint32_t(first_page.width));
+    write_value(header, uint32_t(first_page.height));
+    write_value(header, uint32_t(first_page.store_width));
+    write_value(header, uint32_t(first_page.store_height));
+    write_value(header, uint32_t(atlas.sources.size()));
+
+    auto write_stamp([&] (const FileStamp &stamp) {
+        write_value(header, stamp.size);
+        write_value(header, stamp.mtime);
+        write_value(header, stamp.hash);
+    });
+
+    for (const Source &source : atlas.sources) {
+        write_string(header, source.image_path);
+        write_stamp(source.image_stamp);
+        write_stamp(source.names_stamp);
+        write_value(header, uint32_t(source.width));
+        write_value(header, uint32_t(source.height));
+        write_value(header, uint32_t(source.index_offset));
+        write_value(header, uint32_t(source.names_to_indexes.size()));
+        for (const auto &name : source.names_to_indexes) {
+            write_string(header, name.first);
+            write_value(header, uint32_t(name.second));
+        }
+    }
+
+    header.append((page_alignment - header.size() % page_alignment) % page_alignment, '\0');
+
+    if (mkdir(directory.c_str(), 0755) == -1 && errno != EEXIST) {
+        LOG(WARNING) << "AssetCache::save: Cannot create " << directory << ": " << std::strerror(errno);
+        return false;
+    }
+
+    // Written aside and moved into place, so a half written file is
+    // never loaded and a mapped one is never changed
+    std::string path(get_path(image_paths));
+    std::string temporary_path(path + ".tmp");
+    {
+        std::ofstream file(temporary_path, std::ios::binary | std::ios::trunc);
+        file.write(header.data(), std::streamsize(header.size()));
+
+        for (const Image &page : atlas.pages) {
+            file.write(reinterpret_cast<const char *>(page.pixels),
+                       std::streamsize(size_t(page.store_width) * size_t(page.store_height) * sizeof(Image::Pixel)));
+        }
+
+        if (file.fail()) {
+            LOG(WARNING) << "AssetCache::save: Cannot write " << temporary_path;
+            file.close();
+            std::remove(temporary_path.c_str());
+            return false;
+        }
+    }
+
+    if (std::rename(temporary_path.c_str(), path.c_str()) != 0) {
+        LOG(WARNING) << "AssetCache::save: Cannot replace " << path << ": " << std::strerror(errno);
+        std::remove(temporary_path.c_str());
+        return false;
+    }
+
+    LOG(INFO) << "AssetCache::save: Baked " << atlas.sources.size() << " atlases to " << path;
+    return true;
+}
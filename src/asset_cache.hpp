@@ -0,0 +1,178 @@
+#ifndef ASSET_CACHE_H
+#define ASSET_CACHE_H
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "image.hpp"
+
+///
+/// Merged texture atlases baked to disk, so that loading a map whose
+/// tilesets have been merged before skips decoding the PNGs, parsing
+/// the name files and merging the atlases.
+///
+/// A baked atlas holds the merged pages, ready to be given to GL, the
+/// layout of the units on them and each source's name to index table.
+/// It is written the first time a set of images is merged and mapped
+/// into memory when the same set is loaded again. The pages are used
+/// straight from the mapping.
+///
+/// Each baked atlas records the size, modification time and hash of
+/// every source image and name file. Files whose size and modification
+/// time are unchanged are trusted without hashing them again. If any
+/// has changed, or the format version, tile size or largest texture size
+/// do not match, the file is ignored and baked again.
+///
+class AssetCache {
+public:
+    ///
+    /// What a source file was like when it was baked.
+    ///
+    struct FileStamp {
+        ///
+        /// The size in bytes
+        ///
+        uint64_t size;
+
+        ///
+        /// The modification time in nanoseconds since the epoch, or 0
+        /// if the file had only just changed and must be hashed
+        ///
+        int64_t mtime;
+
+        ///
+        /// The content hash, 0 for a missing file
+        ///
+        uint64_t hash;
+    };
+
+    ///
+    /// One of the atlases merged into a baked atlas.
+    ///
+    struct Source {
+        ///
+        /// The path of the image, as given to TextureAtlas::get_shared
+        ///
+        std::string image_path;
+
+        ///
+        /// The image and its name file
+        ///
+        FileStamp image_stamp;
+        FileStamp names_stamp;
+
+        ///
+        /// The size of the image in pixels
+        ///
+        int width;
+        int height;
+
+        ///
+        /// The index of the image's first unit in the merged atlas
+        ///
+        int index_offset;
+
+        std::map<std::string, int> names_to_indexes;
+    };
+
+    ///
+    /// A merged atlas. Each source's units are numbered on from its
+    /// index offset.
+    ///
+    struct Atlas {
+        int unit_w;
+        int unit_h;
+
+        ///
+        /// The number of columns and rows of units on each page
+        ///
+        int unit_columns;
+        int unit_rows;
+
+        ///
+        /// The largest texture size the pages were laid out for
+        ///
+        int max_texture_size;
+
+        std::vector<Source> sources;
+
+        ///
+        /// The pages, flipped for GL. When loaded, they point into the
+        /// mapped file, which stays mapped while any copy is alive.
+        ///
+        std::vector<Image> pages;
+    };
+
+private:
+    ///
+    /// Changed whenever the file layout changes, so old files are
+    /// ignored
+    ///
+    static const uint32_t format_version = 3;
+
+    ///
+    /// The directory baked files are kept in
+    ///
+    static std::string directory;
+
+    ///
+    /// Get the file a set of images is baked to
+    ///
+    static std::string get_path(const std::vector<std::string> &image_paths);
+
+    ///
+    /// Check whether a file is as it was when stamped, hashing it only
+    /// if its size is the same but its modification time is not
+    ///
+    static bool is_unchanged(const std::string &path, const FileStamp &stamp);
+
+public:
+    ///
+    /// Set the directory baked files are kept in, ../cache by default
+    ///
+    static void set_directory(const std::string &directory) { AssetCache::directory = directory; }
+
+    ///
+    /// Work out the FNV-1a hash of a file's contents
+    /// @return the hash, or 0 if the file cannot be read
+    ///
+    static uint64_t hash_file(const std::string &path);
+
+    ///
+    /// Stamp a file with its size, modification time and hash
+    /// @return the stamp, which is all 0 if the file cannot be read
+    ///
+    static FileStamp stamp_file(const std::string &path);
+
+    ///
+    /// Get the path of the name file which goes with an image
+    ///
+    static std::string get_names_path(const std::string &image_path);
+
+    ///
+    /// Map a baked atlas into memory, if it is up to date.
+    ///
+    /// @param image_paths the images merged, sorted by path
+    /// @param unit_w the width of a unit the atlas must have
+    /// @param unit_h the height of a unit the atlas must have
+    /// @param max_texture_size the largest texture size GL supports
+    /// @param atlas filled with the baked atlas
+    /// @return false if there is no baked atlas or it is out of date
+    ///
+    static bool load(const std::vector<std::string> &image_paths,
+                     int unit_w, int unit_h, int max_texture_size,
+                     Atlas &atlas);
+
+    ///
+    /// Bake an atlas to disk, replacing any baked before from the same
+    /// images. The sources' stamps are filled in from the files.
+    ///
+    /// @param atlas the merged atlas
+    /// @return false if the file could not be written
+    ///
+    static bool save(Atlas &atlas);
+};
+
+#endif
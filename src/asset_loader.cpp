@@ -0,0 +1,291 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <future>
+#include <glog/logging.h>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+extern "C" {
+#ifdef USE_GLES
+#include <GLES2/gl2.h>
+#endif
+#ifdef USE_GL
+#define GL_GLEXT_PROTOTYPES
+#include <GL/gl.h>
+#endif
+}
+
+#include "asset_cache.hpp"
+#include "asset_loader.hpp"
+#include "engine.hpp"
+#include "fml.hpp"
+#include "image.hpp"
+#include "map_loader.hpp"
+#include "texture_atlas.hpp"
+
+
+
+// Check whether a worker's result is ready, optionally waiting for it
+template <typename Result>
+static bool is_finished(std::future<Result> &future, bool wait) {
+    if (wait) {
+        future.wait();
+        return true;
+    }
+    return future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
+static long long to_milliseconds(AssetLoader::clock::duration duration) {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(duration).count();
+}
+
+
+
+AssetLoader::MapLoad::MapLoad(const std::string &source):
+    source(source),
+    map_loader(std::make_shared<MapLoader>()),
+    max_texture_size(0),
+    start_time(clock::now()),
+    stage_start_time(start_time),
+    decode_work(std::make_shared<std::atomic<clock::rep>>(0)) {
+}
+
+float AssetLoader::MapLoad::get_progress() {
+    if (is_ready()) {
+        return 1.0f;
+    }
+    return std::min(float(steps_done) / float(steps_total), 1.0f);
+}
+
+void AssetLoader::MapLoad::set_stage(Stage next) {
+    clock::time_point now(clock::now());
+    stage_durations[stage] += now - stage_start_time;
+    stage_start_time = now;
+    stage = next;
+}
+
+void AssetLoader::MapLoad::advance(clock::time_point deadline, bool wait) {
+    try {
+        if (stage == Stage::PARSING) {
+            if (!is_finished(parsed, wait)) {
+                return;
+            }
+            parsed.get();
+            ++steps_done;
+
+            // Atlases still loaded, such as those the resource cache
+            // kept from the last challenge, need no decoding
+            bool all_shared(std::all_of(std::begin(atlases.image_paths), std::end(atlases.image_paths),
+                                        [] (const std::string &image_path) { return TextureAtlas::is_shared(image_path); }));
+
+            if (atlases.is_baked || all_shared) {
+                set_stage(Stage::MERGING);
+            }
+            else {
+                // Each image is decoded on whichever worker is free
+                for (const std::string &image_path : atlases.image_paths) {
+                    std::shared_ptr<std::atomic<clock::rep>> work(decode_work);
+                    decoded.push_back(AssetLoader::get_instance().run<DecodedImage>([image_path, work] () {
+                        clock::time_point start(clock::now());
+
+                        DecodedImage image;
+                        image.image_path = image_path;
+                        image.image = Image(image_path, true);
+
+                        std::ifstream names(AssetCache::get_names_path(image_path));
+                        if (names.fail()) {
+                            LOG(WARNING) << "No names loaded for texture atlas \"" << image_path << "\": "
+                                         << "File \"" << AssetCache::get_names_path(image_path) << "\" could not be opened.";
+                        }
+                        else {
+                            fml::from_stream(names, image.names_to_indexes);
+                        }
+
+                        *work += (clock::now() - start).count();
+                        return image;
+                    }));
+                }
+                steps_total += int(decoded.size());
+                set_stage(Stage::DECODING);
+            }
+        }
+
+        if (stage == Stage::DECODING) {
+            // Taken in order, so the atlases merge as they would have
+            while (atlases.images.size() < decoded.size()) {
+                std::future<DecodedImage> &image(decoded[atlases.images.size()]);
+                if (!is_finished(image, wait)) {
+                    return;
+                }
+                atlases.images.push_back(image.get());
+                ++steps_done;
+            }
+            decoded.clear();
+            set_stage(Stage::MERGING);
+        }
+
+        if (stage == Stage::MERGING) {
+            if (clock::now() >= deadline) {
+                return;
+            }
+
+            // The merged pages are converted by the workers and queued
+            // for uploading a few at a time
+            size_t queued_before(TextureAtlas::get_queued_upload_count());
+            TextureAtlas::set_upload_deferred(true);
+            try {
+                map_loader->load_tileset(&atlases);
+            }
+            catch (...) {
+                TextureAtlas::set_upload_deferred(false);
+                throw;
+            }
+            TextureAtlas::set_upload_deferred(false);
+
+            pages = int(TextureAtlas::get_queued_upload_count() - queued_before);
+            steps_total += pages;
+            ++steps_done;
+            set_stage(Stage::UPLOADING);
+        }
+
+        if (stage == Stage::UPLOADING) {
+            size_t remaining(TextureAtlas::upload_queued(deadline, wait));
+            steps_done = steps_total - std::min(int(remaining), pages);
+            if (remaining > 0) {
+                return;
+            }
+            set_stage(Stage::DONE);
+            report();
+        }
+    }
+    catch (std::exception &e) {
+        LOG(ERROR) << "Failed to load map \"" << source << "\" in the background: " << e.what();
+        set_stage(Stage::FAILED);
+    }
+}
+
+void AssetLoader::MapLoad::report() {
+    LOG(INFO) << "Loaded map \"" << source << "\" in " << to_milliseconds(clock::now() - start_time) << " ms: "
+              << "parsing " << to_milliseconds(stage_durations[Stage::PARSING]) << " ms, "
+              << "decoding " << to_milliseconds(stage_durations[Stage::DECODING]) << " ms ("
+              << (atlases.is_baked ? "baked" : std::to_string(atlases.images.size()) + " images") << ", "
+              << to_milliseconds(clock::duration(*decode_work)) << " ms of work), "
+              << "merging " << to_milliseconds(stage_durations[Stage::MERGING]) << " ms, "
+              << "uploading " << to_milliseconds(stage_durations[Stage::UPLOADING]) << " ms ("
+              << pages << " pages)";
+}
+
+
+
+AssetLoader::AssetLoader() {
+    // Leave a core for the main thread, where there is more than one
+    unsigned int cores(std::thread::hardware_concurrency());
+    unsigned int worker_count(cores > 1 ? cores - 1 : 1);
+
+    for (unsigned int i = 0; i < worker_count; ++i) {
+        workers.emplace_back(&AssetLoader::run_worker, this);
+    }
+    LOG(INFO) << "Started asset loader with " << worker_count << " workers";
+}
+
+AssetLoader::~AssetLoader() {
+    {
+        std::lock_guard<std::mutex> lock(tasks_mutex);
+        stopping = true;
+    }
+    task_added.notify_all();
+
+    for (std::thread &worker : workers) {
+        worker.join();
+    }
+}
+
+AssetLoader &AssetLoader::get_instance() {
+    // Lazy instantiation of the global instance
+    static AssetLoader global_instance;
+
+    return global_instance;
+}
+
+void AssetLoader::enqueue(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(tasks_mutex);
+        tasks.push_back(task);
+    }
+    task_added.notify_one();
+}
+
+void AssetLoader::run_worker() {
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(tasks_mutex);
+            task_added.wait(lock, [&] () { return stopping || !tasks.empty(); });
+            if (stopping) {
+                return;
+            }
+            task = tasks.front();
+            tasks.pop_front();
+        }
+        task();
+    }
+}
+
+std::shared_ptr<AssetLoader::MapLoad> AssetLoader::load_map(const std::string &source) {
+    std::shared_ptr<MapLoad> load(std::make_shared<MapLoad>(source));
+    loads.push_back(load);
+
+    // Read here, as the workers have no GL context or engine
+    load->max_texture_size = TextureAtlas::get_max_page_size();
+    int tile_size(Engine::get_tile_size());
+
+    load->parsed = run<void>([load, tile_size] () {
+        if (!load->map_loader->parse_map(load->source)) {
+            throw std::runtime_error("Could not parse \"" + load->source + "\"");
+        }
+
+        // As TextureAtlas::load_merged will look for them
+        DecodedAtlases &atlases(load->atlases);
+        atlases.image_paths = load->map_loader->get_tileset_images();
+        std::sort(std::begin(atlases.image_paths), std::end(atlases.image_paths));
+        atlases.image_paths.erase(std::unique(std::begin(atlases.image_paths), std::end(atlases.image_paths)),
+                                  std::end(atlases.image_paths));
+
+        atlases.is_baked = !atlases.image_paths.empty() &&
+                           AssetCache::load(atlases.image_paths, tile_size, tile_size, load->max_texture_size, atlases.baked);
+    });
+
+    return load;
+}
+
+void AssetLoader::update(clock::time_point deadline) {
+    for (std::shared_ptr<MapLoad> &load : loads) {
+        load->advance(deadline, false);
+    }
+}
+
+std::shared_ptr<MapLoader> AssetLoader::take_map(const std::string &source) {
+    auto load(std::find_if(std::begin(loads), std::end(loads),
+                           [&] (const std::shared_ptr<MapLoad> &load) { return load->source == source; }));
+    if (load == std::end(loads)) {
+        return nullptr;
+    }
+
+    std::shared_ptr<MapLoad> taken(*load);
+    loads.erase(load);
+
+    taken->advance(clock::time_point::max(), true);
+    if (taken->stage != MapLoad::Stage::DONE) {
+        return nullptr;
+    }
+    return taken->map_loader;
+}
@@ -0,0 +1,258 @@
+#ifndef ASSET_LOADER_H
+#define ASSET_LOADER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "asset_cache.hpp"
+#include "image.hpp"
+
+class MapLoader;
+
+///
+/// Loads maps in the background, so that the window keeps drawing
+/// whilst a challenge loads.
+///
+/// The work which does not touch GL or the engine's objects, which is
+/// parsing the TMX file, checking the asset cache, decoding the tileset
+/// PNGs and reading their name files, runs on a small pool of worker
+/// threads. The main thread calls update between frames to do the rest
+/// in time slices: merging the decoded atlases and then uploading their
+/// pages to GL, which the workers convert to the texture quality's
+/// format beforehand.
+///
+/// A load's progress and the time spent on each stage are recorded, and
+/// the timings logged when it finishes.
+///
+class AssetLoader {
+public:
+    using clock = std::chrono::steady_clock;
+
+    ///
+    /// An image decoded for a texture atlas, with its names
+    ///
+    struct DecodedImage {
+        std::string image_path;
+        Image image;
+        std::map<std::string, int> names_to_indexes;
+    };
+
+    ///
+    /// The images of a set of texture atlases to be merged, decoded or
+    /// mapped from the asset cache.
+    ///
+    struct DecodedAtlases {
+        ///
+        /// The images, sorted by path
+        ///
+        std::vector<std::string> image_paths;
+
+        ///
+        /// Whether the set was baked in the asset cache, in which case
+        /// baked holds it and the images are not decoded
+        ///
+        bool is_baked = false;
+        AssetCache::Atlas baked;
+
+        std::vector<DecodedImage> images;
+    };
+
+    ///
+    /// A map being loaded
+    ///
+    class MapLoad {
+    public:
+        enum class Stage {
+            ///
+            /// Parsing the TMX file and checking the asset cache, on a
+            /// worker
+            ///
+            PARSING,
+            ///
+            /// Decoding the tileset images, on the workers
+            ///
+            DECODING,
+            ///
+            /// Merging the tilesets' atlases, on the main thread
+            ///
+            MERGING,
+            ///
+            /// Uploading the merged pages, on the main thread
+            ///
+            UPLOADING,
+            DONE,
+            FAILED
+        };
+
+    private:
+        friend class AssetLoader;
+
+        std::string source;
+
+        Stage stage = Stage::PARSING;
+
+        ///
+        /// The loader the map is parsed into and its tilesets loaded by
+        ///
+        std::shared_ptr<MapLoader> map_loader;
+
+        DecodedAtlases atlases;
+
+        ///
+        /// The largest texture size, read on the main thread for the
+        /// asset cache
+        ///
+        int max_texture_size;
+
+        std::future<void> parsed;
+        std::vector<std::future<DecodedImage>> decoded;
+
+        ///
+        /// The number of steps done and known about so far: parsing,
+        /// each image, merging and each page
+        ///
+        int steps_done = 0;
+        int steps_total = 2;
+
+        clock::time_point start_time;
+        clock::time_point stage_start_time;
+
+        ///
+        /// The wall time of each stage
+        ///
+        std::map<Stage, clock::duration> stage_durations;
+
+        ///
+        /// The time the workers spent decoding, summed over the images.
+        /// Shared with the tasks, which may outlive a failed load.
+        ///
+        std::shared_ptr<std::atomic<clock::rep>> decode_work;
+
+        ///
+        /// The number of pages queued for upload when merging finished
+        ///
+        int pages = 0;
+
+        ///
+        /// Move on to the next stage, recording the time spent on this
+        ///
+        void set_stage(Stage next);
+
+        ///
+        /// Do as much of the load as possible before the deadline.
+        ///
+        /// @param wait whether to wait for the workers rather than
+        ///        returning when they are not finished
+        ///
+        void advance(clock::time_point deadline, bool wait);
+
+        ///
+        /// Log the time spent on each stage
+        ///
+        void report();
+
+    public:
+        MapLoad(const std::string &source);
+
+        const std::string &get_source() { return source; }
+
+        Stage get_stage() { return stage; }
+
+        ///
+        /// Whether the map is loaded, or failed to load, so that all
+        /// that is left is to make a Map of it
+        ///
+        bool is_ready() { return stage == Stage::DONE || stage == Stage::FAILED; }
+
+        ///
+        /// Get how far through the load is, from 0 to 1
+        ///
+        float get_progress();
+    };
+
+private:
+    AssetLoader();
+    ~AssetLoader();
+
+    std::vector<std::thread> workers;
+
+    ///
+    /// Tasks waiting for a worker, guarded by tasks_mutex
+    ///
+    std::deque<std::function<void()>> tasks;
+    std::mutex tasks_mutex;
+    std::condition_variable task_added;
+
+    ///
+    /// Set when the workers should finish
+    ///
+    bool stopping = false;
+
+    ///
+    /// The maps being loaded, oldest first
+    ///
+    std::vector<std::shared_ptr<MapLoad>> loads;
+
+    void enqueue(std::function<void()> task);
+
+    void run_worker();
+
+public:
+    static AssetLoader &get_instance();
+
+    ///
+    /// Run a task on a worker thread.
+    ///
+    /// Tasks must not touch GL, the engine's objects or the resource
+    /// caches, and must not wait for other tasks.
+    ///
+    /// @param task the task
+    /// @return its result, once it has run
+    ///
+    template <typename Result>
+    std::future<Result> run(std::function<Result()> task) {
+        auto packaged_task(std::make_shared<std::packaged_task<Result()>>(task));
+        std::future<Result> result(packaged_task->get_future());
+        enqueue([packaged_task] () { (*packaged_task)(); });
+        return result;
+    }
+
+    ///
+    /// Start loading a map in the background. Call update between
+    /// frames until it is ready, and then create the Map, which takes
+    /// the loaded map from here.
+    ///
+    /// Must be called on the main thread.
+    ///
+    /// @param source the TMX file, as it will be given to Map
+    /// @return the load, to follow its progress
+    ///
+    std::shared_ptr<MapLoad> load_map(const std::string &source);
+
+    ///
+    /// Do the main thread's share of loading, such as merging atlases
+    /// and uploading pages, until the deadline.
+    ///
+    void update(clock::time_point deadline);
+
+    ///
+    /// Finish loading a map now, waiting for the workers if needed.
+    ///
+    /// @param source the TMX file
+    /// @return the loader holding the parsed map and its tilesets, or
+    ///         nullptr if the map was not being loaded or failed
+    ///
+    std::shared_ptr<MapLoader> take_map(const std::string &source);
+};
+
+#endif
@@ -0,0 +1,347 @@
+#include "python_embed_headers.hpp"
+
+#include <boost/filesystem.hpp>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <glog/logging.h>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+extern "C" {
+#ifdef USE_GLES
+#include <GLES2/gl2.h>
+#endif
+#ifdef USE_GL
+#define GL_GLEXT_PROTOTYPES
+#include <GL/gl.h>
+#endif
+}
+
+#include "animation_frames.hpp"
+#include "api.hpp"
+#include "api_stats.hpp"
+#include "engine.hpp"
+#include "entitythread.hpp"
+#include "event_manager.hpp"
+#include "frame_pacer.hpp"
+#include "game_window.hpp"
+#include "gui_manager.hpp"
+#include "interpreter.hpp"
+#include "map.hpp"
+#include "map_viewer.hpp"
+#include "object_manager.hpp"
+#include "report_format.hpp"
+#include "sprite.hpp"
+#include "stress_map.hpp"
+#include "walkability.hpp"
+
+// Where the map is written before it is loaded
+static const std::string map_path("bench/api_map.tmx");
+
+// The percentiles of one kind of call
+struct Result {
+    std::string name;
+    size_t calls;
+    double calls_per_second;
+
+    // In microseconds, p50 then p99
+    double total[2];
+    double queue_wait[2];
+    double run_time[2];
+    double gil_wait[2];
+};
+
+using report_format::to_microseconds;
+
+static Result summarise(const std::string &name, const std::vector<ApiStats::Call> &calls, double seconds) {
+    std::vector<double> total;
+    std::vector<double> queue_wait;
+    std::vector<double> run_time;
+    std::vector<double> gil_wait;
+    for (const ApiStats::Call &call : calls) {
+        total.push_back(to_microseconds(call.total));
+        queue_wait.push_back(to_microseconds(call.queue_wait));
+        run_time.push_back(to_microseconds(call.run_time));
+        gil_wait.push_back(to_microseconds(call.gil_wait));
+    }
+
+    Result result;
+    result.name = name;
+    result.calls = calls.size();
+    result.calls_per_second = double(calls.size()) / seconds;
+    result.total[0] = report_format::get_percentile(total, 50.0f);
+    result.total[1] = report_format::get_percentile(total, 99.0f);
+    result.queue_wait[0] = report_format::get_percentile(queue_wait, 50.0f);
+    result.queue_wait[1] = report_format::get_percentile(queue_wait, 99.0f);
+    result.run_time[0] = report_format::get_percentile(run_time, 50.0f);
+    result.run_time[1] = report_format::get_percentile(run_time, 99.0f);
+    result.gil_wait[0] = report_format::get_percentile(gil_wait, 50.0f);
+    result.gil_wait[1] = report_format::get_percentile(gil_wait, 99.0f);
+    return result;
+}
+
+// Run the main loop as the game does, until the time
+static void run_until(std::chrono::steady_clock::time_point end, GameWindow &window,
+                      MapViewer &map_viewer, FramePacer &frame_pacer) {
+    while (std::chrono::steady_clock::now() < end) {
+        GameWindow::update();
+
+        // Sleeps until the frame is due, waking for new events
+        frame_pacer.process_events(EventManager::get_instance());
+
+        if (!window.is_redraw_needed()) {
+            continue;
+        }
+        window.clear_redraw_request();
+
+        map_viewer.render();
+        map_viewer.render_labels();
+        window.swap_buffers();
+    }
+}
+
+static std::string to_json(const std::vector<Result> &results, int threads, double seconds,
+                           const std::string &script, const std::string &renderer) {
+    char date[32];
+    std::time_t now(std::time(nullptr));
+    std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&now));
+
+    std::ostringstream json;
+    json << std::fixed << std::setprecision(3)
+         << "{\n"
+         << "  \"context\": {\n"
+         << "    \"date\": " << report_format::quote(date) << ",\n"
+         << "    \"compiler\": " << report_format::quote(__VERSION__) << ",\n"
+#ifdef USE_GLES
+         << "    \"platform\": \"gles\",\n"
+#endif
+#ifdef USE_GL
+         << "    \"platform\": \"desktop\",\n"
+#endif
+         << "    \"renderer\": " << (renderer.empty() ? "null" : report_format::quote(renderer)) << ",\n"
+         << "    \"threads\": " << threads << ",\n"
+         << "    \"seconds\": " << seconds << ",\n"
+         << "    \"script\": " << report_format::quote(script) << "\n"
+         << "  },\n"
+         << "  \"calls\": [";
+
+    auto percentiles([&] (const double (&us)[2]) {
+        std::ostringstream text;
+        text << std::fixed << std::setprecision(3) << "{\"p50\": " << us[0] << ", \"p99\": " << us[1] << "}";
+        return text.str();
+    });
+
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Result &result(results[i]);
+        json << (i == 0 ? "\n" : ",\n")
+             << "    {\"name\": " << report_format::quote(result.name) << ", "
+             << "\"calls\": " << result.calls << ", "
+             << "\"calls_per_second\": " << result.calls_per_second << ", "
+             << "\"total_us\": " << percentiles(result.total) << ", "
+             << "\"queue_wait_us\": " << percentiles(result.queue_wait) << ", "
+             << "\"run_time_us\": " << percentiles(result.run_time) << ", "
+             << "\"gil_wait_us\": " << percentiles(result.gil_wait) << "}";
+    }
+
+    json << "\n  ]\n}\n";
+    return json.str();
+}
+
+static void print_usage(const char *program) {
+    std::cout << "Usage: " << program << " [OPTION...]" << std::endl
+              << "Runs scripts in entity threads against a headless map, and reports how many" << std::endl
+              << "Python API calls they make a second and where the calls wait." << std::endl
+              << std::endl
+              << "  --threads N          entity threads to run (4)" << std::endl
+              << "  --seconds S          how long to time the calls for (5)" << std::endl
+              << "  --warm-up S          how long to run before timing (1)" << std::endl
+              << "  --script NAME        run python_embed/scripts/NAME.py (bench_api)" << std::endl
+              << "  --json FILE          write the results to FILE" << std::endl;
+}
+
+
+
+int main(int argc, const char *argv[]) {
+    int threads(4);
+    double seconds(5.0);
+    double warm_up(1.0);
+    std::string script("bench_api");
+    std::string json_path;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string argument(argv[i]);
+        bool has_value(i + 1 < argc);
+        if (argument == "--threads" && has_value) {
+            threads = std::atoi(argv[++i]);
+        }
+        else if (argument == "--seconds" && has_value) {
+            seconds = std::atof(argv[++i]);
+        }
+        else if (argument == "--warm-up" && has_value) {
+            warm_up = std::atof(argv[++i]);
+        }
+        else if (argument == "--script" && has_value) {
+            script = argv[++i];
+        }
+        else if (argument == "--json" && has_value) {
+            json_path = argv[++i];
+        }
+        else {
+            print_usage(argv[0]);
+            return argument == "--help" ? 0 : 1;
+        }
+    }
+
+    if (threads < 1 || seconds <= 0.0 || warm_up < 0.0) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    google::InitGoogleLogging(argv[0]);
+    // Scripts log each call at INFO
+    FLAGS_minloglevel = google::WARNING;
+
+    std::unique_ptr<GameWindow> window;
+    try {
+        window.reset(new GameWindow(800, 600, false, true));
+    }
+    catch (GameWindow::InitException &e) {
+        LOG(ERROR) << "Could not create a headless window: " << e.what();
+        return 1;
+    }
+    window->use_context();
+    Engine::set_game_window(window.get());
+    std::string renderer(reinterpret_cast<const char *>(glGetString(GL_RENDERER)));
+
+    // A sprite for each thread, and objects for them to look at
+    stress_map::Settings settings;
+    settings.width = 32;
+    settings.height = 32;
+    settings.objects = 50;
+    settings.sprites = threads;
+    if (!stress_map::write(map_path, settings)) {
+        return 1;
+    }
+
+    Interpreter interpreter(boost::filesystem::absolute("python_embed/wrapper_functions.so").normalize());
+    GUIManager gui_manager;
+    MapViewer map_viewer(window.get(), &gui_manager);
+    Engine::set_map_viewer(&map_viewer);
+    FramePacer frame_pacer(60);
+    Engine::set_frame_pacer(&frame_pacer);
+
+    Map *map(new Map(map_path));
+    std::remove(map_path.c_str());
+    if (map->get_layers().empty()) {
+        LOG(ERROR) << "Could not load the benchmark map";
+        delete map;
+        return 1;
+    }
+    map_viewer.set_map(map);
+
+    std::vector<int> sprite_ids;
+    std::vector<std::unique_ptr<Entity>> entities;
+    std::vector<LockableEntityThread> entity_threads;
+    for (int i = 0; i < threads; ++i) {
+        auto properties(map->locations.at("Objects/sprite/" + std::to_string(i)));
+        std::string tile_root(properties.tileset.substr(0, properties.tileset.rfind('/')));
+        std::string start_frame(properties.tileset.substr(properties.tileset.rfind('/') + 1));
+
+        std::shared_ptr<Sprite> sprite(std::make_shared<Sprite>(
+            properties.location, script, Walkability::BLOCKED, AnimationFrames(tile_root), start_frame));
+        ObjectManager::get_instance().add_object(sprite);
+        map->add_sprite(sprite->get_id());
+        sprite_ids.push_back(sprite->get_id());
+
+        // The script is found by the entity's name
+        entities.emplace_back(new Entity(properties.location, script, sprite->get_id()));
+        entity_threads.push_back(interpreter.register_entity(*entities.back()));
+        entity_threads.back().value->halt_soft(EntityThread::Signal::RESTART);
+    }
+    map_viewer.set_map_focus_object(sprite_ids.front());
+
+    auto to_duration([] (double seconds) {
+        return std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(seconds));
+    });
+
+    run_until(std::chrono::steady_clock::now() + to_duration(warm_up), *window, map_viewer, frame_pacer);
+
+    ApiStats::set_enabled(true);
+    std::chrono::steady_clock::time_point start(std::chrono::steady_clock::now());
+    run_until(start + to_duration(seconds), *window, map_viewer, frame_pacer);
+    ApiStats::set_enabled(false);
+    double elapsed(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    std::vector<ApiStats::Call> calls(ApiStats::get_instance().take_calls());
+
+    // Waiting calls are given their defaults when their events are
+    // dropped, so the threads can be stopped, as between challenges
+    EventManager &event_manager(EventManager::get_instance());
+    event_manager.flush_and_disable();
+    entity_threads.clear();
+    event_manager.reenable();
+    entities.clear();
+
+    for (int sprite_id : sprite_ids) {
+        ObjectManager::get_instance().remove_object(sprite_id);
+    }
+    map_viewer.set_map(nullptr);
+    delete map;
+
+    std::map<std::string, std::vector<ApiStats::Call>> calls_by_name;
+    for (const ApiStats::Call &call : calls) {
+        calls_by_name[call.name].push_back(call);
+    }
+
+    std::vector<Result> results;
+    results.push_back(summarise("all", calls, elapsed));
+    for (const auto &named_calls : calls_by_name) {
+        results.push_back(summarise(named_calls.first, named_calls.second, elapsed));
+    }
+
+    std::cout << threads << " threads running " << script << ".py for " << std::fixed << std::setprecision(1)
+              << elapsed << " s; times in us as p50/p99" << std::endl
+              << std::left << std::setw(28) << "call" << std::right << std::setw(8) << "calls" << std::setw(10) << "calls/s"
+              << std::setw(20) << "total" << std::setw(20) << "queue wait"
+              << std::setw(20) << "run" << std::setw(20) << "GIL wait" << std::endl;
+
+    auto percentiles([] (const double (&us)[2]) {
+        std::ostringstream text;
+        text << std::fixed << std::setprecision(0) << us[0] << "/" << us[1];
+        return text.str();
+    });
+
+    for (const Result &result : results) {
+        std::cout << std::left << std::setw(28) << result.name << std::right
+                  << std::setw(8) << result.calls
+                  << std::setw(10) << std::setprecision(1) << result.calls_per_second
+                  << std::setw(20) << percentiles(result.total)
+                  << std::setw(20) << percentiles(result.queue_wait)
+                  << std::setw(20) << percentiles(result.run_time)
+                  << std::setw(20) << percentiles(result.gil_wait) << std::endl;
+    }
+
+    Engine::set_frame_pacer(nullptr);
+    Engine::set_map_viewer(nullptr);
+    Engine::set_game_window(nullptr);
+
+    if (!json_path.empty()) {
+        std::ofstream json(json_path);
+        json << to_json(results, threads, elapsed, script, renderer);
+        if (json.fail()) {
+            LOG(ERROR) << "Could not write the results to \"" << json_path << "\"";
+            return 1;
+        }
+        std::cout << "Wrote the results to " << json_path << std::endl;
+    }
+
+    return calls.empty() ? 1 : 0;
+}
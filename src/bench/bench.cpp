@@ -0,0 +1,297 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <glog/logging.h>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+extern "C" {
+#ifdef USE_GLES
+#include <GLES2/gl2.h>
+#endif
+#ifdef USE_GL
+#define GL_GLEXT_PROTOTYPES
+#include <GL/gl.h>
+#endif
+}
+
+#include "bench.hpp"
+#include "engine.hpp"
+#include "game_window.hpp"
+#include "report_format.hpp"
+
+
+
+bench::State::State(clock::duration sample_time, clock::duration min_time, size_t min_samples, size_t max_samples):
+    sample_time(sample_time),
+    min_time(min_time),
+    min_samples(min_samples),
+    max_samples(max_samples) {
+}
+
+bool bench::State::next_sample() {
+    clock::time_point now(clock::now());
+
+    if (running) {
+        if (!paused) {
+            sample_elapsed += now - sample_start;
+        }
+
+        if (calibrating) {
+            // Grow the samples quickly while they are far too short,
+            // then scale them to the wanted length
+            if (sample_elapsed >= sample_time) {
+                calibrating = false;
+            }
+            else if (sample_elapsed * 10 < sample_time) {
+                iterations_per_sample *= 10;
+            }
+            else {
+                double scale(double(sample_time.count()) / double(std::max(sample_elapsed.count(), clock::rep(1))));
+                iterations_per_sample = uint64_t(double(iterations_per_sample) * scale) + 1;
+                calibrating = false;
+            }
+        }
+        else {
+            sample_times.push_back(double(std::chrono::duration_cast<std::chrono::nanoseconds>(sample_elapsed).count())
+                                   / double(iterations_per_sample));
+            total_elapsed += sample_elapsed;
+            iterations += iterations_per_sample;
+        }
+
+        bool finished(sample_times.size() >= max_samples ||
+                      (sample_times.size() >= min_samples && total_elapsed >= min_time));
+        if (finished || is_skipped()) {
+            running = false;
+            return false;
+        }
+    }
+    else if (is_skipped()) {
+        return false;
+    }
+
+    running = true;
+    paused = false;
+    remaining = iterations_per_sample - 1;
+    sample_elapsed = clock::duration::zero();
+    sample_start = clock::now();
+    return true;
+}
+
+void bench::State::pause_timing() {
+    if (!paused) {
+        sample_elapsed += clock::now() - sample_start;
+        paused = true;
+    }
+}
+
+void bench::State::resume_timing() {
+    if (paused) {
+        paused = false;
+        sample_start = clock::now();
+    }
+}
+
+void bench::State::skip(const std::string &reason) {
+    skip_reason = reason.empty() ? "skipped" : reason;
+    remaining = 0;
+}
+
+double bench::State::get_mean_time() {
+    if (iterations == 0) {
+        return 0.0;
+    }
+    return double(std::chrono::duration_cast<std::chrono::nanoseconds>(total_elapsed).count()) / double(iterations);
+}
+
+
+
+std::vector<bench::Benchmark> &bench::get_benchmarks() {
+    // Lazy instantiation, as registrations run during static
+    // initialisation in any order
+    static std::vector<Benchmark> benchmarks;
+
+    return benchmarks;
+}
+
+bench::Registration::Registration(const char *name, Function function, bool needs_context) {
+    get_benchmarks().push_back(Benchmark{name, function, needs_context});
+}
+
+
+
+struct Result {
+    std::string name;
+    std::string skip_reason;
+    uint64_t iterations;
+    size_t samples;
+    double mean;
+    double min;
+    double p50;
+    double p99;
+    double max;
+};
+
+static Result run(const bench::Benchmark &benchmark, GameWindow *window, bench::clock::duration min_time) {
+    bench::State state(std::chrono::milliseconds(10), min_time, 10, 1000);
+    if (benchmark.needs_context && !window) {
+        state.skip("no GL context");
+    }
+    else {
+        try {
+            benchmark.function(state);
+        }
+        catch (std::exception &e) {
+            state.skip(std::string("failed: ") + e.what());
+        }
+    }
+
+    const std::vector<double> &times(state.get_sample_times());
+    Result result;
+    result.name = benchmark.name;
+    result.skip_reason = state.get_skip_reason();
+    result.iterations = state.get_iterations();
+    result.samples = times.size();
+    result.mean = state.get_mean_time();
+    result.min = times.empty() ? 0.0 : *std::min_element(std::begin(times), std::end(times));
+    result.p50 = report_format::get_percentile(times, 50.0f);
+    result.p99 = report_format::get_percentile(times, 99.0f);
+    result.max = times.empty() ? 0.0 : *std::max_element(std::begin(times), std::end(times));
+    return result;
+}
+
+static std::string to_json(const std::vector<Result> &results, const std::string &renderer) {
+    char date[32];
+    std::time_t now(std::time(nullptr));
+    std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&now));
+
+    std::ostringstream json;
+    json << std::fixed << std::setprecision(3)
+         << "{\n"
+         << "  \"context\": {\n"
+         << "    \"date\": " << report_format::quote(date) << ",\n"
+         << "    \"compiler\": " << report_format::quote(__VERSION__) << ",\n"
+#ifdef USE_GLES
+         << "    \"platform\": \"gles\",\n"
+#endif
+#ifdef USE_GL
+         << "    \"platform\": \"desktop\",\n"
+#endif
+         << "    \"renderer\": " << (renderer.empty() ? "null" : report_format::quote(renderer)) << "\n"
+         << "  },\n"
+         << "  \"benchmarks\": [";
+
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Result &result(results[i]);
+        json << (i == 0 ? "\n" : ",\n") << "    {\"name\": " << report_format::quote(result.name) << ", ";
+        if (!result.skip_reason.empty()) {
+            json << "\"skipped\": " << report_format::quote(result.skip_reason) << "}";
+            continue;
+        }
+        json << "\"iterations\": " << result.iterations << ", "
+             << "\"samples\": " << result.samples << ", "
+             << "\"ns_per_iteration\": {"
+             << "\"mean\": " << result.mean << ", "
+             << "\"min\": " << result.min << ", "
+             << "\"p50\": " << result.p50 << ", "
+             << "\"p99\": " << result.p99 << ", "
+             << "\"max\": " << result.max << "}}";
+    }
+
+    json << "\n  ]\n}\n";
+    return json.str();
+}
+
+static void print_usage(const char *program) {
+    std::cout << "Usage: " << program << " [--json FILE] [--min-time SECONDS] [FILTER...]" << std::endl
+              << "Runs the benchmarks whose names contain any FILTER, or all of them." << std::endl;
+}
+
+
+
+int main(int argc, const char *argv[]) {
+    std::string json_path;
+    bench::clock::duration min_time(std::chrono::milliseconds(500));
+    std::vector<std::string> filters;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string argument(argv[i]);
+        if (argument == "--json" && i + 1 < argc) {
+            json_path = argv[++i];
+        }
+        else if (argument == "--min-time" && i + 1 < argc) {
+            min_time = std::chrono::duration_cast<bench::clock::duration>(
+                std::chrono::duration<double>(std::atof(argv[++i])));
+        }
+        else if (argument == "--help" || (argument.size() > 1 && argument[0] == '-')) {
+            print_usage(argv[0]);
+            return argument == "--help" ? 0 : 1;
+        }
+        else {
+            filters.push_back(argument);
+        }
+    }
+
+    google::InitGoogleLogging(argv[0]);
+    // Logging from the code being timed would swamp it
+    FLAGS_minloglevel = google::WARNING;
+
+    // GL benchmarks draw into a headless window, so run anywhere
+    std::unique_ptr<GameWindow> window;
+    std::string renderer;
+    try {
+        window.reset(new GameWindow(800, 600, false, true));
+        window->use_context();
+        Engine::set_game_window(window.get());
+        renderer = reinterpret_cast<const char *>(glGetString(GL_RENDERER));
+    }
+    catch (GameWindow::InitException &e) {
+        LOG(WARNING) << "No headless window, so GL benchmarks are skipped: " << e.what();
+    }
+
+    std::vector<Result> results;
+    for (const bench::Benchmark &benchmark : bench::get_benchmarks()) {
+        bool selected(filters.empty() ||
+                      std::any_of(std::begin(filters), std::end(filters), [&] (const std::string &filter) {
+                          return std::string(benchmark.name).find(filter) != std::string::npos;
+                      }));
+        if (!selected) {
+            continue;
+        }
+
+        results.push_back(run(benchmark, window.get(), min_time));
+
+        const Result &result(results.back());
+        std::cout << std::left << std::setw(40) << result.name << std::right;
+        if (!result.skip_reason.empty()) {
+            std::cout << " skipped: " << result.skip_reason << std::endl;
+        }
+        else {
+            std::cout << std::fixed << std::setprecision(1)
+                      << std::setw(14) << result.mean << " ns"
+                      << "   p50 " << std::setw(12) << result.p50 << " ns"
+                      << "   p99 " << std::setw(12) << result.p99 << " ns"
+                      << "   (" << result.iterations << " iterations)" << std::endl;
+        }
+    }
+
+    if (!json_path.empty()) {
+        std::ofstream json(json_path);
+        json << to_json(results, renderer);
+        if (json.fail()) {
+            LOG(ERROR) << "Could not write the results to \"" << json_path << "\"";
+            return 1;
+        }
+        std::cout << "Wrote the results to " << json_path << std::endl;
+    }
+
+    Engine::set_game_window(nullptr);
+    return 0;
+}
@@ -0,0 +1,175 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+///
+/// A small microbenchmark harness.
+///
+/// Benchmarks are functions declared with BENCHMARK, or GL_BENCHMARK
+/// when they need a GL context, which do any setup and then repeat the
+/// code being timed while keep_running returns true:
+///
+///     BENCHMARK("fml/parse") {
+///         std::string text(...);
+///         while (state.keep_running()) {
+///             ...
+///         }
+///     }
+///
+/// The iterations are timed in samples of many iterations, so that the
+/// clock is read rarely. The number of iterations a sample is found by
+/// growing it until a sample takes long enough, and those samples are
+/// thrown away as warm up.
+///
+namespace bench {
+    using clock = std::chrono::steady_clock;
+
+    ///
+    /// Controls the repetitions of a benchmark, and times them.
+    ///
+    class State {
+    private:
+        ///
+        /// How long a sample should take
+        ///
+        clock::duration sample_time;
+
+        ///
+        /// How long the samples should take in total
+        ///
+        clock::duration min_time;
+
+        size_t min_samples;
+        size_t max_samples;
+
+        bool calibrating = true;
+        bool running = false;
+        bool paused = false;
+
+        uint64_t iterations_per_sample = 1;
+        uint64_t remaining = 0;
+
+        clock::time_point sample_start;
+        clock::duration sample_elapsed = clock::duration::zero();
+        clock::duration total_elapsed = clock::duration::zero();
+
+        uint64_t iterations = 0;
+
+        ///
+        /// The mean time of an iteration in each sample, in nanoseconds
+        ///
+        std::vector<double> sample_times;
+
+        std::string skip_reason;
+
+        ///
+        /// Finish the sample being run, and start another if there
+        /// should be one
+        ///
+        bool next_sample();
+
+    public:
+        State(clock::duration sample_time, clock::duration min_time, size_t min_samples, size_t max_samples);
+
+        ///
+        /// Whether to run another iteration
+        ///
+        bool keep_running() {
+            if (remaining > 0) {
+                --remaining;
+                return true;
+            }
+            return next_sample();
+        }
+
+        ///
+        /// Stop the clock, such as to set up the next iteration
+        ///
+        void pause_timing();
+
+        ///
+        /// Start the clock again
+        ///
+        void resume_timing();
+
+        ///
+        /// Give up on the benchmark, such as when what it needs is not
+        /// there. It is reported as skipped, and keep_running returns
+        /// false.
+        ///
+        void skip(const std::string &reason);
+
+        bool is_skipped() { return !skip_reason.empty(); }
+
+        const std::string &get_skip_reason() { return skip_reason; }
+
+        uint64_t get_iterations() { return iterations; }
+
+        const std::vector<double> &get_sample_times() { return sample_times; }
+
+        ///
+        /// Get the mean time of an iteration in nanoseconds
+        ///
+        double get_mean_time();
+    };
+
+    typedef void (*Function)(State &state);
+
+    struct Benchmark {
+        const char *name;
+        Function function;
+
+        ///
+        /// Whether the benchmark needs a GL context, which it is skipped
+        /// without
+        ///
+        bool needs_context;
+    };
+
+    ///
+    /// Get the benchmarks, in the order they were registered
+    ///
+    std::vector<Benchmark> &get_benchmarks();
+
+    ///
+    /// Registers a benchmark when constructed, for BENCHMARK
+    ///
+    class Registration {
+    public:
+        Registration(const char *name, Function function, bool needs_context);
+    };
+
+    ///
+    /// Stop the compiler from optimising away a value which is only
+    /// computed to be timed
+    ///
+    template <typename T>
+    inline void do_not_optimize(const T &value) {
+        asm volatile("" : : "r"(&value) : "memory");
+    }
+}
+
+#define BENCH_CONCATENATE_(a, b) a##b
+#define BENCH_CONCATENATE(a, b) BENCH_CONCATENATE_(a, b)
+
+#define BENCH_REGISTER(name, needs_context)                                                          \
+    static void BENCH_CONCATENATE(benchmark_, __LINE__)(bench::State &state);                        \
+    static bench::Registration BENCH_CONCATENATE(registration_, __LINE__)(                           \
+        name, BENCH_CONCATENATE(benchmark_, __LINE__), needs_context);                               \
+    static void BENCH_CONCATENATE(benchmark_, __LINE__)(bench::State &state)
+
+///
+/// Declare a benchmark, whose body follows
+///
+#define BENCHMARK(name) BENCH_REGISTER(name, false)
+
+///
+/// Declare a benchmark which needs a GL context, whose body follows
+///
+#define GL_BENCHMARK(name) BENCH_REGISTER(name, true)
+
+#endif
@@ -0,0 +1,84 @@
+#include <chrono>
+#include <glm/vec2.hpp>
+
+#include "bench.hpp"
+#include "dispatcher.hpp"
+#include "event_manager.hpp"
+#include "game_time.hpp"
+
+// Callbacks a dispatcher holds, as for a busy map event
+static const int callback_count = 100;
+
+// Events a frame, as many scripts running at once would queue
+static const int event_count = 5000;
+
+// Timed events in flight, as for many animations at once
+static const int timed_event_count = 2000;
+
+BENCHMARK("dispatcher/trigger") {
+    Dispatcher<int, int, int> dispatcher;
+    int calls(0);
+    for (int i = 0; i < callback_count; ++i) {
+        dispatcher.register_callback([&] (int, int, int) { ++calls; return true; });
+    }
+
+    while (state.keep_running()) {
+        dispatcher.trigger(1, 2, 3);
+    }
+    bench::do_not_optimize(calls);
+}
+
+// Trigger the tiles of a map in turn, with a callback on each
+BENCHMARK("position_dispatcher/trigger") {
+    glm::ivec2 size(128, 128);
+    PositionDispatcher<int> dispatcher(size);
+    int calls(0);
+    for (int x = 0; x < size.x; ++x) {
+        for (int y = 0; y < size.y; ++y) {
+            dispatcher.register_callback(glm::ivec2(x, y), [&] (int) { ++calls; return true; });
+        }
+    }
+
+    int i(0);
+    while (state.keep_running()) {
+        dispatcher.trigger(glm::ivec2(i % size.x, (i / size.x) % size.y), i);
+        ++i;
+    }
+    bench::do_not_optimize(calls);
+}
+
+// Run a frame of queued events
+BENCHMARK("event_manager/process_events/queued") {
+    EventManager &event_manager(EventManager::get_instance());
+    int calls(0);
+
+    while (state.keep_running()) {
+        state.pause_timing();
+        for (int i = 0; i < event_count; ++i) {
+            event_manager.add_event([&] () { ++calls; });
+        }
+        state.resume_timing();
+
+        event_manager.process_events();
+    }
+    bench::do_not_optimize(calls);
+}
+
+// Run a frame of timed events, each of which queues itself again
+BENCHMARK("event_manager/process_events/timed") {
+    EventManager &event_manager(EventManager::get_instance());
+    int calls(0);
+    for (int i = 0; i < timed_event_count; ++i) {
+        event_manager.add_timed_event(std::chrono::hours(1), [&] (float) { ++calls; return true; });
+    }
+    // Starts them
+    event_manager.process_events();
+
+    while (state.keep_running()) {
+        event_manager.process_events();
+    }
+    bench::do_not_optimize(calls);
+
+    event_manager.flush_and_disable();
+    event_manager.reenable();
+}
@@ -0,0 +1,47 @@
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+
+#include "bench.hpp"
+#include "fml.hpp"
+
+static void parse(bench::State &state, const std::string &text) {
+    while (state.keep_running()) {
+        std::istringstream input(text);
+        std::map<std::string, std::string> output;
+        bool error(fml::from_stream(input, output));
+        bench::do_not_optimize(error);
+        bench::do_not_optimize(output);
+    }
+}
+
+// The largest shipped file, a flat list of tile names, as read when
+// any atlas is first used
+BENCHMARK("fml/parse/tile_names") {
+    std::ifstream file("../resources/tiles/associated_texture_atlas.fml");
+    if (file.fail()) {
+        state.skip("could not open associated_texture_atlas.fml");
+        return;
+    }
+    std::stringstream text;
+    text << file.rdbuf();
+
+    parse(state, text.str());
+}
+
+// Indented directories with several files to a line and comments
+BENCHMARK("fml/parse/nested") {
+    std::ostringstream text;
+    for (int i = 0; i < 20; ++i) {
+        text << "section_" << i << "/\n"
+             << "    # Section " << i << "\n";
+        for (int j = 0; j < 10; ++j) {
+            text << "    group_" << j << "/\n"
+                 << "        width: " << i * j << " height: " << i + j << " name: tile_" << j << "\n"
+                 << "        deeper/path/value: " << i << "\n";
+        }
+    }
+
+    parse(state, text.str());
+}
@@ -0,0 +1,227 @@
+#include <glm/vec2.hpp>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "bench.hpp"
+#include "layer.hpp"
+#include "map.hpp"
+#include "object_manager.hpp"
+#include "resource_cache.hpp"
+#include "texture_atlas.hpp"
+#include "tileset.hpp"
+
+// The largest shipped map. Its ground is dense, and its other layers
+// mostly blank, so sparse.
+static const std::string map_path("../maps/introduction.tmx");
+
+// Maps log their failure to load, and are left empty
+static bool is_loaded(bench::State &state, Map &map) {
+    if (map.get_layers().empty()) {
+        state.skip("could not load " + map_path);
+        return false;
+    }
+    return true;
+}
+
+static std::shared_ptr<Layer> find_layer(Map &map, Layer::Packing packing) {
+    for (int layer_id : map.get_layers()) {
+        std::shared_ptr<Layer> layer(ObjectManager::get_instance().get_object<Layer>(layer_id));
+        if (layer && layer->get_packing() == packing) {
+            return layer;
+        }
+    }
+    return nullptr;
+}
+
+// The positions of a layer which hold a tile, or which are blank
+static std::vector<glm::ivec2> find_tiles(Map &map, std::shared_ptr<Layer> layer, bool blank) {
+    std::vector<glm::ivec2> tiles;
+    for (int x = 0; x < map.get_width(); ++x) {
+        for (int y = 0; y < map.get_height(); ++y) {
+            if (bool(layer->get_tile(x, y).first) != blank) {
+                tiles.push_back(glm::ivec2(x, y));
+            }
+        }
+    }
+    return tiles;
+}
+
+// Overwrite the tiles of a layer with the packing in turn
+static void update_tiles(bench::State &state, Layer::Packing packing) {
+    Map map(map_path);
+    if (!is_loaded(state, map)) {
+        return;
+    }
+    std::shared_ptr<Layer> layer(find_layer(map, packing));
+    if (!layer) {
+        state.skip("no layer with that packing in " + map_path);
+        return;
+    }
+
+    std::vector<glm::ivec2> tiles(find_tiles(map, layer, false));
+    if (tiles.empty()) {
+        state.skip("no tiles in " + layer->get_name());
+        return;
+    }
+    std::string tile_name(map.query_tile(tiles[0].x, tiles[0].y, layer->get_name()));
+
+    size_t i(0);
+    while (state.keep_running()) {
+        glm::ivec2 tile(tiles[i++ % tiles.size()]);
+        map.update_tile(tile.x, tile.y, layer->get_name(), tile_name);
+    }
+}
+
+GL_BENCHMARK("map/update_tile/dense") {
+    update_tiles(state, Layer::Packing::DENSE);
+}
+
+GL_BENCHMARK("map/update_tile/sparse") {
+    update_tiles(state, Layer::Packing::SPARSE);
+}
+
+// Fill the blank tiles of a sparse layer, which grows its buffer
+GL_BENCHMARK("map/update_tile/sparse_insert") {
+    std::unique_ptr<Map> map(new Map(map_path));
+    if (!is_loaded(state, *map)) {
+        return;
+    }
+    std::shared_ptr<Layer> layer(find_layer(*map, Layer::Packing::SPARSE));
+    if (!layer) {
+        state.skip("no sparse layer in " + map_path);
+        return;
+    }
+
+    std::string layer_name(layer->get_name());
+    std::vector<glm::ivec2> tiles(find_tiles(*map, layer, false));
+    std::vector<glm::ivec2> blanks(find_tiles(*map, layer, true));
+    if (tiles.empty() || blanks.empty()) {
+        state.skip("no tiles or no blanks in " + layer_name);
+        return;
+    }
+    std::string tile_name(map->query_tile(tiles[0].x, tiles[0].y, layer_name));
+    layer.reset();
+
+    size_t i(0);
+    while (state.keep_running()) {
+        if (i == blanks.size()) {
+            // Start again with a fresh map once every blank is filled
+            state.pause_timing();
+            map.reset();
+            map.reset(new Map(map_path));
+            i = 0;
+            state.resume_timing();
+        }
+
+        glm::ivec2 tile(blanks[i++]);
+        map->update_tile(tile.x, tile.y, layer_name, tile_name);
+    }
+}
+
+// While it exists, maps load onto atlas pages of a limited size, as on
+// GPUs with small textures. Atlases kept loaded would be reused whatever
+// their size, so those nothing uses are released on the way in and out.
+class SmallAtlasPages {
+private:
+    size_t retention_budget;
+
+public:
+    SmallAtlasPages(int page_size):
+        retention_budget(ResourceCache<TextureAtlas>::get_retention_budget()) {
+        TextureAtlas::set_retention_budget(0);
+        TextureAtlas::set_max_page_size(page_size);
+    }
+
+    ~SmallAtlasPages() {
+        TextureAtlas::set_max_page_size(0);
+        TextureAtlas::set_retention_budget(0);
+        TextureAtlas::set_retention_budget(retention_budget);
+    }
+};
+
+static int get_page(std::shared_ptr<Layer> layer, glm::ivec2 tile) {
+    std::pair<std::shared_ptr<TileSet>, int> tile_data(layer->get_tile(tile.x, tile.y));
+    return tile_data.first->get_atlas()->index_to_page(tile_data.second);
+}
+
+// Overwrite the tiles of a dense layer whose tiles are on several pages
+// with tiles from two pages. Each tile changes page every other pass, so
+// half the updates patch a quad in place and half move it to another
+// page run.
+GL_BENCHMARK("map/update_tile/paged") {
+    SmallAtlasPages small_pages(256);
+    std::unique_ptr<Map> map(new Map(map_path));
+    if (!is_loaded(state, *map)) {
+        return;
+    }
+    std::shared_ptr<Layer> layer(find_layer(*map, Layer::Packing::DENSE));
+    if (!layer) {
+        state.skip("no dense layer in " + map_path);
+        return;
+    }
+    if (layer->get_chunks().empty() || layer->get_chunks()[0].page_num_quads.empty()) {
+        state.skip("the tiles of " + layer->get_name() + " are on one page");
+        return;
+    }
+
+    std::vector<glm::ivec2> tiles(find_tiles(*map, layer, false));
+    std::vector<std::string> tile_names;
+    for (glm::ivec2 tile : tiles) {
+        if (tile_names.empty() || get_page(layer, tile) != get_page(layer, tiles[0])) {
+            tile_names.push_back(map->query_tile(tile.x, tile.y, layer->get_name()));
+        }
+        if (tile_names.size() == 2) {
+            break;
+        }
+    }
+    if (tile_names.size() < 2) {
+        state.skip("the tiles of " + layer->get_name() + " are all on one page");
+        return;
+    }
+
+    size_t i(0);
+    while (state.keep_running()) {
+        size_t tile_index(i % tiles.size());
+        size_t pass(i / tiles.size());
+        glm::ivec2 tile(tiles[tile_index]);
+        map->update_tile(tile.x, tile.y, layer->get_name(), tile_names[(tile_index + pass / 2) % 2]);
+        ++i;
+    }
+}
+
+GL_BENCHMARK("map/is_walkable") {
+    Map map(map_path);
+    if (!is_loaded(state, map)) {
+        return;
+    }
+    int width(map.get_width());
+    int height(map.get_height());
+
+    int i(0);
+    while (state.keep_running()) {
+        bool walkable(map.is_walkable(i % width, (i / width) % height));
+        bench::do_not_optimize(walkable);
+        ++i;
+    }
+}
+
+// Block and unblock tiles, as moving objects do
+GL_BENCHMARK("map/blocker_churn") {
+    Map map(map_path);
+    if (!is_loaded(state, map)) {
+        return;
+    }
+    int width(map.get_width());
+    int height(map.get_height());
+
+    int i(0);
+    while (state.keep_running()) {
+        glm::ivec2 tile(i % width, (i / width) % height);
+        Map::Blocker blocker(map.block_tile(tile));
+        Map::Blocker copy(blocker);
+        bench::do_not_optimize(copy);
+        ++i;
+    }
+}
@@ -0,0 +1,52 @@
+#include <memory>
+#include <vector>
+
+#include "bench.hpp"
+#include "layer.hpp"
+#include "object.hpp"
+#include "object_manager.hpp"
+
+// Objects in the manager, as on a busy map
+static const int object_count = 1000;
+
+// Owns objects in the object manager for a benchmark
+class ManagedObjects {
+public:
+    std::vector<int> ids;
+
+    ManagedObjects() {
+        for (int i = 0; i < object_count; ++i) {
+            std::shared_ptr<Object> object(std::make_shared<Object>("bench"));
+            ObjectManager::get_instance().add_object(object);
+            ids.push_back(object->get_id());
+        }
+    }
+
+    ~ManagedObjects() {
+        for (int id : ids) {
+            ObjectManager::get_instance().remove_object(id);
+        }
+    }
+};
+
+// Objects have renderable components, which make GL buffers
+GL_BENCHMARK("object_manager/get_object") {
+    ManagedObjects objects;
+
+    size_t i(0);
+    while (state.keep_running()) {
+        std::shared_ptr<Object> object(ObjectManager::get_instance().get_object<Object>(objects.ids[i++ % objects.ids.size()]));
+        bench::do_not_optimize(object);
+    }
+}
+
+// Looking an object up as the wrong type fails in the cast
+GL_BENCHMARK("object_manager/get_object/wrong_type") {
+    ManagedObjects objects;
+
+    size_t i(0);
+    while (state.keep_running()) {
+        std::shared_ptr<Layer> layer(ObjectManager::get_instance().get_object<Layer>(objects.ids[i++ % objects.ids.size()]));
+        bench::do_not_optimize(layer);
+    }
+}
@@ -0,0 +1,42 @@
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "animation_frames.hpp"
+#include "bench.hpp"
+#include "texture_atlas.hpp"
+
+// The tilesets the shipped maps merge
+static const std::vector<std::string> image_paths({
+    "../resources/tiles/ground.png",
+    "../resources/tiles/gui.png",
+    "../resources/tiles/interactable.png",
+    "../resources/tiles/people.png",
+    "../resources/tiles/walls.png"
+});
+
+// Merge the same atlases again and again, which lays them out, copies
+// their units and uploads the pages each time
+GL_BENCHMARK("texture_atlas/merge") {
+    std::vector<std::shared_ptr<TextureAtlas>> atlases;
+    for (const std::string &image_path : image_paths) {
+        atlases.push_back(std::make_shared<TextureAtlas>(image_path));
+    }
+
+    while (state.keep_running()) {
+        TextureAtlas::merge(atlases);
+    }
+}
+
+// Step through an animation, as sprites and map objects do each frame
+GL_BENCHMARK("animation_frames/get_frame") {
+    AnimationFrames frames("gui");
+
+    int i(0);
+    while (state.keep_running()) {
+        std::pair<int, std::string> frame(frames.get_frame("clouds", float(i % 100) / 100.0f));
+        bench::do_not_optimize(frame);
+        ++i;
+    }
+}
@@ -0,0 +1,395 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <glog/logging.h>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+extern "C" {
+#ifdef USE_GLES
+#include <GLES2/gl2.h>
+#endif
+#ifdef USE_GL
+#define GL_GLEXT_PROTOTYPES
+#include <GL/gl.h>
+#endif
+}
+
+#include "animation_frames.hpp"
+#include "bench.hpp"
+#include "engine.hpp"
+#include "game_window.hpp"
+#include "gpu_memory.hpp"
+#include "gui_manager.hpp"
+#include "layer.hpp"
+#include "map.hpp"
+#include "map_object.hpp"
+#include "map_viewer.hpp"
+#include "object_manager.hpp"
+#include "report_format.hpp"
+#include "sprite.hpp"
+#include "stress_map.hpp"
+#include "walkability.hpp"
+
+// Where the maps are written before they are loaded
+static const std::string map_path("bench/stress_map.tmx");
+
+struct Result {
+    int size;
+    size_t dense_layers;
+    size_t sparse_layers;
+    size_t objects;
+    size_t sprites;
+    double load_ms;
+    double populate_ms;
+    long resident_bytes;
+    long gpu_bytes;
+    double first_frame_ms;
+    double frame_mean_ms;
+    double frame_p50_ms;
+    double frame_p99_ms;
+};
+
+using report_format::to_milliseconds;
+
+// The resident set size of this process, from the second field of statm
+static long get_resident_bytes() {
+    std::ifstream statm("/proc/self/statm");
+    long size(0);
+    long resident(0);
+    statm >> size >> resident;
+    return resident * sysconf(_SC_PAGESIZE);
+}
+
+// Split a comma-separated list, as for --sizes
+template <typename T>
+static std::vector<T> parse_list(const std::string &text) {
+    std::vector<T> values;
+    std::istringstream input(text);
+    std::string item;
+    while (std::getline(input, item, ',')) {
+        std::istringstream item_input(item);
+        T value;
+        if (item_input >> value) {
+            values.push_back(value);
+        }
+    }
+    return values;
+}
+
+// Split a tile name such as "people/crocodile/land/east/still/1" into
+// the root of its animation and its frame
+static std::pair<std::string, std::string> split_tile(const std::string &tile_name) {
+    size_t slash(tile_name.rfind('/'));
+    return std::make_pair(tile_name.substr(0, slash), tile_name.substr(slash + 1));
+}
+
+// Make the objects and sprites named in the map's "Objects" group, as
+// challenges do
+static void populate(Map &map, MapViewer &map_viewer, std::vector<int> &object_ids, std::vector<int> &sprite_ids) {
+    for (const auto &location : map.locations) {
+        const std::string &name(location.first);
+        std::pair<std::string, std::string> tile(split_tile(location.second.tileset));
+
+        if (name.compare(0, 15, "Objects/object/") == 0) {
+            std::shared_ptr<MapObject> object(std::make_shared<MapObject>(
+                location.second.location, name, Walkability::WALKABLE, AnimationFrames(tile.first), tile.second));
+            ObjectManager::get_instance().add_object(object);
+            object_ids.push_back(object->get_id());
+            map.add_map_object(object->get_id());
+        }
+        else if (name.compare(0, 15, "Objects/sprite/") == 0) {
+            std::shared_ptr<Sprite> sprite(std::make_shared<Sprite>(
+                location.second.location, name, Walkability::BLOCKED, AnimationFrames(tile.first), tile.second));
+            ObjectManager::get_instance().add_object(sprite);
+            sprite_ids.push_back(sprite->get_id());
+            map.add_sprite(sprite->get_id());
+        }
+    }
+
+    if (!sprite_ids.empty()) {
+        map_viewer.set_map_focus_object(sprite_ids.front());
+    }
+}
+
+static bool measure(int size, const stress_map::Settings &base_settings, int frames,
+                    GameWindow &window, MapViewer &map_viewer, Result &result) {
+    stress_map::Settings settings(base_settings);
+    settings.width = size;
+    settings.height = size;
+    if (!stress_map::write(map_path, settings)) {
+        return false;
+    }
+
+    result = Result();
+    result.size = size;
+
+    long resident_before(get_resident_bytes());
+    long gpu_before(long(GPUMemory::get_current().get_total_bytes()));
+
+    bench::clock::time_point load_start(bench::clock::now());
+    Map *map(new Map(map_path));
+    map_viewer.set_map(map);
+    result.load_ms = to_milliseconds(bench::clock::now() - load_start);
+
+    if (map->get_layers().empty()) {
+        LOG(ERROR) << "Could not load the " << size << "x" << size << " stress map";
+        map_viewer.set_map(nullptr);
+        delete map;
+        return false;
+    }
+
+    for (int layer_id : map->get_layers()) {
+        std::shared_ptr<Layer> layer(ObjectManager::get_instance().get_object<Layer>(layer_id));
+        if (layer && layer->get_packing() == Layer::Packing::SPARSE) {
+            ++result.sparse_layers;
+        }
+        else {
+            ++result.dense_layers;
+        }
+    }
+
+    std::vector<int> object_ids;
+    std::vector<int> sprite_ids;
+    bench::clock::time_point populate_start(bench::clock::now());
+    populate(*map, map_viewer, object_ids, sprite_ids);
+    result.populate_ms = to_milliseconds(bench::clock::now() - populate_start);
+    result.objects = object_ids.size();
+    result.sprites = sprite_ids.size();
+
+    result.resident_bytes = get_resident_bytes() - resident_before;
+    result.gpu_bytes = long(GPUMemory::get_current().get_total_bytes()) - gpu_before;
+
+    // The first frame fills the layer caches, so is reported apart.
+    // Swapping a headless window finishes the frame, so the GPU's time
+    // is counted too.
+    std::vector<double> frame_times;
+    for (int i = 0; i <= frames; ++i) {
+        bench::clock::time_point frame_start(bench::clock::now());
+        map_viewer.render();
+        window.swap_buffers();
+        double frame_ms(to_milliseconds(bench::clock::now() - frame_start));
+
+        if (i == 0) {
+            result.first_frame_ms = frame_ms;
+        }
+        else {
+            frame_times.push_back(frame_ms);
+            result.frame_mean_ms += frame_ms / double(frames);
+        }
+    }
+    result.frame_p50_ms = report_format::get_percentile(frame_times, 50.0f);
+    result.frame_p99_ms = report_format::get_percentile(frame_times, 99.0f);
+
+    // Clean up as a challenge does
+    for (int sprite_id : sprite_ids) {
+        ObjectManager::get_instance().remove_object(sprite_id);
+    }
+    for (int object_id : object_ids) {
+        ObjectManager::get_instance().remove_object(object_id);
+    }
+    map_viewer.set_map(nullptr);
+    delete map;
+
+    return true;
+}
+
+static std::string to_json(const std::vector<Result> &results, const stress_map::Settings &settings,
+                           int frames, const std::string &renderer) {
+    char date[32];
+    std::time_t now(std::time(nullptr));
+    std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&now));
+
+    std::ostringstream json;
+    json << std::fixed << std::setprecision(3)
+         << "{\n"
+         << "  \"context\": {\n"
+         << "    \"date\": " << report_format::quote(date) << ",\n"
+         << "    \"compiler\": " << report_format::quote(__VERSION__) << ",\n"
+#ifdef USE_GLES
+         << "    \"platform\": \"gles\",\n"
+#endif
+#ifdef USE_GL
+         << "    \"platform\": \"desktop\",\n"
+#endif
+         << "    \"renderer\": " << (renderer.empty() ? "null" : report_format::quote(renderer)) << ",\n"
+         << "    \"blank_densities\": [";
+    for (size_t i = 0; i < settings.blank_densities.size(); ++i) {
+        json << (i == 0 ? "" : ", ") << settings.blank_densities[i];
+    }
+    json << "],\n"
+         << "    \"frames\": " << frames << ",\n"
+         << "    \"seed\": " << settings.seed << "\n"
+         << "  },\n"
+         << "  \"maps\": [";
+
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Result &result(results[i]);
+        json << (i == 0 ? "\n" : ",\n")
+             << "    {\"width\": " << result.size << ", \"height\": " << result.size << ", "
+             << "\"dense_layers\": " << result.dense_layers << ", "
+             << "\"sparse_layers\": " << result.sparse_layers << ", "
+             << "\"objects\": " << result.objects << ", "
+             << "\"sprites\": " << result.sprites << ", "
+             << "\"load_ms\": " << result.load_ms << ", "
+             << "\"populate_ms\": " << result.populate_ms << ", "
+             << "\"resident_bytes\": " << result.resident_bytes << ", "
+             << "\"gpu_bytes\": " << result.gpu_bytes << ", "
+             << "\"frame_ms\": {"
+             << "\"first\": " << result.first_frame_ms << ", "
+             << "\"mean\": " << result.frame_mean_ms << ", "
+             << "\"p50\": " << result.frame_p50_ms << ", "
+             << "\"p99\": " << result.frame_p99_ms << "}}";
+    }
+
+    json << "\n  ]\n}\n";
+    return json.str();
+}
+
+static void print_usage(const char *program) {
+    std::cout << "Usage: " << program << " [OPTION...]" << std::endl
+              << "Loads generated maps of each size headlessly, and reports how long they take to" << std::endl
+              << "load and draw and how much memory they use." << std::endl
+              << std::endl
+              << "  --sizes N,N,...      the widths and heights of the maps (64,128,256,512,1024)" << std::endl
+              << "  --blank F,F,...      the fraction of blank tiles of each layer, bottom first;" << std::endl
+              << "                       more than 0.5 packs a layer sparsely (0,0.3,0.9,0.98)" << std::endl
+              << "  --objects N          map objects on each map (100)" << std::endl
+              << "  --sprites N          sprites on each map (10)" << std::endl
+              << "  --frames N           frames to time on each map (100)" << std::endl
+              << "  --seed N             seeds the placement of tiles and objects (1)" << std::endl
+              << "  --json FILE          write the results to FILE" << std::endl
+              << "  --generate FILE      only write a map of the first size to FILE" << std::endl;
+}
+
+
+
+int main(int argc, const char *argv[]) {
+    std::vector<int> sizes({64, 128, 256, 512, 1024});
+    stress_map::Settings settings;
+    settings.objects = 100;
+    settings.sprites = 10;
+    int frames(100);
+    std::string json_path;
+    std::string generate_path;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string argument(argv[i]);
+        bool has_value(i + 1 < argc);
+        if (argument == "--sizes" && has_value) {
+            sizes = parse_list<int>(argv[++i]);
+        }
+        else if (argument == "--blank" && has_value) {
+            settings.blank_densities = parse_list<float>(argv[++i]);
+        }
+        else if (argument == "--objects" && has_value) {
+            settings.objects = std::atoi(argv[++i]);
+        }
+        else if (argument == "--sprites" && has_value) {
+            settings.sprites = std::atoi(argv[++i]);
+        }
+        else if (argument == "--frames" && has_value) {
+            frames = std::atoi(argv[++i]);
+        }
+        else if (argument == "--seed" && has_value) {
+            settings.seed = (unsigned int)std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (argument == "--json" && has_value) {
+            json_path = argv[++i];
+        }
+        else if (argument == "--generate" && has_value) {
+            generate_path = argv[++i];
+        }
+        else {
+            print_usage(argv[0]);
+            return argument == "--help" ? 0 : 1;
+        }
+    }
+
+    if (sizes.empty() || settings.blank_densities.empty() || frames < 1) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    google::InitGoogleLogging(argv[0]);
+    // Loading large maps logs a lot at INFO
+    FLAGS_minloglevel = google::WARNING;
+
+    if (!generate_path.empty()) {
+        settings.width = sizes.front();
+        settings.height = sizes.front();
+        return stress_map::write(generate_path, settings) ? 0 : 1;
+    }
+
+    std::unique_ptr<GameWindow> window;
+    try {
+        window.reset(new GameWindow(800, 600, false, true));
+    }
+    catch (GameWindow::InitException &e) {
+        LOG(ERROR) << "Could not create a headless window: " << e.what();
+        return 1;
+    }
+    window->use_context();
+    Engine::set_game_window(window.get());
+    std::string renderer(reinterpret_cast<const char *>(glGetString(GL_RENDERER)));
+
+    std::vector<Result> results;
+    {
+        GUIManager gui_manager;
+        MapViewer map_viewer(window.get(), &gui_manager);
+        Engine::set_map_viewer(&map_viewer);
+
+        std::cout << std::setw(6) << "size" << std::setw(8) << "layers" << std::setw(9) << "objects"
+                  << std::setw(11) << "load ms" << std::setw(13) << "populate ms" << std::setw(10) << "RSS MiB"
+                  << std::setw(10) << "GPU MiB" << std::setw(13) << "1st frame ms"
+                  << std::setw(11) << "frame ms" << std::setw(9) << "p99 ms" << std::endl;
+
+        for (int size : sizes) {
+            Result result;
+            if (!measure(size, settings, frames, *window, map_viewer, result)) {
+                LOG(ERROR) << "Stopping at the " << size << "x" << size << " map";
+                break;
+            }
+            results.push_back(result);
+
+            std::ostringstream layers;
+            layers << result.dense_layers << "d+" << result.sparse_layers << "s";
+            std::cout << std::fixed << std::setprecision(1)
+                      << std::setw(6) << size
+                      << std::setw(8) << layers.str()
+                      << std::setw(9) << result.objects + result.sprites
+                      << std::setw(11) << result.load_ms
+                      << std::setw(13) << result.populate_ms
+                      << std::setw(10) << double(result.resident_bytes) / (1024.0 * 1024.0)
+                      << std::setw(10) << double(result.gpu_bytes) / (1024.0 * 1024.0)
+                      << std::setw(13) << result.first_frame_ms
+                      << std::setprecision(2)
+                      << std::setw(11) << result.frame_mean_ms
+                      << std::setw(9) << result.frame_p99_ms << std::endl;
+        }
+
+        Engine::set_map_viewer(nullptr);
+    }
+    std::remove(map_path.c_str());
+
+    if (!json_path.empty()) {
+        std::ofstream json(json_path);
+        json << to_json(results, settings, frames, renderer);
+        if (json.fail()) {
+            LOG(ERROR) << "Could not write the results to \"" << json_path << "\"";
+            return 1;
+        }
+        std::cout << "Wrote the results to " << json_path << std::endl;
+    }
+
+    Engine::set_game_window(nullptr);
+    return results.size() == sizes.size() ? 0 : 1;
+}
@@ -0,0 +1,209 @@
+#include <cstdint>
+#include <fstream>
+#include <glog/logging.h>
+#include <map>
+#include <ostream>
+#include <random>
+#include <string>
+#include <vector>
+#include <zlib.h>
+
+#include "engine.hpp"
+#include "fml.hpp"
+#include "stress_map.hpp"
+
+namespace {
+    struct Tileset {
+        std::string name;
+        int width;
+        int height;
+        int first_gid;
+        int tile_count;
+        std::map<std::string, int> names_to_indexes;
+    };
+
+    // Read the size of a PNG from its header
+    bool read_png_size(const std::string &path, int &width, int &height) {
+        std::ifstream file(path, std::ios::binary);
+        unsigned char header[24];
+        if (!file.read(reinterpret_cast<char *>(header), sizeof(header))) {
+            return false;
+        }
+
+        // The IHDR chunk comes first, with big-endian dimensions
+        auto read_int([&] (int offset) {
+            return int(uint32_t(header[offset]) << 24 | uint32_t(header[offset + 1]) << 16
+                       | uint32_t(header[offset + 2]) << 8 | uint32_t(header[offset + 3]));
+        });
+        width = read_int(16);
+        height = read_int(20);
+        return width > 0 && height > 0;
+    }
+
+    bool load_tileset(const std::string &name, int first_gid, Tileset &tileset) {
+        tileset.name = name;
+        tileset.first_gid = first_gid;
+
+        if (!read_png_size("../resources/tiles/" + name + ".png", tileset.width, tileset.height)) {
+            LOG(ERROR) << "Could not read the size of tileset \"" << name << "\"";
+            return false;
+        }
+        int tile_size(Engine::get_tile_size());
+        tileset.tile_count = (tileset.width / tile_size) * (tileset.height / tile_size);
+
+        std::ifstream names("../resources/tiles/" + name + ".fml");
+        if (names.fail() || fml::from_stream(names, tileset.names_to_indexes)) {
+            LOG(ERROR) << "Could not read the tile names of tileset \"" << name << "\"";
+            return false;
+        }
+        return tileset.tile_count > 0;
+    }
+
+    // The global ID of a named tile
+    int get_gid(const std::vector<Tileset> &tilesets, const std::string &tile_name) {
+        for (const Tileset &tileset : tilesets) {
+            auto index(tileset.names_to_indexes.find(tile_name));
+            if (index != std::end(tileset.names_to_indexes)) {
+                return tileset.first_gid + index->second;
+            }
+        }
+        return 0;
+    }
+
+    std::string encode_base64(const std::vector<unsigned char> &data) {
+        static const char digits[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+        std::string encoded;
+        encoded.reserve((data.size() + 2) / 3 * 4);
+        for (size_t i = 0; i < data.size(); i += 3) {
+            uint32_t group(uint32_t(data[i]) << 16);
+            if (i + 1 < data.size()) { group |= uint32_t(data[i + 1]) << 8; }
+            if (i + 2 < data.size()) { group |= uint32_t(data[i + 2]); }
+
+            encoded += digits[(group >> 18) & 0x3f];
+            encoded += digits[(group >> 12) & 0x3f];
+            encoded += i + 1 < data.size() ? digits[(group >> 6) & 0x3f] : '=';
+            encoded += i + 2 < data.size() ? digits[group & 0x3f] : '=';
+        }
+        return encoded;
+    }
+
+    // Encode global tile IDs as TMX layer data: little-endian, zlib
+    // compressed, then base64
+    bool encode_layer(const std::vector<uint32_t> &gids, std::string &encoded) {
+        std::vector<unsigned char> raw;
+        raw.reserve(gids.size() * 4);
+        for (uint32_t gid : gids) {
+            raw.push_back(static_cast<unsigned char>(gid));
+            raw.push_back(static_cast<unsigned char>(gid >> 8));
+            raw.push_back(static_cast<unsigned char>(gid >> 16));
+            raw.push_back(static_cast<unsigned char>(gid >> 24));
+        }
+
+        uLongf compressed_size(compressBound(uLong(raw.size())));
+        std::vector<unsigned char> compressed(compressed_size);
+        if (compress2(compressed.data(), &compressed_size, raw.data(), uLong(raw.size()), Z_BEST_SPEED) != Z_OK) {
+            return false;
+        }
+        compressed.resize(compressed_size);
+
+        encoded = encode_base64(compressed);
+        return true;
+    }
+}
+
+bool stress_map::write(const std::string &path, const Settings &settings) {
+    if (settings.width < 1 || settings.height < 1 || settings.width > max_size || settings.height > max_size) {
+        LOG(ERROR) << "Stress maps must be from 1x1 to " << max_size << "x" << max_size;
+        return false;
+    }
+
+    // The ground and walls tile the layers, and the objects and
+    // sprites come from the others
+    std::vector<Tileset> tilesets;
+    int first_gid(1);
+    for (const std::string name : {"ground", "walls", "interactable", "people"}) {
+        Tileset tileset;
+        if (!load_tileset(name, first_gid, tileset)) {
+            return false;
+        }
+        first_gid += tileset.tile_count;
+        tilesets.push_back(tileset);
+    }
+
+    int object_gid(get_gid(tilesets, object_tile));
+    int sprite_gid(get_gid(tilesets, sprite_tile));
+    if (object_gid == 0 || sprite_gid == 0) {
+        LOG(ERROR) << "The tiles of stress map objects and sprites are missing";
+        return false;
+    }
+
+    std::ofstream file(path);
+    if (file.fail()) {
+        LOG(ERROR) << "Could not open \"" << path << "\" to write a stress map";
+        return false;
+    }
+
+    int tile_size(Engine::get_tile_size());
+    std::mt19937 random(settings.seed);
+    std::uniform_real_distribution<float> chance(0.0f, 1.0f);
+
+    file << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+         << "<map version=\"1.0\" orientation=\"orthogonal\" width=\"" << settings.width << "\" "
+         << "height=\"" << settings.height << "\" tilewidth=\"" << tile_size << "\" tileheight=\"" << tile_size << "\">\n";
+
+    for (const Tileset &tileset : tilesets) {
+        file << " <tileset firstgid=\"" << tileset.first_gid << "\" name=\"" << tileset.name << "\" "
+             << "tilewidth=\"" << tile_size << "\" tileheight=\"" << tile_size << "\">\n"
+             << "  <image source=\"../resources/tiles/" << tileset.name << ".png\" "
+             << "width=\"" << tileset.width << "\" height=\"" << tileset.height << "\"/>\n"
+             << " </tileset>\n";
+    }
+
+    for (size_t layer = 0; layer < settings.blank_densities.size(); ++layer) {
+        // Walls on every other layer above the ground
+        const Tileset &tileset(tilesets[layer % 2]);
+        std::uniform_int_distribution<int> tile(0, tileset.tile_count - 1);
+
+        std::vector<uint32_t> gids(size_t(settings.width) * size_t(settings.height), 0);
+        for (uint32_t &gid : gids) {
+            if (chance(random) >= settings.blank_densities[layer]) {
+                gid = uint32_t(tileset.first_gid + tile(random));
+            }
+        }
+
+        std::string encoded;
+        if (!encode_layer(gids, encoded)) {
+            LOG(ERROR) << "Could not compress layer " << layer << " of a stress map";
+            return false;
+        }
+
+        file << " <layer name=\"" << (layer == 0 ? std::string("Ground") : "Layer " + std::to_string(layer)) << "\" "
+             << "width=\"" << settings.width << "\" height=\"" << settings.height << "\">\n"
+             << "  <data encoding=\"base64\" compression=\"zlib\">\n"
+             << "   " << encoded << "\n"
+             << "  </data>\n"
+             << " </layer>\n";
+    }
+
+    // Tile objects are placed by their bottom-left corner
+    std::uniform_int_distribution<int> x(0, settings.width - 1);
+    std::uniform_int_distribution<int> y(1, settings.height);
+    file << " <objectgroup name=\"Objects\" width=\"" << settings.width << "\" height=\"" << settings.height << "\">\n";
+    for (int i = 0; i < settings.objects; ++i) {
+        file << "  <object name=\"object/" << i << "\" gid=\"" << object_gid << "\" "
+             << "x=\"" << x(random) * tile_size << "\" y=\"" << y(random) * tile_size << "\"/>\n";
+    }
+    for (int i = 0; i < settings.sprites; ++i) {
+        file << "  <object name=\"sprite/" << i << "\" gid=\"" << sprite_gid << "\" "
+             << "x=\"" << x(random) * tile_size << "\" y=\"" << y(random) * tile_size << "\"/>\n";
+    }
+    file << " </objectgroup>\n"
+         << "</map>\n";
+
+    if (file.fail()) {
+        LOG(ERROR) << "Could not write the stress map \"" << path << "\"";
+        return false;
+    }
+    return true;
+}
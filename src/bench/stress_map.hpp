@@ -0,0 +1,70 @@
+#ifndef STRESS_MAP_H
+#define STRESS_MAP_H
+
+#include <string>
+#include <vector>
+
+///
+/// Writes procedurally generated TMX maps, for finding where the engine
+/// stops scaling.
+///
+/// The maps use the shipped tilesets and the conventions of the shipped
+/// maps: base64 zlib layer data, image paths relative to src, and an
+/// "Objects" group of tile objects, which challenges look up by name.
+///
+namespace stress_map {
+    struct Settings {
+        int width = 64;
+        int height = 64;
+
+        ///
+        /// The fraction of blank tiles of each layer, bottom first. The
+        /// engine packs layers with more than half blank sparsely.
+        ///
+        std::vector<float> blank_densities = {0.0f, 0.3f, 0.9f, 0.98f};
+
+        ///
+        /// The number of map objects, named "object/N" in the "Objects"
+        /// group
+        ///
+        int objects = 0;
+
+        ///
+        /// The number of sprites, named "sprite/N" in the "Objects"
+        /// group
+        ///
+        int sprites = 0;
+
+        ///
+        /// Seeds the placement of tiles and objects, so that a map can
+        /// be made again
+        ///
+        unsigned int seed = 1;
+    };
+
+    ///
+    /// The largest map which may be generated in each direction
+    ///
+    static const int max_size = 1024;
+
+    ///
+    /// The tile of map objects, with its animation frame last
+    ///
+    static const char *const object_tile = "interactable/bridge/1";
+
+    ///
+    /// The tile of sprites, with its animation frame last
+    ///
+    static const char *const sprite_tile = "people/crocodile/land/east/still/1";
+
+    ///
+    /// Write a map.
+    ///
+    /// @param path the file to write
+    /// @param settings what to put in it
+    /// @return whether it was written; why not is logged
+    ///
+    bool write(const std::string &path, const Settings &settings);
+}
+
+#endif
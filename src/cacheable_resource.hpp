@@ -1,7 +1,9 @@
 #ifndef CACHEABLE_RESOURCE_H
 #define CACHEABLE_RESOURCE_H
 
+#include <cstddef>
 #include <functional>
+#include <iterator>
 #include <map>
 #include <memory>
 #include <string>
@@ -44,6 +46,12 @@ private:
     /// Creates a new resource using the give resource name.
     ///
     static std::shared_ptr<Res> new_shared(const std::string resource_name);
+
+    ///
+    /// Get the current context's cache, creating it if this is the
+    /// first of its context.
+    ///
+    static std::shared_ptr<ResourceCache<Res>> get_cache();
 protected:
     ///
     /// The name which was used to load the resource.
@@ -66,6 +74,43 @@ public:
     /// @return A shared pointer to the relevant resource.
     ///
     static std::shared_ptr<Res> get_shared(const std::string resource_name);
+
+    ///
+    /// Check whether a resource is loaded in the current context's
+    /// cache, without loading it.
+    ///
+    static bool is_shared(const std::string resource_name);
+
+    ///
+    /// Load a resource into the current context's cache, if needed,
+    /// and keep it there until unpinned, whether or not it is used.
+    ///
+    static void pin(const std::string resource_name);
+
+    ///
+    /// Let a pinned resource be released like any other.
+    ///
+    static void unpin(const std::string resource_name);
+
+    ///
+    /// Set the most memory each context's cache keeps alive for unused
+    /// resources of this kind, releasing any over it.
+    ///
+    static void set_retention_budget(size_t bytes);
+
+    ///
+    /// Log the hits, misses and evictions of each context's cache.
+    ///
+    /// @param kind the kind of resource, such as "texture atlas"
+    ///
+    static void report_caches(const std::string &kind);
+
+    ///
+    /// Get the memory the resource keeps alive, in bytes, which counts
+    /// against the cache's retention budget. Resources which are worth
+    /// keeping whatever their size need not override this.
+    ///
+    size_t get_resource_bytes() { return 0; }
 };
 
 template<typename Res>
@@ -84,19 +129,53 @@ CacheableResource<Res>::~CacheableResource() {
 }
 
 template<typename Res>
-std::shared_ptr<Res> CacheableResource<Res>::get_shared(const std::string resource_name) {
+std::shared_ptr<ResourceCache<Res>> CacheableResource<Res>::get_cache() {
     GraphicsContext* context = GraphicsContext::get_current();
 
     if (resource_caches.count(context) == 0) {
         // Create a new resource cache as this is the first of its context.
-        std::shared_ptr<ResourceCache<Res>> resource_cache = std::make_shared<ResourceCache<Res>>(context);
-        // Tell it who it is.
-        resource_cache->weak_this = std::weak_ptr<ResourceCache<Res>>(resource_cache);
+        std::shared_ptr<ResourceCache<Res>> resource_cache = ResourceCache<Res>::create(context);
         resource_caches.insert(std::make_pair(context, resource_cache));
         context->register_resource_releaser(std::function<void()>([context] () {resource_caches.erase(context);}));
     }
 
-    return resource_caches.find(context)->second->get_resource(resource_name);
+    return resource_caches.find(context)->second;
+}
+
+template<typename Res>
+std::shared_ptr<Res> CacheableResource<Res>::get_shared(const std::string resource_name) {
+    return get_cache()->get_resource(resource_name);
+}
+
+template<typename Res>
+bool CacheableResource<Res>::is_shared(const std::string resource_name) {
+    auto resource_cache(resource_caches.find(GraphicsContext::get_current()));
+    return resource_cache != std::end(resource_caches) && resource_cache->second->has_resource(resource_name);
+}
+
+template<typename Res>
+void CacheableResource<Res>::pin(const std::string resource_name) {
+    get_cache()->pin(resource_name);
+}
+
+template<typename Res>
+void CacheableResource<Res>::unpin(const std::string resource_name) {
+    get_cache()->unpin(resource_name);
+}
+
+template<typename Res>
+void CacheableResource<Res>::set_retention_budget(size_t bytes) {
+    ResourceCache<Res>::set_retention_budget(bytes);
+    for (auto &resource_cache : resource_caches) {
+        resource_cache.second->trim();
+    }
+}
+
+template<typename Res>
+void CacheableResource<Res>::report_caches(const std::string &kind) {
+    for (auto &resource_cache : resource_caches) {
+        resource_cache.second->report(kind);
+    }
 }
 
 template<typename Res>
@@ -23,13 +23,13 @@
 #include "object_manager.hpp"
 #include "gil_safe_future.hpp"
 #include "sprite.hpp"
-#include "text.hpp"
 
 
 ///Static variables
 MapViewer *Engine::map_viewer(nullptr);
 NotificationBar *Engine::notification_bar(nullptr);
 GameWindow* Engine::game_window(nullptr);
+FramePacer* Engine::frame_pacer(nullptr);
 Challenge* Engine::challenge(nullptr);
 int Engine::tile_size(64);
 float Engine::global_scale(1.0f);
@@ -261,19 +261,6 @@ void Engine::print_dialogue(std::string name, std::string text) {
 }
 
 
-void Engine::text_displayer() {
-    Map *map = CHECK_NOTNULL(map_viewer->get_map());
-
-    auto objects = map->get_sprites();
-    for (int object_id : objects) {
-        //Object is on the map so now get its locationg
-        auto sprite = ObjectManager::get_instance().get_object<Sprite>(object_id);
-        if (sprite->get_object_text()) {
-            sprite->get_object_text()->display();
-        }
-    }
-}
-
 std::vector<std::tuple<std::string, int, int>> Engine::look(int id, int search_range) {
     std::vector<std::tuple<std::string, int, int>> objects;
 
@@ -362,24 +349,6 @@ bool Engine::cut(int id, glm::ivec2 location) {
     return false;
 }
 
-void Engine::text_updater() {
-    Map *map = CHECK_NOTNULL(map_viewer->get_map());
-
-    auto objects = map->get_sprites();
-    for (int object_id : objects) {
-        //Object is on the map so now get its location
-        auto sprite = ObjectManager::get_instance().get_object<Sprite>(object_id);
-
-        glm::ivec2 pixel_position(Engine::get_map_viewer()->tile_to_pixel(sprite->get_position()));
-
-        sprite->get_object_text()->move(
-            pixel_position.x + int(Engine::get_actual_tile_size() / 2.0f),
-            pixel_position.y
-        );
-    }
-
-}
-
 void Engine::update_status(int id, std::string status) {
     auto sprite = ObjectManager::get_instance().get_object<Sprite>(id);
     if (!sprite) {
@@ -15,6 +15,7 @@
 #include "text_font.hpp"
 #include "typeface.hpp"
 
+class FramePacer;
 class MapViewer;
 class NotificationBar;
 
@@ -36,6 +37,7 @@ private:
     static NotificationBar* notification_bar;
 
     static GameWindow* game_window;
+    static FramePacer* frame_pacer;
 
     static Challenge* challenge;
     ///
@@ -88,6 +90,28 @@ public:
     ///
     static GameWindow* get_game_window() { return game_window; }
 
+    ///
+    /// Request that the game window is redrawn, as something on it has
+    /// changed
+    ///
+    static void request_redraw() {
+        if (game_window) {
+            game_window->request_redraw();
+        }
+    }
+
+    ///
+    /// Set the frame pacer of the main loop
+    /// @param _frame_pacer the frame pacer
+    ///
+    static void set_frame_pacer(FramePacer* _frame_pacer) { frame_pacer = _frame_pacer; }
+
+    ///
+    /// Get the frame pacer of the main loop, to change the target FPS
+    /// @return the frame pacer
+    ///
+    static FramePacer* get_frame_pacer() { return frame_pacer; }
+
     ///
     /// Set the map viewer attached to the engine
     /// @param _map_viewer the map viewer which is attached to the engine
@@ -191,8 +215,6 @@ public:
     static void print_dialogue(std::string name, std::string text);
 
     /// method for handling sprite test
-    static void text_displayer();
-    static void text_updater();
     static void update_status(int id, std::string status);
 
     /// global access to game font
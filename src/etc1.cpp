@@ -0,0 +1,209 @@
+#include <algorithm>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+
+#include "etc1.hpp"
+
+// The intensity modifiers of each table, in the order of the pixel
+// index values which select them
+static const int modifier_tables[8][4] = {
+    { 2,   8,  -2,   -8},
+    { 5,  17,  -5,  -17},
+    { 9,  29,  -9,  -29},
+    {13,  42, -13,  -42},
+    {18,  60, -18,  -60},
+    {24,  80, -24,  -80},
+    {33, 106, -33, -106},
+    {47, 183, -47, -183}
+};
+
+// Pixels of a block, numbered x * 4 + y as in the pixel index bits
+struct Block {
+    int colours[16][3];
+};
+
+// The best table and selectors found for half of a block
+struct HalfFit {
+    long error;
+    int table;
+    int selectors[16];
+};
+
+static inline int clamp_byte(int value) {
+    return std::min(std::max(value, 0), 255);
+}
+
+static inline int quantise(float value, int max) {
+    return std::min(std::max(int(value * float(max) / 255.0f + 0.5f), 0), max);
+}
+
+static inline int expand_4(int value) {
+    return (value << 4) | value;
+}
+
+static inline int expand_5(int value) {
+    return (value << 3) | (value >> 2);
+}
+
+// Find the table and selectors which best fit half of a block to a base
+// colour, giving up once worse than give_up_error
+static HalfFit fit_half(const Block &block, const int (&pixels)[8], const int (&base)[3], long give_up_error) {
+    HalfFit best;
+    best.error = give_up_error;
+    best.table = -1;
+
+    for (int table = 0; table < 8; ++table) {
+        HalfFit fit;
+        fit.error = 0;
+        fit.table = table;
+
+        for (int pixel : pixels) {
+            long pixel_error(LONG_MAX);
+            for (int selector = 0; selector < 4; ++selector) {
+                int modifier(modifier_tables[table][selector]);
+                long error(0);
+                for (int channel = 0; channel < 3; ++channel) {
+                    long difference(clamp_byte(base[channel] + modifier) - block.colours[pixel][channel]);
+                    error += difference * difference;
+                }
+                if (error < pixel_error) {
+                    pixel_error = error;
+                    fit.selectors[pixel] = selector;
+                }
+            }
+
+            fit.error += pixel_error;
+            if (fit.error >= best.error) {
+                break;
+            }
+        }
+
+        if (fit.error < best.error) {
+            best = fit;
+        }
+    }
+
+    return best;
+}
+
+static uint64_t selector_bits(const HalfFit &first, const HalfFit &second, const int (&first_pixels)[8], const int (&second_pixels)[8]) {
+    uint64_t bits(0);
+    auto add([&] (const HalfFit &fit, const int (&pixels)[8]) {
+        for (int pixel : pixels) {
+            int selector(fit.selectors[pixel]);
+            bits |= uint64_t(selector >> 1) << (16 + pixel);
+            bits |= uint64_t(selector &  1) << pixel;
+        }
+    });
+    add(first, first_pixels);
+    add(second, second_pixels);
+    return bits;
+}
+
+static uint64_t encode_block(const Block &block) {
+    uint64_t best_bits(0);
+    long best_error(LONG_MAX);
+
+    for (int flip = 0; flip < 2; ++flip) {
+        // Side by side 2x4 halves, or 4x2 halves one above the other
+        int halves[2][8];
+        int counts[2] = {0, 0};
+        for (int x = 0; x < 4; ++x) {
+            for (int y = 0; y < 4; ++y) {
+                int half(flip ? y / 2 : x / 2);
+                halves[half][counts[half]++] = x * 4 + y;
+            }
+        }
+
+        float averages[2][3] = {{0.0f, 0.0f, 0.0f}, {0.0f, 0.0f, 0.0f}};
+        for (int half = 0; half < 2; ++half) {
+            for (int pixel : halves[half]) {
+                for (int channel = 0; channel < 3; ++channel) {
+                    averages[half][channel] += float(block.colours[pixel][channel]) / 8.0f;
+                }
+            }
+        }
+
+        // Differential mode, if the halves' colours are close enough
+        int first_5[3], second_5[3];
+        bool differential(true);
+        for (int channel = 0; channel < 3; ++channel) {
+            first_5 [channel] = quantise(averages[0][channel], 31);
+            second_5[channel] = quantise(averages[1][channel], 31);
+            int delta(second_5[channel] - first_5[channel]);
+            differential = differential && delta >= -4 && delta <= 3;
+        }
+
+        if (differential) {
+            int first_base[3], second_base[3];
+            for (int channel = 0; channel < 3; ++channel) {
+                first_base [channel] = expand_5(first_5 [channel]);
+                second_base[channel] = expand_5(second_5[channel]);
+            }
+
+            HalfFit first (fit_half(block, halves[0], first_base,  best_error));
+            HalfFit second(fit_half(block, halves[1], second_base, best_error));
+            if (first.table >= 0 && second.table >= 0 && first.error + second.error < best_error) {
+                best_error = first.error + second.error;
+                best_bits = uint64_t(first_5[0]) << 59 | uint64_t((second_5[0] - first_5[0]) & 7) << 56
+                          | uint64_t(first_5[1]) << 51 | uint64_t((second_5[1] - first_5[1]) & 7) << 48
+                          | uint64_t(first_5[2]) << 43 | uint64_t((second_5[2] - first_5[2]) & 7) << 40
+                          | uint64_t(first.table) << 37 | uint64_t(second.table) << 34
+                          | uint64_t(1) << 33 | uint64_t(flip) << 32
+                          | selector_bits(first, second, halves[0], halves[1]);
+            }
+        }
+
+        // Individual mode, with coarser but independent colours
+        int first_4[3], second_4[3];
+        int first_base[3], second_base[3];
+        for (int channel = 0; channel < 3; ++channel) {
+            first_4 [channel] = quantise(averages[0][channel], 15);
+            second_4[channel] = quantise(averages[1][channel], 15);
+            first_base [channel] = expand_4(first_4 [channel]);
+            second_base[channel] = expand_4(second_4[channel]);
+        }
+
+        HalfFit first (fit_half(block, halves[0], first_base,  best_error));
+        HalfFit second(fit_half(block, halves[1], second_base, best_error));
+        if (first.table >= 0 && second.table >= 0 && first.error + second.error < best_error) {
+            best_error = first.error + second.error;
+            best_bits = uint64_t(first_4[0]) << 60 | uint64_t(second_4[0]) << 56
+                      | uint64_t(first_4[1]) << 52 | uint64_t(second_4[1]) << 48
+                      | uint64_t(first_4[2]) << 44 | uint64_t(second_4[2]) << 40
+                      | uint64_t(first.table) << 37 | uint64_t(second.table) << 34
+                      | uint64_t(flip) << 32
+                      | selector_bits(first, second, halves[0], halves[1]);
+        }
+    }
+
+    return best_bits;
+}
+
+std::size_t etc1::get_encoded_size(int width, int height) {
+    return std::size_t((width + 3) / 4) * std::size_t((height + 3) / 4) * 8;
+}
+
+void etc1::encode(const uint8_t *rgba, std::ptrdiff_t pitch, int width, int height, uint8_t *encoded) {
+    for (int block_y = 0; block_y < height; block_y += 4) {
+        for (int block_x = 0; block_x < width; block_x += 4) {
+            Block block;
+            for (int x = 0; x < 4; ++x) {
+                for (int y = 0; y < 4; ++y) {
+                    const uint8_t *pixel(rgba + std::min(block_y + y, height - 1) * pitch
+                                              + std::min(block_x + x, width  - 1) * 4);
+                    block.colours[x * 4 + y][0] = pixel[0];
+                    block.colours[x * 4 + y][1] = pixel[1];
+                    block.colours[x * 4 + y][2] = pixel[2];
+                }
+            }
+
+            // Blocks are stored most significant byte first
+            uint64_t bits(encode_block(block));
+            for (int byte = 7; byte >= 0; --byte) {
+                *encoded++ = uint8_t(bits >> (byte * 8));
+            }
+        }
+    }
+}
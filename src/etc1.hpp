@@ -0,0 +1,39 @@
+#ifndef ETC1_H
+#define ETC1_H
+
+#include <cstddef>
+#include <cstdint>
+
+///
+/// An ETC1 texture compressor, so that opaque atlases can be held in
+/// the Pi's GPU memory at half a byte per pixel.
+///
+/// Each 4x4 block is tried split in both directions, with individual
+/// and differential base colours, and the best modifier table picked
+/// for each half. This is far quicker than an exhaustive search and
+/// does well on flat pixel-art tiles.
+///
+/// ETC1 data is also valid ETC2, so desktop drivers with
+/// GL_ARB_ES3_compatibility can show it.
+///
+namespace etc1 {
+    ///
+    /// Get the size of an encoded image in bytes
+    ///
+    std::size_t get_encoded_size(int width, int height);
+
+    ///
+    /// Encode an image. Blocks are written a row at a time from the first
+    /// row of pixels, which GL takes as the bottom of the texture. Alpha
+    /// is ignored and partial blocks at the edges repeat the edge pixels.
+    ///
+    /// @param rgba the first row of pixels, 4 bytes each
+    /// @param pitch the distance in bytes between rows
+    /// @param width the width in pixels
+    /// @param height the height in pixels
+    /// @param encoded filled with get_encoded_size bytes
+    ///
+    void encode(const uint8_t *rgba, std::ptrdiff_t pitch, int width, int height, uint8_t *encoded);
+}
+
+#endif
@@ -1,5 +1,6 @@
 #include <algorithm>
 #include <chrono>
+#include <condition_variable>
 #include <functional>
 #include <glog/logging.h>
 #include <list>
@@ -9,9 +10,10 @@
 
 #include "event_manager.hpp"
 #include "game_time.hpp"
+#include "profiler.hpp"
 
 
-EventManager::EventManager(): enabled(true) {
+EventManager::EventManager(): events_pending(false), enabled(true) {
     // Allocate on the heap so that we can swap the curr_frame and next_frame
     curr_frame_queue = new std::list<std::function<void ()>>();
     next_frame_queue = new std::list<std::function<void ()>>();
@@ -55,12 +57,15 @@ void EventManager::flush_and_disable() {
         //Clear both lists
         curr_frame_queue->clear();
         next_frame_queue->clear();
+        events_pending = false;
 
     }
     // Lock released
 }
 
 void EventManager::process_events() {
+    Profiler::Scope profile("EventManager::process_events");
+
     // We need to process all the events in the queue
     // Problem is that, when events are being processed, they can add
     // further events. If we have the lock on the lock_guard in the
@@ -84,6 +89,9 @@ void EventManager::process_events() {
 
             //If the queue is empty, exit this processing
             if(curr_frame_queue->empty()) {
+                //Everything added so far has been run
+                events_pending = false;
+
                 //This is safe as we have the lock
                 std::swap(curr_frame_queue, next_frame_queue);
                 break;
@@ -113,6 +121,16 @@ void EventManager::add_event(std::function<void ()> func) {
 
     //Add it to the queue
     curr_frame_queue->push_back(func);
+
+    //Wake the main loop if it is waiting for the next frame
+    events_pending = true;
+    event_added.notify_one();
+}
+
+bool EventManager::wait_for_event(std::chrono::steady_clock::time_point deadline) {
+    std::unique_lock<std::mutex> lock(queue_mutex);
+
+    return event_added.wait_until(lock, deadline, [this] () { return events_pending; });
 }
 
 void EventManager::add_event_next_frame(std::function<void ()> func) {
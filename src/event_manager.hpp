@@ -1,6 +1,8 @@
 #ifndef EVENT_MANAGER_H
 #define EVENT_MANAGER_H
 
+#include <chrono>
+#include <condition_variable>
 #include <functional>
 #include <list>
 #include <mutex>
@@ -21,6 +23,17 @@ class EventManager {
     ///
     std::mutex queue_mutex;
 
+    ///
+    /// Signalled when add_event adds an event, to wake wait_for_event
+    ///
+    std::condition_variable event_added;
+
+    ///
+    /// Whether add_event has added events since the current frame
+    /// queue was last emptied
+    ///
+    bool events_pending;
+
     ///
     ///The queue for lambdas to be dealt with in this frame
     /// We use a list as the iterator remains valid if we add and
@@ -134,6 +147,20 @@ public:
     ///
     void process_events();
 
+    ///
+    /// Sleep until an event is added with add_event, possibly from
+    /// another thread, or until a deadline. Events added with
+    /// add_event_next_frame don't wake this.
+    ///
+    /// @param deadline
+    ///     The time to stop waiting at.
+    ///
+    /// @return
+    ///     true if there are events to process, false if the
+    ///     deadline passed.
+    ///
+    bool wait_for_event(std::chrono::steady_clock::time_point deadline);
+
 };
 
 #endif
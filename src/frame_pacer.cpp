@@ -0,0 +1,75 @@
+#include <algorithm>
+#include <chrono>
+#include <glog/logging.h>
+#include <ostream>
+
+#include "event_manager.hpp"
+#include "frame_pacer.hpp"
+#include "profiler.hpp"
+
+constexpr std::chrono::seconds FramePacer::report_interval;
+
+FramePacer::FramePacer(int target_fps):
+    frame_duration(std::chrono::duration_cast<clock::duration>(std::chrono::seconds(1)) / std::max(target_fps, 1)),
+    deadline(clock::now() + frame_duration),
+    last_frame_end(clock::now()),
+    report_start(clock::now()) {
+}
+
+void FramePacer::set_target_fps(int target_fps) {
+    frame_duration = std::chrono::duration_cast<clock::duration>(std::chrono::seconds(1)) / std::max(target_fps, 1);
+    deadline = clock::now() + frame_duration;
+
+    LOG(INFO) << "Frame pacer: targeting " << get_target_fps() << " FPS";
+}
+
+int FramePacer::get_target_fps() {
+    return int(std::chrono::duration_cast<clock::duration>(std::chrono::seconds(1)) / frame_duration);
+}
+
+void FramePacer::process_events(EventManager &event_manager) {
+    clock::duration idle(clock::duration::zero());
+
+    // Run what is queued, then sleep until either more is
+    // queued or the frame is due
+    bool woken;
+    do {
+        event_manager.process_events();
+
+        Profiler::Scope profile("FramePacer::sleep");
+        clock::time_point wait_start(clock::now());
+        woken = event_manager.wait_for_event(deadline);
+        idle += clock::now() - wait_start;
+    } while (woken);
+
+    clock::time_point now(clock::now());
+
+    // Keep to the frame grid, unless the frame was missed entirely;
+    // then start again from now instead of rushing to catch up
+    deadline += frame_duration;
+    if (deadline < now) {
+        deadline = now + frame_duration;
+        ++report_missed;
+    }
+
+    clock::duration frame_time(now - last_frame_end);
+    last_frame_end = now;
+    idle_fraction = frame_time.count() > 0 ? float(idle.count()) / float(frame_time.count()) : 0.0f;
+
+    report_idle += idle;
+    ++report_frames;
+
+    if (now - report_start >= report_interval) {
+        std::chrono::duration<float> period(now - report_start);
+        std::chrono::duration<float> period_idle(report_idle);
+
+        LOG(INFO) << "Frame pacer: " << float(report_frames) / period.count() << " FPS, "
+                  << 100.0f * period_idle.count() / period.count() << "% idle, "
+                  << report_missed << " of " << report_frames << " frames late";
+
+        report_start = now;
+        report_idle = clock::duration::zero();
+        report_frames = 0;
+        report_missed = 0;
+    }
+}
@@ -0,0 +1,102 @@
+#ifndef FRAME_PACER_H
+#define FRAME_PACER_H
+
+#include <chrono>
+#include <cstdint>
+
+class EventManager;
+
+///
+/// Paces the main loop to a target frame rate.
+///
+/// Between frames, events are processed and then the thread sleeps
+/// until the next frame's deadline, rather than spinning. Events added
+/// from other threads, such as the Python entity threads, wake it early
+/// so that they are run without waiting for the frame.
+///
+/// The fraction of each frame spent asleep is measured, and logged
+/// periodically.
+///
+class FramePacer {
+public:
+    using clock = std::chrono::steady_clock;
+
+private:
+    ///
+    /// The time between frames
+    ///
+    clock::duration frame_duration;
+
+    ///
+    /// When the next frame is due
+    ///
+    clock::time_point deadline;
+
+    ///
+    /// When the last frame's events finished
+    ///
+    clock::time_point last_frame_end;
+
+    ///
+    /// The fraction of the last frame spent asleep
+    ///
+    float idle_fraction = 0.0f;
+
+    ///
+    /// When the current reporting period started
+    ///
+    clock::time_point report_start;
+
+    ///
+    /// The time spent asleep in the current reporting period
+    ///
+    clock::duration report_idle = clock::duration::zero();
+
+    ///
+    /// The frames in the current reporting period
+    ///
+    uint64_t report_frames = 0;
+
+    ///
+    /// The frames in the current reporting period which missed their
+    /// deadline
+    ///
+    uint64_t report_missed = 0;
+
+    ///
+    /// How often the idle time is logged
+    ///
+    static constexpr std::chrono::seconds report_interval = std::chrono::seconds(10);
+
+public:
+    ///
+    /// @param target_fps the frame rate to pace to
+    ///
+    FramePacer(int target_fps = 60);
+
+    ///
+    /// Set the frame rate to pace to
+    /// @param target_fps frames per second, at least 1
+    ///
+    void set_target_fps(int target_fps);
+
+    ///
+    /// Get the frame rate being paced to
+    ///
+    int get_target_fps();
+
+    ///
+    /// Process events until the next frame is due, sleeping whenever
+    /// there are none.
+    ///
+    /// @param event_manager the event manager to process
+    ///
+    void process_events(EventManager &event_manager);
+
+    ///
+    /// Get the fraction of the last frame spent asleep, from 0 to 1
+    ///
+    float get_idle_fraction() { return idle_fraction; }
+};
+
+#endif
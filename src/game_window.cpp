@@ -19,27 +19,39 @@
 //
 
 
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
 #include <fstream>
 #include <glog/logging.h>
 #include <map>
+#include <sstream>
 #include <string>
 #include <utility>
+#include <vector>
 
 // Include position important.
 #include "game_window.hpp"
+#include "image.hpp"
 #include "input_manager.hpp"
+#include "pixel_ops.hpp"
+#include "profiler.hpp"
 
 extern "C" {
 #include <SDL2/SDL.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
 
 #ifdef USE_GLES
 #include <SDL2/SDL_syswm.h>
 #include <bcm_host.h>
-#include <EGL/egl.h>
-#include <EGL/eglext.h>
 #include <GLES2/gl2.h>
 #include <X11/Xlib.h>
 #endif
+#ifdef USE_GL
+#define GL_GLEXT_PROTOTYPES
+#include <GL/gl.h>
+#endif
 }
 
 #include "callback.hpp"
@@ -50,6 +62,12 @@ extern "C" {
 
 
 
+#ifndef EGL_PLATFORM_SURFACELESS_MESA
+#define EGL_PLATFORM_SURFACELESS_MESA 0x31DD
+#endif
+
+
+
 #ifdef USE_GLES
 
 #ifdef STATIC_OVERSCAN
@@ -80,6 +98,7 @@ int GameWindow::overscan_top  = OVERSCAN_TOP;
 
 std::map<Uint32,GameWindow*> GameWindow::windows = std::map<Uint32,GameWindow*>();
 GameWindow* GameWindow::focused_window = nullptr;
+Uint32 GameWindow::next_headless_id = 0x80000000;
 
 
 // Need to inherit constructors manually.
@@ -146,7 +165,7 @@ static std::pair<int, int> query_overscan(int left, int top) {
 #endif
 
 
-GameWindow::GameWindow(int width, int height, bool fullscreen):
+GameWindow::GameWindow(int width, int height, bool fullscreen, bool headless):
     window_width(width),
     window_height(height),
     window_x(0),
@@ -160,6 +179,10 @@ GameWindow::GameWindow(int width, int height, bool fullscreen):
 #endif
     resizing(false),
     close_requested(false),
+    render_on_demand(true),
+    redraw_requested(true),
+    change_surface(InitAction::DO_NOTHING),
+    headless(headless),
     graphics_context(this)
 {
     input_manager = new InputManager(this);
@@ -168,6 +191,31 @@ GameWindow::GameWindow(int width, int height, bool fullscreen):
         init_sdl(); // May throw InitException
     }
 
+    if (headless) {
+        window = nullptr;
+        sdl_window_surface = nullptr;
+        background_surface = nullptr;
+
+        try {
+            init_headless_gl();
+        }
+        catch (InitException e) {
+            if (windows.size() == 0) {
+                deinit_sdl();
+            }
+            throw e;
+        }
+
+        window_id = next_headless_id++;
+        windows[window_id] = this;
+        return;
+    }
+
+    // The first window may have been headless, which needs no video
+    if (!SDL_WasInit(SDL_INIT_VIDEO) && SDL_InitSubSystem(SDL_INIT_VIDEO) != 0) {
+        throw GameWindow::InitException("Failed to initialize SDL video");
+    }
+
     // SDL already uses width,height = 0,0 for automatic
     // resolution. Sets maximized if not in fullscreen and given
     // width,height = 0,0.
@@ -230,18 +278,21 @@ GameWindow::GameWindow(int width, int height, bool fullscreen):
     // SEE ALSO ABOVE IN THIS FUNCTION.
     SDL_ShowWindow(window);
 
-    windows[SDL_GetWindowID(window)] = this;
+    window_id = SDL_GetWindowID(window);
+    windows[window_id] = this;
 }
 
 GameWindow::~GameWindow() {
     deinit_gl();
 
+    windows.erase(window_id);
+
+    if (!headless) {
 #ifdef USE_GLES
-    vc_dispmanx_display_close(dispmanDisplay); // (???)
+        vc_dispmanx_display_close(dispmanDisplay); // (???)
 #endif
-    windows.erase(SDL_GetWindowID(window));
-
-    SDL_DestroyWindow (window);
+        SDL_DestroyWindow (window);
+    }
     if (windows.size() == 0) {
         deinit_sdl();
     }
@@ -263,7 +314,9 @@ void GameWindow::init_sdl() {
 #endif
 
     LOG(INFO) << "Initializing SDL...";
-    result = SDL_Init(SDL_INIT_VIDEO | SDL_INIT_EVENTS);
+    // Headless windows have nothing to show, and there may be no
+    // display to show it on
+    result = SDL_Init(headless ? SDL_INIT_EVENTS : SDL_INIT_VIDEO | SDL_INIT_EVENTS);
 
     if (result != 0) {
         throw GameWindow::InitException("Failed to initialize SDL");
@@ -346,6 +399,14 @@ void GameWindow::init_gl() {
 
 
 void GameWindow::deinit_gl() {
+    if (headless) {
+        eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        eglDestroySurface(display, surface);
+        eglDestroyContext(display, context);
+        eglTerminate(display);
+        return;
+    }
+
 #ifdef USE_GLES
     // Release EGL resources
     deinit_surface();
@@ -358,6 +419,123 @@ void GameWindow::deinit_gl() {
 }
 
 
+void GameWindow::init_headless_gl() {
+    EGLBoolean result;
+
+    if (window_width <= 0 || window_height <= 0) {
+        throw GameWindow::InitException("Headless windows need a size");
+    }
+
+    static const EGLint attribute_list[] = {
+        EGL_RED_SIZE, 8,
+        EGL_GREEN_SIZE, 8,
+        EGL_BLUE_SIZE, 8,
+        EGL_ALPHA_SIZE, 0,
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+#ifdef USE_GLES
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_ES2_BIT,
+#endif
+#ifdef USE_GL
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+#endif
+        EGL_NONE
+    };
+
+#ifdef USE_GLES
+    static const EGLint context_attributes[] = {
+        EGL_CONTEXT_CLIENT_VERSION, 2,
+        EGL_NONE
+    };
+#endif
+#ifdef USE_GL
+    static const EGLint context_attributes[] = {
+        EGL_NONE
+    };
+#endif
+
+    const EGLint surface_attributes[] = {
+        EGL_WIDTH, window_width,
+        EGL_HEIGHT, window_height,
+        EGL_NONE
+    };
+
+    // Mesa's surfaceless platform renders without X or a GPU. The
+    // default display needs an X server on Mesa, but is all there is
+    // on the Raspberry Pi.
+    display = EGL_NO_DISPLAY;
+    const char *client_extensions(eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS));
+    if (client_extensions != nullptr && std::strstr(client_extensions, "EGL_MESA_platform_surfaceless") != nullptr) {
+        typedef EGLDisplay (*GetPlatformDisplay)(EGLenum platform, void *native_display, const EGLint *attributes);
+        GetPlatformDisplay get_platform_display(
+            reinterpret_cast<GetPlatformDisplay>(eglGetProcAddress("eglGetPlatformDisplayEXT")));
+
+        if (get_platform_display != nullptr) {
+            display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+        }
+    }
+    if (display == EGL_NO_DISPLAY) {
+        display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    }
+    if (display == EGL_NO_DISPLAY) {
+        throw GameWindow::InitException("Error getting headless display");
+    }
+
+    result = eglInitialize(display, nullptr, nullptr);
+    if (result == EGL_FALSE) {
+        eglTerminate(display);
+        throw GameWindow::InitException("Error initializing headless display connection");
+    }
+
+#ifdef USE_GLES
+    result = eglBindAPI(EGL_OPENGL_ES_API);
+#endif
+#ifdef USE_GL
+    result = eglBindAPI(EGL_OPENGL_API);
+#endif
+    if (result == EGL_FALSE) {
+        eglTerminate(display);
+        throw GameWindow::InitException("Error binding the headless rendering API");
+    }
+
+    result = eglChooseConfig(display, attribute_list, &config, 1, &configCount);
+    if (result == EGL_FALSE || configCount == 0) {
+        eglTerminate(display);
+        throw GameWindow::InitException("Error getting pbuffer frame buffer configuration");
+    }
+
+    context = eglCreateContext(display, config, EGL_NO_CONTEXT, context_attributes);
+    if (context == EGL_NO_CONTEXT) {
+        eglTerminate(display);
+        throw GameWindow::InitException("Error creating headless rendering context");
+    }
+
+    surface = eglCreatePbufferSurface(display, config, surface_attributes);
+    if (surface == EGL_NO_SURFACE) {
+        std::stringstream hex_error_code;
+        hex_error_code << std::hex << eglGetError();
+
+        eglDestroyContext(display, context);
+        eglTerminate(display);
+        throw GameWindow::InitException("Error creating headless pbuffer surface: " + hex_error_code.str());
+    }
+
+    result = eglMakeCurrent(display, surface, surface, context);
+    if (result == EGL_FALSE) {
+        eglDestroySurface(display, surface);
+        eglDestroyContext(display, context);
+        eglTerminate(display);
+        throw GameWindow::InitException("Error connecting headless context to surface");
+    }
+
+    LOG(INFO) << "Headless window: " << window_width << "x" << window_height << " pbuffer, "
+              << glGetString(GL_RENDERER);
+
+    visible = true;
+    was_foreground = false;
+    foreground = false;
+}
+
+
 void GameWindow::init_surface() {
     int x, y, w, h;
 
@@ -533,6 +711,8 @@ void GameWindow::deinit_surface() {
 
 
 void GameWindow::update() {
+    Profiler::Scope profile("GameWindow::update");
+
     SDL_Event event;
     bool close_all = false;
 
@@ -550,6 +730,9 @@ void GameWindow::update() {
         case SDL_WINDOWEVENT:
             window = windows[event.window.windowID];
 
+            // Exposure, focus and resizes can all lose what was drawn
+            window->request_redraw();
+
             // Instead of reinitialising on every event, do it ater we have
             // scanned the event queue in full.
             // Should focus events be included?
@@ -596,6 +779,9 @@ void GameWindow::update() {
         // Let the input manager use the event (even if we used it).
         if (focused_window) {
             focused_window->input_manager->handle_event(&event);
+
+            // The cursor or what is under it may have changed
+            focused_window->request_redraw();
         }
     }
 
@@ -607,24 +793,27 @@ void GameWindow::update() {
 #ifdef USE_GLES
         // Hacky fix: The events don't quite chronologically work, so
         // check the window position to start any needed surface update.
-        int x, y;
-        Window child;
-        XTranslateCoordinates(window->wm_info.info.x11.display,
-                              window->wm_info.info.x11.window,
-                              XDefaultRootWindow(window->wm_info.info.x11.display),
-                              0,
-                              0,
-                              &x,
-                              &y,
-                              &child);
-        if ((window->window_x != x || window->window_y != y) && window->visible) {
-            VLOG(2) << "Need surface reinit (moved).";
-            window->change_surface = InitAction::DO_INIT;
+        if (!window->headless) {
+            int x, y;
+            Window child;
+            XTranslateCoordinates(window->wm_info.info.x11.display,
+                                  window->wm_info.info.x11.window,
+                                  XDefaultRootWindow(window->wm_info.info.x11.display),
+                                  0,
+                                  0,
+                                  &x,
+                                  &y,
+                                  &child);
+            if ((window->window_x != x || window->window_y != y) && window->visible) {
+                VLOG(2) << "Need surface reinit (moved).";
+                window->change_surface = InitAction::DO_INIT;
+            }
         }
 #endif
 
         switch (window->change_surface) {
         case InitAction::DO_INIT:
+            window->request_redraw();
             try {
                 window->init_surface();
             }
@@ -674,6 +863,12 @@ std::pair<int, int> GameWindow::get_size() {
 
 
 void GameWindow::use_context() {
+    if (headless) {
+        eglMakeCurrent(display, surface, surface, context);
+        GraphicsContext::current = &graphics_context;
+        return;
+    }
+
 #ifdef USE_GLES
     if (visible) {
         eglMakeCurrent(display, surface, surface, context);
@@ -696,6 +891,12 @@ GraphicsContext* GameWindow::get_context() {
 
 
 void GameWindow::disable_context() {
+    if (headless) {
+        eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        GraphicsContext::current = nullptr;
+        return;
+    }
+
 #ifdef USE_GLES
     eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
 #endif
@@ -707,6 +908,15 @@ void GameWindow::disable_context() {
 
 
 void GameWindow::swap_buffers() {
+    Profiler::Scope profile("GameWindow::swap_buffers");
+
+    if (headless) {
+        // Nothing is shown, so nothing paces the frames. Wait for the
+        // frame to be drawn, so that frame times include drawing it.
+        glFinish();
+        return;
+    }
+
 #ifdef USE_GLES
     if (visible) {
         if (foreground) {
@@ -724,16 +934,52 @@ void GameWindow::swap_buffers() {
                          GL_UNSIGNED_BYTE,
                          background_surface->pixels);
 
-            // Copy (blit) the surface (whilst flipping) to the SDL window's surface.
-            SDL_Rect dst;
-            SDL_Rect src;
-            dst.x = src.x = 0;
-            dst.w = src.w = sdl_window_surface->w;
-            dst.h = src.h = 1;
-            for (int y = 0; y < background_surface->h; y++) {
-                src.y = sdl_window_surface->h - y - 1;
-                dst.y = y;
-                SDL_BlitSurface(background_surface, &src, sdl_window_surface, &dst);
+            // The render is RGBX from the bottom up.
+#if SDL_BYTE_ORDER == SDL_BIG_ENDIAN
+            const bool same_order(sdl_window_surface->format->format == SDL_PIXELFORMAT_RGBX8888
+                               || sdl_window_surface->format->format == SDL_PIXELFORMAT_RGBA8888);
+            const bool swapped_order(sdl_window_surface->format->format == SDL_PIXELFORMAT_BGRX8888
+                                  || sdl_window_surface->format->format == SDL_PIXELFORMAT_BGRA8888);
+#else
+            const bool same_order(sdl_window_surface->format->format == SDL_PIXELFORMAT_BGR888
+                               || sdl_window_surface->format->format == SDL_PIXELFORMAT_ABGR8888);
+            const bool swapped_order(sdl_window_surface->format->format == SDL_PIXELFORMAT_RGB888
+                                  || sdl_window_surface->format->format == SDL_PIXELFORMAT_ARGB8888);
+#endif
+
+            if (same_order || swapped_order) {
+                // Copy the whole render at once, flipping it by walking
+                // the rows backwards.
+                int width (std::min(background_surface->w, sdl_window_surface->w));
+                int height(std::min(background_surface->h, sdl_window_surface->h));
+                const Uint8 *last_row(static_cast<const Uint8 *>(background_surface->pixels)
+                                      + (background_surface->h - 1) * background_surface->pitch);
+
+                SDL_LockSurface(sdl_window_surface);
+                if (same_order) {
+                    pixel_ops::copy_rect(sdl_window_surface->pixels, sdl_window_surface->pitch,
+                                         last_row, -background_surface->pitch,
+                                         size_t(width) * 4, height);
+                }
+                else {
+                    pixel_ops::swap_red_blue_rect(sdl_window_surface->pixels, sdl_window_surface->pitch,
+                                                  last_row, -background_surface->pitch,
+                                                  size_t(width), height);
+                }
+                SDL_UnlockSurface(sdl_window_surface);
+            }
+            else {
+                // Copy (blit) the surface (whilst flipping) to the SDL window's surface.
+                SDL_Rect dst;
+                SDL_Rect src;
+                dst.x = src.x = 0;
+                dst.w = src.w = sdl_window_surface->w;
+                dst.h = src.h = 1;
+                for (int y = 0; y < background_surface->h; y++) {
+                    src.y = sdl_window_surface->h - y - 1;
+                    dst.y = y;
+                    SDL_BlitSurface(background_surface, &src, sdl_window_surface, &dst);
+                }
             }
             SDL_UpdateWindowSurface(window);
         }
@@ -745,6 +991,29 @@ void GameWindow::swap_buffers() {
 }
 
 
+Image GameWindow::read_frame() {
+    Image frame(window_width, window_height, false);
+
+    // GL reads from the bottom up
+    std::vector<Uint8> pixels(size_t(window_width) * size_t(window_height) * 4);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glReadPixels(0, 0, window_width, window_height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+
+    std::ptrdiff_t pitch(std::ptrdiff_t(window_width) * 4);
+    pixel_ops::copy_rect(frame.row(0), frame.row_pitch(),
+                         pixels.data() + (window_height - 1) * pitch, -pitch,
+                         size_t(pitch), window_height);
+    return frame;
+}
+
+
+void GameWindow::set_render_on_demand(bool enabled) {
+    render_on_demand = enabled;
+    request_redraw();
+    LOG(INFO) << "Render on demand " << (enabled ? "enabled" : "disabled");
+}
+
+
 InputManager* GameWindow::get_input_manager() {
     return input_manager;
 }
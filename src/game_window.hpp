@@ -18,11 +18,11 @@
 
 extern "C" {
 #include <SDL2/SDL.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
 
 #ifdef USE_GLES
 #include <SDL2/SDL_syswm.h>
-#include <EGL/egl.h>
-#include <EGL/eglext.h>
 #endif
 }
 
@@ -31,6 +31,7 @@ extern "C" {
 #include "lifeline.hpp"
 #include "lifeline_controller.hpp"
 #include "graphics_context.hpp"
+#include "image.hpp"
 
 
 
@@ -43,6 +44,11 @@ class InputManager;
 ///
 /// Input management is handled in a separate class.
 ///
+/// A headless window has no SDL window, and draws into an EGL pbuffer
+/// of a fixed size instead, so that the game can be drawn, timed and
+/// read back on machines with no display or GPU (such as Mesa's
+/// llvmpipe on a build server).
+///
 class GameWindow {
 private:
     friend class InputManager;
@@ -133,13 +139,40 @@ private:
     ///
     bool close_requested;
 
+    ///
+    /// Whether the window only needs redrawing when something on it
+    /// changes, rather than every frame.
+    ///
+    bool render_on_demand;
+
+    ///
+    /// Whether something has changed since the last frame was drawn.
+    ///
+    bool redraw_requested;
+
     ///
     ///Tracks whether the egl surface needs to be changed
     ///
     InitAction change_surface;
 
-#ifdef USE_GLES
-    // These need to be reused for resource management.
+    ///
+    /// Whether the window draws into a pbuffer, with no SDL window.
+    ///
+    bool headless;
+
+    ///
+    /// The key of the window in windows. This is the SDL window ID, or
+    /// a number far above those SDL gives for headless windows.
+    ///
+    Uint32 window_id;
+
+    ///
+    /// The window_id of the next headless window
+    ///
+    static Uint32 next_headless_id;
+
+    // These need to be reused for resource management. Desktop GL only
+    // uses them for headless windows.
     EGLDisplay display;
     EGLSurface surface;
     EGLContext context;
@@ -147,6 +180,7 @@ private:
     EGLConfig config;
     EGLint configCount;
 
+#ifdef USE_GLES
     DISPMANX_DISPLAY_HANDLE_T dispmanDisplay;
     DISPMANX_ELEMENT_HANDLE_T dispmanElement;
 
@@ -203,6 +237,8 @@ private:
     /// This initialises first-time SDL and graphics related stuff. It
     /// calls bcm_host_init(), and also queries the overscan.
     ///
+    /// SDL video is left uninitialised if the first window is headless.
+    ///
     void init_sdl();
     ///
     /// Deinitialize SDL.
@@ -218,6 +254,15 @@ private:
     ///
     void deinit_gl();
 
+    ///
+    /// Initialize EGL with a pbuffer of the window's size, for a
+    /// headless window.
+    ///
+    /// This prefers Mesa's surfaceless platform, which needs no X
+    /// server, to the default display.
+    ///
+    void init_headless_gl();
+
     ///
     /// Creates the EGL surface.
     ///
@@ -259,8 +304,11 @@ public:
     /// @param width The width of the window. 0 uses current resolution.
     /// @param height The height of the window. 0 uses current resolution.
     /// @param fullscreen Whether to use fullscreen.
+    /// @param headless Whether to draw into a pbuffer of exactly width
+    ///        by height instead, with no SDL window. Such a window gets
+    ///        no input and never resizes.
     ///
-    GameWindow(int width, int height, bool fullscreen = false);
+    GameWindow(int width, int height, bool fullscreen = false, bool headless = false);
 
     ///
     /// Shuts down and cleans up both SDL and EGL.
@@ -334,6 +382,55 @@ public:
     ///
     void swap_buffers();
 
+    ///
+    /// Whether the window draws into a pbuffer, with no SDL window.
+    ///
+    bool is_headless() { return headless; }
+
+    ///
+    /// Read back what has been drawn, such as to compare a frame with
+    /// a golden image.
+    ///
+    /// The window's context must be current. On-screen windows must
+    /// be read before swap_buffers, as the back buffer is undefined
+    /// after a swap.
+    ///
+    /// @return the frame, with rows from the top down
+    ///
+    Image read_frame();
+
+    ///
+    /// Mark the window's contents as out of date, so that the next
+    /// frame is drawn.
+    ///
+    /// This should be called by anything which changes what is on
+    /// screen, such as moving objects or changing text. Input and
+    /// window events request a redraw themselves.
+    ///
+    void request_redraw() { redraw_requested = true; }
+
+    ///
+    /// Whether the next frame needs drawing. This is always true if
+    /// render on demand is disabled.
+    ///
+    bool is_redraw_needed() { return redraw_requested || !render_on_demand; }
+
+    ///
+    /// Forget any requested redraw, before the frame is drawn.
+    ///
+    void clear_redraw_request() { redraw_requested = false; }
+
+    ///
+    /// Set whether frames are only drawn and swapped when a redraw has
+    /// been requested, to save power when nothing is changing.
+    ///
+    void set_render_on_demand(bool enabled);
+
+    ///
+    /// Get whether frames are only drawn when a redraw is requested.
+    ///
+    bool is_render_on_demand() { return render_on_demand; }
+
     ///
     /// Input manager getter.
     ///
@@ -0,0 +1,177 @@
+#include <glog/logging.h>
+#include <ostream>
+
+#include "gl_state.hpp"
+#include "graphics_context.hpp"
+
+const GLuint GLState::unknown;
+const int GLState::max_texture_units;
+const int GLState::max_attributes;
+
+GLState &GLState::get_current() {
+    return CHECK_NOTNULL(GraphicsContext::get_current())->get_gl_state();
+}
+
+GLuint *GLState::active_texture_binding() {
+    if (active_texture_unit == unknown) {
+        return nullptr;
+    }
+
+    GLuint index(active_texture_unit - GL_TEXTURE0);
+    if (index >= GLuint(max_texture_units)) {
+        return nullptr;
+    }
+
+    return &bound_textures[index];
+}
+
+void GLState::use_program(GLuint program) {
+    if (program == current_program) {
+        ++calls_avoided;
+        return;
+    }
+
+    glUseProgram(program);
+    current_program = program;
+    ++calls_issued;
+}
+
+GLuint GLState::get_program() {
+    if (current_program == unknown) {
+        GLint program;
+        glGetIntegerv(GL_CURRENT_PROGRAM, &program);
+        current_program = GLuint(program);
+        ++calls_issued;
+    }
+
+    return current_program;
+}
+
+void GLState::active_texture(GLenum unit) {
+    if (unit == active_texture_unit) {
+        ++calls_avoided;
+        return;
+    }
+
+    glActiveTexture(unit);
+    active_texture_unit = unit;
+    ++calls_issued;
+}
+
+void GLState::bind_texture(GLuint texture) {
+    GLuint *binding(active_texture_binding());
+
+    if (binding && *binding == texture) {
+        ++calls_avoided;
+        return;
+    }
+
+    glBindTexture(GL_TEXTURE_2D, texture);
+    if (binding) {
+        *binding = texture;
+    }
+    ++calls_issued;
+    ++texture_binds;
+}
+
+void GLState::bind_array_buffer(GLuint buffer) {
+    if (buffer == bound_array_buffer) {
+        ++calls_avoided;
+        return;
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    bound_array_buffer = buffer;
+    ++calls_issued;
+}
+
+void GLState::bind_element_array_buffer(GLuint buffer) {
+    if (buffer == bound_element_array_buffer) {
+        ++calls_avoided;
+        return;
+    }
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffer);
+    bound_element_array_buffer = buffer;
+    ++calls_issued;
+}
+
+void GLState::enable_attribute(GLuint index) {
+    if (index >= GLuint(max_attributes)) {
+        glEnableVertexAttribArray(index);
+        ++calls_issued;
+        return;
+    }
+
+    uint32_t bit(uint32_t(1) << index);
+    if ((known_attributes & bit) && (enabled_attributes & bit)) {
+        ++calls_avoided;
+        return;
+    }
+
+    glEnableVertexAttribArray(index);
+    enabled_attributes |= bit;
+    known_attributes   |= bit;
+    ++calls_issued;
+}
+
+void GLState::disable_attribute(GLuint index) {
+    if (index >= GLuint(max_attributes)) {
+        glDisableVertexAttribArray(index);
+        ++calls_issued;
+        return;
+    }
+
+    uint32_t bit(uint32_t(1) << index);
+    if ((known_attributes & bit) && !(enabled_attributes & bit)) {
+        ++calls_avoided;
+        return;
+    }
+
+    glDisableVertexAttribArray(index);
+    enabled_attributes &= ~bit;
+    known_attributes   |= bit;
+    ++calls_issued;
+}
+
+void GLState::forget_program(GLuint program) {
+    // Deleting the program in use only flags it for deletion, but
+    // the name may later be reused.
+    if (program == current_program) {
+        current_program = unknown;
+    }
+}
+
+void GLState::forget_texture(GLuint texture) {
+    for (auto &binding : bound_textures) {
+        if (binding == texture) {
+            binding = 0;
+        }
+    }
+}
+
+void GLState::forget_buffer(GLuint buffer) {
+    if (buffer == bound_array_buffer) {
+        bound_array_buffer = 0;
+    }
+    if (buffer == bound_element_array_buffer) {
+        bound_element_array_buffer = 0;
+    }
+}
+
+void GLState::invalidate() {
+    current_program = unknown;
+    active_texture_unit = unknown;
+    for (auto &binding : bound_textures) {
+        binding = unknown;
+    }
+    bound_array_buffer = unknown;
+    bound_element_array_buffer = unknown;
+    known_attributes = 0;
+}
+
+void GLState::report() {
+    uint64_t total(calls_issued + calls_avoided);
+    LOG(INFO) << "GL state: " << calls_avoided << " of " << total << " state calls avoided ("
+              << (total ? 100 * calls_avoided / total : 0) << "%)";
+}
@@ -0,0 +1,173 @@
+#ifndef GL_STATE_H
+#define GL_STATE_H
+
+#include <cstdint>
+
+#ifdef USE_GLES
+#include <GLES2/gl2.h>
+#endif
+
+#ifdef USE_GL
+#define GL_GLEXT_PROTOTYPES
+#include <GL/gl.h>
+#endif
+
+///
+/// A shadow copy of the GL binding state for one GraphicsContext.
+///
+/// All program, texture, buffer and vertex attribute binds should
+/// go through this so that it stays in sync with GL. Binds of what is
+/// already bound are skipped, and the current program can be read
+/// without a pipeline-stalling glGet.
+///
+/// Because binds are cheap when redundant, state is not released after
+/// a draw; the next draw binds over whatever it needs.
+///
+/// If anything binds state behind this object's back, call invalidate()
+/// afterwards.
+///
+class GLState {
+private:
+    ///
+    /// Stands for a binding which is not known, so the next bind is
+    /// always passed on to GL.
+    ///
+    static const GLuint unknown = ~GLuint(0);
+
+    ///
+    /// The number of texture units tracked. Units above this are passed
+    /// straight through to GL.
+    ///
+    static const int max_texture_units = 8;
+
+    ///
+    /// The number of vertex attribute arrays tracked.
+    ///
+    static const int max_attributes = 16;
+
+    GLuint current_program = 0;
+    GLenum active_texture_unit = GL_TEXTURE0;
+    GLuint bound_textures[max_texture_units] = {};
+    GLuint bound_array_buffer = 0;
+    GLuint bound_element_array_buffer = 0;
+
+    ///
+    /// Bitmask of the enabled vertex attribute arrays.
+    ///
+    uint32_t enabled_attributes = 0;
+
+    ///
+    /// Bitmask of the vertex attribute arrays whose state is known.
+    ///
+    uint32_t known_attributes = ~uint32_t(0);
+
+    uint64_t calls_issued = 0;
+    uint64_t calls_avoided = 0;
+    uint64_t texture_binds = 0;
+
+    ///
+    /// @return The slot for the active texture unit's binding, or
+    ///     nullptr if the unit is not tracked.
+    ///
+    GLuint *active_texture_binding();
+
+public:
+    ///
+    /// Get the state of the current GraphicsContext.
+    ///
+    /// There must be a current context.
+    ///
+    static GLState &get_current();
+
+    ///
+    /// Wrapper around glUseProgram.
+    ///
+    void use_program(GLuint program);
+
+    ///
+    /// Get the program in use without querying GL.
+    ///
+    /// @return The program set by the last call to use_program.
+    ///
+    GLuint get_program();
+
+    ///
+    /// Wrapper around glActiveTexture.
+    ///
+    void active_texture(GLenum unit);
+
+    ///
+    /// Wrapper around glBindTexture(GL_TEXTURE_2D, ...) for the active
+    /// texture unit.
+    ///
+    void bind_texture(GLuint texture);
+
+    ///
+    /// Wrapper around glBindBuffer(GL_ARRAY_BUFFER, ...).
+    ///
+    void bind_array_buffer(GLuint buffer);
+
+    ///
+    /// Wrapper around glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ...).
+    ///
+    void bind_element_array_buffer(GLuint buffer);
+
+    ///
+    /// Wrapper around glEnableVertexAttribArray.
+    ///
+    void enable_attribute(GLuint index);
+
+    ///
+    /// Wrapper around glDisableVertexAttribArray.
+    ///
+    void disable_attribute(GLuint index);
+
+    ///
+    /// Record that a program is about to be deleted. GL unbinds deleted
+    /// objects, and their names may be reused.
+    ///
+    void forget_program(GLuint program);
+
+    ///
+    /// Record that a texture is about to be deleted.
+    ///
+    void forget_texture(GLuint texture);
+
+    ///
+    /// Record that a buffer is about to be deleted.
+    ///
+    void forget_buffer(GLuint buffer);
+
+    ///
+    /// Forget everything, so that all following binds are passed to GL.
+    ///
+    void invalidate();
+
+    ///
+    /// Count GL calls skipped by other caches, such as Shader's
+    /// uniform locations.
+    ///
+    void record_avoided(uint64_t calls = 1) { calls_avoided += calls; }
+
+    ///
+    /// @return The number of GL calls passed through.
+    ///
+    uint64_t get_calls_issued() { return calls_issued; }
+
+    ///
+    /// @return The number of GL calls skipped as redundant.
+    ///
+    uint64_t get_calls_avoided() { return calls_avoided; }
+
+    ///
+    /// @return The number of texture binds passed through.
+    ///
+    uint64_t get_texture_binds() { return texture_binds; }
+
+    ///
+    /// Log the call counts.
+    ///
+    void report();
+};
+
+#endif
@@ -0,0 +1,513 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <glog/logging.h>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+extern "C" {
+#include <SDL2/SDL_ttf.h>
+}
+
+#include "gl_state.hpp"
+#include "glyph_atlas.hpp"
+#include "gpu_memory.hpp"
+#include "graphics_context.hpp"
+#include "pixel_ops.hpp"
+#include "render_stats.hpp"
+#include "text_font.hpp"
+
+const int GlyphAtlas::texture_width;
+const int GlyphAtlas::initial_height;
+const int GlyphAtlas::max_height;
+const int GlyphAtlas::max_distance;
+
+std::map<GlyphAtlas::Key, std::weak_ptr<GlyphAtlas>> GlyphAtlas::atlases;
+int GlyphAtlas::last_revision = 0;
+
+static std::string encode_utf8(uint32_t codepoint) {
+    std::string utf8;
+    if (codepoint < 0x80) {
+        utf8 += char(codepoint);
+    }
+    else if (codepoint < 0x800) {
+        utf8 += char(0xc0 | (codepoint >> 6));
+        utf8 += char(0x80 | (codepoint & 0x3f));
+    }
+    else if (codepoint < 0x10000) {
+        utf8 += char(0xe0 | (codepoint >> 12));
+        utf8 += char(0x80 | ((codepoint >> 6) & 0x3f));
+        utf8 += char(0x80 | (codepoint & 0x3f));
+    }
+    else {
+        utf8 += char(0xf0 | (codepoint >> 18));
+        utf8 += char(0x80 | ((codepoint >> 12) & 0x3f));
+        utf8 += char(0x80 | ((codepoint >> 6) & 0x3f));
+        utf8 += char(0x80 | (codepoint & 0x3f));
+    }
+    return utf8;
+}
+
+std::shared_ptr<GlyphAtlas> GlyphAtlas::get_shared(TextFont font, bool smooth) {
+    Key key(font.filename, font.size, smooth);
+
+    std::shared_ptr<GlyphAtlas> atlas(atlases[key].lock());
+    if (!atlas) {
+        atlas = std::make_shared<GlyphAtlas>(font, smooth);
+        atlases[key] = atlas;
+    }
+
+    return atlas;
+}
+
+GlyphAtlas::GlyphAtlas(TextFont font, bool smooth):
+    font(font),
+    smooth(smooth),
+    line_height(TTF_FontHeight(font.font)),
+    space_width(0),
+    texels(size_t(texture_width) * size_t(initial_height), 0) {
+
+    TTF_SizeUTF8(font.font, " ", &space_width, nullptr);
+}
+
+GlyphAtlas::~GlyphAtlas() {
+    // Forget this atlas unless another has replaced it
+    auto entry(atlases.find(Key(font.filename, font.size, smooth)));
+    if (entry != std::end(atlases) && entry->second.expired()) {
+        atlases.erase(entry);
+    }
+
+    if (gl_texture) {
+        if (GraphicsContext::get_current()) {
+            GLState::get_current().forget_texture(gl_texture);
+            GPUMemory::get_current().forget_texture(gl_texture);
+        }
+        glDeleteTextures(1, &gl_texture);
+    }
+}
+
+uint32_t GlyphAtlas::next_codepoint(const char *&utf8) {
+    unsigned char lead(static_cast<unsigned char>(*utf8++));
+    if (lead < 0x80) {
+        return lead;
+    }
+
+    // The number of bits set before the first zero in the lead byte
+    // is the length of the character
+    int continuation;
+    uint32_t codepoint;
+    if      ((lead & 0xe0) == 0xc0) { continuation = 1; codepoint = lead & 0x1f; }
+    else if ((lead & 0xf0) == 0xe0) { continuation = 2; codepoint = lead & 0x0f; }
+    else if ((lead & 0xf8) == 0xf0) { continuation = 3; codepoint = lead & 0x07; }
+    else {
+        return 0xfffd;
+    }
+
+    for (; continuation > 0; --continuation) {
+        // Also stops at the null terminator
+        if ((*utf8 & 0xc0) != 0x80) {
+            return 0xfffd;
+        }
+        codepoint = (codepoint << 6) | (static_cast<unsigned char>(*utf8++) & 0x3f);
+    }
+
+    return codepoint;
+}
+
+bool GlyphAtlas::rasterise(uint32_t codepoint, std::vector<GLubyte> &coverage, Glyph &glyph) {
+    // SDL_ttf breaks on some leading characters, so put a space first
+    // and skip over it
+    std::string safe_str(" " + encode_utf8(codepoint));
+
+    SDL_Color blank;
+    blank.r = blank.g = blank.b = blank.a = 0;
+    SDL_Color colour;
+    colour.r = colour.g = colour.b = colour.a = 255;
+
+    SDL_Surface *rendered(smooth ? TTF_RenderUTF8_Shaded(font.font, safe_str.c_str(), colour, blank)
+                                 : TTF_RenderUTF8_Solid (font.font, safe_str.c_str(), colour));
+    if (rendered == nullptr) {
+        LOG(WARNING) << "GlyphAtlas::rasterise: Cannot render glyph U+" << std::hex << codepoint;
+        return false;
+    }
+
+    if (rendered->format->BytesPerPixel != 1) {
+        LOG(WARNING) << "GlyphAtlas::rasterise: Unexpected surface format";
+        SDL_FreeSurface(rendered);
+        return false;
+    }
+
+    SDL_LockSurface(rendered);
+    const Uint8 *pixels(static_cast<const Uint8 *>(rendered->pixels));
+
+    // Shaded surfaces hold coverage as palette indices; solid ones
+    // only use 0 and 1
+    auto alpha_at = [&] (int x, int y) -> GLubyte {
+        Uint8 index(pixels[y * rendered->pitch + x]);
+        return smooth ? index : (index ? 255 : 0);
+    };
+
+    // Trim the cell to the drawn pixels
+    int left(rendered->w), right(0), top(rendered->h), bottom(0);
+    for (int y = 0; y < rendered->h; ++y) {
+        for (int x = 0; x < rendered->w; ++x) {
+            if (alpha_at(x, y)) {
+                left   = std::min(left,   x);
+                right  = std::max(right,  x + 1);
+                top    = std::min(top,    y);
+                bottom = std::max(bottom, y + 1);
+            }
+        }
+    }
+
+    glyph.width  = std::max(right - left, 0);
+    glyph.height = std::max(bottom - top, 0);
+    glyph.offset_x = glyph.width  ? left - space_width : 0;
+    glyph.offset_y = glyph.height ? top : 0;
+
+    coverage.assign(size_t(glyph.width) * size_t(glyph.height), 0);
+    if (smooth) {
+        if (!coverage.empty()) {
+            pixel_ops::copy_rect(coverage.data(), glyph.width,
+                                 &pixels[top * rendered->pitch + left], rendered->pitch,
+                                 size_t(glyph.width), glyph.height);
+        }
+    }
+    else {
+        for (int y = 0; y < glyph.height; ++y) {
+            for (int x = 0; x < glyph.width; ++x) {
+                coverage[size_t(y * glyph.width + x)] = alpha_at(left + x, top + y);
+            }
+        }
+    }
+
+    glyph.advance = rendered->w - space_width;
+    int min_x, max_x, min_y, max_y, advance;
+    if (codepoint <= 0xffff &&
+        TTF_GlyphMetrics(font.font, Uint16(codepoint), &min_x, &max_x, &min_y, &max_y, &advance) == 0) {
+        glyph.advance = advance;
+    }
+
+    SDL_UnlockSurface(rendered);
+    SDL_FreeSurface(rendered);
+
+    return true;
+}
+
+bool GlyphAtlas::allocate(Glyph &glyph) {
+    // Leave a texel between cells so they never bleed into each other
+    int width(glyph.width + 1);
+    int height(glyph.height + 1);
+
+    if (width > texture_width || height > max_height) {
+        LOG(WARNING) << "GlyphAtlas::allocate: " << glyph.width << "x" << glyph.height << " glyph is too large";
+        return false;
+    }
+
+    if (shelf_x + width > texture_width) {
+        shelf_y += shelf_height;
+        shelf_x = 0;
+        shelf_height = 0;
+    }
+
+    while (shelf_y + height > texture_height) {
+        if (texture_height < max_height) {
+            // Existing glyphs keep their texels but move in texture
+            // coordinates
+            texture_height *= 2;
+            texels.resize(size_t(texture_width) * size_t(texture_height), 0);
+            revision = ++last_revision;
+            VLOG(1) << "GlyphAtlas::allocate: Grew to " << texture_width << "x" << texture_height;
+        }
+        else {
+            clear();
+        }
+    }
+
+    glyph.x = shelf_x;
+    glyph.y = shelf_y;
+    shelf_x += width;
+    shelf_height = std::max(shelf_height, height);
+
+    return true;
+}
+
+void GlyphAtlas::store(const Glyph &glyph, const std::vector<GLubyte> &cell) {
+    if (!cell.empty()) {
+        pixel_ops::copy_rect(&texels[size_t(glyph.y) * size_t(texture_width) + size_t(glyph.x)], texture_width,
+                             cell.data(), glyph.width,
+                             size_t(glyph.width), glyph.height);
+    }
+
+    if (dirty_rows_end <= dirty_rows_begin) {
+        dirty_rows_begin = glyph.y;
+        dirty_rows_end = glyph.y + glyph.height;
+    }
+    else {
+        dirty_rows_begin = std::min(dirty_rows_begin, glyph.y);
+        dirty_rows_end   = std::max(dirty_rows_end,   glyph.y + glyph.height);
+    }
+}
+
+void GlyphAtlas::clear() {
+    LOG(INFO) << "GlyphAtlas::clear: Atlas full, clearing " << glyphs.size() << " glyphs";
+
+    glyphs.clear();
+    std::fill(std::begin(texels), std::end(texels), 0);
+    shelf_x = shelf_y = shelf_height = 0;
+
+    dirty_rows_begin = 0;
+    dirty_rows_end = texture_height;
+    revision = ++last_revision;
+}
+
+const GlyphAtlas::Glyph *GlyphAtlas::get_glyph(uint32_t codepoint, int glow_radius) {
+    // Glows the shader can draw share the glyph's distance field
+    bool distance_field(glow_radius > 0 && glow_radius <= max_distance);
+    auto key(std::make_pair(codepoint, distance_field ? -1 : glow_radius));
+    auto found(glyphs.find(key));
+    if (found != std::end(glyphs)) {
+        return &found->second;
+    }
+
+    Glyph glyph;
+    std::vector<GLubyte> cell;
+
+    if (glow_radius == 0) {
+        if (!rasterise(codepoint, cell, glyph)) {
+            return nullptr;
+        }
+    }
+    else {
+        const Glyph *base(get_glyph(codepoint, 0));
+        if (!base) {
+            return nullptr;
+        }
+        glyph = *base;
+
+        // Copy the glyph out with room for the glow around it, as
+        // making space may clear the atlas
+        if (glyph.width) {
+            int padding(distance_field ? max_distance : glow_radius);
+            int width(glyph.width + 2 * padding);
+            int height(glyph.height + 2 * padding);
+
+            std::vector<GLubyte> coverage(size_t(width) * size_t(height), 0);
+            for (int y = 0; y < glyph.height; ++y) {
+                std::copy_n(&texels[size_t(glyph.y + y) * size_t(texture_width) + size_t(glyph.x)], glyph.width,
+                            &coverage[size_t((y + padding) * width + padding)]);
+            }
+
+            cell.resize(coverage.size());
+            if (distance_field) {
+                generate_distance_field(coverage.data(), cell.data(), width, height);
+            }
+            else {
+                apply_newson_bloom(coverage.data(), cell.data(), width, height, glow_radius);
+            }
+
+            glyph.width = width;
+            glyph.height = height;
+            glyph.offset_x -= padding;
+            glyph.offset_y -= padding;
+        }
+    }
+
+    if (glyph.width && glyph.height) {
+        if (!allocate(glyph)) {
+            return nullptr;
+        }
+        store(glyph, cell);
+    }
+
+    return &(glyphs[key] = glyph);
+}
+
+int GlyphAtlas::measure(const char *utf8) {
+    int width(0);
+    while (*utf8) {
+        const Glyph *glyph(get_glyph(next_codepoint(utf8)));
+        if (glyph) {
+            width += glyph->advance;
+        }
+    }
+    return width;
+}
+
+GLuint GlyphAtlas::get_gl_texture() {
+    GLState &gl_state(GLState::get_current());
+
+    if (!gl_texture) {
+        glGenTextures(1, &gl_texture);
+        gl_state.bind_texture(gl_texture);
+
+        // Glyphs are drawn texel for texel
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    }
+    else {
+        gl_state.bind_texture(gl_texture);
+    }
+
+    if (gl_texture_height != texture_height) {
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_ALPHA, texture_width, texture_height, 0,
+                     GL_ALPHA, GL_UNSIGNED_BYTE, texels.data());
+        GPUMemory::get_current().set_texture(gl_texture, GPUMemory::Category::TEXT,
+                                             GPUMemory::get_texture_bytes(texture_width, texture_height, GL_ALPHA, GL_UNSIGNED_BYTE));
+        RenderStats::get_instance().record_upload(texels.size());
+        gl_texture_height = texture_height;
+
+        VLOG(1) << "GlyphAtlas: Created " << texture_width << "x" << texture_height << " texture " << gl_texture;
+    }
+    else if (dirty_rows_end > dirty_rows_begin) {
+        // Whole rows are contiguous in the texels, so need no unpacking
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, dirty_rows_begin, texture_width, dirty_rows_end - dirty_rows_begin,
+                        GL_ALPHA, GL_UNSIGNED_BYTE, &texels[size_t(dirty_rows_begin) * size_t(texture_width)]);
+        RenderStats::get_instance().record_upload(size_t(dirty_rows_end - dirty_rows_begin) * size_t(texture_width));
+    }
+
+    dirty_rows_begin = dirty_rows_end = 0;
+
+    return gl_texture;
+}
+
+void GlyphAtlas::generate_distance_field(const GLubyte *coverage, GLubyte *field, int width, int height) {
+    // Cells are small and only made once per glyph, so a plain search
+    // of the surrounding texels is quick enough
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            int nearest(max_distance * max_distance + 1);
+
+            if (coverage[y*width + x]) {
+                nearest = 0;
+            }
+            else {
+                int min_y(std::max(y - max_distance, 0)), max_y(std::min(y + max_distance, height - 1));
+                int min_x(std::max(x - max_distance, 0)), max_x(std::min(x + max_distance, width  - 1));
+                for (int sy = min_y; sy <= max_y; ++sy) {
+                    for (int sx = min_x; sx <= max_x; ++sx) {
+                        if (coverage[sy*width + sx]) {
+                            nearest = std::min(nearest, (sx - x) * (sx - x) + (sy - y) * (sy - y));
+                        }
+                    }
+                }
+            }
+
+            float distance(std::sqrt(float(nearest)) / float(max_distance));
+            field[y*width + x] = GLubyte(std::max(1.0f - distance, 0.0f) * 255.0f + 0.5f);
+        }
+    }
+}
+
+
+// My own spicy algorithm for creating a cheap bloom effect.
+//
+// Perform a vertical scan, to create a list of vertical distances from
+// seed points.
+// Perform a horizontal scan and calculate a winning radiance from the
+// distances in the vertical scan.
+//
+// We perform vertical scan and then horizontal to enable better
+// optimisation.
+void GlyphAtlas::apply_newson_bloom(const GLubyte *coverage, GLubyte *glow, int width, int height, int glow_radius) {
+    // Stores distance information from the first pass.
+    int* vertical_scan(new int[width*height]);
+    int grpo = glow_radius + 1;
+
+    // Vertical Scan.
+    int i = 0;
+    for (int x = 0; x < width; ++x) {
+        int seed_y = 0;
+        for (; seed_y < height && coverage[seed_y*width + x] == 0; ++seed_y);
+        if (seed_y == height) {
+            // It's a blank line, so move on.
+            for (int y = 0; y < height; ++y) {
+                vertical_scan[i] = 0;
+                i += width;
+            }
+        } else {
+            int seed_y_prev = -1;
+            for (int y = 0; y < height; ++y) {
+                if (y == seed_y) {
+                    // Find the next seed (or go outside of image).
+                    for (++seed_y; seed_y < height && coverage[seed_y*width + x] == 0; ++seed_y);
+                    seed_y_prev = y;
+                }
+
+                int r(0);
+                if (seed_y_prev != -1) {
+                    // Calculate radius from distance from last seed.
+                    r = glow_radius - (y - seed_y_prev);
+                }
+                if (seed_y != height) {
+                    // Calculate radius from distance from next seed.
+                    int r2(glow_radius - (seed_y - y));
+                    if (r2 > r) {
+                        r = r2;
+                    }
+                }
+                if (r > 0) {
+                    vertical_scan[i] = r;
+                }
+                else {
+                    // If it's too far away, set radiance to 0.
+                    vertical_scan[i] = 0;
+                }
+                i += width;
+            }
+        }
+        i += 1 - (width * height);
+    }
+
+    // Pre-compute pythagoras's theorem and 0-255 scale strength.
+    int* pythag(new int[(grpo)*(grpo)]);
+    for (int y = 0; y <= glow_radius; ++y) {
+        int ry = glow_radius - y;
+        for (int x = 0; x <= glow_radius; ++x) {
+            int rx = x;
+            int score(int((float(glow_radius) - sqrt(float(rx*rx + ry*ry))) * 255.0f / float(glow_radius)));
+            pythag[x+y*grpo] = (score > 0) ? score*score/255 : 0;
+        }
+    }
+
+    // Horizontal Scan.
+    i = 0;
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            // The glyph is drawn over its glow, so glow fully under it.
+            if (coverage[i] == 0) {
+                int winner = pythag[vertical_scan[i]*grpo];
+                for (int dx = 1; dx < glow_radius; ++dx) {
+                    int candidate(0);
+                    if (x - dx >= 0) {
+                        candidate = pythag[dx+vertical_scan[i - dx]*grpo];
+                    }
+                    if (x + dx < width) {
+                        int candidate2(pythag[dx+vertical_scan[i + dx]*grpo]);
+                        if (candidate2 > candidate) {
+                            candidate = candidate2;
+                        }
+                    }
+                    if (candidate > winner) {
+                        winner = candidate;
+                    }
+                }
+                glow[i] = GLubyte(winner);
+            }
+            else {
+                glow[i] = 255;
+            }
+            ++i;
+        }
+    }
+
+    delete[] vertical_scan;
+    delete[] pythag;
+}
@@ -0,0 +1,303 @@
+#ifndef GLYPH_ATLAS_H
+#define GLYPH_ATLAS_H
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+extern "C" {
+#ifdef USE_GL
+#define GL_GLEXT_PROTOTYPES
+#include <GL/gl.h>
+#endif
+
+#ifdef USE_GLES
+#include <GLES2/gl2.h>
+#endif
+}
+
+#include "text_font.hpp"
+
+///
+/// A texture holding the glyphs of a font, rasterised the first time
+/// they are used, so that text can be drawn as a quad per glyph rather
+/// than rendering every string to its own texture.
+///
+/// The texture has a single alpha channel, so text of any colour can be
+/// drawn from it. Besides the glyphs themselves, it holds a distance
+/// field around each glyph, from which the text shader draws glows of
+/// any radius up to max_distance. Larger glows are worked out on the
+/// CPU for each radius in use.
+///
+/// Atlases are shared by every Text using the same font and smoothing,
+/// through get_shared.
+///
+class GlyphAtlas {
+public:
+    ///
+    /// Where a glyph is in the atlas and how to place it.
+    ///
+    struct Glyph {
+        ///
+        /// The left of the glyph's cell in the atlas, in texels
+        ///
+        int x;
+
+        ///
+        /// The top of the glyph's cell in the atlas, in texels
+        ///
+        int y;
+
+        ///
+        /// The size of the cell in texels. Glyphs with nothing to draw,
+        /// such as spaces, have an empty cell.
+        ///
+        int width;
+        int height;
+
+        ///
+        /// The distance from the pen position to the left of the cell
+        ///
+        int offset_x;
+
+        ///
+        /// The distance from the top of the line to the top of the cell
+        ///
+        int offset_y;
+
+        ///
+        /// The distance to move the pen after the glyph
+        ///
+        int advance;
+    };
+
+private:
+    ///
+    /// The width of the texture in texels
+    ///
+    static const int texture_width = 512;
+
+    ///
+    /// The height the texture starts at, doubling as it fills
+    ///
+    static const int initial_height = 128;
+
+    ///
+    /// The tallest the texture can grow, after which it is cleared
+    ///
+    static const int max_height = 2048;
+
+    ///
+    /// A font file, point size and smoothing
+    ///
+    using Key = std::tuple<std::string, int, bool>;
+
+    ///
+    /// Atlases by font and smoothing, for get_shared. Fonts are keyed by
+    /// their file and size rather than the TTF_Font, whose address can
+    /// be reused once it is closed.
+    ///
+    static std::map<Key, std::weak_ptr<GlyphAtlas>> atlases;
+
+    ///
+    /// The font glyphs are rasterised from
+    ///
+    TextFont font;
+
+    ///
+    /// Whether glyphs are anti-aliased
+    ///
+    bool smooth;
+
+    ///
+    /// The height of a line of text
+    ///
+    int line_height;
+
+    ///
+    /// The width of a space, which is drawn before each glyph to work
+    /// around SDL_ttf mis-rendering some leading characters
+    ///
+    int space_width;
+
+    ///
+    /// Rasterised glyphs by codepoint and glow radius, where a radius
+    /// of 0 is the glyph itself and -1 its distance field
+    ///
+    std::map<std::pair<uint32_t, int>, Glyph> glyphs;
+
+    ///
+    /// The height of the texture in texels
+    ///
+    int texture_height = initial_height;
+
+    ///
+    /// Alpha texels, row by row from the top
+    ///
+    std::vector<GLubyte> texels;
+
+    ///
+    /// The top of the row of cells being filled
+    ///
+    int shelf_y = 0;
+
+    ///
+    /// The height of the tallest cell in the current row
+    ///
+    int shelf_height = 0;
+
+    ///
+    /// The left of the next cell in the current row
+    ///
+    int shelf_x = 0;
+
+    ///
+    /// The rows of texels changed since the texture was last updated,
+    /// empty if dirty_rows_end <= dirty_rows_begin
+    ///
+    int dirty_rows_begin = 0;
+    int dirty_rows_end = 0;
+
+    ///
+    /// The GL texture, or 0 if it has not been created
+    ///
+    GLuint gl_texture = 0;
+
+    ///
+    /// The height of the GL texture, to know when it must be recreated
+    ///
+    int gl_texture_height = 0;
+
+    ///
+    /// The last revision given to any atlas
+    ///
+    static int last_revision;
+
+    ///
+    /// Changed whenever existing glyphs move in texture coordinates.
+    /// Revisions are unique across atlases, so layouts cached for an
+    /// atlas which has been destroyed never match a new one.
+    ///
+    int revision = ++last_revision;
+
+    ///
+    /// Rasterise a glyph's coverage into a buffer
+    /// @param codepoint the glyph
+    /// @param coverage filled with width * height alpha values
+    /// @param glyph filled with the size, offset and advance
+    /// @return false if SDL_ttf could not render the glyph
+    ///
+    bool rasterise(uint32_t codepoint, std::vector<GLubyte> &coverage, Glyph &glyph);
+
+    ///
+    /// Find space for a cell, growing or clearing the texture if needed
+    /// @param glyph the glyph, whose x and y are set
+    /// @return false if the cell can never fit
+    ///
+    bool allocate(Glyph &glyph);
+
+    ///
+    /// Copy a cell's alpha values into the texels
+    ///
+    void store(const Glyph &glyph, const std::vector<GLubyte> &cell);
+
+    ///
+    /// Forget every glyph, to make space for new ones
+    ///
+    void clear();
+
+    ///
+    /// Work out the distance from each texel to the nearest covered
+    /// one, stored as 255 on the glyph falling to 0 at max_distance.
+    ///
+    /// @param coverage width * height alpha values, row by row
+    /// @param field filled with width * height distances
+    /// @param width the width of both buffers
+    /// @param height the height of both buffers
+    ///
+    static void generate_distance_field(const GLubyte *coverage, GLubyte *field, int width, int height);
+
+public:
+    ///
+    /// The largest glow radius drawn from the distance fields, in texels
+    ///
+    static const int max_distance = 8;
+
+    ///
+    /// Get the atlas for a font, creating it if there is none
+    /// @param font the font
+    /// @param smooth whether glyphs are anti-aliased
+    ///
+    static std::shared_ptr<GlyphAtlas> get_shared(TextFont font, bool smooth);
+
+    ///
+    /// Work out the glow around some glyph coverage. The glow is
+    /// strongest on and next to the glyph and fades to 0 at the radius.
+    ///
+    /// This is only used for glows too large for the distance fields.
+    ///
+    /// @param coverage width * height alpha values, row by row
+    /// @param glow filled with width * height glow strengths
+    /// @param width the width of both buffers
+    /// @param height the height of both buffers
+    /// @param glow_radius the radius of the glow in texels
+    ///
+    static void apply_newson_bloom(const GLubyte *coverage, GLubyte *glow, int width, int height, int glow_radius);
+
+    ///
+    /// Read a UTF-8 character.
+    /// @param utf8 the character, which is moved past it
+    /// @return the codepoint, or U+FFFD for malformed characters
+    ///
+    static uint32_t next_codepoint(const char *&utf8);
+
+    GlyphAtlas(TextFont font, bool smooth);
+    ~GlyphAtlas();
+
+    GlyphAtlas(const GlyphAtlas &) = delete;
+    GlyphAtlas &operator=(const GlyphAtlas &) = delete;
+
+    ///
+    /// Get a glyph, rasterising it into the atlas if it is not there.
+    /// Rasterising does not touch GL; the texture is updated by the
+    /// next get_gl_texture.
+    ///
+    /// @param codepoint the character
+    /// @param glow_radius 0 for the glyph; up to max_distance for its
+    ///        distance field, for the text shader to draw a glow of
+    ///        that radius from; otherwise the glow of that radius
+    /// @return the glyph, or nullptr if it cannot be rasterised
+    ///
+    const Glyph *get_glyph(uint32_t codepoint, int glow_radius = 0);
+
+    ///
+    /// Measure a line of text by its glyphs' advances
+    /// @param utf8 the line
+    /// @return the width in pixels
+    ///
+    int measure(const char *utf8);
+
+    ///
+    /// Get the GL texture, creating or updating it if glyphs have been
+    /// added. It is bound to the active texture unit.
+    ///
+    GLuint get_gl_texture();
+
+    int get_line_height() { return line_height; }
+    int get_space_width() { return space_width; }
+
+    int get_width() { return texture_width; }
+    int get_height() { return texture_height; }
+
+    ///
+    /// Get the revision of the glyph positions. Text laid out at an
+    /// older revision must be laid out again.
+    ///
+    int get_revision() { return revision; }
+};
+
+#endif
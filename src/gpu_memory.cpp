@@ -0,0 +1,121 @@
+#include <glog/logging.h>
+#include <ostream>
+#include <sstream>
+#include <string>
+
+#include "gpu_memory.hpp"
+#include "graphics_context.hpp"
+#include "report_format.hpp"
+
+const int GPUMemory::category_count;
+
+using report_format::to_kib;
+
+GPUMemory &GPUMemory::get_current() {
+    return CHECK_NOTNULL(GraphicsContext::get_current())->get_gpu_memory();
+}
+
+const char *GPUMemory::get_category_name(Category category) {
+    switch (category) {
+    case Category::MAP_LAYER:
+        return "map layer";
+    case Category::MAP_OBJECT:
+        return "map object";
+    case Category::TEXT:
+        return "text";
+    case Category::GUI:
+        return "GUI";
+    case Category::ATLAS:
+        return "atlas";
+    case Category::CURSOR:
+        return "cursor";
+    case Category::SHARED:
+        return "shared";
+    }
+    return "unknown";
+}
+
+size_t GPUMemory::get_texture_bytes(GLsizei width, GLsizei height, GLenum format, GLenum type) {
+    size_t pixel_bytes;
+    switch (type) {
+    case GL_UNSIGNED_SHORT_4_4_4_4:
+    case GL_UNSIGNED_SHORT_5_5_5_1:
+    case GL_UNSIGNED_SHORT_5_6_5:
+        pixel_bytes = 2;
+        break;
+    default:
+        switch (format) {
+        case GL_RGBA:
+            pixel_bytes = 4;
+            break;
+        case GL_RGB:
+            pixel_bytes = 3;
+            break;
+        case GL_LUMINANCE_ALPHA:
+            pixel_bytes = 2;
+            break;
+        default:
+            pixel_bytes = 1;
+            break;
+        }
+        break;
+    }
+    return size_t(width) * size_t(height) * pixel_bytes;
+}
+
+void GPUMemory::set(std::map<GLuint, Allocation> &allocations, GLuint name, Category category, size_t bytes) {
+    forget(allocations, name);
+
+    allocations[name] = Allocation{category, bytes};
+    category_bytes[int(category)] += bytes;
+    total_bytes += bytes;
+    if (total_bytes > peak_bytes) {
+        peak_bytes = total_bytes;
+    }
+}
+
+void GPUMemory::forget(std::map<GLuint, Allocation> &allocations, GLuint name) {
+    auto allocation(allocations.find(name));
+    if (allocation == std::end(allocations)) {
+        return;
+    }
+
+    category_bytes[int(allocation->second.category)] -= allocation->second.bytes;
+    total_bytes -= allocation->second.bytes;
+    allocations.erase(allocation);
+}
+
+void GPUMemory::set_buffer(GLuint buffer, Category category, size_t bytes) {
+    set(buffers, buffer, category, bytes);
+}
+
+void GPUMemory::set_texture(GLuint texture, Category category, size_t bytes) {
+    set(textures, texture, category, bytes);
+}
+
+void GPUMemory::forget_buffer(GLuint buffer) {
+    forget(buffers, buffer);
+}
+
+void GPUMemory::forget_texture(GLuint texture) {
+    forget(textures, texture);
+}
+
+std::string GPUMemory::get_summary() {
+    std::ostringstream summary;
+    summary << "GPU memory: " << to_kib(total_bytes) << " (peak " << to_kib(peak_bytes) << ")";
+    for (int category = 0; category < category_count; ++category) {
+        summary << "\n" << get_category_name(Category(category)) << ": " << to_kib(category_bytes[category]);
+    }
+    return summary.str();
+}
+
+void GPUMemory::report() {
+    std::ostringstream categories;
+    for (int category = 0; category < category_count; ++category) {
+        categories << (category ? ", " : "")
+                   << get_category_name(Category(category)) << " " << to_kib(category_bytes[category]);
+    }
+    LOG(INFO) << "GPU memory: " << to_kib(total_bytes) << " in " << buffers.size() << " buffers and "
+              << textures.size() << " textures, peak " << to_kib(peak_bytes) << " (" << categories.str() << ")";
+}
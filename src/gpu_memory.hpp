@@ -0,0 +1,155 @@
+#ifndef GPU_MEMORY_H
+#define GPU_MEMORY_H
+
+#include <cstddef>
+#include <map>
+#include <string>
+
+#ifdef USE_GLES
+#include <GLES2/gl2.h>
+#endif
+
+#ifdef USE_GL
+#define GL_GLEXT_PROTOTYPES
+#include <GL/gl.h>
+#endif
+
+///
+/// A record of the GL buffers and textures allocated in one
+/// GraphicsContext, and what they were allocated for.
+///
+/// Every glBufferData, glTexImage2D and glCompressedTexImage2D call
+/// should be followed by a call to set_buffer or set_texture with the
+/// size of the storage, and every delete preceded by a call to
+/// forget_buffer or forget_texture, like the GLState calls around them.
+/// Calling set again for the same name, as when a buffer is refilled or
+/// a texture grown, replaces its size.
+///
+/// The sizes are those of the data given to GL, so drivers which pad
+/// or convert textures use somewhat more.
+///
+class GPUMemory {
+public:
+    ///
+    /// What an allocation is for
+    ///
+    enum class Category {
+        ///
+        /// Tile layers: their vertex buffers, cached pages and tile
+        /// index textures
+        ///
+        MAP_LAYER,
+        ///
+        /// Sprites and other map objects
+        ///
+        MAP_OBJECT,
+        ///
+        /// Text, labels and glyph atlases
+        ///
+        TEXT,
+        ///
+        /// The GUI's vertex buffers
+        ///
+        GUI,
+        ///
+        /// Texture atlas pages
+        ///
+        ATLAS,
+        ///
+        /// The mouse cursor's quad
+        ///
+        CURSOR,
+        ///
+        /// Buffers used by every kind of renderable, such as the quad
+        /// index buffer
+        ///
+        SHARED
+    };
+
+    static const int category_count = 7;
+
+private:
+    struct Allocation {
+        Category category;
+        size_t bytes;
+    };
+
+    std::map<GLuint, Allocation> buffers;
+    std::map<GLuint, Allocation> textures;
+
+    size_t category_bytes[category_count] = {};
+    size_t total_bytes = 0;
+    size_t peak_bytes = 0;
+
+    void set(std::map<GLuint, Allocation> &allocations, GLuint name, Category category, size_t bytes);
+    void forget(std::map<GLuint, Allocation> &allocations, GLuint name);
+
+public:
+    ///
+    /// Get the record of the current GraphicsContext.
+    ///
+    /// There must be a current context.
+    ///
+    static GPUMemory &get_current();
+
+    ///
+    /// @return The category's name, such as "map layer".
+    ///
+    static const char *get_category_name(Category category);
+
+    ///
+    /// Get the size of an uncompressed texture.
+    ///
+    /// @param format The format passed to glTexImage2D.
+    /// @param type The type passed to glTexImage2D.
+    ///
+    static size_t get_texture_bytes(GLsizei width, GLsizei height, GLenum format, GLenum type);
+
+    ///
+    /// Record the storage of a buffer, after glBufferData.
+    ///
+    void set_buffer(GLuint buffer, Category category, size_t bytes);
+
+    ///
+    /// Record the storage of a texture, after glTexImage2D or
+    /// glCompressedTexImage2D.
+    ///
+    void set_texture(GLuint texture, Category category, size_t bytes);
+
+    ///
+    /// Record that a buffer is about to be deleted.
+    ///
+    void forget_buffer(GLuint buffer);
+
+    ///
+    /// Record that a texture is about to be deleted.
+    ///
+    void forget_texture(GLuint texture);
+
+    ///
+    /// @return The bytes allocated for a category.
+    ///
+    size_t get_bytes(Category category) { return category_bytes[int(category)]; }
+
+    ///
+    /// @return The bytes allocated for everything.
+    ///
+    size_t get_total_bytes() { return total_bytes; }
+
+    ///
+    /// @return The most bytes allocated at once.
+    ///
+    size_t get_peak_bytes() { return peak_bytes; }
+
+    ///
+    /// Get the totals on one line each, for drawing on screen.
+    ///
+    std::string get_summary();
+
+    ///
+    /// Log the totals of each category.
+    ///
+    void report();
+};
+
+#endif
@@ -13,12 +13,15 @@ GraphicsContext* GraphicsContext::current = nullptr;
 
 
 GraphicsContext::GraphicsContext(GameWindow* window):
-    window(window) {
+    window(window),
+    quad_index_buffer(0) {
 }
 
 
 GraphicsContext::~GraphicsContext() {
     LOG(INFO) << "Graphics context " << this << " destroyed: Releasing resources.";
+    gl_state.report();
+    gpu_memory.report();
     resource_releasers.broadcast();
 }
 
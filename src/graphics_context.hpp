@@ -12,6 +12,8 @@ extern "C" {
 
 #include "callback.hpp"
 #include "callback_registry.hpp"
+#include "gl_state.hpp"
+#include "gpu_memory.hpp"
 
 
 
@@ -57,6 +59,22 @@ private:
     /// is destroyed.
     ///
     CallbackRegistry<void> resource_releasers;
+
+    ///
+    /// Shadow of the GL binding state of this context.
+    ///
+    GLState gl_state;
+
+    ///
+    /// The buffers and textures allocated in this context.
+    ///
+    GPUMemory gpu_memory;
+
+    ///
+    /// The index buffer shared by every renderable's quads, or 0 until
+    /// it is first needed.
+    ///
+    GLuint quad_index_buffer;
 public:
     ///
     /// Return true if the contexts use the same GL context.
@@ -78,6 +96,28 @@ public:
     ///
     void register_resource_releaser(Callback<void> callback);
 
+    ///
+    /// Get the tracked GL binding state of this context.
+    ///
+    GLState &get_gl_state() { return gl_state; }
+
+    ///
+    /// Get the record of the GL memory allocated in this context.
+    ///
+    GPUMemory &get_gpu_memory() { return gpu_memory; }
+
+    ///
+    /// Get the shared quad index buffer of this context, or 0 if it has
+    /// not been created.
+    ///
+    GLuint get_quad_index_buffer() { return quad_index_buffer; }
+
+    ///
+    /// Set the shared quad index buffer of this context. Whoever creates
+    /// it registers a releaser to delete it.
+    ///
+    void set_quad_index_buffer(GLuint buffer) { quad_index_buffer = buffer; }
+
     ///
     /// Get the current active context.
     ///
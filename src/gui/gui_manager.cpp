@@ -10,6 +10,8 @@
 #include "cacheable_resource.hpp"
 #include "component.hpp"
 #include "component_group.hpp"
+#include "engine.hpp"
+#include "gpu_memory.hpp"
 #include "gui_manager.hpp"
 #include "mouse_input_event.hpp"
 #include "mouse_state.hpp"
@@ -36,11 +38,12 @@ void GUIManager::parse_components() {
     regenerate_offsets(root);
 
     //Now generate the needed rendering data
-    generate_texture_data();
-    generate_vertex_data();
+    generate_quad_data();
 
     generate_text_data();
     init_shaders();
+
+    Engine::request_redraw();
 }
 
 void GUIManager::regenerate_offsets(std::shared_ptr<Component> parent) {
@@ -143,7 +146,7 @@ bool GUIManager::handle_mouse_click(std::shared_ptr<Component> root, int mouse_x
 }
 
 GUIManager::GUIManager() {
-
+    renderable_component.set_memory_category(GPUMemory::Category::GUI);
 }
 
 GUIManager::~GUIManager() {
@@ -152,80 +155,65 @@ GUIManager::~GUIManager() {
 
 
 
-void GUIManager::generate_texture_data() {
-    
-    //generate the texture data data
-    std::vector<std::pair<GLfloat*, int>> components_data = root->generate_texture_data();
+void GUIManager::generate_quad_data() {
+    //generate the texture and vertex data
+    std::vector<std::pair<GLfloat*, int>> components_texture_data = root->generate_texture_data();
+    std::vector<std::pair<GLfloat*, int>> components_vertex_data = root->generate_vertex_data();
 
     //calculate data size
+    long num_tex_floats = 0;
+    for(auto component_texture_data : components_texture_data) {
+        num_tex_floats += component_texture_data.second;
+    }
+
     long num_floats = 0;
-    for(auto component_texture_data : components_data) {
-        num_floats += component_texture_data.second;
+    for(auto component_vertex_data : components_vertex_data) {
+        num_floats += component_vertex_data.second;
+    }
+
+    if(num_tex_floats != num_floats) {
+        LOG(ERROR) << "ERROR: texture and vertex data sizes differ in GUIManager::generate_quad_data()";
+        return;
     }
 
-    GLfloat* gui_tex_data = nullptr;
-    //Create a buffer for the data
+    //Create buffers for the data
+    std::vector<GLfloat> gui_tex_data;
+    std::vector<GLfloat> gui_data;
     try {
-        gui_tex_data  = new GLfloat[sizeof(GLfloat)*num_floats];
+        gui_tex_data.reserve(size_t(num_floats));
+        gui_data.reserve(size_t(num_floats));
     }
     catch(std::bad_alloc& ba) {
-        LOG(ERROR) << "ERROR: bad_alloc caught in GUIManager::generate_tex_data()" << ba.what();
+        LOG(ERROR) << "ERROR: bad_alloc caught in GUIManager::generate_quad_data()" << ba.what();
         return;
     }
 
-
-    int gui_tex_data_offset = 0;
-
     //Extract the data
-    for(auto component_texture_data : components_data) {
+    for(auto component_texture_data : components_texture_data) {
         GLfloat* texture_coords = component_texture_data.first;
         size_t texture_coords_size = size_t(component_texture_data.second);
 
         //copy data into buffer
-        std::copy(texture_coords, &texture_coords[texture_coords_size], &gui_tex_data[gui_tex_data_offset]);
-
-        gui_tex_data_offset += component_texture_data.second;
-    }
-
-    //Generate the data
-    renderable_component.set_texture_coords_data(gui_tex_data, sizeof(GLfloat)*num_floats, false);
-}
-
-void GUIManager::generate_vertex_data() {
-    //generate the vertex data
-    std::vector<std::pair<GLfloat*, int>> components_data = root->generate_vertex_data();
-
-    //calculate data size
-    int num_dimensions = 2;
-    long num_floats = 0;
-    for(auto component_vertex_data : components_data) {
-        num_floats += component_vertex_data.second;
-    }
-
-    //Create a buffer for the data
-    GLfloat* gui_data = nullptr;
-    try {
-        gui_data  = new GLfloat[sizeof(GLfloat)*num_floats];
-    }
-    catch(std::bad_alloc& ba) {
-        LOG(ERROR) << "bad_alloc caught in GUIManager::generate_vertex_data()" << ba.what();
-        return;
+        gui_tex_data.insert(gui_tex_data.end(), texture_coords, &texture_coords[texture_coords_size]);
     }
 
-    int gui_data_offset = 0;
-    //Extract the data
-    for(auto component_vertex_data : components_data) {
+    for(auto component_vertex_data : components_vertex_data) {
         GLfloat* vertices = component_vertex_data.first;
         size_t vertices_size = size_t(component_vertex_data.second);
 
         //copy data into buffer
-        std::copy(vertices, &vertices[vertices_size], &gui_data[gui_data_offset]);
+        gui_data.insert(gui_data.end(), vertices, &vertices[vertices_size]);
+    }
 
-        gui_data_offset += component_vertex_data.second;
+    //The components generate two triangles, 12 floats, per quad
+    size_t num_quads = size_t(num_floats) / 12;
+    GLfloat* gui_quad_data = RenderableComponent::quads_from_triangles(gui_data.data(), gui_tex_data.data(), num_quads);
+    if(gui_quad_data == nullptr) {
+        return;
     }
 
-    renderable_component.set_vertex_data(gui_data,sizeof(GLfloat)*num_floats, false);
-    renderable_component.set_num_vertices_render(GLsizei(num_floats/num_dimensions));//GL_TRIANGLES being used
+    renderable_component.set_quad_data(gui_quad_data, sizeof(GLfloat) * num_quads * RenderableComponent::floats_per_quad, false);
+    renderable_component.set_num_quads_render(GLsizei(num_quads));
 }
 
 void GUIManager::generate_text_data() {
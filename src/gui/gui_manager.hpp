@@ -32,14 +32,11 @@ class GUIManager : public Object {
     std::vector<std::shared_ptr<GUIText>> components_text;
 
     ///
-    /// Generate the texture data for this component and its sub components
+    /// Generate the quad data for this component and its sub components.
+    /// The components generate separate triangle vertex and texture
+    /// data, which is combined into interleaved quads here.
     ///
-    void generate_texture_data();
-
-    ///
-    /// Generate the vertex data for this component and its sub components
-    ///
-    void generate_vertex_data();
+    void generate_quad_data();
 
     ///
     /// Generate the text data for this component and its sub componets
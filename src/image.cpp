@@ -1,5 +1,7 @@
-#include <cstring>
+#include <algorithm>
+#include <cstddef>
 #include <glog/logging.h>
+#include <mutex>
 #include <new>
 #include <ostream>
 #include <sstream>
@@ -12,6 +14,7 @@ extern "C" {
 
 #include "image.hpp"
 #include "lifeline.hpp"
+#include "pixel_ops.hpp"
 
 
 // Need to inherit constructors manually.
@@ -76,6 +79,18 @@ Image::Image(int width, int height, bool opengl) {
     create_blank(width, height);
 }
 
+Image::Image(int width, int height, int store_width, int store_height, Pixel* pixels, Lifeline owner):
+    resource_lifeline(owner),
+    flipped_pixels(Flipper(store_width, store_height, pixels)),
+    width(width),
+    height(height),
+    store_width(store_width),
+    store_height(store_height),
+    pixels(pixels),
+    power_of_two(false),
+    flipped(true) {
+}
+
 
 Image::~Image() {
 }
@@ -106,12 +121,11 @@ void Image::create_blank(int w, int h) {
 }
 
 
-void Image::load_file(const char* filename) {
-    // The image is loaded into this surface.
-    SDL_Surface* loaded;
-    // A surface with a known format to blit the loaded image on to.
-    SDL_Surface* compatible;
+// IMG_Init is not thread-safe, and images are decoded on the asset
+// loader's threads, so it is only called once
+static std::once_flag image_subsystem_initialised;
 
+static void init_image_subsystem() {
     if ((IMG_Init(IMG_INIT_JPG) & IMG_INIT_JPG) == 0) {
         LOG(WARNING) << "Warning: Failure initialising image subsystem: " << IMG_GetError();
     }
@@ -121,6 +135,15 @@ void Image::load_file(const char* filename) {
     if ((IMG_Init(IMG_INIT_TIF) & IMG_INIT_TIF) == 0) {
         LOG(WARNING) << "Warning: Failure initialising image subsystem: " << IMG_GetError();
     }
+}
+
+void Image::load_file(const char* filename) {
+    // The image is loaded into this surface.
+    SDL_Surface* loaded;
+    // A surface with a known format to blit the loaded image on to.
+    SDL_Surface* compatible;
+
+    std::call_once(image_subsystem_initialised, init_image_subsystem);
 
     loaded = IMG_Load(filename);
 
@@ -131,50 +154,70 @@ void Image::load_file(const char* filename) {
         throw Image::LoadException(error_message.str());
     }
 
-    // This surface has a known format.
-    compatible = SDL_CreateRGBSurface(0, // Unsed
-                                      loaded->w,
-                                      loaded->h,
-                                      32, // 32 bit
 #if SDL_BYTE_ORDER == SDL_BIG_ENDIAN
-                                      0xff000000,
-                                      0x00ff0000,
-                                      0x0000ff00,
-                                      0x000000ff
+    const Uint32 rgba_format(SDL_PIXELFORMAT_RGBA8888);
+    const Uint32 bgra_format(SDL_PIXELFORMAT_BGRA8888);
+#else
+    const Uint32 rgba_format(SDL_PIXELFORMAT_ABGR8888);
+    const Uint32 bgra_format(SDL_PIXELFORMAT_ARGB8888);
+#endif
+
+    // Images in RGBA, as PNGs with alpha usually are, or BGRA are copied
+    // straight out of the loaded surface. Anything else is converted by
+    // blitting it on to a surface with a known format.
+    SDL_Surface* source = loaded;
+    bool swap_red_blue = loaded->format->format == bgra_format;
+
+    if (loaded->format->format != rgba_format && !swap_red_blue) {
+        // This surface has a known format.
+        compatible = SDL_CreateRGBSurface(0, // Unsed
+                                          loaded->w,
+                                          loaded->h,
+                                          32, // 32 bit
+#if SDL_BYTE_ORDER == SDL_BIG_ENDIAN
+                                          0xff000000,
+                                          0x00ff0000,
+                                          0x0000ff00,
+                                          0x000000ff
 #else
-                                      0x000000ff,
-                                      0x0000ff00,
-                                      0x00ff0000,
-                                      0xff000000
+                                          0x000000ff,
+                                          0x0000ff00,
+                                          0x00ff0000,
+                                          0xff000000
 #endif
-                                      );
+                                          );
 
-    if (compatible == nullptr) {
+        if (compatible == nullptr) {
+            SDL_FreeSurface(loaded);
+            pixels = nullptr;
+            throw Image::LoadException("Failed to allocate space.");
+        }
+
+        SDL_SetSurfaceBlendMode(loaded, SDL_BLENDMODE_NONE);
+        SDL_BlitSurface(loaded, NULL, compatible, NULL);
         SDL_FreeSurface(loaded);
-        pixels = nullptr;
-        throw Image::LoadException("Failed to allocate space.");
+        source = compatible;
     }
 
-    SDL_SetSurfaceBlendMode(loaded, SDL_BLENDMODE_NONE);
-    SDL_BlitSurface(loaded, NULL, compatible, NULL);
-    SDL_FreeSurface(loaded);
-
     try {
-        create_blank(compatible->w, compatible->h);
+        create_blank(source->w, source->h);
     }
     catch (std::bad_alloc& e) {
         LOG(ERROR) << "Error loading image \"" << filename << "\": " << e.what();
-        SDL_FreeSurface(compatible);
+        SDL_FreeSurface(source);
         throw e;
     }
 
-    SDL_LockSurface(compatible);
-    for (int y = 0; y < height; y++) {
-        std::memcpy ((*this)[flipped ? (store_height-y-1) : y], &((Image::Pixel*)compatible->pixels)[y*compatible->w], 4 * compatible->w);
+    SDL_LockSurface(source);
+    if (swap_red_blue) {
+        pixel_ops::swap_red_blue_rect(row(0), row_pitch(), source->pixels, source->pitch, size_t(width), height);
+    }
+    else {
+        pixel_ops::copy_rect(row(0), row_pitch(), source->pixels, source->pitch, size_t(width) * sizeof(Pixel), height);
     }
-    SDL_UnlockSurface(compatible);
+    SDL_UnlockSurface(source);
 
-    SDL_FreeSurface(compatible);
+    SDL_FreeSurface(source);
 
     // Errrrr... There isn't currently any logical place to put an
     // IMG_Quit()... It's not going to cause any problems, it's just a
@@ -182,6 +225,33 @@ void Image::load_file(const char* filename) {
 }
 
 
+void Image::blit(Image &src, int src_x, int src_y, int w, int h, int dst_x, int dst_y) {
+    // Clip to the source then the destination
+    if (src_x < 0) { w += src_x; dst_x -= src_x; src_x = 0; }
+    if (src_y < 0) { h += src_y; dst_y -= src_y; src_y = 0; }
+    if (dst_x < 0) { w += dst_x; src_x -= dst_x; dst_x = 0; }
+    if (dst_y < 0) { h += dst_y; src_y -= dst_y; dst_y = 0; }
+    w = std::min({w, src.width  - src_x, width  - dst_x});
+    h = std::min({h, src.height - src_y, height - dst_y});
+
+    if (w <= 0 || h <= 0) {
+        return;
+    }
+
+    pixel_ops::copy_rect(&row(dst_y)[dst_x], row_pitch(),
+                         &src.row(src_y)[src_x], src.row_pitch(),
+                         size_t(w) * sizeof(Pixel), h);
+}
+
+void Image::premultiply_alpha() {
+    // Rows are contiguous, but there may be unused space at their ends
+    for (int y = 0; y < height; ++y) {
+        uint8_t *bytes(reinterpret_cast<uint8_t *>(row(y)));
+        pixel_ops::premultiply_alpha(bytes, bytes, size_t(width));
+    }
+}
+
+
 void Image::clear(uint32_t colour, uint32_t mask) {
     uint32_t invmask = ~mask;
     uint8_t ri = (uint8_t)(invmask >> 24);
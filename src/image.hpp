@@ -1,6 +1,7 @@
 #ifndef IMAGE_H
 #define IMAGE_H
 
+#include <cstddef>
 #include <stdexcept>
 #include <string>
 
@@ -88,34 +89,34 @@ public:
     ///
     /// Width of the used image area.
     ///
-    int width;
+    int width = 0;
     ///
     /// Height of the used image area.
     ///
-    int height;
+    int height = 0;
     ///
     /// Width of the allocated image area.
     ///
-    int store_width;
+    int store_width = 0;
     ///
     /// Height of the allocated image area.
     ///
-    int store_height;
+    int store_height = 0;
 
     ///
     /// RGBA Pixels of image
     ///
-    Pixel* pixels;
+    Pixel* pixels = nullptr;
 
     ///
     /// Whether the image width and height should be forced to powers
     /// of two.
     ///
-    bool power_of_two;
+    bool power_of_two = false;
     ///
     /// Flip the image (interchange high and low y values).
     ///
-    bool flipped;
+    bool flipped = false;
 
     ///
     /// Create an empty image (everything initialised to defaults).
@@ -124,6 +125,14 @@ public:
     Image(const char* filename, bool opengl = true);
     Image(const std::string filename, bool opengl = true);
     Image(int width, int height, bool opengl = true);
+    ///
+    /// Wrap flipped pixels held elsewhere, such as in a mapped file,
+    /// without copying them.
+    ///
+    /// @param owner kept alive by the image and its copies, so that it
+    ///        can free the pixels once they are no longer used
+    ///
+    Image(int width, int height, int store_width, int store_height, Pixel* pixels, Lifeline owner);
     ~Image();
 
     ///
@@ -143,6 +152,43 @@ public:
     inline Pixel* operator[](int y) {
         return &pixels[y * store_width];
     }
+
+    ///
+    /// Index a row in the picture, counting from the top whether or not
+    /// the image is flipped.
+    ///
+    inline Pixel* row(int y) {
+        return flipped ? flipped_pixels[y] : (*this)[y];
+    }
+
+    ///
+    /// The distance in bytes from a row of the picture to the one below
+    ///
+    inline std::ptrdiff_t row_pitch() {
+        return std::ptrdiff_t(flipped ? -store_width : store_width) * std::ptrdiff_t(sizeof(Pixel));
+    }
+
+    ///
+    /// Copy a rectangle of pixels from another image, a row at a time.
+    /// Positions count from the top-left of each picture, and the
+    /// rectangle is clipped to both images.
+    ///
+    /// @param src the image to copy from, which may be flipped
+    ///        differently to this one
+    /// @param src_x the left of the rectangle in src
+    /// @param src_y the top of the rectangle in src
+    /// @param w the width of the rectangle
+    /// @param h the height of the rectangle
+    /// @param dst_x the left of the rectangle in this image
+    /// @param dst_y the top of the rectangle in this image
+    ///
+    void blit(Image &src, int src_x, int src_y, int w, int h, int dst_x, int dst_y);
+
+    ///
+    /// Multiply the colour of every pixel by its alpha, for drawing with
+    /// glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA).
+    ///
+    void premultiply_alpha();
     /*
     inline PixelRow& operator[](int y) {
         return *( (PixelRow*)&pixels[y * store_width] );
@@ -0,0 +1,248 @@
+#define GLM_FORCE_RADIANS
+
+#include <cstdint>
+#include <exception>
+#include <glm/gtc/type_ptr.hpp>
+#include <glog/logging.h>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "engine.hpp"
+#include "gl_state.hpp"
+#include "glyph_atlas.hpp"
+#include "gpu_memory.hpp"
+#include "graphics_context.hpp"
+#include "label_layer.hpp"
+#include "render_stats.hpp"
+#include "renderable_component.hpp"
+#include "shader.hpp"
+
+const int LabelLayer::glow_radius;
+
+// Add a glyph's quad, in pixels from the label's anchor with y going up.
+static void add_glyph_quad(std::vector<GLfloat> &quads, const GlyphAtlas::Glyph &glyph,
+                           int pen_x, int line_y, float u_scale, float v_scale) {
+    if (glyph.width == 0 || glyph.height == 0) {
+        return;
+    }
+
+    int left(pen_x + glyph.offset_x);
+    int top(line_y + glyph.offset_y);
+
+    std::tuple<float,float,float,float> tex_bounds(
+        float(glyph.x)                * u_scale,
+        float(glyph.x + glyph.width)  * u_scale,
+        float(glyph.y + glyph.height) * v_scale,
+        float(glyph.y)                * v_scale
+    );
+
+    size_t offset(quads.size());
+    quads.resize(offset + RenderableComponent::floats_per_quad);
+    RenderableComponent::write_quad(&quads[offset],
+                                    float(left), float(left + glyph.width),
+                                    float(-(top + glyph.height)), float(-top),
+                                    tex_bounds);
+}
+
+LabelLayer::LabelLayer() {
+    glGenBuffers(1, &vbo_id);
+    LOG(INFO) << "LabelLayer::LabelLayer: Buffer " << vbo_id;
+
+    try {
+        shader = Shader::get_shared("label_shader");
+    }
+    catch (std::exception &e) {
+        LOG(ERROR) << "LabelLayer::LabelLayer: Failed to create the shader";
+    }
+}
+
+LabelLayer::~LabelLayer() {
+    if (GraphicsContext::get_current()) {
+        GLState::get_current().forget_buffer(vbo_id);
+        GPUMemory::get_current().forget_buffer(vbo_id);
+    }
+    glDeleteBuffers(1, &vbo_id);
+}
+
+void LabelLayer::layout(Label &label) {
+    label.glow_quads.clear();
+    label.glyph_quads.clear();
+
+    // Lines are laid out with a space on each side, as Text does to
+    // work around SDL_ttf
+    int border(glyph_atlas->get_space_width() * 2);
+    int width(glyph_atlas->measure(label.text.c_str()) + border + glow_radius * 2);
+
+    // Centred under the anchor, with room for the glow above
+    int pen_x(-width / 2 + glow_radius + border / 2);
+    int line_y(glow_radius);
+
+    for (const char *scan = label.text.c_str(); *scan != '\0';) {
+        uint32_t codepoint(GlyphAtlas::next_codepoint(scan));
+
+        // Copied, as getting the glow can clear the atlas.
+        const GlyphAtlas::Glyph *found(glyph_atlas->get_glyph(codepoint));
+        if (!found) {
+            continue;
+        }
+        GlyphAtlas::Glyph glyph(*found);
+
+        const GlyphAtlas::Glyph *glow(glyph_atlas->get_glyph(codepoint, glow_radius));
+
+        float u_scale(1.0f / float(glyph_atlas->get_width()));
+        float v_scale(1.0f / float(glyph_atlas->get_height()));
+        if (glow) {
+            add_glyph_quad(label.glow_quads, *glow, pen_x, line_y, u_scale, v_scale);
+        }
+        add_glyph_quad(label.glyph_quads, glyph, pen_x, line_y, u_scale, v_scale);
+
+        pen_x += glyph.advance;
+    }
+}
+
+void LabelLayer::layout_all() {
+    // Laying out can fill the atlas, which moves the glyphs laid out
+    // before, so try again if that happens.
+    for (int attempt = 0; attempt < 2; ++attempt) {
+        glyph_atlas_revision = glyph_atlas->get_revision();
+        for (auto &label : labels) {
+            layout(label.second);
+        }
+        if (glyph_atlas->get_revision() == glyph_atlas_revision) {
+            break;
+        }
+    }
+
+    dirty_vbo = true;
+}
+
+void LabelLayer::generate_vbo(float tile_size) {
+    // Format: vertex_x, vertex_y, texture_x, texture_y, ... in tiles
+    std::vector<GLfloat> vbo_data;
+    auto add_quads([&] (const Label &label, const std::vector<GLfloat> &quads) {
+        for (size_t i = 0; i < quads.size(); i += RenderableComponent::floats_per_vertex) {
+            vbo_data.push_back(label.anchor.x + quads[i    ] / tile_size);
+            vbo_data.push_back(label.anchor.y + quads[i + 1] / tile_size);
+            vbo_data.push_back(quads[i + 2]);
+            vbo_data.push_back(quads[i + 3]);
+        }
+    });
+
+    // All of the glows go under all of the glyphs
+    for (auto &label : labels) {
+        add_quads(label.second, label.second.glow_quads);
+    }
+    num_glow_quads = GLsizei(vbo_data.size() / RenderableComponent::floats_per_quad);
+
+    for (auto &label : labels) {
+        add_quads(label.second, label.second.glyph_quads);
+    }
+    num_quads = GLsizei(vbo_data.size() / RenderableComponent::floats_per_quad);
+
+    GLState::get_current().bind_array_buffer(vbo_id);
+    glBufferData(GL_ARRAY_BUFFER, vbo_data.size() * sizeof(GLfloat), vbo_data.data(), GL_STATIC_DRAW);
+    GPUMemory::get_current().set_buffer(vbo_id, GPUMemory::Category::TEXT, vbo_data.size() * sizeof(GLfloat));
+    RenderStats::get_instance().record_upload(vbo_data.size() * sizeof(GLfloat));
+
+    vbo_tile_size = tile_size;
+    dirty_vbo = false;
+}
+
+void LabelLayer::set_label(int id, std::string text, glm::vec2 anchor) {
+    if (!glyph_atlas) {
+        glyph_atlas = GlyphAtlas::get_shared(Engine::get_game_font(), true);
+        glyph_atlas_revision = glyph_atlas->get_revision();
+    }
+
+    Label &label(labels[id]);
+    label.text = text;
+    label.anchor = anchor;
+
+    layout(label);
+    if (glyph_atlas->get_revision() != glyph_atlas_revision) {
+        layout_all();
+    }
+
+    dirty_vbo = true;
+    Engine::request_redraw();
+}
+
+void LabelLayer::move_label(int id, glm::vec2 anchor) {
+    auto label(labels.find(id));
+    if (label == std::end(labels) || label->second.anchor == anchor) {
+        return;
+    }
+
+    label->second.anchor = anchor;
+    dirty_vbo = true;
+}
+
+void LabelLayer::remove_label(int id) {
+    if (labels.erase(id) > 0) {
+        dirty_vbo = true;
+        Engine::request_redraw();
+    }
+}
+
+void LabelLayer::render(glm::mat4 projection_matrix, glm::mat4 modelview_matrix, float tile_size) {
+    if (labels.empty()) {
+        return;
+    }
+
+    if (!shader) {
+        LOG(ERROR) << "LabelLayer::render: Shader should not be null";
+        return;
+    }
+
+    if (glyph_atlas->get_revision() != glyph_atlas_revision) {
+        // The glyphs have moved in the atlas.
+        layout_all();
+    }
+    if (dirty_vbo || tile_size != vbo_tile_size) {
+        generate_vbo(tile_size);
+    }
+    if (num_quads == 0) {
+        return;
+    }
+
+    GLState &gl_state(GLState::get_current());
+    gl_state.use_program(shader->get_program());
+
+    glUniformMatrix4fv(shader->get_uniform_location("mat_projection"), 1, GL_FALSE, glm::value_ptr(projection_matrix));
+    glUniformMatrix4fv(shader->get_uniform_location("mat_modelview"),  1, GL_FALSE, glm::value_ptr(modelview_matrix));
+    shader->set_uniform("s_texture", 0);
+    glUniform1f(shader->get_uniform_location("glow_spread"), float(GlyphAtlas::max_distance));
+
+    gl_state.active_texture(GL_TEXTURE0);
+    glyph_atlas->get_gl_texture();
+    gl_state.bind_array_buffer(vbo_id);
+    glDisable(GL_DEPTH_TEST);
+
+    gl_state.enable_attribute(0 /* VERTEX_POS_INDX */);
+    gl_state.enable_attribute(1 /* VERTEX_TEXCOORD0_INDX */);
+
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    GLint colour_location(shader->get_uniform_location("colour"));
+    GLint glow_radius_location(shader->get_uniform_location("glow_radius"));
+
+    // Black glows under white glyphs, as Text draws by default
+    if (num_glow_quads > 0) {
+        glUniform4f(colour_location, 0.0f, 0.0f, 0.0f, 1.0f);
+        glUniform1f(glow_radius_location, glow_radius <= GlyphAtlas::max_distance ? float(glow_radius) : 0.0f);
+        RenderableComponent::draw_quad_range(0, num_glow_quads);
+    }
+
+    glUniform4f(colour_location, 1.0f, 1.0f, 1.0f, 1.0f);
+    glUniform1f(glow_radius_location, 0.0f);
+    RenderableComponent::draw_quad_range(num_glow_quads, num_quads - num_glow_quads);
+
+    glEnable(GL_DEPTH_TEST);
+
+    VLOG(3) << "LabelLayer::render: " << labels.size() << " labels in " << num_quads << " quads";
+}
@@ -0,0 +1,175 @@
+#ifndef LABEL_LAYER_H
+#define LABEL_LAYER_H
+
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+#include <glm/mat4x4.hpp>
+#include <glm/vec2.hpp>
+
+#ifdef USE_GLES
+#include <GLES2/gl2.h>
+#endif
+
+#ifdef USE_GL
+#define GL_GLEXT_PROTOTYPES
+#include <GL/gl.h>
+#endif
+
+class GlyphAtlas;
+class Shader;
+
+///
+/// Draws the name labels under sprites from one vertex buffer.
+///
+/// Labels are laid out once, as glyph quads in pixels around an anchor,
+/// and stored in the buffer in tiles from the bottom-left of the map.
+/// The map's modelview matrix scrolls the whole layer, so moving the
+/// camera costs nothing on the CPU and every label is drawn with one
+/// call for the glows and one for the glyphs.
+///
+/// The buffer is only rebuilt when a label is added, moved or removed,
+/// when the tile size changes or when the glyphs move in the atlas.
+///
+/// Labels are a single line of text in the game font, centred under
+/// their anchor.
+///
+class LabelLayer {
+    ///
+    /// A label and its laid out glyphs.
+    ///
+    struct Label {
+        std::string text;
+
+        ///
+        /// The top centre of the label, in tiles
+        ///
+        glm::vec2 anchor;
+
+        ///
+        /// The quads of the glyphs' glows, in pixels from the anchor
+        ///
+        std::vector<GLfloat> glow_quads;
+
+        ///
+        /// The quads of the glyphs, in pixels from the anchor
+        ///
+        std::vector<GLfloat> glyph_quads;
+    };
+
+    ///
+    /// The radius of the glow around the labels, in pixels
+    ///
+    static const int glow_radius = 6;
+
+    ///
+    /// Labels by the id of the object they belong to
+    ///
+    std::map<int, Label> labels;
+
+    ///
+    /// The glyphs of the game font, shared with Text
+    ///
+    std::shared_ptr<GlyphAtlas> glyph_atlas;
+
+    ///
+    /// The revision of the glyph atlas the labels were laid out at
+    ///
+    int glyph_atlas_revision = 0;
+
+    ///
+    /// The size of a tile in pixels when the buffer was generated
+    ///
+    float vbo_tile_size = 0.0f;
+
+    ///
+    /// If true, the vertex buffer needs to be re-generated
+    ///
+    bool dirty_vbo = true;
+
+    ///
+    /// The vertex buffer holding every glow quad followed by every
+    /// glyph quad
+    ///
+    GLuint vbo_id = 0;
+
+    ///
+    /// The number of glow quads at the start of the buffer
+    ///
+    GLsizei num_glow_quads = 0;
+
+    ///
+    /// The number of quads in the buffer
+    ///
+    GLsizei num_quads = 0;
+
+    std::shared_ptr<Shader> shader;
+
+    ///
+    /// Lay out a label's glyphs from the glyph atlas
+    ///
+    void layout(Label &label);
+
+    ///
+    /// Lay out every label again, as the glyphs have moved in the atlas
+    ///
+    void layout_all();
+
+    ///
+    /// Convert the labels' quads to tiles and upload them
+    /// @param tile_size the size of a tile in pixels
+    ///
+    void generate_vbo(float tile_size);
+
+public:
+    LabelLayer();
+    ~LabelLayer();
+
+    LabelLayer(const LabelLayer &) = delete;
+    LabelLayer &operator=(const LabelLayer &) = delete;
+
+    ///
+    /// Add a label, or replace the text of an existing one
+    /// @param id the id of the object the label belongs to
+    /// @param text the text of the label
+    /// @param anchor the top centre of the label, in tiles
+    ///
+    void set_label(int id, std::string text, glm::vec2 anchor);
+
+    ///
+    /// Move a label
+    /// @param id the id of the object the label belongs to
+    /// @param anchor the top centre of the label, in tiles
+    ///
+    void move_label(int id, glm::vec2 anchor);
+
+    ///
+    /// Remove a label, if there is one
+    /// @param id the id of the object the label belongs to
+    ///
+    void remove_label(int id);
+
+    ///
+    /// Draw every label
+    ///
+    /// @param projection_matrix
+    ///     The projection matrix to draw with.
+    ///
+    /// @param modelview_matrix
+    ///     The modelview matrix of the map, which scales tiles to
+    ///     pixels and scrolls to the camera.
+    ///
+    /// @param tile_size
+    ///     The size of a tile in pixels, which the modelview scales by.
+    ///
+    void render(glm::mat4 projection_matrix, glm::mat4 modelview_matrix, float tile_size);
+
+    size_t get_num_labels() { return labels.size(); }
+};
+
+#endif
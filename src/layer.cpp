@@ -1,3 +1,4 @@
+#include "gpu_memory.hpp"
 #include "layer.hpp"
 #include "tileset.hpp"
 
@@ -7,7 +8,9 @@ Layer::Layer(int width_tiles, int height_tiles, std::string name) :
     name(name),
     layer(std::make_shared<std::vector<std::pair<std::shared_ptr<TileSet>, int>>>()),
     packing(Packing::DENSE),
-    location_texture_vbo_offset_map() {
+    location_texture_vbo_offset_map(),
+    tile_index_map(width_tiles, height_tiles) {
+    renderable_component.set_memory_category(GPUMemory::Category::MAP_LAYER);
 }
 
 void Layer::add_tile(std::shared_ptr<TileSet> tileset, int tile_id) {
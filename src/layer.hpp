@@ -2,6 +2,7 @@
 #define LAYER_H
 
 #include <exception>
+#include <glm/vec2.hpp>
 #include <memory>
 #include <map>
 #include <string>
@@ -9,6 +10,7 @@
 #include <vector>
 
 #include "object.hpp"
+#include "tile_index_map.hpp"
 
 class TileSet;
 
@@ -32,6 +34,44 @@ public:
         SPARSE
     };
 
+    ///
+    /// A rectangular block of the layer whose tiles are stored
+    /// contiguously in the layer's buffers, so that it can be drawn
+    /// (or culled) on its own.
+    ///
+    struct Chunk {
+        ///
+        /// The bottom-left tile of the chunk
+        ///
+        glm::ivec2 origin;
+
+        ///
+        /// The size of the chunk in tiles. Chunks on the top and right
+        /// edges of the map may be smaller than the rest.
+        ///
+        glm::ivec2 size;
+
+        ///
+        /// The first quad of the chunk in the layer's buffer
+        ///
+        int first_quad;
+
+        ///
+        /// The number of quads in the chunk. Blank tiles are not
+        /// stored for sparse layers, so this may be less than a full chunk.
+        ///
+        int num_quads;
+
+        ///
+        /// When the tiles are on several pages of the atlas, the number
+        /// of the chunk's quads on each page, which are stored page by
+        /// page. Their running sums give where each page's run starts,
+        /// so a tile can be found or moved within its chunk alone.
+        /// Empty when the tiles are all on one page.
+        ///
+        std::vector<int> page_num_quads;
+    };
+
 private:
     ///
     /// The width of the layer in tiles
@@ -62,6 +102,21 @@ private:
     /// The map of tile locations to tile offset
     ///
     std::map<int, int> location_texture_vbo_offset_map;
+
+    ///
+    /// The chunks of the layer, in the order they are stored in the buffers
+    ///
+    std::vector<Chunk> chunks;
+
+    ///
+    /// The tiles of the layer as a texture, for the tile index renderer
+    ///
+    TileIndexMap tile_index_map;
+
+    ///
+    /// Whether the layer is drawn over the sprites and map objects
+    ///
+    bool above_sprites = false;
 public:
     ///
     /// Construct the new Layer
@@ -113,6 +168,32 @@ public:
     ///
     void set_packing(Packing _packing) { packing = _packing; }
 
+    ///
+    /// Get the chunks of the layer, in buffer order
+    ///
+    std::vector<Chunk> &get_chunks() { return chunks; }
+
+    ///
+    /// Set the chunks of the layer
+    /// @param _chunks the chunks, in buffer order
+    ///
+    void set_chunks(std::vector<Chunk> _chunks) { chunks = _chunks; }
+
+    ///
+    /// Get whether the layer is drawn over the sprites and map objects
+    ///
+    bool is_above_sprites() { return above_sprites; }
+
+    ///
+    /// Set whether the layer is drawn over the sprites and map objects
+    ///
+    void set_above_sprites(bool _above_sprites) { above_sprites = _above_sprites; }
+
+    ///
+    /// Get the layer's tile index texture
+    ///
+    TileIndexMap &get_tile_index_map() { return tile_index_map; }
+
     ///
     /// Get the name of the layer
     ///
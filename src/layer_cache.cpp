@@ -0,0 +1,260 @@
+#define GLM_FORCE_RADIANS
+
+#include <algorithm>
+#include <cmath>
+#include <exception>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <glog/logging.h>
+#include <ostream>
+#include <tuple>
+
+#include "gl_state.hpp"
+#include "gpu_memory.hpp"
+#include "graphics_context.hpp"
+#include "layer_cache.hpp"
+#include "shader.hpp"
+
+const int LayerCache::page_pixels;
+const int LayerCache::max_pages;
+
+///
+/// Round down to a multiple of a positive step, also for negative values.
+///
+static int floor_to_multiple(int value, int step) {
+    int quotient(value / step);
+    if (value % step != 0 && value < 0) {
+        --quotient;
+    }
+    return quotient * step;
+}
+
+LayerCache::LayerCache() {
+    page_quad.set_memory_category(GPUMemory::Category::MAP_LAYER);
+
+    try {
+        page_quad.set_shader(Shader::get_shared("tile_shader"));
+    }
+    catch (std::exception &) {
+        LOG(ERROR) << "LayerCache: Failed to create the shader, layers will not be cached";
+        failed = true;
+    }
+}
+
+LayerCache::~LayerCache() {
+    clear();
+}
+
+LayerCache::Page *LayerCache::find_page(glm::ivec2 origin) {
+    for (auto &page : pages) {
+        if (page.origin == origin) {
+            return &page;
+        }
+    }
+    return nullptr;
+}
+
+bool LayerCache::create_page(Page &page) {
+    GLState &gl_state(GLState::get_current());
+
+    glGenTextures(1, &page.gl_texture);
+    gl_state.bind_texture(page.gl_texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, page_size, page_size, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    GPUMemory::get_current().set_texture(page.gl_texture, GPUMemory::Category::MAP_LAYER,
+                                         GPUMemory::get_texture_bytes(page_size, page_size, GL_RGBA, GL_UNSIGNED_BYTE));
+
+    glGenFramebuffers(1, &page.gl_framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, page.gl_framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, page.gl_texture, 0);
+
+    GLenum status(glCheckFramebufferStatus(GL_FRAMEBUFFER));
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    page.valid = false;
+
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+        LOG(ERROR) << "LayerCache: Framebuffer incomplete (0x" << std::hex << status << std::dec
+                   << "), layers will not be cached";
+        return false;
+    }
+
+    return true;
+}
+
+void LayerCache::release_page(Page &page) {
+    if (GraphicsContext::get_current()) {
+        GLState::get_current().forget_texture(page.gl_texture);
+        GPUMemory::get_current().forget_texture(page.gl_texture);
+    }
+    glDeleteFramebuffers(1, &page.gl_framebuffer);
+    glDeleteTextures(1, &page.gl_texture);
+    page.gl_framebuffer = 0;
+    page.gl_texture = 0;
+}
+
+bool LayerCache::resize_pages(float new_tile_pixels) {
+    clear();
+    tile_pixels = new_tile_pixels;
+
+    GLint max_texture_size;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_texture_size);
+
+    page_tiles = std::max(1, int(float(std::min(page_pixels, int(max_texture_size))) / tile_pixels));
+    page_size  = int(std::ceil(float(page_tiles) * tile_pixels));
+
+    if (page_size > max_texture_size) {
+        LOG(WARNING) << "LayerCache: Tiles are too big to cache";
+        return false;
+    }
+
+    // The pages are rounded up to whole pixels; only draw the tiles
+    float used(float(page_tiles) * tile_pixels / float(page_size));
+    GLfloat *quad(new GLfloat[RenderableComponent::floats_per_quad]);
+    RenderableComponent::write_quad(quad, 0.0f, 1.0f, 0.0f, 1.0f, std::make_tuple(0.0f, used, 0.0f, used));
+    page_quad.set_quad_data(quad, sizeof(GLfloat) * RenderableComponent::floats_per_quad, false);
+    page_quad.set_num_quads_render(1);
+
+    VLOG(1) << "LayerCache: Pages of " << page_tiles << " tiles, " << page_size << " pixels";
+    return true;
+}
+
+void LayerCache::render_page(Page &page, glm::ivec2 viewport_size, const DrawFunction &draw) {
+    glBindFramebuffer(GL_FRAMEBUFFER, page.gl_framebuffer);
+    glViewport(0, 0, page_size, page_size);
+    glScissor(0, 0, page_size, page_size);
+
+    // MapViewer masks out alpha, but the page needs it to composite
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    // Accumulate premultiplied colour
+    glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+
+    glm::mat4 projection_matrix(glm::ortho(0.0f, float(page_size), 0.0f, float(page_size), 0.0f, 1.0f));
+    glm::mat4 model(glm::mat4(1.0f));
+    model = glm::scale    (model, glm::vec3(tile_pixels));
+    model = glm::translate(model, glm::vec3(-float(page.origin.x), -float(page.origin.y), 0.0f));
+
+    draw(projection_matrix, model, page.origin, page.origin + glm::ivec2(page_tiles));
+
+    // Restore MapViewer's state
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_FALSE);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(0, 0, viewport_size.x, viewport_size.y);
+    glScissor(0, 0, viewport_size.x, viewport_size.y);
+
+    page.valid = true;
+}
+
+void LayerCache::evict_pages() {
+    if (pages.size() <= size_t(max_pages)) {
+        return;
+    }
+
+    // Oldest first
+    std::sort(std::begin(pages), std::end(pages), [] (const Page &a, const Page &b) {
+        return a.last_used < b.last_used;
+    });
+
+    size_t num_evicted(0);
+    while (pages.size() - num_evicted > size_t(max_pages) && pages[num_evicted].last_used != frame) {
+        release_page(pages[num_evicted]);
+        ++num_evicted;
+    }
+
+    pages.erase(std::begin(pages), std::begin(pages) + long(num_evicted));
+}
+
+bool LayerCache::composite(glm::mat4 projection_matrix, glm::mat4 modelview_matrix,
+                           glm::ivec2 visible_min, glm::ivec2 visible_max,
+                           float new_tile_pixels, glm::ivec2 viewport_size, const DrawFunction &draw) {
+    if (failed) {
+        return false;
+    }
+
+    // Zooming changes every page's resolution
+    if (new_tile_pixels != tile_pixels && !resize_pages(new_tile_pixels)) {
+        tile_pixels = 0.0f;
+        return false;
+    }
+
+    ++frame;
+
+    // Bring the visible pages up to date before drawing any of them
+    std::vector<glm::ivec2> visible_origins;
+    for (int y = floor_to_multiple(visible_min.y, page_tiles); y < visible_max.y; y += page_tiles) {
+        for (int x = floor_to_multiple(visible_min.x, page_tiles); x < visible_max.x; x += page_tiles) {
+            glm::ivec2 origin(x, y);
+            Page *page(find_page(origin));
+
+            if (!page) {
+                pages.push_back(Page{origin, 0, 0, false, frame});
+                page = &pages.back();
+
+                if (!create_page(*page)) {
+                    failed = true;
+                    clear();
+                    return false;
+                }
+            }
+
+            if (!page->valid) {
+                render_page(*page, viewport_size, draw);
+            }
+
+            page->last_used = frame;
+            visible_origins.push_back(origin);
+        }
+    }
+
+    // Draw the pages
+    Shader *shader(page_quad.get_shader().get());
+    page_quad.bind_shader();
+    glUniformMatrix4fv(shader->get_uniform_location("mat_projection"), 1, GL_FALSE, glm::value_ptr(projection_matrix));
+    page_quad.bind_vbos();
+
+    GLState &gl_state(GLState::get_current());
+    gl_state.active_texture(GL_TEXTURE0);
+
+    glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+    for (glm::ivec2 origin : visible_origins) {
+        glm::mat4 model(modelview_matrix);
+        model = glm::translate(model, glm::vec3(float(origin.x), float(origin.y), 0.0f));
+        model = glm::scale    (model, glm::vec3(float(page_tiles), float(page_tiles), 1.0f));
+        glUniformMatrix4fv(shader->get_uniform_location("mat_modelview"), 1, GL_FALSE, glm::value_ptr(model));
+
+        gl_state.bind_texture(find_page(origin)->gl_texture);
+        page_quad.draw_quads();
+    }
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    evict_pages();
+
+    return true;
+}
+
+void LayerCache::invalidate_tile(int x_pos, int y_pos) {
+    if (page_tiles == 0) {
+        return;
+    }
+
+    glm::ivec2 origin(floor_to_multiple(x_pos, page_tiles), floor_to_multiple(y_pos, page_tiles));
+    if (Page *page = find_page(origin)) {
+        page->valid = false;
+    }
+}
+
+void LayerCache::clear() {
+    for (auto &page : pages) {
+        release_page(page);
+    }
+    pages.clear();
+}
@@ -0,0 +1,195 @@
+#ifndef LAYER_CACHE_H
+#define LAYER_CACHE_H
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+#include <glm/mat4x4.hpp>
+#include <glm/vec2.hpp>
+
+#ifdef USE_GLES
+#include <GLES2/gl2.h>
+#endif
+
+#ifdef USE_GL
+#define GL_GLEXT_PROTOTYPES
+#include <GL/gl.h>
+#endif
+
+#include "renderable_component.hpp"
+
+///
+/// Caches a group of tile layers in offscreen textures, so that they
+/// are drawn with one textured quad per page each frame instead of
+/// every tile of every layer.
+///
+/// The map is split into square pages, which are rendered into
+/// framebuffer textures at screen resolution the first time they are
+/// visible. A page is only rendered again when one of its tiles changes
+/// or the tile size on screen changes. Pages which have not been
+/// visible for a while are freed once there are more than max_pages.
+///
+/// The pages hold premultiplied alpha, so that translucent tiles
+/// composite the same as when drawn directly.
+///
+class LayerCache {
+public:
+    ///
+    /// Draws the cached layers.
+    ///
+    /// @param projection_matrix the projection to draw with
+    /// @param modelview_matrix the modelview to draw with, in tiles
+    /// @param visible_min the lowest tile to draw
+    /// @param visible_max one past the highest tile to draw
+    ///
+    typedef std::function<void (glm::mat4 projection_matrix, glm::mat4 modelview_matrix,
+                                glm::ivec2 visible_min, glm::ivec2 visible_max)> DrawFunction;
+
+private:
+    ///
+    /// An offscreen rendering of part of the map.
+    ///
+    struct Page {
+        ///
+        /// The bottom-left tile of the page
+        ///
+        glm::ivec2 origin;
+
+        GLuint gl_texture;
+        GLuint gl_framebuffer;
+
+        ///
+        /// Whether the texture holds the current tiles
+        ///
+        bool valid;
+
+        ///
+        /// The frame the page was last drawn on
+        ///
+        uint64_t last_used;
+    };
+
+    ///
+    /// The size of a page in pixels, if the texture size allows
+    ///
+    static const int page_pixels = 512;
+
+    ///
+    /// The most pages kept at once
+    ///
+    static const int max_pages = 16;
+
+    std::vector<Page> pages;
+
+    ///
+    /// The width and height of a page in tiles
+    ///
+    int page_tiles = 0;
+
+    ///
+    /// The width and height of a page's texture in pixels
+    ///
+    int page_size = 0;
+
+    ///
+    /// The size of a tile in pixels the pages were rendered at
+    ///
+    float tile_pixels = 0.0f;
+
+    ///
+    /// The number of frames composited
+    ///
+    uint64_t frame = 0;
+
+    ///
+    /// Set when framebuffers are unsupported, so the layers are
+    /// always drawn directly
+    ///
+    bool failed = false;
+
+    ///
+    /// A quad from (0, 0) to (1, 1), textured with the part of a page
+    /// holding page_tiles tiles
+    ///
+    RenderableComponent page_quad;
+
+    ///
+    /// Find the page with the given origin
+    /// @return the page, or nullptr if there is none
+    ///
+    Page *find_page(glm::ivec2 origin);
+
+    ///
+    /// Create a page's texture and framebuffer
+    /// @return false if the framebuffer is incomplete
+    ///
+    bool create_page(Page &page);
+
+    ///
+    /// Work out the page size for a new tile size, and free the pages
+    /// @return false if a tile is too big for a texture
+    ///
+    bool resize_pages(float new_tile_pixels);
+
+    ///
+    /// Draw the layers into a page
+    ///
+    void render_page(Page &page, glm::ivec2 viewport_size, const DrawFunction &draw);
+
+    ///
+    /// Free pages which were not drawn this frame until at most
+    /// max_pages remain
+    ///
+    void evict_pages();
+
+    ///
+    /// Free a page's GL objects
+    ///
+    static void release_page(Page &page);
+
+public:
+    LayerCache();
+    ~LayerCache();
+
+    LayerCache(const LayerCache &) = delete;
+    LayerCache &operator=(const LayerCache &) = delete;
+
+    ///
+    /// Draw the visible part of the layers, rendering any pages which
+    /// are missing or out of date.
+    ///
+    /// @param projection_matrix the projection of the screen
+    /// @param modelview_matrix the modelview of the map, in tiles
+    /// @param visible_min the lowest tile on screen
+    /// @param visible_max one past the highest tile on screen
+    /// @param tile_pixels the size of a tile on screen in pixels
+    /// @param viewport_size the size of the screen, restored after
+    ///        rendering a page
+    /// @param draw draws the layers, used to render the pages
+    /// @return false if the layers could not be cached, in which case
+    ///         nothing was drawn
+    ///
+    bool composite(glm::mat4 projection_matrix, glm::mat4 modelview_matrix,
+                   glm::ivec2 visible_min, glm::ivec2 visible_max,
+                   float tile_pixels, glm::ivec2 viewport_size, const DrawFunction &draw);
+
+    ///
+    /// Mark the page holding a tile as out of date
+    ///
+    void invalidate_tile(int x_pos, int y_pos);
+
+    ///
+    /// Free all pages, so that they are rendered again when visible
+    ///
+    void clear();
+
+    ///
+    /// @return The number of pages held
+    ///
+    size_t get_num_pages() { return pages.size(); }
+};
+
+#endif
@@ -4,6 +4,7 @@
 #include <boost/filesystem/operations.hpp>
 #include <boost/filesystem/path.hpp>
 #include <chrono>
+#include <cstdlib>
 #include <functional>
 #include <glm/vec2.hpp>
 #include <iostream>
@@ -15,15 +16,28 @@
 #include <utility>
 #include <vector>
 
+extern "C" {
+#ifdef USE_GLES
+#include <GLES2/gl2.h>
+#endif
+#ifdef USE_GL
+#define GL_GLEXT_PROTOTYPES
+#include <GL/gl.h>
+#endif
+}
+
+#include "asset_loader.hpp"
 #include "button.hpp"
 #include "callback_state.hpp"
 #include "challenge_data.hpp"
 #include "cutting_challenge.hpp"
 #include "engine.hpp"
+#include "frame_pacer.hpp"
 #include "event_manager.hpp"
 #include "filters.hpp"
 #include "final_challenge.hpp"
 #include "game_window.hpp"
+#include "gpu_memory.hpp"
 #include "gui_manager.hpp"
 #include "gui_window.hpp"
 #include "input_manager.hpp"
@@ -36,8 +50,12 @@
 #include "mouse_input_event.hpp"
 #include "mouse_state.hpp"
 #include "notification_bar.hpp"
+#include "profiler.hpp"
+#include "render_stats.hpp"
+#include "shader.hpp"
 #include "sprite.hpp"
 #include "start_screen.hpp"
+#include "texture_atlas.hpp"
 
 #ifdef USE_GLES
 #include "typeface.hpp"
@@ -50,6 +68,7 @@
 using namespace std;
 
 static std::mt19937 random_generator;
+std::string get_challenge_map(int challenge);
 Challenge* pick_challenge(ChallengeData* challenge_data);
 int main(int argc, const char *argv[]) {
     std::string map_path("../maps/start_screen.tmx");
@@ -73,6 +92,55 @@ int main(int argc, const char *argv[]) {
     google::InitGoogleLogging(argv[0]);
     google::InstallFailureSignalHandler();
 
+    // Trade texture quality for GPU memory with
+    // PYLAND_TEXTURE_QUALITY=full, reduced or compressed
+    if (const char *texture_quality = std::getenv("PYLAND_TEXTURE_QUALITY")) {
+        std::string setting(texture_quality);
+        if (setting == "full") {
+            TextureAtlas::set_quality(TextureAtlas::Quality::FULL);
+        }
+        else if (setting == "reduced") {
+            TextureAtlas::set_quality(TextureAtlas::Quality::REDUCED);
+        }
+        else if (setting == "compressed") {
+            TextureAtlas::set_quality(TextureAtlas::Quality::COMPRESSED);
+        }
+        else {
+            LOG(WARNING) << "Unknown PYLAND_TEXTURE_QUALITY \"" << setting << "\"";
+        }
+    }
+
+    // PYLAND_PROFILE=1 starts with the profiler recording
+    if (std::getenv("PYLAND_PROFILE")) {
+        Profiler::set_enabled(true);
+    }
+    Profiler::get_instance().set_thread_name("Main");
+
+    // PYLAND_RENDER_STATS=file times the GPU and writes the render
+    // statistics to the file as JSON after each challenge
+    const char *render_stats_path(std::getenv("PYLAND_RENDER_STATS"));
+    if (render_stats_path) {
+        RenderStats::get_instance().set_gpu_timing_enabled(true);
+    }
+
+    // Keep up to PYLAND_RETAINED_ATLAS_MB of unused texture atlases
+    // loaded, so the next challenge can reuse them
+    if (const char *retained_atlas_mb = std::getenv("PYLAND_RETAINED_ATLAS_MB")) {
+        TextureAtlas::set_retention_budget(size_t(std::atoi(retained_atlas_mb)) * 1024 * 1024);
+    }
+
+    // Pace the main loop to PYLAND_TARGET_FPS frames a second
+    int target_fps(60);
+    if (const char *target_fps_setting = std::getenv("PYLAND_TARGET_FPS")) {
+        int setting(std::atoi(target_fps_setting));
+        if (setting > 0) {
+            target_fps = setting;
+        }
+        else {
+            LOG(WARNING) << "Invalid PYLAND_TARGET_FPS \"" << target_fps_setting << "\", using " << target_fps;
+        }
+    }
+
     /// CREATE GLOBAL OBJECTS
 
     //Create the game window to present to the users
@@ -80,6 +148,10 @@ int main(int argc, const char *argv[]) {
     window.use_context();
     Engine::set_game_window(&window);
 
+    // Every map draws with these, so keep them between challenges
+    Shader::pin("tile_shader");
+    Shader::pin("label_shader");
+
     //Create the interpreter
     Interpreter interpreter(boost::filesystem::absolute("python_embed/wrapper_functions.so").normalize());
     //Create the input manager
@@ -92,6 +164,11 @@ int main(int argc, const char *argv[]) {
     MapViewer map_viewer(&window, &gui_manager);
     Engine::set_map_viewer(&map_viewer);
 
+    // PYLAND_LAYER_CACHE=1 starts with the layers cached offscreen
+    if (std::getenv("PYLAND_LAYER_CACHE")) {
+        map_viewer.set_layer_cache_enabled(true);
+    }
+
     //    void (GUIManager::*mouse_callback_function) (MouseInputEvent) = &GUIManager::mouse_callback_function;
 
     //TODO : REMOVE THIS HACKY EDIT - done for the demo tomorrow
@@ -194,6 +271,67 @@ int main(int argc, const char *argv[]) {
         }
     ));
 
+    // Switch between the tile renderers, to compare them
+    Lifeline tile_renderer_callback = input_manager->register_keyboard_handler(filter(
+        {KEY_PRESS, KEY("F9")},
+        [&] (KeyboardInputEvent) {
+            map_viewer.set_tile_renderer(
+                map_viewer.get_tile_renderer() == MapViewer::TileRenderer::VERTEX_BUFFER
+                    ? MapViewer::TileRenderer::TILE_INDEX
+                    : MapViewer::TileRenderer::VERTEX_BUFFER);
+        }
+    ));
+
+    Lifeline layer_cache_callback = input_manager->register_keyboard_handler(filter(
+        {KEY_PRESS, KEY("F10")},
+        [&] (KeyboardInputEvent) {
+            map_viewer.set_layer_cache_enabled(!map_viewer.is_layer_cache_enabled());
+        }
+    ));
+
+    // Draw every frame rather than only when something changes
+    Lifeline render_on_demand_callback = input_manager->register_keyboard_handler(filter(
+        {KEY_PRESS, KEY("F11")},
+        [&] (KeyboardInputEvent) {
+            window.set_render_on_demand(!window.is_render_on_demand());
+        }
+    ));
+
+    // Write a trace of the last frames, starting the profiler first if
+    // it is not running
+    Lifeline profiler_callback = input_manager->register_keyboard_handler(filter(
+        {KEY_PRESS, KEY("F7")},
+        [&] (KeyboardInputEvent) {
+            if (Profiler::is_enabled()) {
+                Profiler::get_instance().write_trace();
+            }
+            else {
+                Profiler::set_enabled(true);
+            }
+        }
+    ));
+
+    // Show what each frame costs, timing the GPU whilst shown
+    bool show_render_stats(false);
+    Lifeline render_stats_callback = input_manager->register_keyboard_handler(filter(
+        {KEY_PRESS, KEY("F12")},
+        [&] (KeyboardInputEvent) {
+            show_render_stats = !show_render_stats;
+            RenderStats::get_instance().set_gpu_timing_enabled(show_render_stats || render_stats_path);
+            window.request_redraw();
+        }
+    ));
+
+    // Show what the GL buffers and textures are taking up
+    bool show_gpu_memory(false);
+    Lifeline gpu_memory_callback = input_manager->register_keyboard_handler(filter(
+        {KEY_PRESS, KEY("F8")},
+        [&] (KeyboardInputEvent) {
+            show_gpu_memory = !show_gpu_memory;
+            window.request_redraw();
+        }
+    ));
+
 
     std::chrono::steady_clock::time_point start_time;
 
@@ -343,12 +481,35 @@ int main(int argc, const char *argv[]) {
     tile_identifier_text.set_text("(?, ?)");
     glm::ivec2 tile_identifier_old_tile;
 
-    std::function<void (GameWindow *)> func_char = [&] (GameWindow *) {
-        LOG(INFO) << "text window resizing";
-        Engine::text_updater();
-    };
-
-    Lifeline text_lifeline_char = window.register_resize_handler(func_char);
+    Text gpu_memory_text(&window, Engine::get_game_font(), false);
+    gpu_memory_text.move_ratio(0.0f, 1.0f);
+    gpu_memory_text.resize(320, 192);
+    gpu_memory_text.align_left();
+    gpu_memory_text.vertical_align_top();
+    gpu_memory_text.align_at_origin(true);
+    gpu_memory_text.set_bloom_radius(5);
+    gpu_memory_text.set_bloom_colour(0x00, 0x0, 0x00, 0xa0);
+    gpu_memory_text.set_colour(0xff, 0xff, 0xff, 0xa8);
+    std::string gpu_memory_summary;
+
+    Text render_stats_text(&window, Engine::get_game_font(), false);
+    render_stats_text.move_ratio(1.0f, 1.0f);
+    render_stats_text.resize(320, 256);
+    render_stats_text.align_right();
+    render_stats_text.vertical_align_top();
+    render_stats_text.align_at_origin(true);
+    render_stats_text.set_bloom_radius(5);
+    render_stats_text.set_bloom_colour(0x00, 0x0, 0x00, 0xa0);
+    render_stats_text.set_colour(0xff, 0xff, 0xff, 0xa8);
+    std::chrono::steady_clock::time_point render_stats_updated;
+
+    Text loading_text(&window, Engine::get_game_font(), false);
+    loading_text.move_ratio(0.5f, 0.5f);
+    loading_text.resize(256, 64);
+    loading_text.align_centre();
+    loading_text.vertical_align_centre();
+    loading_text.align_at_origin(true);
+    loading_text.set_colour(0xff, 0xff, 0xff, 0xa8);
 
     //Run the map
     bool run_game = true;
@@ -365,38 +526,56 @@ int main(int argc, const char *argv[]) {
     ));
 
     MouseCursor cursor(&window);
+
+    FramePacer frame_pacer(target_fps);
+    Engine::set_frame_pacer(&frame_pacer);
+
+    // Frames half a frame late or worse are traced
+    Profiler::get_instance().set_frame_budget(
+        std::chrono::duration_cast<Profiler::clock::duration>(std::chrono::seconds(1)) * 3 / (2 * frame_pacer.get_target_fps()));
     //Run the challenge - returns after challenge completes
 
     while(!window.check_close() && run_game) {
         challenge_data->run_challenge = true;
+
+        // Load the challenge's map in the background, showing how far it
+        // has got, so that the window keeps responding
+        std::shared_ptr<AssetLoader::MapLoad> map_load(
+            AssetLoader::get_instance().load_map(get_challenge_map(challenge_data->next_challenge)));
+        while (!window.check_close() && !map_load->is_ready()) {
+            GameWindow::update();
+            frame_pacer.process_events(em);
+
+            // Leave most of the frame for drawing and events
+            AssetLoader::get_instance().update(AssetLoader::clock::now() + std::chrono::milliseconds(8));
+
+            std::stringstream progress;
+            progress << "Loading... " << int(map_load->get_progress() * 100.0f) << "%";
+            loading_text.set_text(progress.str());
+
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            loading_text.display();
+            cursor.display();
+            window.swap_buffers();
+        }
+
         Challenge* challenge = pick_challenge(challenge_data);
         Engine::set_challenge(challenge);
         challenge->start();
-
-        auto last_clock(std::chrono::steady_clock::now());
+        Profiler::get_instance().reset_frame();
 
         //Run the challenge - returns after challenge completes
         VLOG(3) << "{";
         while (!challenge_data->game_window->check_close() && challenge_data->run_challenge) {
-            last_clock = std::chrono::steady_clock::now();
+            Profiler::get_instance().end_frame();
 
             VLOG(3) << "} SB | IM {";
             GameWindow::update();
 
             VLOG(3) << "} IM | EM {";
 
-            do {
-                EventManager::get_instance().process_events();
-            } while (
-                  std::chrono::steady_clock::now() - last_clock
-                < std::chrono::nanoseconds(1000000000 / 60)
-            );
-
-            VLOG(3) << "} EM | RM {";
-            Engine::get_map_viewer()->render();
-            VLOG(3) << "} RM | TD {";
-            Engine::text_displayer();
-            challenge_data->notification_bar->text_displayer();
+            // Sleeps until the frame is due, waking for new events
+            frame_pacer.process_events(EventManager::get_instance());
 
             // This is not an input event, because the map can move with
             // the mouse staying still.
@@ -411,12 +590,53 @@ int main(int argc, const char *argv[]) {
                     tile_identifier_text.set_text(position.str());
                 }
             }
+
+            // The overlay is refreshed twice a second, as laying it out
+            // every frame would show mostly its own cost
+            if (show_render_stats
+                && std::chrono::steady_clock::now() - render_stats_updated >= std::chrono::milliseconds(500)) {
+                render_stats_updated = std::chrono::steady_clock::now();
+                render_stats_text.set_text(RenderStats::get_instance().get_summary());
+                challenge_data->game_window->request_redraw();
+            }
+
+            // Nothing has changed, so the last frame is still on screen
+            if (!challenge_data->game_window->is_redraw_needed()) {
+                continue;
+            }
+            challenge_data->game_window->clear_redraw_request();
+
+            RenderStats &render_stats(RenderStats::get_instance());
+            render_stats.begin_frame();
+
+            VLOG(3) << "} EM | RM {";
+            Engine::get_map_viewer()->render();
+            VLOG(3) << "} RM | TD {";
+            render_stats.begin_phase(RenderStats::Phase::TEXT);
+            Engine::get_map_viewer()->render_labels();
+            challenge_data->notification_bar->text_displayer();
             tile_identifier_text.display();
 
+            if (show_gpu_memory) {
+                // Only laid out again when the totals change
+                std::string summary(GPUMemory::get_current().get_summary());
+                if (summary != gpu_memory_summary) {
+                    gpu_memory_summary = summary;
+                    gpu_memory_text.set_text(summary);
+                }
+                gpu_memory_text.display();
+            }
+
+            if (show_render_stats) {
+                render_stats_text.display();
+            }
+            render_stats.end_phase();
+
             cursor.display();
 
             VLOG(3) << "} TD | SB {";
             challenge_data->game_window->swap_buffers();
+            render_stats.end_frame();
         }
 
         VLOG(3) << "}";
@@ -426,33 +646,51 @@ int main(int argc, const char *argv[]) {
         delete challenge;
         em.reenable();
 
+        TextureAtlas::report_caches("texture atlas");
+        Shader::report_caches("shader");
+        GPUMemory::get_current().report();
+        if (render_stats_path) {
+            RenderStats::get_instance().write_json(render_stats_path);
+        }
+
     }
 
     return 0;
 }
 
+std::string get_challenge_map(int challenge) {
+    switch(challenge) {
+        case 0:
+            return "../maps/start_screen.tmx";
+        case 1:
+            return "../maps/introduction.tmx";
+        case 2:
+            return "../maps/cutting_challenge.tmx";
+        case 3:
+            return "../maps/final_challenge.tmx";
+        default:
+            return "";
+    }
+}
+
 Challenge* pick_challenge(ChallengeData* challenge_data) {
     int next_challenge(challenge_data->next_challenge);
     Challenge *challenge(nullptr);
-    std::string map_name = "";
+    std::string map_name = get_challenge_map(next_challenge);
     switch(next_challenge) {
         case 0:
-            map_name ="../maps/start_screen.tmx";
             challenge_data->map_name = map_name;
             challenge = new StartScreen(challenge_data);
             break;
         case 1:
-            map_name = "../maps/introduction.tmx";
             challenge_data->map_name = map_name;
             challenge = new IntroductionChallenge(challenge_data);
             break;
         case 2:
-            map_name = "../maps/cutting_challenge.tmx";
             challenge_data->map_name = map_name;
             challenge = new CuttingChallenge(challenge_data);
             break;
         case 3:
-            map_name = "../maps/final_challenge.tmx";
             challenge_data->map_name = map_name;
             challenge = new FinalChallenge(challenge_data);
             break;
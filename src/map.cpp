@@ -9,6 +9,7 @@
 #include <string>
 #include <tuple>
 #include <utility>
+#include <vector>
 
 #ifdef USE_GLES
 #include <GLES2/gl2.h>
@@ -19,6 +20,7 @@
 #include <GL/gl.h>
 #endif
 
+#include "asset_loader.hpp"
 #include "cacheable_resource.hpp"
 #include "dispatcher.hpp"
 #include "engine.hpp"
@@ -28,43 +30,57 @@
 #include "map_loader.hpp"
 #include "map_object.hpp"
 #include "object_manager.hpp"
+#include "profiler.hpp"
 #include "renderable_component.hpp"
 #include "shader.hpp"
 #include "texture_atlas.hpp"
+#include "tile_index_map.hpp"
 #include "tileset.hpp"
 
 
+const int Map::chunk_size;
+const int Map::floats_per_tile;
+
+// The page a tile's quad is grouped with. Blank tiles go with the first.
+static int get_tile_page(const std::pair<std::shared_ptr<TileSet>, int> &tile) {
+    return tile.first ? tile.first->get_atlas()->index_to_page(tile.second) : 0;
+}
+
 Map::Map(const std::string map_src):
     event_step_on(glm::ivec2(0, 0)),
     event_step_off(glm::ivec2(0, 0))
     {
-        //Load the map
-        MapLoader map_loader;
-        bool result = map_loader.load_map(map_src);
+        //Load the map, taking it from the asset loader if it has been
+        //loaded in the background
+        std::shared_ptr<MapLoader> map_loader(AssetLoader::get_instance().take_map(map_src));
+        if (!map_loader) {
+            map_loader = std::make_shared<MapLoader>();
+        }
+        bool result = map_loader->load_map(map_src);
         if(!result)  {
 
             LOG(ERROR) << "Couldn't load map";
             return;
         }
 
-        locations = map_loader.get_object_mapping();
+        locations = map_loader->get_object_mapping();
 
         //Get the loaded map data
-        map_width = map_loader.get_map_width();
-        map_height = map_loader.get_map_height();
+        map_width = map_loader->get_map_width();
+        map_height = map_loader->get_map_height();
 
         // hack to construct postion dispatcher as we need map diametions
         event_step_on  = PositionDispatcher<int>(glm::ivec2(map_width, map_height));
         event_step_off = PositionDispatcher<int>(glm::ivec2(map_width, map_height));
 
         LOG(INFO) << "Map width: " << map_width << " Map height: " << map_height;
-        std::vector<std::shared_ptr<Layer>> layers = map_loader.get_layers();
+        std::vector<std::shared_ptr<Layer>> layers = map_loader->get_layers();
         for(auto layer : layers) {
             layer_ids.push_back(layer->get_id());
             ObjectManager::get_instance().add_object(layer);
         }
 
-        tilesets = map_loader.get_tilesets();
+        tilesets = map_loader->get_tilesets();
 
         //Get the tilesets
         //TODO: We'll only support one tileset at the moment
@@ -184,275 +200,303 @@ void Map::generate_tileset_coords(std::shared_ptr<TextureAtlas> atlas) {
     }
 }
 
-void Map::generate_data() {
-    LOG(INFO) << "Generating map data";
-
-    // Get each layer of the map
-    // Start at layer 0
-    int layer_num = 0;
-    for (int layer_id : layer_ids) {
-        std::shared_ptr<Layer> layer = ObjectManager::get_instance().get_object<Layer>(layer_id);
-
-        auto layer_data = layer->get_layer_data();
+void Map::generate_chunk_layout() {
+    num_chunks_x = (map_width  + chunk_size - 1) / chunk_size;
+    int num_chunks_y((map_height + chunk_size - 1) / chunk_size);
 
+    chunk_layout.clear();
 
-        // Build the mapping from (x, y) to offsets in the vertex and texture buffers
-        auto buffer_map = std::make_shared<std::map<int, int>>();
-        layer_mappings[layer_num] = buffer_map;
+    int first_quad(0);
+    for (int chunk_y = 0; chunk_y < num_chunks_y; ++chunk_y) {
+        for (int chunk_x = 0; chunk_x < num_chunks_x; ++chunk_x) {
+            Layer::Chunk chunk;
+            chunk.origin = glm::ivec2(chunk_x * chunk_size, chunk_y * chunk_size);
+            chunk.size   = glm::ivec2(std::min(chunk_size, map_width  - chunk.origin.x),
+                                      std::min(chunk_size, map_height - chunk.origin.y));
+            chunk.first_quad = first_quad;
+            chunk.num_quads  = chunk.size.x * chunk.size.y;
 
-
-        // Don't generate data for the collisions layer
-        // TODO: handle this not being in layer_mappings
-        if (layer->get_name() == "Collisions") {
-            layer_num++;
-            continue;
+            first_quad += chunk.num_quads;
+            chunk_layout.push_back(chunk);
         }
+    }
 
+    LOG(INFO) << "Map split into " << chunk_layout.size() << " chunks";
+}
 
-        // Work out if we need a dense or a sparse buffer
-        int total_tiles = 0;
-        int num_blank_tiles = 0;
+int Map::get_chunk_index(int x_pos, int y_pos) {
+    return (y_pos / chunk_size) * num_chunks_x + (x_pos / chunk_size);
+}
 
-        // Get all the tiles in the layer, moving from left to right and down
-        for (auto &tile_data : *layer_data) {
-            std::shared_ptr<TileSet> tileset = tile_data.first;
-            if (!tileset) { num_blank_tiles++; }
+int Map::get_tile_order(int x_pos, int y_pos) {
+    const Layer::Chunk &chunk(chunk_layout[get_chunk_index(x_pos, y_pos)]);
 
-            total_tiles++;
-        }
+    return chunk.first_quad + (y_pos - chunk.origin.y) * chunk.size.x + (x_pos - chunk.origin.x);
+}
 
-        // Spare packing by default
-        auto layer_packing(Layer::Packing::SPARSE);
+void Map::generate_atlas_geometry() {
+    tile_index_supported = false;
 
-        // If more than 50% of layer has tiles, make it dense
-        if (num_blank_tiles < total_tiles / 2) {
-            layer_packing = Layer::Packing::DENSE;
-        }
+    if (tilesets.empty()) {
+        return;
+    }
 
-        layer->set_packing(layer_packing);
+    // All the layers share the merged atlas: see init_textures
+    std::shared_ptr<TextureAtlas> atlas(tilesets[0]->get_atlas());
 
-        // Create the buffer for the layer
-        int num_tiles(layer_packing == Layer::Packing::DENSE ? total_tiles
-                                                             : total_tiles - num_blank_tiles);
+    // The shader looks tiles up in a single texture
+    if (atlas->get_page_count() > 1) {
+        LOG(INFO) << "Tile index renderer unavailable: the tiles are on " << atlas->get_page_count() << " pages";
+        return;
+    }
 
-        // The number of bytes needed - *6 for the GLTRIANGLES
-        // WTF: num_tile_vertices??
-        size_t tex_data_size (sizeof(GLfloat) * num_tiles * num_tile_vertices * num_tile_dimensions);
-        size_t vert_data_size(sizeof(GLfloat) * num_tiles * num_tile_vertices * num_tile_dimensions);
-        GLfloat* layer_tex_coords(nullptr);
-        GLfloat* layer_vert_coords(nullptr);
+    std::tuple<float,float,float,float> coords(atlas->index_to_coords(0));
+    std::pair<int,int> units(atlas->index_to_units(0));
 
-        try {
-            layer_tex_coords = new GLfloat[tex_data_size];
-            layer_vert_coords = new GLfloat[vert_data_size];
-        }
-        catch(std::bad_alloc& ba) {
-            LOG(ERROR) << "Out of memory in Map::generate_data";
-            return;
-        }
+    atlas_unit_size = glm::vec2(std::get<1>(coords) - std::get<0>(coords),
+                                std::get<3>(coords) - std::get<2>(coords));
+    atlas_origin    = glm::vec2(std::get<0>(coords) - float(units.first)  * atlas_unit_size.x,
+                                std::get<3>(coords) + float(units.second) * atlas_unit_size.y);
 
-        // Build the layer data based on the
-        if (layer_packing == Layer::Packing::DENSE) {
-            generate_dense_layer_tex_coords(layer_tex_coords, layer);
-            generate_dense_layer_vert_coords(layer_vert_coords, layer);
-        }
-        else {
-            generate_sparse_layer_tex_coords(layer_tex_coords, layer);
-            generate_sparse_layer_vert_coords(layer_vert_coords, layer);
+    tile_index_supported = true;
+}
 
-            //Generate the mappings
-            //ONLY NEEDED FOR SPARSE
-            int x(0);
-            int y(0);
-            int idx(0);
+bool Map::generate_tile_index_map(std::shared_ptr<Layer> layer) {
+    TileIndexMap &tile_index_map(layer->get_tile_index_map());
+    bool fits(true);
 
-            for(auto tile_data = layer_data->begin(); tile_data != layer_data->end(); ++tile_data) {
-                std::shared_ptr<TileSet> tileset = tile_data->first;
+    for (int y = 0; y < map_height; ++y) {
+        for (int x = 0; x < map_width; ++x) {
+            std::pair<std::shared_ptr<TileSet>, int> tile_data(layer->get_tile(x, y));
 
-                //Set the index into the buffer
-                buffer_map->insert(std::make_pair(y*map_width + x, idx));
+            if (!tile_data.first) {
+                tile_index_map.clear_tile(x, y);
+            }
+            else if (!tile_index_map.set_tile(x, y, tile_data.first->get_atlas()->index_to_units(tile_data.second))) {
+                fits = false;
+            }
+        }
+    }
 
-                //Calculate the next index
-                //If we're not looking at a blank tile
-                if(tileset) {
-                    //Calculate the new offset
-                    idx += num_tile_dimensions*num_tile_vertices;
+    if (!fits) {
+        LOG(WARNING) << "Layer " << layer->get_name() << " uses tiles beyond the tile index map's range";
+    }
 
-                }
+    return fits;
+}
 
-                //ELSE: Offset unchanged
+void Map::generate_data() {
+    LOG(INFO) << "Generating map data";
 
-                //Next tile
-                x++;
+    generate_chunk_layout();
+    generate_atlas_geometry();
 
-                //if we're on a new layer
-                if(x >= map_width) {
-                    x = 0;
-                    y++;
-                }
-            }
-        }
+    // Get each layer of the map
+    // Start at layer 0
+    int layer_num = 0;
+    for (int layer_id : layer_ids) {
+        std::shared_ptr<Layer> layer = ObjectManager::get_instance().get_object<Layer>(layer_id);
 
-        // Set this data in the renderable component for the layer
-        RenderableComponent* renderable_component = layer->get_renderable_component();
-        renderable_component->set_texture_coords_data(layer_tex_coords, tex_data_size, false);
-        renderable_component->set_vertex_data(layer_vert_coords, vert_data_size, false);
-        renderable_component->set_num_vertices_render(num_tiles*num_tile_vertices);
+        generate_layer_data(layer, layer_num);
 
         layer_num++;
     }
 }
 
-void Map::generate_layer_tex_coords(GLfloat* data, std::shared_ptr<Layer> layer, bool dense) {
+void Map::generate_layer_data(std::shared_ptr<Layer> layer, int layer_num) {
     auto layer_data = layer->get_layer_data();
 
-    //Get all the tiles in the layer, moving from left to right and down
-    int offset(0);
-    const int num_floats(12);
+
+    // Build the mapping from (x, y) to offsets in the vertex and texture buffers
+    auto buffer_map = std::make_shared<std::map<int, int>>();
+    layer_mappings[layer_num] = buffer_map;
+
+
+    // Don't generate data for the collisions layer
+    // TODO: handle this not being in layer_mappings
+    if (layer->get_name() == "Collisions") {
+        return;
+    }
+
+
+    // Work out if we need a dense or a sparse buffer
+    int total_tiles = 0;
+    int num_blank_tiles = 0;
+
+    // Get all the tiles in the layer, moving from left to right and down
     for (auto &tile_data : *layer_data) {
-        std::shared_ptr<TileSet> tileset(tile_data.first);
-        int tile_id(tile_data.second);
+        std::shared_ptr<TileSet> tileset = tile_data.first;
+        if (!tileset) { num_blank_tiles++; }
 
-        //IF WE ARE GENERATING A SPARSE LAYER
-        //Skip out blank tiles:
-        //This get's us our sparse data structure
-        if (!dense && !tileset) {
-            continue;
-        }
+        total_tiles++;
+    }
 
-        // If this is a dense layer and the tile is blank, then we don't
-        // actually care about the texture coordinates. Only create data
-        // when we have a tileset.
-        if (tileset) {
-            //Get the texture coordinates for this tile
-            // GLfloat *tileset_ptr = &tileset_tex_coords[(tile_id)*8]; //*8 as 8 coordinates per tile
-            std::tuple<float,float,float,float> coords(tileset->get_atlas()->index_to_coords(tile_id));
-
-            //bottom left
-            data[offset+0]  = std::get<0>(coords);
-            data[offset+1]  = std::get<2>(coords);
-
-            //top left
-            data[offset+2]  = std::get<0>(coords);
-            data[offset+3]  = std::get<3>(coords);
-
-            //bottom right
-            data[offset+4]  = std::get<1>(coords);
-            data[offset+5]  = std::get<2>(coords);
-
-            //top left
-            data[offset+6]  = std::get<0>(coords);
-            data[offset+7]  = std::get<3>(coords);
-
-            //top right
-            data[offset+8]  = std::get<1>(coords);
-            data[offset+9]  = std::get<3>(coords);
-
-            //bottom right
-            data[offset+10] = std::get<1>(coords);
-            data[offset+11] = std::get<2>(coords);
-        }
+    // Tiles are fetched by position, chunk by chunk
+    if (total_tiles < map_width * map_height) {
+        LOG(ERROR) << "Layer had less data than map dimensions in Map::generate_data";
+        return;
+    }
+
+    // Spare packing by default
+    auto layer_packing(Layer::Packing::SPARSE);
 
-        offset += num_floats;
+    // If more than 50% of layer has tiles, make it dense
+    if (num_blank_tiles < total_tiles / 2) {
+        layer_packing = Layer::Packing::DENSE;
     }
-}
 
-void Map::generate_sparse_layer_tex_coords(GLfloat* data, std::shared_ptr<Layer> layer) {
-    generate_layer_tex_coords(data, layer, false);
-}
+    layer->set_packing(layer_packing);
 
+    // Create the buffer for the layer
+    int num_tiles(layer_packing == Layer::Packing::DENSE ? total_tiles
+                                                         : total_tiles - num_blank_tiles);
 
-void Map::generate_dense_layer_tex_coords(GLfloat* data, std::shared_ptr<Layer> layer) {
-    generate_layer_tex_coords(data, layer, true);
-}
+    // The number of bytes needed: one quad per tile
+    size_t quad_data_size(sizeof(GLfloat) * size_t(num_tiles) * floats_per_tile);
+    GLfloat* layer_quads(nullptr);
 
-void Map::generate_layer_vert_coords(GLfloat* data, std::shared_ptr<Layer> layer, bool dense) {
-    LOG(INFO) << "Generating map coordinate data";
+    try {
+        layer_quads = new GLfloat[size_t(num_tiles) * floats_per_tile];
+    }
+    catch(std::bad_alloc& ba) {
+        LOG(ERROR) << "Out of memory in Map::generate_data";
+        return;
+    }
 
-    int num_floats(12);
-    int offset(0);
-    ///
-    /// Vertex winding order:
-    /// 1, 3   4
-    ///  * --- *
-    ///  |     |
-    ///  |     |
-    ///  * --- *
-    /// 0       2,5
-    ///
-
-    // The current tile's data
-    auto tile_data = layer->get_layer_data()->begin();
-
-    // Generate one layer's worth of data
-    for (int y = 0; y < map_height; y++) {
-        for (int x = 0; x < map_width; x++) {
-            // If we exhaust the layer's data
-            if (tile_data == layer->get_layer_data()->end()) {
-                LOG(ERROR) << "Layer had less data than map dimensions in Map::generate_layer_vert_coords";
-                return;
-            }
+    std::vector<Layer::Chunk> chunks(chunk_layout);
 
-            std::shared_ptr<TileSet> tileset(tile_data->first);
-            // int tile_id(tile_data->second);
+    // Build the layer data based on the
+    if (layer_packing == Layer::Packing::DENSE) {
+        generate_dense_layer_quads(layer_quads, layer, chunks);
 
-            // IF GENERATING A SPARSE LAYER
-            // Skip empty tiles
-            if (!dense && !tileset) {
-                ++tile_data;
-                continue;
-            }
+        layer->set_chunks(chunks);
+    }
+    else {
+        generate_sparse_layer_quads(layer_quads, layer, chunks);
+
+        //Generate the mappings and the chunks' quad ranges
+        //ONLY NEEDED FOR SPARSE
+        int idx(0);
 
-            // Default to invisible.
-            float vx1(-1.0f), vy1(-1.0f);
-            float vx2(-1.0f), vy2(-1.0f);
-
-            if (tileset) {
-                // The tile is not blank, so set its x, y.
-                vx1 = float(x);
-                vy1 = float(y);
-                vx2 = float(x + 1.001);
-                vy2 = float(y + 1.001);
-            } else if (dense) {
-                LOG(INFO) << x << ", " << y;
+        for (auto &chunk : chunks) {
+            chunk.first_quad = idx / floats_per_tile;
+
+            for (int y = chunk.origin.y; y < chunk.origin.y + chunk.size.y; ++y) {
+                for (int x = chunk.origin.x; x < chunk.origin.x + chunk.size.x; ++x) {
+                    //Set the index into the buffer
+                    buffer_map->insert(std::make_pair(get_tile_order(x, y), idx));
+
+                    //Calculate the next index
+                    //If we're not looking at a blank tile
+                    if (layer->get_tile(x, y).first) {
+                        //Calculate the new offset
+                        idx += floats_per_tile;
+                    }
+
+                    //ELSE: Offset unchanged
+                }
             }
 
-            //bottom left
-            data[offset + 0] = vx1;
-            data[offset + 1] = vy1;
+            chunk.num_quads = idx / floats_per_tile - chunk.first_quad;
+        }
+
+        layer->set_chunks(chunks);
+    }
+
+    // Set this data in the renderable component for the layer
+    RenderableComponent* renderable_component = layer->get_renderable_component();
+    renderable_component->set_quad_data(layer_quads, quad_data_size, false);
+    renderable_component->set_num_quads_render(num_tiles);
+
+    // Keep the tile index map too, so the renderer can be switched at any time
+    if (!generate_tile_index_map(layer)) {
+        tile_index_supported = false;
+    }
+}
+
+void Map::generate_layer_quads(GLfloat* data, std::shared_ptr<Layer> layer, bool dense,
+                               std::vector<Layer::Chunk> &chunks) {
+    LOG(INFO) << "Generating map quad data";
 
-            //top left
-            data[offset + 2] = vx1;
-            data[offset + 3] = vy2;
+    // Generate one layer's worth of data, chunk by chunk, moving from
+    // left to right and up
+    int offset(0);
+    for (auto &chunk : chunks) {
+        offset += generate_chunk_quads(&data[offset], layer, dense, chunk) * floats_per_tile;
+    }
+}
 
-            //bottom right
-            data[offset + 4] = vx2;
-            data[offset + 5] = vy1;
+int Map::generate_chunk_quads(GLfloat* data, std::shared_ptr<Layer> layer, bool dense, Layer::Chunk &chunk) {
+    int offset(0);
+    int num_pages(get_page_count());
+
+    chunk.page_num_quads.clear();
+
+    // When the tiles are on several pages, the chunk's tiles are
+    // grouped by page so that each page's can be drawn together
+    for (int page = 0; page < num_pages; ++page) {
+        int page_first_offset(offset);
+
+        for (int y = chunk.origin.y; y < chunk.origin.y + chunk.size.y; y++) {
+            for (int x = chunk.origin.x; x < chunk.origin.x + chunk.size.x; x++) {
+                std::pair<std::shared_ptr<TileSet>, int> tile_data(layer->get_tile(x, y));
+                std::shared_ptr<TileSet> tileset(tile_data.first);
+                int tile_id(tile_data.second);
+
+                // IF GENERATING A SPARSE LAYER
+                // Skip empty tiles
+                // This get's us our sparse data structure
+                if (!dense && !tileset) {
+                    continue;
+                }
 
-            //top left
-            data[offset + 6] = vx1;
-            data[offset + 7] = vy2;
+                if (get_tile_page(tile_data) != page) {
+                    continue;
+                }
 
-            //top right
-            data[offset + 8] = vx2;
-            data[offset + 9] = vy2;
+                if (tileset) {
+                    // The tile is not blank, so set its x, y and texture.
+                    // The slight overlap hides seams between tiles.
+                    RenderableComponent::write_quad(&data[offset],
+                                                    float(x), float(x + 1.001),
+                                                    float(y), float(y + 1.001),
+                                                    tileset->get_atlas()->index_to_coords(tile_id));
+                } else {
+                    // Blank tiles in dense layers are degenerate, so invisible
+                    RenderableComponent::write_quad(&data[offset],
+                                                    -1.0f, -1.0f, -1.0f, -1.0f,
+                                                    std::make_tuple(0.0f, 0.0f, 0.0f, 0.0f));
+                }
 
-            //bottom right
-            data[offset + 10] = vx2;
-            data[offset + 11] = vy1;
+                offset += floats_per_tile;
+            }
+        }
 
-            offset += num_floats;
-            ++tile_data;
+        if (num_pages > 1) {
+            chunk.page_num_quads.push_back((offset - page_first_offset) / floats_per_tile);
         }
     }
+
+    return offset / floats_per_tile;
 }
 
-void Map::generate_dense_layer_vert_coords(GLfloat* data, std::shared_ptr<Layer> layer) {
-    generate_layer_vert_coords(data, layer, true);
+void Map::generate_dense_layer_quads(GLfloat* data, std::shared_ptr<Layer> layer,
+                                     std::vector<Layer::Chunk> &chunks) {
+    generate_layer_quads(data, layer, true, chunks);
 }
 
-void Map::generate_sparse_layer_vert_coords(GLfloat* data, std::shared_ptr<Layer> layer) {
-    generate_layer_vert_coords(data, layer, false);
+void Map::generate_sparse_layer_quads(GLfloat* data, std::shared_ptr<Layer> layer,
+                                      std::vector<Layer::Chunk> &chunks) {
+    generate_layer_quads(data, layer, false, chunks);
+}
+
+int Map::get_page_count() {
+    if (tilesets.empty() || !tilesets[0]->get_atlas()) {
+        return 1;
+    }
+
+    // All the layers share the merged atlas: see init_textures
+    return tilesets[0]->get_atlas()->get_page_count();
 }
 
 void Map::init_textures() {
@@ -521,44 +565,126 @@ Map::Blocker Map::block_tile(glm::ivec2 tile) {
     return Blocker(tile, &blocker);
 }
 
-bool Map::recalculate_layer_mappings(int x_pos, int y_pos, int layer_num) {
-    if (y_pos < 0 || x_pos < 0) {
-        return false;
+void Map::recalculate_layer_mappings(int x_pos, int y_pos, std::shared_ptr<Layer> layer, int layer_num) {
+    auto mappings(layer_mappings[layer_num]);
+
+    // Shift all of the offsets after this position down as we're
+    // putting a tile into this position
+    for (auto mapping = mappings->upper_bound(get_tile_order(x_pos, y_pos)); mapping != std::end(*mappings); ++mapping) {
+        mapping->second += floats_per_tile;
     }
 
-    auto layer(layer_mappings[layer_num]);
-    int index(y_pos * map_width + x_pos);
-    int size(int(layer->size()));
+    // The tile's chunk grows and the following chunks move down
+    std::vector<Layer::Chunk> &chunks(layer->get_chunks());
+    int chunk_index(get_chunk_index(x_pos, y_pos));
+
+    chunks[chunk_index].num_quads += 1;
+    for (size_t i = size_t(chunk_index) + 1; i < chunks.size(); ++i) {
+        chunks[i].first_quad += 1;
+    }
+}
 
-    // Handle last element and those outside of range
-    // Note: index ≥ 0 by y_pos, map_width, x_pos > 0
-    if (index + 1 >= size) {
+bool Map::replace_layer_quads(std::shared_ptr<Layer> layer, int first_quad, int num_quads,
+                              const GLfloat *data, int new_num_quads) {
+    RenderableComponent* layer_renderable_component(layer->get_renderable_component());
+    GLfloat* layer_quad_data(layer_renderable_component->get_quad_data());
+    size_t layer_num_floats(layer_renderable_component->get_quad_data_size() / sizeof(GLfloat));
+
+    size_t start(size_t(first_quad) * floats_per_tile);
+    size_t end(start + size_t(num_quads) * floats_per_tile);
+    size_t new_floats(size_t(new_num_quads) * floats_per_tile);
+
+    //Generate the new buffer
+    GLfloat *new_quad_data;
+    size_t new_num_floats(layer_num_floats - (end - start) + new_floats);
+
+    try {
+        new_quad_data = new GLfloat[new_num_floats];
+    }
+    catch(std::bad_alloc& ba) {
+        LOG(ERROR) << "Couldn't allocate memory for new quad buffer in Map::replace_layer_quads";
         return false;
     }
 
-    // Do we need to increment mappings?
-    // Compare offsets
-    if ((*layer)[index + 1] == (*layer)[index]) {
-        // The next element is the same so we need to increment
-        // further offsets.
+    //Copy the first part of the original data
+    std::copy(layer_quad_data, &layer_quad_data[start], new_quad_data);
 
-        // Shift all of the offsets down as we're putting a tile into
-        // this position
-        for (auto i = index + 1; i < size; i++) {
-            (*layer)[i] += num_tile_dimensions * num_tile_vertices;;
+    //Insert the new data into the correct position
+    std::copy(data, &data[new_floats], &new_quad_data[start]);
+
+    //Copy the rest of the original data
+    std::copy(&layer_quad_data[end], &layer_quad_data[layer_num_floats], &new_quad_data[start + new_floats]);
+
+    //Set the new data
+    layer_renderable_component->set_quad_data(new_quad_data, sizeof(GLfloat) * new_num_floats, false);
+    layer_renderable_component->set_num_quads_render(GLsizei(new_num_floats / floats_per_tile));
+    return true;
+}
+
+void Map::update_paged_tile(int x_pos, int y_pos, std::shared_ptr<Layer> layer, int layer_num,
+                            int old_page, bool had_quad, GLfloat *data) {
+    // Layers which are not drawn, such as the collisions, have no chunks
+    if (layer->get_chunks().empty()) {
+        return;
+    }
+
+    bool dense(layer->get_packing() == Layer::Packing::DENSE);
+    Layer::Chunk &chunk(layer->get_chunks()[size_t(get_chunk_index(x_pos, y_pos))]);
+    int new_page(get_tile_page(layer->get_tile(x_pos, y_pos)));
+
+    if (had_quad && new_page == old_page) {
+        // The quad stays in its page run: page_num_quads gives where the
+        // run starts, and the stored tiles before this one on the same
+        // page its place in the run
+        int quad(chunk.first_quad);
+        for (int page = 0; page < new_page; ++page) {
+            quad += chunk.page_num_quads[size_t(page)];
         }
 
-        return false;
+        for (int y = chunk.origin.y; y <= y_pos; ++y) {
+            int end_x(y == y_pos ? x_pos : chunk.origin.x + chunk.size.x);
+            for (int x = chunk.origin.x; x < end_x; ++x) {
+                std::pair<std::shared_ptr<TileSet>, int> tile_data(layer->get_tile(x, y));
+                if ((dense || tile_data.first) && get_tile_page(tile_data) == new_page) {
+                    ++quad;
+                }
+            }
+        }
+
+        layer->get_renderable_component()->update_quad_buffer(
+            GLintptr(sizeof(GLfloat) * size_t(quad) * floats_per_tile),
+            sizeof(GLfloat) * floats_per_tile,
+            data
+        );
+        return;
+    }
+
+    // The quad moves to another page run, or is new to a sparse layer:
+    // write the chunk's page runs again
+    int old_num_quads(chunk.num_quads);
+    std::vector<GLfloat> chunk_quads(size_t(old_num_quads + (had_quad ? 0 : 1)) * floats_per_tile);
+    int num_quads(generate_chunk_quads(chunk_quads.data(), layer, dense, chunk));
+
+    if (num_quads == old_num_quads) {
+        layer->get_renderable_component()->update_quad_buffer(
+            GLintptr(sizeof(GLfloat) * size_t(chunk.first_quad) * floats_per_tile),
+            sizeof(GLfloat) * chunk_quads.size(),
+            chunk_quads.data()
+        );
+        return;
     }
-    else {
-        // There is already a tile here, so don't mutate
 
-        // You can directly insert the tile
-        return true;
+    if (!replace_layer_quads(layer, chunk.first_quad, old_num_quads, chunk_quads.data(), num_quads)) {
+        return;
     }
+
+    // Recalculate the layer mappings and chunks
+    recalculate_layer_mappings(x_pos, y_pos, layer, layer_num);
 }
 
 void Map::update_tile(int x_pos, int y_pos, const std::string layer_name, const std::string tile_name) {
+    Profiler::Scope profile("Map::update_tile");
+
     int tile_id = -1;
     std::shared_ptr<TileSet> tileset;
     for (std::shared_ptr<TileSet> tileset_i : tilesets) {
@@ -575,48 +701,6 @@ void Map::update_tile(int x_pos, int y_pos, const std::string layer_name, const
         throw std::runtime_error("Tile not found: " + tile_name);
     }
 
-    // Build the data for the update
-    GLfloat *data;
-    size_t data_size(sizeof(GLfloat) * num_tile_dimensions * num_tile_vertices);
-
-    // Get a buffer for the data
-    try {
-        data = new GLfloat[data_size];
-    }
-    catch(std::bad_alloc& ba) {
-        LOG(ERROR) << "Couldn't allocate memory in Map::update_tile";
-        return;
-    }
-
-    // Get the texture coordinates for this tile
-    // GLfloat *tileset_ptr = &tileset_tex_coords[(tile_id)*8]; //*8 as 8 coordinates per tile
-    std::tuple<float,float,float,float> coords(tileset->get_atlas()->index_to_coords(tile_id));
-
-    //bottom left
-    data[0]  = std::get<0>(coords);
-    data[1]  = std::get<2>(coords);
-
-    //top left
-    data[2]  = std::get<0>(coords);
-    data[3]  = std::get<3>(coords);
-
-    //bottom right
-    data[4]  = std::get<1>(coords);
-    data[5]  = std::get<2>(coords);
-
-    //top left
-    data[6]  = std::get<0>(coords);
-    data[7]  = std::get<3>(coords);
-
-    //top right
-    data[8]  = std::get<1>(coords);
-    data[9]  = std::get<3>(coords);
-
-    //bottom right
-    data[10] = std::get<1>(coords);
-    data[11] = std::get<2>(coords);
-
-
     // Find the layer from the layer name name.
     std::shared_ptr<Layer> layer;
     int layer_num;
@@ -633,24 +717,55 @@ void Map::update_tile(int x_pos, int y_pos, const std::string layer_name, const
         throw std::runtime_error("Layer not found: " + layer_name);
     }
 
+    // Build the tile's quad: positions and texture coordinates together
+    GLfloat data[floats_per_tile];
+    size_t data_size(sizeof(data));
+
+    RenderableComponent::write_quad(data,
+                                    float(x_pos), float(x_pos + 1.001),
+                                    float(y_pos), float(y_pos + 1.001),
+                                    tileset->get_atlas()->index_to_coords(tile_id));
+
     // Put it into the buffers
 
     Layer::Packing packing(layer->get_packing());
 
+    // Whether there was a tile here: sparse layers only store those
+    bool in_map(x_pos >= 0 && y_pos >= 0 && x_pos < map_width && y_pos < map_height);
+    bool overwrite(in_map && layer->get_tile(x_pos, y_pos).first);
+
+    // The page run the tile's quad was in, when the tiles are on several
+    int old_page(in_map ? get_tile_page(layer->get_tile(x_pos, y_pos)) : 0);
+
     // Add this tile to the layer data structure
     layer->update_tile(x_pos, y_pos, tile_id, tileset);
 
-    int tile_offset;
+    // The tile index renderer only needs the one texel
+    if (!layer->get_tile_index_map().set_tile(x_pos, y_pos, tileset->get_atlas()->index_to_units(tile_id))) {
+        tile_index_supported = false;
+    }
+
+    event_tile_update.trigger(x_pos, y_pos, layer->get_id());
+
+    // Tiles are grouped by page within their chunks, so the tile's
+    // chunk may have to be laid out again
+    if (get_page_count() > 1) {
+        update_paged_tile(x_pos, y_pos, layer, layer_num, old_page,
+                          overwrite || packing == Layer::Packing::DENSE, data);
+        return;
+    }
+
+    RenderableComponent* layer_renderable_component(layer->get_renderable_component());
 
     // Perform O(1) update. no need to do mapping changes
     if (packing == Layer::Packing::DENSE) {
-        tile_offset = y_pos * map_width + x_pos;
+        int tile_offset(get_tile_order(x_pos, y_pos));
 
         // Update the buffer
-        // Just update that tile directly
-        RenderableComponent *renderable_component(layer->get_renderable_component());
-        renderable_component->update_texture_buffer(
-            sizeof(GLfloat) * tile_offset * num_tile_vertices * num_tile_dimensions,
+        // Just update that tile directly. The whole quad is written as a
+        // blank tile's positions are degenerate.
+        layer_renderable_component->update_quad_buffer(
+            GLintptr(sizeof(GLfloat) * size_t(tile_offset) * floats_per_tile),
             data_size,
             data
         );
@@ -658,107 +773,26 @@ void Map::update_tile(int x_pos, int y_pos, const std::string layer_name, const
     else {
         // TODO: create a small buffer to hold these updates rather than rebuilding the entire buffer
 
-        // Generate the new tile's data
-        GLfloat* vertex_data = nullptr;
-
-        // Get a buffer for the data
-        try {
-            vertex_data = new GLfloat[data_size];
-        }
-        catch(std::bad_alloc& ba) {
-            LOG(ERROR) << "Couldn't allocate memory in Map::update_tile";
-            data = nullptr;
-            return;
-        }
-
-        // Set the needed data
-
-        // bottom left
-        vertex_data[0]  = float(x_pos);
-        vertex_data[1]  = float(y_pos);
-
-        // top left
-        vertex_data[2]  = float(x_pos);
-        vertex_data[3]  = float(y_pos + 1);
-
-        // bottom right
-        vertex_data[4]  = float(x_pos + 1);
-        vertex_data[5]  = float(y_pos);
-
-        // top left
-        vertex_data[6]  = float(x_pos);
-        vertex_data[7]  = float(y_pos + 1);
-
-        // top right
-        vertex_data[8]  = float(x_pos + 1);
-        vertex_data[9]  = float(y_pos + 1);
-
-        // bottom right
-        vertex_data[10] = float(x_pos + 1);
-        vertex_data[11] = float(y_pos);
-
         // Fetch the offset from the data buffer
         // Tile offset in floats
-        int offset((*layer_mappings[layer_num])[y_pos*map_width + x_pos]);
-
-        // Recalculate the layer mappings
-        bool overwrite(recalculate_layer_mappings(x_pos, y_pos, layer_num));
-
-        // TODO: small buffer
-        // Get the data
-        RenderableComponent* layer_renderable_component(layer->get_renderable_component());
-
-        GLfloat* layer_texture_data(layer_renderable_component->get_texture_coords_data());
-        GLfloat* layer_vertex_data (layer_renderable_component->get_vertex_data());
-
-        size_t texture_data_size(layer_renderable_component->get_texture_coords_data_size());
-        size_t vertex_data_size (layer_renderable_component->get_vertex_data_size());
+        size_t offset(size_t((*layer_mappings[layer_num])[get_tile_order(x_pos, y_pos)]));
 
         if (overwrite) {
             // We just need to overwrite the tile
             // Update the buffer
             // Just update that tile directly
-            layer_renderable_component->update_texture_buffer(offset*sizeof(GLfloat), data_size, data);
+            layer_renderable_component->update_quad_buffer(GLintptr(offset * sizeof(GLfloat)), data_size, data);
         }
         else {
-            // We need to insert the tile: expand the buffers
-
-            //Generate the new buffers
-            GLfloat *new_texture_data;
-            GLfloat *new_vertex_data;
-            int new_texture_data_size(int(texture_data_size + data_size));
-            int new_vertex_data_size (int( vertex_data_size + data_size));
-
-            try {
-                new_texture_data = new GLfloat[new_texture_data_size];
-                new_vertex_data  = new GLfloat[new_vertex_data_size];
-            }
-            catch(std::bad_alloc& ba) {
-                LOG(ERROR) << "Couldn't allocate memory for new texture and vertex buffers in Map::update_tile";
+            // We need to insert the tile: expand the buffer
+            if (!replace_layer_quads(layer, int(offset / floats_per_tile), 0, data, 1)) {
                 return;
             }
 
-            //Copy the first part of the original data
-            int data_length(num_tile_vertices * num_tile_dimensions);
-            std::copy(layer_vertex_data, &layer_vertex_data[offset], new_vertex_data);
-            std::copy(layer_texture_data, &layer_texture_data[offset], new_texture_data);
-
-            //Insert the new data into the correct position
-            std::copy(vertex_data, &vertex_data[data_length], &new_vertex_data[offset]);
-            std::copy(data, &data[data_length], &new_texture_data[offset]);
-
-            //Copy the rest of the original data
-            std::copy(&layer_vertex_data[offset], &layer_vertex_data[vertex_data_size], &new_vertex_data[offset + data_length]);
-            std::copy(&layer_texture_data[offset], &layer_texture_data[texture_data_size], &new_texture_data[offset + data_length]);
-
-            //Set the new data
-            layer_renderable_component->set_vertex_data(new_vertex_data, new_vertex_data_size, false);
-            layer_renderable_component->set_num_vertices_render(new_texture_data_size / (int(sizeof(GLfloat)) * num_tile_dimensions));
-            layer_renderable_component->set_texture_coords_data(new_texture_data, new_texture_data_size, false);
+            // Recalculate the layer mappings and chunks
+            recalculate_layer_mappings(x_pos, y_pos, layer, layer_num);
         }
-        delete[] vertex_data;
     }
-    delete[] data;
 }
 
 std::string Map::query_tile(int x_pos, int y_pos, const std::string layer_name) {
@@ -780,9 +814,13 @@ std::string Map::query_tile(int x_pos, int y_pos, const std::string layer_name)
 }
 
 int Map::get_tile_texture_vbo_offset(int layer_num, int x_pos, int y_pos) {
-     // Fetch the offset from the data buffer
-     int tile_offset((*layer_mappings[layer_num])[y_pos*map_width + x_pos]);
+     std::shared_ptr<Layer> layer(ObjectManager::get_instance().get_object<Layer>(layer_ids[layer_num]));
+
+     // Sparse layers map the tile to its GLfloat offset
+     if (layer->get_packing() == Layer::Packing::SPARSE) {
+         return (*layer_mappings[layer_num])[get_tile_order(x_pos, y_pos)];
+     }
 
-     // The VBO offset is the tile offset times the dimenions and number of vertices
-     return tile_offset * num_tile_vertices * num_tile_dimensions;
+     // The VBO offset is the tile offset times the floats in a quad
+     return get_tile_order(x_pos, y_pos) * floats_per_tile;
 }
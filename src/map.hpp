@@ -21,9 +21,10 @@
 
 #include "dispatcher.hpp"
 #include "fml.hpp"
+#include "layer.hpp"
 #include "map_loader.hpp"
+#include "renderable_component.hpp"
 
-class Layer;
 class TextureAtlas;
 class TileSet;
 
@@ -46,11 +47,44 @@ class Map {
     ///.This allows us to update the buffers to change the map.
     /// First param: layer number, starts at 0
     /// Second param: Map of (x, y) positions, flattened to a single
-    ///               number, this is x+ y*map_width, which maps these
+    ///               number by get_tile_order, which maps these
     ///               locations to their offset in the vertex and texture
     ///
     std::map<int, std::shared_ptr<std::map<int, int>>> layer_mappings;
 
+    ///
+    /// The width and height of a layer chunk in tiles
+    ///
+    static const int chunk_size = 16;
+
+    ///
+    /// The size of one atlas unit in texture coordinates, for the tile
+    /// index renderer
+    ///
+    glm::vec2 atlas_unit_size = glm::vec2(0.0f);
+
+    ///
+    /// The texture coordinates of the top left of the atlas unit in
+    /// column 0 and row 0, for the tile index renderer
+    ///
+    glm::vec2 atlas_origin = glm::vec2(0.0f);
+
+    ///
+    /// Whether every tile fits into the layers' tile index maps
+    ///
+    bool tile_index_supported = false;
+
+    ///
+    /// The number of chunks across the map
+    ///
+    int num_chunks_x = 0;
+
+    ///
+    /// The chunks every layer is split into, in buffer order. The
+    /// vertex ranges are those of a dense layer.
+    ///
+    std::vector<Layer::Chunk> chunk_layout;
+
     ///
     /// The ids of the map objects that are on this map
     ///
@@ -82,19 +116,37 @@ class Map {
     std::shared_ptr<TextureAtlas> texture_atlases[1];
 
     ///
-    /// The number of dimensions in the vertex and texture buffers for a tile: (x, y) here
+    /// The number of floats in the layer buffers for a tile: one
+    /// interleaved quad
     ///
-    int num_tile_dimensions = 2;
+    static const int floats_per_tile = RenderableComponent::floats_per_quad;
 
     ///
-    /// The number of vertices for a tile
+    /// The function used to generate the cache of tile texture coordinates.
     ///
-    int num_tile_vertices = 6;
+    void generate_tileset_coords(std::shared_ptr<TextureAtlas> texture);
 
     ///
-    /// The function used to generate the cache of tile texture coordinates.
+    /// Split the map into chunks, filling in chunk_layout
     ///
-    void generate_tileset_coords(std::shared_ptr<TextureAtlas> texture);
+    void generate_chunk_layout();
+
+    ///
+    /// Get the index of the chunk holding a tile
+    /// @param x_pos the x position of the tile
+    /// @param y_pos the y position of the tile
+    /// @return the index into chunk_layout
+    ///
+    int get_chunk_index(int x_pos, int y_pos);
+
+    ///
+    /// Get the position of a tile in the buffers of a dense layer.
+    /// Tiles are ordered by chunk, then row by row within the chunk.
+    /// @param x_pos the x position of the tile
+    /// @param y_pos the y position of the tile
+    /// @return the tile's index
+    ///
+    int get_tile_order(int x_pos, int y_pos);
 
     ///
     /// Generate the map's texture and vertex data
@@ -102,85 +154,114 @@ class Map {
     void generate_data();
 
     ///
-    /// Generates a layer's texture coordinates. Handles generating the
-    /// data if the layers are sparse or dense. A dense layer is one
-    /// with more tiles that are non-empty than empty ones.
-    ///
-    /// @data the array to put the data
-    /// @data_size the size of he array in bytes
-    /// @num_tiles the number of tiles to generate data for
-    /// @layer the layer to generate the texture coordinates for
-    /// @dense if the layer is dense or sparse
+    /// Generate a layer's vertex data, chunks and tile index map
+    /// @param layer the layer
+    /// @param layer_num the layer's number
     ///
-    void generate_layer_tex_coords(GLfloat* data, std::shared_ptr<Layer> layer, bool dense=true);
+    void generate_layer_data(std::shared_ptr<Layer> layer, int layer_num);
 
     ///
-    /// Generates a layer's vertex coordinates. Handles generating the
+    /// Generates a layer's interleaved quad data. Handles generating the
     /// data if the layers are sparse or dense. A dense layer is one
     /// with more tiles that are non-empty than empty ones.
     ///
-    /// @data the array to put the data
-    /// @data_size the size of he array in bytes
-    /// @num_tiles the number of tiles to generate data for
-    /// @layer the layer to generate the texture coordinates for
+    /// @data the array to put the data, floats_per_tile floats per tile
+    /// @layer the layer to generate the quads for
     /// @dense if the layer is dense or sparse
+    /// @chunks the layer's chunks, whose page_num_quads are filled in
     ///
-    void generate_layer_vert_coords(GLfloat* data, std::shared_ptr<Layer> layer, bool dense=true);
+    void generate_layer_quads(GLfloat* data, std::shared_ptr<Layer> layer, bool dense,
+                              std::vector<Layer::Chunk> &chunks);
 
     ///
-    /// Calls genenerate_layer_vert_coords to generate a layer's vertex data
+    /// Generates one chunk's interleaved quad data, grouped by page when
+    /// the tiles are on several pages.
     ///
-    /// @data the array to put the data
-    /// @data_size the size of he array in bytes
-    /// @num_tiles the number of tiles to generate data for
-    /// @layer the layer to generate the texture coordinates for
+    /// @data the array to put the data, floats_per_tile floats per tile
+    /// @layer the layer to generate the quads for
     /// @dense if the layer is dense or sparse
+    /// @chunk the chunk, whose page_num_quads are filled in
+    /// @return the number of quads written
     ///
-    void generate_dense_layer_vert_coords(GLfloat* data, std::shared_ptr<Layer> layer);
+    int generate_chunk_quads(GLfloat* data, std::shared_ptr<Layer> layer, bool dense, Layer::Chunk &chunk);
 
     ///
-    /// Calls generate_layer_tex_coords
+    /// Calls generate_layer_quads to generate a dense layer's data
     ///
     /// @data the array to put the data
-    /// @data_size the size of he array in bytes
-    /// @num_tiles the number of tiles to generate data for
-    /// @layer the layer to generate the texture coordinates for
-    /// @dense if the layer is dense or sparse
+    /// @layer the layer to generate the quads for
+    /// @chunks the layer's chunks
     ///
-    void generate_dense_layer_tex_coords(GLfloat* data, std::shared_ptr<Layer> layer);
+    void generate_dense_layer_quads(GLfloat* data, std::shared_ptr<Layer> layer,
+                                    std::vector<Layer::Chunk> &chunks);
 
     ///
-    /// Calls generate_layer_vert_coords
+    /// Calls generate_layer_quads to generate a sparse layer's data
     ///
     /// @data the array to put the data
-    /// @data_size the size of he array in bytes
-    /// @num_tiles the number of tiles to generate data for
-    /// @layer the layer to generate the texture coordinates for
-    /// @dense if the layer is dense or sparse
+    /// @layer the layer to generate the quads for
+    /// @chunks the layer's chunks
     ///
-    void generate_sparse_layer_vert_coords(GLfloat* data, std::shared_ptr<Layer> layer);
+    void generate_sparse_layer_quads(GLfloat* data, std::shared_ptr<Layer> layer,
+                                     std::vector<Layer::Chunk> &chunks);
 
     ///
-    /// Calls generate_layer_tex_coords
+    /// Get the number of pages of the atlas the layers' tiles are on
     ///
-    /// @data the array to put the data
-    /// @data_size the size of he array in bytes
-    /// @num_tiles the number of tiles to generate data for
-    /// @layer the layer to generate the texture coordinates for
-    /// @dense if the layer is dense or sparse
+    int get_page_count();
+
+    ///
+    /// Work out the atlas geometry used by the tile index renderer
+    ///
+    void generate_atlas_geometry();
+
     ///
-    void generate_sparse_layer_tex_coords(GLfloat* data, std::shared_ptr<Layer> layer);
+    /// Fill in a layer's tile index map
+    /// @param layer the layer
+    /// @return false if a tile's unit does not fit in the map
+    ///
+    bool generate_tile_index_map(std::shared_ptr<Layer> layer);
 
     ///
-    /// Used when a tile needs to be added at a point. This function
-    /// will recalculate the layer mappings as needed to ensure future
-    /// updates update the correct buffer locations. Used for sparse maps.
+    /// Used when a tile needs to be added at a point where a sparse layer
+    /// had none. This function shifts the layer mappings and the chunks
+    /// after the point to ensure future updates update the correct buffer
+    /// locations.
     /// @param x_pos
     /// @param y_pos
-    /// @param layer_num the layer
-    /// @return true if the tile can just be overwritten,false if it needs to be inserted
+    /// @param layer the layer
+    /// @param layer_num the layer's number
+    ///
+    void recalculate_layer_mappings(int x_pos, int y_pos, std::shared_ptr<Layer> layer, int layer_num);
+
+    ///
+    /// Replace a range of a layer's quads with a different number of
+    /// quads, reallocating its buffers.
+    /// @param layer the layer
+    /// @param first_quad the first quad to replace
+    /// @param num_quads the number of quads to replace
+    /// @param data the new quads, floats_per_tile floats per quad
+    /// @param new_num_quads the number of new quads
+    /// @return false if there was not the memory
     ///
-    bool recalculate_layer_mappings(int x_pos, int y_pos, int layer_num);
+    bool replace_layer_quads(std::shared_ptr<Layer> layer, int first_quad, int num_quads,
+                             const GLfloat *data, int new_num_quads);
+
+    ///
+    /// Put a changed tile's quad into the buffers of a layer whose tiles
+    /// are on several pages. Only the tile's chunk is touched: the quad
+    /// is patched in place when it stays in the same page run, and
+    /// otherwise the chunk's page runs are written again.
+    /// @param x_pos the x position of the tile
+    /// @param y_pos the y position of the tile
+    /// @param layer the layer, already holding the new tile
+    /// @param layer_num the layer's number
+    /// @param old_page the page the tile's quad was on
+    /// @param had_quad whether the layer stored a quad for the old tile
+    /// @param data the tile's new quad
+    ///
+    void update_paged_tile(int x_pos, int y_pos, std::shared_ptr<Layer> layer, int layer_num,
+                           int old_page, bool had_quad, GLfloat *data);
 
     ///
     /// Initialises the textures
@@ -194,6 +275,12 @@ class Map {
 
 public:
     Dispatcher<int> event_sprite_add;
+
+    ///
+    /// Triggered with the tile's x and y position and the layer's id
+    /// whenever update_tile changes a tile
+    ///
+    Dispatcher<int, int, int> event_tile_update;
     PositionDispatcher<int> event_step_on;
     PositionDispatcher<int> event_step_off;
     std::vector<std::vector<int>> blocker;
@@ -281,6 +368,21 @@ public:
     ///
     std::vector<int> get_layers() { return layer_ids; }
 
+    ///
+    /// Whether the layers can be drawn with the tile index renderer
+    ///
+    bool is_tile_index_supported() { return tile_index_supported; }
+
+    ///
+    /// Get the size of one atlas unit in texture coordinates
+    ///
+    glm::vec2 get_atlas_unit_size() { return atlas_unit_size; }
+
+    ///
+    /// Get the texture coordinates of the top left of the first atlas unit
+    ///
+    glm::vec2 get_atlas_origin() { return atlas_origin; }
+
     ///
     /// Update the tile at a given point in the map
     /// @param x_pos the x position of the tile
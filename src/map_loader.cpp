@@ -7,7 +7,9 @@
 #include <string>
 #include <Tmx.h>
 #include <utility>
+#include <vector>
 
+#include "asset_loader.hpp"
 #include "engine.hpp"
 #include "fml.hpp"
 #include "layer.hpp"
@@ -27,6 +29,19 @@
 /// attributes and have only parsed them if we need them.
 ///
 bool MapLoader::load_map(const std::string source) {
+    if (!parsed && !parse_map(source)) {
+        return false;
+    }
+
+    if (!tilesets_loaded) {
+        load_tileset();
+    }
+    load_layers();
+
+    return true;
+}
+
+bool MapLoader::parse_map(const std::string source) {
 
     LOG(INFO) << "Loading map";
     map.ParseFile(source);
@@ -38,13 +53,19 @@ bool MapLoader::load_map(const std::string source) {
 
     map_width = map.GetWidth();
     map_height = map.GetHeight();
-
-    load_tileset();
-    load_layers();
+    parsed = true;
 
     return true;
 }
 
+std::vector<std::string> MapLoader::get_tileset_images() {
+    std::vector<std::string> image_paths;
+    for (int i = 0; i < map.GetNumTilesets(); ++i) {
+        image_paths.push_back(map.GetTileset(i)->GetImage()->GetSource());
+    }
+    return image_paths;
+}
+
 void MapLoader::load_layers() {
     for (int i = 0; i < map.GetNumLayers(); ++i) {
         //Get the layer
@@ -55,6 +76,10 @@ void MapLoader::load_layers() {
 
         //Generate a new layer
         std::shared_ptr<Layer> layer_ptr = std::make_shared<Layer>(num_tiles_x, num_tiles_y, name);
+
+        // Layers with this property in Tiled are drawn over the sprites
+        layer_ptr->set_above_sprites(layer->GetProperties().HasProperty("above_sprites"));
+
         layers.push_back(layer_ptr);
         ObjectManager::get_instance().add_object(layer_ptr);
         //Get the tiles
@@ -140,7 +165,12 @@ std::map<std::string, ObjectProperties> MapLoader::get_object_mapping() {
     return named_tiles_mapping;
 }
 
-void MapLoader::load_tileset() {
+void MapLoader::load_tileset(const AssetLoader::DecodedAtlases *decoded) {
+    // Load the tilesets' atlases merged, from the asset cache if they
+    // have been merged before. The tilesets share them from here.
+    std::vector<std::shared_ptr<TextureAtlas>> atlases(TextureAtlas::load_merged(get_tileset_images(), decoded));
+    tilesets_loaded = true;
+
     //For all the tilesets
     for (int i = 0; i < map.GetNumTilesets(); ++i) {
 
@@ -181,13 +211,4 @@ void MapLoader::load_tileset() {
             }
         }
     }
-
-    // Merge the tilesets.
-    std::vector<std::shared_ptr<TextureAtlas>> atlases;
-    for (auto tileset : tilesets) {
-        if (tileset->get_atlas()) {
-            atlases.push_back(tileset->get_atlas());
-        }
-    }
-    TextureAtlas::merge(atlases);
 }
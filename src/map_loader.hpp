@@ -9,6 +9,8 @@
 #include <utility>
 #include <vector>
 
+#include "asset_loader.hpp"
+
 class Layer;
 class MapObject;
 class TileSet;
@@ -38,14 +40,19 @@ class MapLoader {
     int map_height = 0;
 
     ///
-    /// Load layers from the TMX map
+    /// Whether the TMX map has been parsed
     ///
-    void load_layers();
+    bool parsed = false;
 
     ///
-    /// Load tilesets from the TMX map
+    /// Whether the tilesets have been loaded
+    ///
+    bool tilesets_loaded = false;
+
+    ///
+    /// Load layers from the TMX map
     ///
-    void load_tileset();
+    void load_layers();
 
     ///
     /// Vector of tilesets
@@ -70,10 +77,30 @@ public:
     std::map<std::string, ObjectProperties> get_object_mapping();
 
     ///
-    /// Load the TMX map from the source file
+    /// Load the TMX map from the source file, parsing it and loading
+    /// its tilesets if that has not already been done
     ///
     bool load_map(const std::string source);
 
+    ///
+    /// Parse the TMX map from the source file. This touches nothing but
+    /// the loader, so can be done on the asset loader's threads.
+    ///
+    bool parse_map(const std::string source);
+
+    ///
+    /// Get the images of the parsed map's tilesets
+    ///
+    std::vector<std::string> get_tileset_images();
+
+    ///
+    /// Load tilesets from the TMX map
+    ///
+    /// @param decoded the tilesets' images decoded by the asset loader,
+    ///        or nullptr to decode them here
+    ///
+    void load_tileset(const AssetLoader::DecodedAtlases *decoded = nullptr);
+
     ///
     /// Gets the width of the ma
     /// @return the width of the map
@@ -47,8 +47,7 @@ MapObject::MapObject(glm::vec2 position,
         init_shaders();
         // Hack hack hack
         load_textures(frames.get_frame(start_frame));
-        generate_tex_data(frames.get_frame(start_frame));
-        generate_vertex_data();
+        generate_quad_data(frames.get_frame(start_frame));
 
         LOG(INFO) << "MapObject initialized";
 }
@@ -97,102 +96,45 @@ void MapObject::regenerate_blockers() {
     }
 }
 
-void MapObject::generate_tex_data(std::pair<int, std::string> tile) {
-    // holds the texture data
-    // need 12 float for the 2D texture coordinates
-    int num_floats = 12;
-
-    GLfloat *map_object_tex_data;
+void MapObject::generate_quad_data(std::pair<int, std::string> tile) {
+    // holds the interleaved position and texture data of one quad
+    GLfloat *map_object_quad_data;
     try {
-        map_object_tex_data = new GLfloat[sizeof(GLfloat)*num_floats];
+        map_object_quad_data = new GLfloat[RenderableComponent::floats_per_quad];
     }
     catch(std::bad_alloc &) {
-        LOG(ERROR) << "ERROR in MapObject::generate_tex_data(), cannot allocate memory";
+        LOG(ERROR) << "ERROR in MapObject::generate_quad_data(), cannot allocate memory";
         return;
     }
 
     std::tuple<float,float,float,float> bounds(
         renderable_component.get_texture()->index_to_coords(tile.first)
     );
+    renderable_component.set_texture_page(renderable_component.get_texture()->index_to_page(tile.first));
 
-    // bottom left
-    map_object_tex_data[ 0] = std::get<0>(bounds);
-    map_object_tex_data[ 1] = std::get<2>(bounds);
-
-    // top left
-    map_object_tex_data[ 2] = std::get<0>(bounds);
-    map_object_tex_data[ 3] = std::get<3>(bounds);
-
-    // bottom right
-    map_object_tex_data[ 4] = std::get<1>(bounds);
-    map_object_tex_data[ 5] = std::get<2>(bounds);
-
-    // top left
-    map_object_tex_data[ 6] = std::get<0>(bounds);
-    map_object_tex_data[ 7] = std::get<3>(bounds);
-
-    // top right
-    map_object_tex_data[ 8] = std::get<1>(bounds);
-    map_object_tex_data[ 9] = std::get<3>(bounds);
+    // The object covers one tile from its position
+    RenderableComponent::write_quad(map_object_quad_data, 0.0f, 1.0f, 0.0f, 1.0f, bounds);
 
-    // bottom right
-    map_object_tex_data[10] = std::get<1>(bounds);
-    map_object_tex_data[11] = std::get<2>(bounds);
-
-    renderable_component.set_texture_coords_data(map_object_tex_data, sizeof(GLfloat)*num_floats, false);
+    renderable_component.set_quad_data(map_object_quad_data, sizeof(GLfloat) * RenderableComponent::floats_per_quad, false);
+    renderable_component.set_num_quads_render(1);
 }
 
 void MapObject::set_position(glm::vec2 position) {
     this->position = position;
     VLOG(2) << std::fixed << position.x << " " << position.y;
     regenerate_blockers();
+    Engine::request_redraw();
 }
 
 void MapObject::set_tile(std::pair<int, std::string> tile) {
     load_textures(tile);
-    generate_tex_data(tile);
+    generate_quad_data(tile);
+    Engine::request_redraw();
 }
 
-void MapObject::generate_vertex_data() {
-    //holds the map object's vertex data
-    int num_dimensions(2);
-    int num_floats(num_dimensions * 6); // GL's Triangles
-    GLfloat *map_object_vert_data(nullptr);
-
-    try {
-        map_object_vert_data = new GLfloat[sizeof(GLfloat)*num_floats];
-    }
-    catch(std::bad_alloc& ba) {
-        LOG(ERROR) << "ERROR in MapObject::generate_vertex_data(), cannot allocate memory";
-        return;
-    }
-
-    //bottom left
-    map_object_vert_data[0]  = 0;
-    map_object_vert_data[1]  = 0;
-
-    //top left
-    map_object_vert_data[2]  = 0;
-    map_object_vert_data[3]  = 1;
-
-    //bottom right
-    map_object_vert_data[4]  = 1;
-    map_object_vert_data[5]  = 0;
-
-    //top left
-    map_object_vert_data[6]  = 0;
-    map_object_vert_data[7]  = 1;
-
-    //top right
-    map_object_vert_data[8]  = 1;
-    map_object_vert_data[9]  = 1;
-
-    //bottom right
-    map_object_vert_data[10] = 1;
-    map_object_vert_data[11] = 0;
-
-    renderable_component.set_vertex_data(map_object_vert_data, sizeof(GLfloat)*num_floats, false);
-    renderable_component.set_num_vertices_render(num_floats / num_dimensions);//GL_TRIANGLES being used
+void MapObject::set_render_above_sprites(bool _render_above_sprites) {
+    render_above_sprite = _render_above_sprites;
+    Engine::request_redraw();
 }
 
 void MapObject::set_state_on_moving_start(glm::ivec2) {
@@ -176,23 +176,19 @@ public:
     /// If the object is to be rendered above sprites
     /// @param _render_above_sprites true if the object should be above sprites
     ///
-    virtual void set_render_above_sprites(bool _render_above_sprites) { render_above_sprite = _render_above_sprites; }
+    virtual void set_render_above_sprites(bool _render_above_sprites);
 
     ///
-    /// Generate the texture coordinate data for the object
+    /// Generate the quad data for the object: a tile-sized quad textured
+    /// with the given tile
     ///
-    virtual void generate_tex_data(std::pair<int, std::string> tile);
+    virtual void generate_quad_data(std::pair<int, std::string> tile);
 
     ///
     /// Change the tile of the sprite to that of the given name
     ///
     virtual void set_tile(std::pair<int, std::string> tile);
 
-    ///
-    /// Generate the vertex data for the object
-    ///
-    virtual void generate_vertex_data();
-
     ///
     /// Load the textures that are being used by the object
     ///
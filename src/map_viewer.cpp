@@ -3,6 +3,7 @@
 
 #include <algorithm>
 #include <cmath>
+#include <exception>
 #include <glog/logging.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
@@ -13,20 +14,27 @@
 #include <glm/vec4.hpp>
 #include <memory>
 #include <ostream>
+#include <tuple>
 #include <utility>
 #include <vector>
 
 #include "engine.hpp"
 #include "game_window.hpp"
+#include "gl_state.hpp"
+#include "gpu_memory.hpp"
 #include "gui_manager.hpp"
 #include "layer.hpp"
 #include "map.hpp"
 #include "map_object.hpp"
 #include "map_viewer.hpp"
 #include "object_manager.hpp"
+#include "profiler.hpp"
+#include "render_stats.hpp"
 #include "renderable_component.hpp"
 #include "shader.hpp"
 #include "sprite.hpp"
+#include "texture_atlas.hpp"
+#include "tile_index_map.hpp"
 
 extern "C" {
 #ifdef USE_GL
@@ -46,6 +54,8 @@ MapViewer::MapViewer(GameWindow *window, GUIManager *gui_manager):
 
         resize();
 
+        tile_index_quad.set_memory_category(GPUMemory::Category::MAP_LAYER);
+
         // Set background color and clear buffers
         glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
         glClear(GL_DEPTH_BUFFER_BIT);
@@ -64,6 +74,9 @@ MapViewer::MapViewer(GameWindow *window, GUIManager *gui_manager):
 
 
 MapViewer::~MapViewer() {
+    if (map) {
+        map->event_tile_update.unregister(tile_update_callback);
+    }
     LOG(INFO) << "MapViewer DESTROYED";
 }
 
@@ -74,6 +87,7 @@ void MapViewer::resize() {
     // Set the viewable fragments
     glScissor(0, 0, size.first, size.second);
     glViewport(0, 0, size.first, size.second);
+    window->request_redraw();
 
     if (get_map()) {
         // Readjust the map focus
@@ -82,19 +96,41 @@ void MapViewer::resize() {
 }
 
 void MapViewer::render() {
+    Profiler::Scope profile("MapViewer::render");
+
     CHECK_NOTNULL(map);
 
+    RenderStats &render_stats(RenderStats::get_instance());
+
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    render_map();
+    render_stats.begin_phase(RenderStats::Phase::MAP_LAYERS);
+    render_map(false);
+    // Queued in draw order, then drawn together
     render_objects(false);
     render_sprites();
     render_objects(true);
+    render_stats.begin_phase(RenderStats::Phase::OBJECTS);
+    render_batched();
+    render_stats.begin_phase(RenderStats::Phase::MAP_LAYERS);
+    render_map(true);
+    render_stats.begin_phase(RenderStats::Phase::GUI);
     render_gui();
+    render_stats.end_phase();
 }
 
-void MapViewer::render_map() {
+void MapViewer::render_map(bool above_sprites) {
+    Profiler::Scope profile("MapViewer::render_map");
+
     // Focus onto the player
-    refocus_map();
+    if (!above_sprites) {
+        refocus_map();
+    }
+
+    // Nothing to draw, so don't make pages for it
+    if (!has_layers(above_sprites)) {
+        return;
+    }
+
     // Calculate the projection and modelview matrix for the map
     std::pair<int, int> size(window->get_size());
     glm::mat4 projection_matrix(glm::ortho(0.0f, float(size.first), 0.0f, float(size.second), 0.0f, 1.0f));
@@ -103,6 +139,63 @@ void MapViewer::render_map() {
     model = glm::scale    (model, glm::vec3(Engine::get_actual_tile_size()));
     model = glm::translate(model, glm::vec3(-get_display_x(), -get_display_y(), 0.0f));
 
+    // The tiles on screen; only chunks touching these are drawn
+    glm::ivec2 visible_min(int(std::floor(get_display_x())),
+                           int(std::floor(get_display_y())));
+    glm::ivec2 visible_max(int(std::ceil(get_display_x() + get_display_width())),
+                           int(std::ceil(get_display_y() + get_display_height())));
+
+    if (layer_cache_enabled) {
+        // Only pages on the map are cached
+        glm::ivec2 cache_min(glm::max(visible_min, glm::ivec2(0, 0)));
+        glm::ivec2 cache_max(glm::min(visible_max, glm::ivec2(map->get_width(), map->get_height())));
+
+        if (cache_min.x >= cache_max.x || cache_min.y >= cache_max.y) {
+            return;
+        }
+
+        LayerCache &layer_cache(above_sprites ? above_sprites_cache : below_sprites_cache);
+        bool cached(layer_cache.composite(
+            projection_matrix, model, cache_min, cache_max,
+            Engine::get_actual_tile_size(), glm::ivec2(size.first, size.second),
+            [&] (glm::mat4 page_projection, glm::mat4 page_model, glm::ivec2 page_min, glm::ivec2 page_max) {
+                render_layers(page_projection, page_model, page_min, page_max, above_sprites);
+            }
+        ));
+
+        if (cached) {
+            return;
+        }
+
+        LOG(WARNING) << "Layer caching failed, drawing layers directly";
+        layer_cache_enabled = false;
+    }
+
+    render_layers(projection_matrix, model, visible_min, visible_max, above_sprites);
+}
+
+bool MapViewer::has_layers(bool above_sprites) {
+    for (int layer_id: map->get_layers()) {
+        auto layer(ObjectManager::get_instance().get_object<Layer>(layer_id));
+
+        // Layers without generated data, such as collisions, have no chunks
+        if (layer && layer->is_renderable() && layer->is_above_sprites() == above_sprites
+            && !layer->get_chunks().empty()) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void MapViewer::render_layers(glm::mat4 projection_matrix, glm::mat4 model,
+                              glm::ivec2 visible_min, glm::ivec2 visible_max, bool above_sprites) {
+    Profiler::Scope profile("MapViewer::render_layers");
+
+    if (tile_renderer == TileRenderer::TILE_INDEX && render_map_tile_index(projection_matrix, model, above_sprites)) {
+        return;
+    }
+
     // Draw all the layers, from base to top to get the correct draw order
     int layer_num = 0;
     for (int layer_id: map->get_layers()) {
@@ -111,7 +204,7 @@ void MapViewer::render_map() {
             continue;
         }
 
-        if (!layer->is_renderable()) {
+        if (!layer->is_renderable() || layer->is_above_sprites() != above_sprites) {
             continue;
         }
 
@@ -125,12 +218,12 @@ void MapViewer::render_map() {
         layer_render_component->bind_shader();
 
         //TODO: I don't want to actually expose the shader, put these into wrappers in the shader object
-        glUniformMatrix4fv(glGetUniformLocation(layer_shader->get_program(), "mat_projection"),
+        glUniformMatrix4fv(layer_shader->get_uniform_location("mat_projection"),
                            1,
                            GL_FALSE,
                            glm::value_ptr(layer_render_component->get_projection_matrix()));
 
-        glUniformMatrix4fv(glGetUniformLocation(layer_shader->get_program(), "mat_modelview"),
+        glUniformMatrix4fv(layer_shader->get_uniform_location("mat_modelview"),
                            1,
                            GL_FALSE,
                            glm::value_ptr(layer_render_component->get_modelview_matrix()));
@@ -138,15 +231,56 @@ void MapViewer::render_map() {
 
         layer_render_component->bind_vbos();
 
-        layer_render_component->bind_textures();
-
-        glDrawArrays(GL_TRIANGLES, 0, layer_render_component->get_num_vertices_render());
-
-        //Release the vertex buffers and texppptures
-        layer_render_component->release_textures();
-        layer_render_component->release_vbos();
+        // Tiles on several pages are grouped by page within each chunk,
+        // so each page is bound once and its tiles drawn together
+        std::shared_ptr<TextureAtlas> atlas(layer_render_component->get_texture());
+        int num_pages(atlas ? atlas->get_page_count() : 1);
+
+        for (int page = 0; page < num_pages; ++page) {
+            layer_render_component->set_texture_page(page);
+            layer_render_component->bind_textures();
+
+            // Draw the visible chunks, merging neighbours in the buffer into one call
+            GLint first_quad(0);
+            GLsizei num_quads(0);
+            for (auto &chunk : layer->get_chunks()) {
+                bool visible(chunk.origin.x < visible_max.x && chunk.origin.x + chunk.size.x > visible_min.x &&
+                             chunk.origin.y < visible_max.y && chunk.origin.y + chunk.size.y > visible_min.y);
+
+                if (!visible) {
+                    continue;
+                }
+
+                GLint page_first_quad(chunk.first_quad);
+                GLsizei page_num_quads(chunk.num_quads);
+                if (!chunk.page_num_quads.empty()) {
+                    for (int i = 0; i < page; ++i) {
+                        page_first_quad += chunk.page_num_quads[size_t(i)];
+                    }
+                    page_num_quads = chunk.page_num_quads[size_t(page)];
+                }
+                else if (page > 0) {
+                    continue;
+                }
+
+                if (page_num_quads == 0) {
+                    continue;
+                }
+
+                if (first_quad + num_quads != page_first_quad) {
+                    if (num_quads) {
+                        layer_render_component->draw_quads(first_quad, num_quads);
+                    }
+                    first_quad = page_first_quad;
+                    num_quads = 0;
+                }
+                num_quads += page_num_quads;
+            }
 
-        layer_render_component->release_shader();
+            if (num_quads) {
+                layer_render_component->draw_quads(first_quad, num_quads);
+            }
+        }
 
         //next layer
         layer_num ++;
@@ -154,10 +288,9 @@ void MapViewer::render_map() {
 }
 
 void MapViewer::render_sprites() {
-    //Calculate the projection matrix
-    std::pair<int, int> size = window->get_size();
-    glm::mat4 projection_matrix = glm::ortho(0.0f, float(size.first), 0.0f, float(size.second), 0.0f, 1.0f);
-    //Draw the sprites
+    Profiler::Scope profile("MapViewer::render_sprites");
+
+    //Queue the sprites for the batched draw
     const std::vector<int>& sprites = map->get_sprites();
     ObjectManager& object_manager = ObjectManager::get_instance();
     for (auto it = sprites.begin(); it != sprites.end(); ++it) {
@@ -172,52 +305,15 @@ void MapViewer::render_sprites() {
                 continue;
             }
 
-            RenderableComponent* sprite_render_component = sprite->get_renderable_component();
-
-            //Move sprite to the required position
-            glm::vec3 translator(
-                sprite->get_position().x - get_display_x(),
-                sprite->get_position().y - get_display_y(),
-                0.0f
-            );
-
-            glm::mat4 model(glm::mat4(1.0f));
-            model = glm::scale    (model, glm::vec3(Engine::get_actual_tile_size()));
-            model = glm::translate(model, translator);
-
-            sprite_render_component->set_modelview_matrix(model);
-            sprite_render_component->set_projection_matrix(projection_matrix);
-
-            sprite_render_component->bind_shader();
-
-            Shader* shader = sprite_render_component->get_shader().get();
-
-            if(shader == nullptr) {
-                LOG(ERROR) << "MapViewer::render_map: Shader (sprite_render_component->get_shader()) should not be null";
-                return;
-            }
-
-            //TODO: I don't want to actually expose the shader, put these into wrappers in the shader object
-            glUniformMatrix4fv(glGetUniformLocation(shader->get_program(), "mat_projection"), 1, GL_FALSE,glm::value_ptr(sprite_render_component->get_projection_matrix()));
-
-            glUniformMatrix4fv(glGetUniformLocation(shader->get_program(), "mat_modelview"), 1, GL_FALSE, glm::value_ptr(sprite_render_component->get_modelview_matrix()));
-
-            sprite_render_component->bind_vbos();
-            sprite_render_component->bind_textures();
-
-            glDrawArrays(GL_TRIANGLES, 0, sprite_render_component->get_num_vertices_render());
-
-            sprite_render_component->release_textures();
-            sprite_render_component->release_vbos();
-            sprite_render_component->release_shader();
+            sprite_batcher.add(sprite->get_renderable_component(), sprite->get_position());
         }
     }
 }
+
 void MapViewer::render_objects(bool above_sprite) {
-    //Calculate the projection matrix
-    std::pair<int, int> size = window->get_size();
-    glm::mat4 projection_matrix = glm::ortho(0.0f, float(size.first), 0.0f, float(size.second), 0.0f, 1.0f);
-    //Draw the objects
+    Profiler::Scope profile("MapViewer::render_objects");
+
+    //Queue the objects for the batched draw
     const std::vector<int>& objects = map->get_map_objects();
     ObjectManager& object_manager = ObjectManager::get_instance();
     for(auto it = objects.begin(); it != objects.end(); ++it) {
@@ -234,51 +330,130 @@ void MapViewer::render_objects(bool above_sprite) {
             if(above_sprite ^ object->render_above_sprites())
                 continue;
 
-            RenderableComponent* object_render_component = object->get_renderable_component();
+            sprite_batcher.add(object->get_renderable_component(), object->get_position());
+        }
+    }
+}
 
-            //Move object to the required position
-            glm::vec3 translator(
-                object->get_position().x - get_display_x(),
-                object->get_position().y - get_display_y(),
-                0.0f
-            );
+void MapViewer::render_batched() {
+    Profiler::Scope profile("MapViewer::render_batched");
 
-            glm::mat4 model(glm::mat4(1.0f));
-            model = glm::scale    (model, glm::vec3(Engine::get_actual_tile_size()));
-            model = glm::translate(model, translator);
+    //Calculate the projection matrix
+    std::pair<int, int> size = window->get_size();
+    glm::mat4 projection_matrix = glm::ortho(0.0f, float(size.first), 0.0f, float(size.second), 0.0f, 1.0f);
 
-            object_render_component->set_modelview_matrix(model);
-            object_render_component->set_projection_matrix(projection_matrix);
+    //Positions are baked into the vertices, so one modelview serves every object
+    glm::mat4 model(glm::mat4(1.0f));
+    model = glm::scale    (model, glm::vec3(Engine::get_actual_tile_size()));
+    model = glm::translate(model, glm::vec3(-get_display_x(), -get_display_y(), 0.0f));
 
-            object_render_component->bind_shader();
+    sprite_batcher.render(projection_matrix, model);
+}
 
-            Shader* shader = object_render_component->get_shader().get();
-            if(shader == nullptr) {
-                LOG(ERROR) << "MapViewer::render_map: Shader (object_render_component->get_shader()) should not be null";
-                return;
-            }
+void MapViewer::render_labels() {
+    Profiler::Scope profile("MapViewer::render_labels");
+
+    std::pair<int, int> size = window->get_size();
+    glm::mat4 projection_matrix = glm::ortho(0.0f, float(size.first), 0.0f, float(size.second), 0.0f, 1.0f);
 
-            // TODO: I don't want to actually expose the shader, put these into wrappers in the shader object
-            GLuint mat_projection(glGetUniformLocation(shader->get_program(), "mat_projection"));
-            glUniformMatrix4fv(mat_projection, 1, GL_FALSE,
-                               glm::value_ptr(object_render_component->get_projection_matrix()));
+    //The labels are in tiles, so they scroll with the map
+    glm::mat4 model(glm::mat4(1.0f));
+    model = glm::scale    (model, glm::vec3(Engine::get_actual_tile_size()));
+    model = glm::translate(model, glm::vec3(-get_display_x(), -get_display_y(), 0.0f));
 
-            GLuint mat_modelview(glGetUniformLocation(shader->get_program(), "mat_modelview"));
-            glUniformMatrix4fv(mat_modelview, 1, GL_FALSE,
-                               glm::value_ptr(object_render_component->get_modelview_matrix()));
+    label_layer.render(projection_matrix, model, Engine::get_actual_tile_size());
+}
 
-            object_render_component->bind_vbos();
-            object_render_component->bind_textures();
+bool MapViewer::render_map_tile_index(glm::mat4 projection_matrix, glm::mat4 modelview_matrix, bool above_sprites) {
+    Profiler::Scope profile("MapViewer::render_map_tile_index");
 
-            glDrawArrays(GL_TRIANGLES, 0, object_render_component->get_num_vertices_render());
+    if (!map->is_tile_index_supported()) {
+        return false;
+    }
 
-            object_render_component->release_textures();
-            object_render_component->release_vbos();
-            object_render_component->release_shader();
+    if (!tile_index_quad.get_shader()) {
+        try {
+            tile_index_quad.set_shader(Shader::get_shared("tile_index_shader"));
+        }
+        catch (std::exception &) {
+            LOG(ERROR) << "Failed to create the tile index shader, using the vertex buffers";
+            tile_renderer = TileRenderer::VERTEX_BUFFER;
+            return false;
         }
     }
+
+    // One quad covers the whole map; GL clips it to the screen. Its
+    // texture coordinates are its position in tiles.
+    glm::ivec2 map_size(map->get_width(), map->get_height());
+    if (map_size != tile_index_quad_size) {
+        GLfloat *quad(new GLfloat[RenderableComponent::floats_per_quad]);
+        RenderableComponent::write_quad(quad,
+                                        0.0f, float(map_size.x), 0.0f, float(map_size.y),
+                                        std::make_tuple(0.0f, float(map_size.x), 0.0f, float(map_size.y)));
+
+        tile_index_quad.set_quad_data(quad, sizeof(GLfloat) * RenderableComponent::floats_per_quad, false);
+        tile_index_quad.set_num_quads_render(1);
+        tile_index_quad_size = map_size;
+    }
+
+    Shader *shader(tile_index_quad.get_shader().get());
+    tile_index_quad.bind_shader();
+
+    glUniformMatrix4fv(shader->get_uniform_location("mat_projection"), 1, GL_FALSE, glm::value_ptr(projection_matrix));
+    glUniformMatrix4fv(shader->get_uniform_location("mat_modelview"),  1, GL_FALSE, glm::value_ptr(modelview_matrix));
+    glUniform2f(shader->get_uniform_location("u_map_size"), float(map_size.x), float(map_size.y));
+    glUniform2f(shader->get_uniform_location("u_unit_size"), map->get_atlas_unit_size().x, map->get_atlas_unit_size().y);
+    glUniform2f(shader->get_uniform_location("u_atlas_origin"), map->get_atlas_origin().x, map->get_atlas_origin().y);
+    shader->set_uniform("s_tile_index", 1);
+
+    tile_index_quad.bind_vbos();
+
+    GLState &gl_state(GLState::get_current());
+
+    // Draw all the layers, from base to top to get the correct draw order
+    for (int layer_id: map->get_layers()) {
+        auto layer(ObjectManager::get_instance().get_object<Layer>(layer_id));
+        if (!layer || !layer->is_renderable() || layer->is_above_sprites() != above_sprites) {
+            continue;
+        }
+
+        // Layers without generated data, such as collisions, have no chunks
+        std::shared_ptr<TextureAtlas> atlas(layer->get_renderable_component()->get_texture());
+        if (!atlas || layer->get_chunks().empty()) {
+            continue;
+        }
+
+        gl_state.active_texture(GL_TEXTURE1);
+        gl_state.bind_texture(layer->get_tile_index_map().get_gl_texture());
+        gl_state.active_texture(GL_TEXTURE0);
+        gl_state.bind_texture(atlas->get_gl_texture());
+
+        tile_index_quad.draw_quads();
+    }
+
+    return true;
 }
+
+void MapViewer::set_layer_cache_enabled(bool enabled) {
+    layer_cache_enabled = enabled;
+    if (!enabled) {
+        below_sprites_cache.clear();
+        above_sprites_cache.clear();
+    }
+    window->request_redraw();
+    LOG(INFO) << "Layer caching " << (enabled ? "enabled" : "disabled");
+}
+
+void MapViewer::set_tile_renderer(TileRenderer renderer) {
+    tile_renderer = renderer;
+    window->request_redraw();
+    LOG(INFO) << "Drawing tiles with the "
+              << (renderer == TileRenderer::TILE_INDEX ? "tile index" : "vertex buffer") << " renderer";
+}
+
 void MapViewer::render_gui() {
+    Profiler::Scope profile("MapViewer::render_gui");
+
     //Calculate the projection matrix
     std::pair<int, int> size = window->get_size();
     glm::mat4 projection_matrix = glm::ortho(0.0f, float(size.first), 0.0f, float(size.second), 0.0f, 1.0f);
@@ -300,18 +475,14 @@ void MapViewer::render_gui() {
     }
 
     //TODO: I don't want to actually expose the shader, put these into wrappers in the shader object
-    glUniformMatrix4fv(glGetUniformLocation(gui_shader->get_program(), "mat_projection"), 1, GL_FALSE,glm::value_ptr(gui_render_component->get_projection_matrix()));
+    glUniformMatrix4fv(gui_shader->get_uniform_location("mat_projection"), 1, GL_FALSE,glm::value_ptr(gui_render_component->get_projection_matrix()));
 
-    glUniformMatrix4fv(glGetUniformLocation(gui_shader->get_program(), "mat_modelview"), 1, GL_FALSE, glm::value_ptr(gui_render_component->get_modelview_matrix()));
+    glUniformMatrix4fv(gui_shader->get_uniform_location("mat_modelview"), 1, GL_FALSE, glm::value_ptr(gui_render_component->get_modelview_matrix()));
 
     gui_render_component->bind_vbos();
     gui_render_component->bind_textures();
 
-    glDrawArrays(GL_TRIANGLES, 0, gui_render_component->get_num_vertices_render());
-
-    gui_render_component->release_textures();
-    gui_render_component->release_vbos();
-    gui_render_component->release_shader();
+    gui_render_component->draw_quads();
      
     gui_manager->render_text();
 }
@@ -424,12 +595,30 @@ void MapViewer::refocus_map() {
     } else {
         LOG(INFO) << "MapViewer::refocus_map: No sprites have focus.";
     }
-    Engine::text_updater();
 }
 
 void MapViewer::set_map(Map* new_map) {
+    if (map) {
+        map->event_tile_update.unregister(tile_update_callback);
+    }
+
     //Reset the map and associated data
     map = new_map;
+    below_sprites_cache.clear();
+    above_sprites_cache.clear();
+
+    // Changed tiles must be drawn into the cached pages again
+    if (map) {
+        tile_update_callback = map->event_tile_update.register_callback([&] (int x_pos, int y_pos, int layer_id) {
+            auto layer(ObjectManager::get_instance().get_object<Layer>(layer_id));
+            if (layer) {
+                LayerCache &layer_cache(layer->is_above_sprites() ? above_sprites_cache : below_sprites_cache);
+                layer_cache.invalidate_tile(x_pos, y_pos);
+            }
+            window->request_redraw();
+            return true;
+        });
+    }
     map_focus_object = 0;
     map_display_x = 0.0f;
     map_display_y = 0.0f;
@@ -452,6 +641,7 @@ void MapViewer::set_map_focus_object(int object_id) {
 
         map_focus_object = object_id;
         refocus_map();
+        window->request_redraw();
 
 
         //TODO: add this in again
@@ -471,6 +661,20 @@ Map* MapViewer::get_map() {
     return map;
 }
 
+void MapViewer::set_display_x(float new_display_x) {
+    if (map_display_x != new_display_x) {
+        map_display_x = new_display_x;
+        window->request_redraw();
+    }
+}
+
+void MapViewer::set_display_y(float new_display_y) {
+    if (map_display_y != new_display_y) {
+        map_display_y = new_display_y;
+        window->request_redraw();
+    }
+}
+
 
 glm::ivec2 MapViewer::pixel_to_tile(glm::ivec2 pixel_location) {
     float scale(Engine::get_actual_tile_size());
@@ -1,13 +1,40 @@
 #ifndef MAPVIEWER_H
 #define MAPVIEWER_H
 
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+#include <glm/mat4x4.hpp>
 #include <glm/vec2.hpp>
 
+#include "dispatcher.hpp"
+#include "label_layer.hpp"
+#include "layer_cache.hpp"
+#include "renderable_component.hpp"
+#include "sprite_batcher.hpp"
+
 class GameWindow;
 class GUIManager;
 class Map;
 
 class MapViewer {
+public:
+    ///
+    /// The ways of drawing the map's tile layers
+    ///
+    enum class TileRenderer {
+        ///
+        /// One quad per tile in each layer's vertex buffer, drawn by chunk
+        ///
+        VERTEX_BUFFER,
+
+        ///
+        /// One quad per layer, with the tiles looked up in the layer's
+        /// tile index map by the fragment shader
+        ///
+        TILE_INDEX
+    };
+
+private:
 
     ///
     /// The Map we are currently rendering
@@ -39,27 +66,106 @@ class MapViewer {
     ///
     float map_display_y = 0.0f;
 
+    ///
+    /// Collects sprites and map objects so they can be drawn together
+    ///
+    SpriteBatcher sprite_batcher;
+
+    ///
+    /// The name labels of the sprites
+    ///
+    LabelLayer label_layer;
+
+    ///
+    /// How the tile layers are drawn
+    ///
+    TileRenderer tile_renderer = TileRenderer::VERTEX_BUFFER;
+
+    ///
+    /// The quad covering the map, used by the tile index renderer
+    ///
+    RenderableComponent tile_index_quad;
+
+    ///
+    /// The map size tile_index_quad was generated for
+    ///
+    glm::ivec2 tile_index_quad_size = glm::ivec2(0, 0);
+
+    ///
+    /// Whether the layers are drawn through the layer caches. Off by
+    /// default, as the offscreen pages cost GPU memory and a redraw
+    /// whenever a tile changes.
+    ///
+    bool layer_cache_enabled = false;
+
+    ///
+    /// The layers drawn under the sprites, cached offscreen
+    ///
+    LayerCache below_sprites_cache;
+
+    ///
+    /// The layers drawn over the sprites, cached offscreen
+    ///
+    LayerCache above_sprites_cache;
+
+    ///
+    /// The callback invalidating the caches when the map's tiles change
+    ///
+    Dispatcher<int, int, int>::CallbackID tile_update_callback = 0;
+
     ///
     /// Render the GUI
     ///
     void render_gui();
 
     ///
-    /// Render the map
+    /// Render the map's layers which are under or over the sprites,
+    /// through the layer cache if it is enabled
+    /// @param above_sprites which layers to draw
+    ///
+    void render_map(bool above_sprites);
+
+    ///
+    /// Whether there are any layers to draw under or over the sprites
+    ///
+    bool has_layers(bool above_sprites);
+
+    ///
+    /// Draw the map's layers which are under or over the sprites
+    /// @param projection_matrix the projection matrix
+    /// @param modelview_matrix the modelview matrix, in tiles
+    /// @param visible_min the lowest tile to draw
+    /// @param visible_max one past the highest tile to draw
+    /// @param above_sprites which layers to draw
     ///
-    void render_map();
+    void render_layers(glm::mat4 projection_matrix, glm::mat4 modelview_matrix,
+                       glm::ivec2 visible_min, glm::ivec2 visible_max, bool above_sprites);
 
     ///
-    /// Render objects on the map
+    /// Draw the map's layers with the tile index renderer
+    /// @param projection_matrix the projection matrix
+    /// @param modelview_matrix the modelview matrix, in tiles
+    /// @param above_sprites which layers to draw
+    /// @return false if the renderer is unavailable
+    ///
+    bool render_map_tile_index(glm::mat4 projection_matrix, glm::mat4 modelview_matrix, bool above_sprites);
+
+    ///
+    /// Queue objects on the map for the batched draw
     /// @param above_sprite if the object is to be rendered above the sprites
     ///
     void render_objects(bool above_sprite);
 
     ///
-    /// Render sprites on the map
+    /// Queue sprites on the map for the batched draw
     ///
     void render_sprites();
 
+    ///
+    /// Draw the queued sprites and objects
+    ///
+    void render_batched();
+
 public:
     MapViewer(GameWindow* window, GUIManager* manager);
     ~MapViewer();
@@ -86,6 +192,11 @@ public:
     ///
     void render();
 
+    ///
+    /// Render the sprites' name labels over the map
+    ///
+    void render_labels();
+
     ///
     /// Set the map that the viewer is managing
     /// @param new_map The new map to manage
@@ -105,6 +216,31 @@ public:
 
     GUIManager* get_gui_manager() { return gui_manager; }
 
+    LabelLayer &get_label_layer() { return label_layer; }
+
+    ///
+    /// Set how the map's tile layers are drawn. Maps which the tile index
+    /// renderer cannot draw fall back to the vertex buffers.
+    /// @param renderer the renderer to use from the next frame
+    ///
+    void set_tile_renderer(TileRenderer renderer);
+
+    ///
+    /// Get how the map's tile layers are drawn
+    ///
+    TileRenderer get_tile_renderer() { return tile_renderer; }
+
+    ///
+    /// Set whether the layers are cached offscreen and composited,
+    /// rather than drawn tile by tile every frame
+    ///
+    void set_layer_cache_enabled(bool enabled);
+
+    ///
+    /// Get whether the layers are cached offscreen
+    ///
+    bool is_layer_cache_enabled() { return layer_cache_enabled; }
+
     ///
     /// Rejigg the map in response to the viewport size changing.
     ///
@@ -131,7 +267,7 @@ public:
     /// Set the x display position of the map
     /// @param new_display_x the new display position
     ///
-    void set_display_x(float new_display_x) { map_display_x = new_display_x; }
+    void set_display_x(float new_display_x);
 
     ///
     /// Get the map display bottom y position
@@ -142,7 +278,7 @@ public:
     /// Set the y display position of the map
     /// @param new_display_y the new display position
     ///
-    void set_display_y(float new_display_y) { map_display_y = new_display_y; }
+    void set_display_y(float new_display_y);
 
     ///
     /// converts pixel location inside window to a map tile
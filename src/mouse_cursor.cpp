@@ -16,9 +16,13 @@ extern "C" {
 #include "mouse_cursor.hpp"
 
 #include "game_window.hpp"
+#include "gl_state.hpp"
+#include "gpu_memory.hpp"
+#include "graphics_context.hpp"
 #include "input_manager.hpp"
 #include "lifeline.hpp"
 #include "mouse_input_event.hpp"
+#include "render_stats.hpp"
 #include "renderable_component.hpp"
 #include "shader.hpp"
 #include "texture_atlas.hpp"
@@ -58,6 +62,10 @@ MouseCursor::MouseCursor(GameWindow* window):
 }
 
 MouseCursor::~MouseCursor() {
+    if (GraphicsContext::get_current()) {
+        GLState::get_current().forget_buffer(vbo);
+        GPUMemory::get_current().forget_buffer(vbo);
+    }
     glDeleteBuffers(1, &vbo);
 }
 
@@ -65,10 +73,11 @@ MouseCursor::~MouseCursor() {
 void MouseCursor::display() {
     window->use_context();
 
-    glUseProgram(shader->get_program());
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, atlas->get_gl_texture());
+    GLState &gl_state(GLState::get_current());
+    gl_state.use_program(shader->get_program());
+    gl_state.bind_array_buffer(vbo);
+    gl_state.active_texture(GL_TEXTURE0);
+    gl_state.bind_texture(atlas->get_gl_texture());
 
     if (dirty) {
         std::pair<float,float> lower = window->get_ratio_from_pixels(std::make_pair(x-32, y-32));
@@ -96,6 +105,8 @@ void MouseCursor::display() {
             tex_x2     , tex_y1
         };
         glBufferData(GL_ARRAY_BUFFER, sizeof(vbo_data), vbo_data, GL_DYNAMIC_DRAW);
+        GPUMemory::get_current().set_buffer(vbo, GPUMemory::Category::CURSOR, sizeof(vbo_data));
+        RenderStats::get_instance().record_upload(sizeof(vbo_data));
         dirty = false;
     }
 
@@ -103,8 +114,8 @@ void MouseCursor::display() {
     glVertexAttribPointer(SHADER_LOCATION_POSITION, 2, GL_FLOAT, GL_FALSE, 4 * (GLsizei)sizeof(GLfloat), (GLvoid*)(0 * sizeof(GLfloat)));
     // Texture data.
     glVertexAttribPointer(SHADER_LOCATION_TEXTURE, 2, GL_FLOAT, GL_FALSE, 4 * (GLsizei)sizeof(GLfloat), (GLvoid*)(2 * sizeof(GLfloat)));
-    glEnableVertexAttribArray(SHADER_LOCATION_POSITION);
-    glEnableVertexAttribArray(SHADER_LOCATION_TEXTURE);
+    gl_state.enable_attribute(SHADER_LOCATION_POSITION);
+    gl_state.enable_attribute(SHADER_LOCATION_TEXTURE);
     
     glDisable(GL_DEPTH_TEST);
     glEnable(GL_BLEND);
@@ -112,6 +123,7 @@ void MouseCursor::display() {
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
     glDrawArrays(GL_TRIANGLES, 0, 6);
+    RenderStats::get_instance().record_draw(6);
 
     glEnable(GL_DEPTH_TEST);
 }
@@ -1,6 +1,7 @@
 #include <glog/logging.h>
 #include <string>
 
+#include "engine.hpp"
 #include "object.hpp"
 #include "entitythread.hpp"
 #include "object_manager.hpp"
@@ -28,3 +29,10 @@ void Object::set_id(int new_id) {
 void Object::set_name(std::string new_name) {
     name = new_name;
 }
+
+void Object::set_renderable(bool can_render) {
+    if (renderable != can_render) {
+        renderable = can_render;
+        Engine::request_redraw();
+    }
+}
@@ -84,7 +84,7 @@ public:
     /// Set whether the object can be rendered
     /// @param can_render true if the object can be rendered and false if not
     ///
-    void set_renderable(bool can_render) { renderable = can_render; }
+    void set_renderable(bool can_render);
 
     ///
     /// The Python thread for running scripts in.
@@ -0,0 +1,184 @@
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define PIXEL_OPS_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define PIXEL_OPS_NEON
+#endif
+
+#include "pixel_ops.hpp"
+
+// Divide a product of two bytes by 255, rounding to nearest
+static inline uint8_t div_255(unsigned int x) {
+    x += 128;
+    return uint8_t((x + (x >> 8)) >> 8);
+}
+
+void pixel_ops::copy_rect(void *dst, std::ptrdiff_t dst_pitch,
+                          const void *src, std::ptrdiff_t src_pitch,
+                          std::size_t row_bytes, int rows) {
+    if (rows <= 0 || row_bytes == 0) {
+        return;
+    }
+
+    uint8_t *dst_row(static_cast<uint8_t *>(dst));
+    const uint8_t *src_row(static_cast<const uint8_t *>(src));
+
+    // Whole images and tightly packed cells are one block
+    if (dst_pitch == src_pitch && dst_pitch == std::ptrdiff_t(row_bytes)) {
+        std::memcpy(dst_row, src_row, row_bytes * std::size_t(rows));
+        return;
+    }
+
+    for (int y = 0; y < rows; ++y) {
+        std::memcpy(dst_row, src_row, row_bytes);
+        dst_row += dst_pitch;
+        src_row += src_pitch;
+    }
+}
+
+void pixel_ops::swap_red_blue(uint8_t *dst, const uint8_t *src, std::size_t count) {
+    std::size_t i(0);
+
+#if defined(PIXEL_OPS_SSE2)
+    // Pixels are little-endian words of 0xAABBGGRR or 0xAARRGGBB
+    const __m128i keep_mask(_mm_set1_epi32(int(0xff00ff00)));
+    const __m128i low_mask (_mm_set1_epi32(0x000000ff));
+    for (; i + 4 <= count; i += 4) {
+        __m128i pixels(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i * 4)));
+        __m128i swapped(_mm_or_si128(
+            _mm_and_si128(pixels, keep_mask),
+            _mm_or_si128(_mm_and_si128(_mm_srli_epi32(pixels, 16), low_mask),
+                         _mm_slli_epi32(_mm_and_si128(pixels, low_mask), 16))
+        ));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i * 4), swapped);
+    }
+#elif defined(PIXEL_OPS_NEON)
+    for (; i + 16 <= count; i += 16) {
+        uint8x16x4_t pixels(vld4q_u8(src + i * 4));
+        uint8x16_t first(pixels.val[0]);
+        pixels.val[0] = pixels.val[2];
+        pixels.val[2] = first;
+        vst4q_u8(dst + i * 4, pixels);
+    }
+#endif
+
+    for (; i < count; ++i) {
+        uint8_t first(src[i * 4]);
+        dst[i * 4    ] = src[i * 4 + 2];
+        dst[i * 4 + 1] = src[i * 4 + 1];
+        dst[i * 4 + 2] = first;
+        dst[i * 4 + 3] = src[i * 4 + 3];
+    }
+}
+
+void pixel_ops::premultiply_alpha(uint8_t *dst, const uint8_t *src, std::size_t count) {
+    std::size_t i(0);
+
+#if defined(PIXEL_OPS_SSE2)
+    const __m128i zero(_mm_setzero_si128());
+    const __m128i half(_mm_set1_epi16(128));
+    const __m128i alpha_mask(_mm_set1_epi32(int(0xff000000)));
+
+    // Multiply two pixels widened to 16 bits a channel by their alpha
+    auto multiply([&] (__m128i channels) {
+        __m128i alpha(_mm_shufflehi_epi16(_mm_shufflelo_epi16(channels, _MM_SHUFFLE(3, 3, 3, 3)),
+                                          _MM_SHUFFLE(3, 3, 3, 3)));
+        __m128i product(_mm_add_epi16(_mm_mullo_epi16(channels, alpha), half));
+        return _mm_srli_epi16(_mm_add_epi16(product, _mm_srli_epi16(product, 8)), 8);
+    });
+
+    for (; i + 4 <= count; i += 4) {
+        __m128i pixels(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i * 4)));
+        __m128i low (multiply(_mm_unpacklo_epi8(pixels, zero)));
+        __m128i high(multiply(_mm_unpackhi_epi8(pixels, zero)));
+
+        // Put the original alpha back over alpha * alpha
+        __m128i result(_mm_packus_epi16(low, high));
+        result = _mm_or_si128(_mm_andnot_si128(alpha_mask, result), _mm_and_si128(alpha_mask, pixels));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i * 4), result);
+    }
+#elif defined(PIXEL_OPS_NEON)
+    auto multiply([] (uint8x16_t channel, uint8x16_t alpha) {
+        uint16x8_t low (vmull_u8(vget_low_u8 (channel), vget_low_u8 (alpha)));
+        uint16x8_t high(vmull_u8(vget_high_u8(channel), vget_high_u8(alpha)));
+        low  = vrsraq_n_u16(low,  low,  8);
+        high = vrsraq_n_u16(high, high, 8);
+        return vcombine_u8(vrshrn_n_u16(low, 8), vrshrn_n_u16(high, 8));
+    });
+
+    for (; i + 16 <= count; i += 16) {
+        uint8x16x4_t pixels(vld4q_u8(src + i * 4));
+        pixels.val[0] = multiply(pixels.val[0], pixels.val[3]);
+        pixels.val[1] = multiply(pixels.val[1], pixels.val[3]);
+        pixels.val[2] = multiply(pixels.val[2], pixels.val[3]);
+        vst4q_u8(dst + i * 4, pixels);
+    }
+#endif
+
+    for (; i < count; ++i) {
+        unsigned int alpha(src[i * 4 + 3]);
+        dst[i * 4    ] = div_255(src[i * 4    ] * alpha);
+        dst[i * 4 + 1] = div_255(src[i * 4 + 1] * alpha);
+        dst[i * 4 + 2] = div_255(src[i * 4 + 2] * alpha);
+        dst[i * 4 + 3] = uint8_t(alpha);
+    }
+}
+
+// Scale a byte to a channel of the given maximum, rounding to nearest
+static inline uint16_t scale_byte(unsigned int value, unsigned int max) {
+    return uint16_t((value * max + 127) / 255);
+}
+
+bool pixel_ops::is_opaque(const uint8_t *src, std::size_t count) {
+    // Branchless, so the loop can be vectorised
+    unsigned int alpha(255);
+    for (std::size_t i = 0; i < count; ++i) {
+        alpha &= src[i * 4 + 3];
+    }
+    return alpha == 255;
+}
+
+void pixel_ops::pack_rgba4444(uint16_t *dst, const uint8_t *src, std::size_t count) {
+    for (std::size_t i = 0; i < count; ++i) {
+        dst[i] = uint16_t(scale_byte(src[i * 4    ], 15) << 12 |
+                          scale_byte(src[i * 4 + 1], 15) <<  8 |
+                          scale_byte(src[i * 4 + 2], 15) <<  4 |
+                          scale_byte(src[i * 4 + 3], 15));
+    }
+}
+
+void pixel_ops::pack_rgb565(uint16_t *dst, const uint8_t *src, std::size_t count) {
+    for (std::size_t i = 0; i < count; ++i) {
+        dst[i] = uint16_t(scale_byte(src[i * 4    ], 31) << 11 |
+                          scale_byte(src[i * 4 + 1], 63) <<  5 |
+                          scale_byte(src[i * 4 + 2], 31));
+    }
+}
+
+void pixel_ops::swap_red_blue_rect(void *dst, std::ptrdiff_t dst_pitch,
+                                   const void *src, std::ptrdiff_t src_pitch,
+                                   std::size_t width, int rows) {
+    uint8_t *dst_row(static_cast<uint8_t *>(dst));
+    const uint8_t *src_row(static_cast<const uint8_t *>(src));
+
+    for (int y = 0; y < rows; ++y) {
+        swap_red_blue(dst_row, src_row, width);
+        dst_row += dst_pitch;
+        src_row += src_pitch;
+    }
+}
+
+const char *pixel_ops::get_instruction_set() {
+#if defined(PIXEL_OPS_SSE2)
+    return "SSE2";
+#elif defined(PIXEL_OPS_NEON)
+    return "NEON";
+#else
+    return "scalar";
+#endif
+}
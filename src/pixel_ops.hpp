@@ -0,0 +1,88 @@
+#ifndef PIXEL_OPS_H
+#define PIXEL_OPS_H
+
+#include <cstddef>
+#include <cstdint>
+
+///
+/// Kernels for copying and converting rows of pixels, used by Image,
+/// TextureAtlas, GlyphAtlas and the GLES window.
+///
+/// The RGBA kernels use SSE2 on x86 and NEON on ARM when the compiler
+/// targets them (on the Pi, build with NEON=1), falling back to plain
+/// loops otherwise. Pixels are 4 bytes in memory order, so "RGBA" is
+/// R, G, B then A whatever the byte order of the machine.
+///
+/// Pitches are the distance in bytes from one row to the next and may be
+/// negative, which flips the rows as they are copied.
+///
+namespace pixel_ops {
+    ///
+    /// Copy a rectangle of bytes. Rows are copied with memcpy, and
+    /// contiguous rectangles in one go.
+    ///
+    /// @param dst the first byte of the destination's first row
+    /// @param dst_pitch the distance between destination rows
+    /// @param src the first byte of the source's first row
+    /// @param src_pitch the distance between source rows
+    /// @param row_bytes the number of bytes to copy from each row
+    /// @param rows the number of rows
+    ///
+    void copy_rect(void *dst, std::ptrdiff_t dst_pitch,
+                   const void *src, std::ptrdiff_t src_pitch,
+                   std::size_t row_bytes, int rows);
+
+    ///
+    /// Convert pixels between RGBA and BGRA by swapping the first and
+    /// third bytes. The source and destination may be the same.
+    ///
+    /// @param dst filled with count pixels
+    /// @param src count pixels
+    /// @param count the number of pixels
+    ///
+    void swap_red_blue(uint8_t *dst, const uint8_t *src, std::size_t count);
+
+    ///
+    /// Multiply the colour of RGBA pixels by their alpha, rounding to
+    /// nearest. The source and destination may be the same.
+    ///
+    /// @param dst filled with count pixels
+    /// @param src count pixels
+    /// @param count the number of pixels
+    ///
+    void premultiply_alpha(uint8_t *dst, const uint8_t *src, std::size_t count);
+
+    ///
+    /// Check whether every pixel of an RGBA row is fully opaque.
+    ///
+    bool is_opaque(const uint8_t *src, std::size_t count);
+
+    ///
+    /// Pack RGBA pixels into GL_UNSIGNED_SHORT_4_4_4_4, rounding each
+    /// channel to nearest.
+    ///
+    void pack_rgba4444(uint16_t *dst, const uint8_t *src, std::size_t count);
+
+    ///
+    /// Pack RGBA pixels into GL_UNSIGNED_SHORT_5_6_5, dropping alpha and
+    /// rounding each channel to nearest.
+    ///
+    void pack_rgb565(uint16_t *dst, const uint8_t *src, std::size_t count);
+
+    ///
+    /// Convert a rectangle of pixels between RGBA and BGRA.
+    ///
+    /// @see copy_rect
+    ///
+    void swap_red_blue_rect(void *dst, std::ptrdiff_t dst_pitch,
+                            const void *src, std::ptrdiff_t src_pitch,
+                            std::size_t width, int rows);
+
+    ///
+    /// The instruction set the RGBA kernels were compiled for: "SSE2",
+    /// "NEON" or "scalar"
+    ///
+    const char *get_instruction_set();
+}
+
+#endif
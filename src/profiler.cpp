@@ -0,0 +1,323 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <ctime>
+#include <fstream>
+#include <glog/logging.h>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "asset_loader.hpp"
+#include "profiler.hpp"
+#include "report_format.hpp"
+
+std::atomic<bool> Profiler::enabled(false);
+const size_t Profiler::samples_per_thread;
+const int Profiler::Histogram::bucket_count;
+constexpr std::chrono::seconds Profiler::report_interval;
+constexpr std::chrono::seconds Profiler::dump_interval;
+
+using report_format::quote;
+using report_format::to_microseconds;
+using report_format::to_milliseconds;
+
+
+
+Profiler::Scope::Scope(const char *name):
+    name(name),
+    buffer(nullptr) {
+
+    if (!Profiler::is_enabled()) {
+        return;
+    }
+
+    buffer = Profiler::get_thread_buffer();
+    ++buffer->depth;
+    start = clock::now();
+}
+
+Profiler::Scope::~Scope() {
+    if (!buffer) {
+        return;
+    }
+
+    clock::duration duration(clock::now() - start);
+    int depth(--buffer->depth);
+
+    std::lock_guard<std::mutex> lock(buffer->mutex);
+    buffer->samples[buffer->recorded % samples_per_thread] = Sample{name, start, duration, depth};
+    ++buffer->recorded;
+}
+
+
+
+void Profiler::Histogram::add(clock::duration duration) {
+    // Bucket n holds durations under 2^n microseconds
+    uint64_t microseconds(uint64_t(std::chrono::duration_cast<std::chrono::microseconds>(duration).count()));
+    int bucket(0);
+    while (microseconds > 0 && bucket < bucket_count - 1) {
+        microseconds >>= 1;
+        ++bucket;
+    }
+
+    ++buckets[bucket];
+    ++count;
+    total += duration;
+    max = std::max(max, duration);
+}
+
+Profiler::clock::duration Profiler::Histogram::get_percentile(float percentile) {
+    uint64_t wanted(uint64_t(float(count) * percentile / 100.0f));
+    uint64_t seen(0);
+    for (int bucket = 0; bucket < bucket_count; ++bucket) {
+        seen += buckets[bucket];
+        if (seen > wanted) {
+            return std::min(clock::duration(std::chrono::microseconds(uint64_t(1) << bucket)), max);
+        }
+    }
+    return max;
+}
+
+
+
+Profiler::Profiler():
+    epoch(clock::now()),
+    frame_start(epoch),
+    report_start(epoch),
+    last_dump(epoch - dump_interval) {
+}
+
+Profiler &Profiler::get_instance() {
+    // Lazy instantiation of the global instance
+    static Profiler global_instance;
+
+    return global_instance;
+}
+
+Profiler::ThreadBuffer *Profiler::get_thread_buffer() {
+    // Registered on the thread's first scope, and kept for traces until
+    // its samples are too old to be in one
+    struct Holder {
+        std::shared_ptr<ThreadBuffer> buffer;
+
+        Holder(): buffer(std::make_shared<ThreadBuffer>()) {
+            buffer->samples.resize(samples_per_thread);
+
+            Profiler &profiler(Profiler::get_instance());
+            std::lock_guard<std::mutex> lock(profiler.buffers_mutex);
+            buffer->thread_id = profiler.next_thread_id++;
+            buffer->thread_name = "Thread " + std::to_string(buffer->thread_id);
+            profiler.buffers.push_back(buffer);
+        }
+
+        ~Holder() {
+            std::lock_guard<std::mutex> lock(buffer->mutex);
+            buffer->finished = true;
+        }
+    };
+    static thread_local Holder holder;
+
+    return holder.buffer.get();
+}
+
+void Profiler::set_enabled(bool enabled) {
+    Profiler::enabled.store(enabled, std::memory_order_relaxed);
+    LOG(INFO) << "Profiler " << (enabled ? "enabled" : "disabled");
+}
+
+void Profiler::set_thread_name(const std::string &name) {
+    ThreadBuffer *buffer(get_thread_buffer());
+
+    std::lock_guard<std::mutex> lock(buffer->mutex);
+    buffer->thread_name = name;
+}
+
+void Profiler::aggregate() {
+    clock::time_point oldest_frame(frames.empty() ? frame_start : frames.front().start);
+
+    std::lock_guard<std::mutex> buffers_lock(buffers_mutex);
+    for (auto buffer(std::begin(buffers)); buffer != std::end(buffers);) {
+        std::lock_guard<std::mutex> lock((*buffer)->mutex);
+        ThreadBuffer &thread(**buffer);
+
+        // Samples overwritten before they were seen are lost
+        uint64_t first(std::max(thread.aggregated,
+                                thread.recorded > samples_per_thread ? thread.recorded - samples_per_thread : 0));
+        for (uint64_t i = first; i < thread.recorded; ++i) {
+            const Sample &sample(thread.samples[i % samples_per_thread]);
+            Histogram *&histogram(histograms_by_address[sample.name]);
+            if (!histogram) {
+                histogram = &histograms[sample.name];
+            }
+            histogram->add(sample.duration);
+        }
+        thread.aggregated = thread.recorded;
+
+        bool expired(thread.finished &&
+                     (thread.recorded == 0 ||
+                      thread.samples[(thread.recorded - 1) % samples_per_thread].start < oldest_frame));
+        if (expired) {
+            buffer = buffers.erase(buffer);
+        }
+        else {
+            ++buffer;
+        }
+    }
+}
+
+void Profiler::end_frame() {
+    clock::time_point now(clock::now());
+    clock::duration frame_time(now - frame_start);
+
+    if (!is_enabled()) {
+        frame_start = now;
+        return;
+    }
+
+    frames.push_back(Frame{frame_index++, frame_start, now});
+    while (frames.size() > frames_kept) {
+        frames.pop_front();
+    }
+    frame_start = now;
+
+    aggregate();
+    frame_histogram.add(frame_time);
+
+    if (frame_budget > clock::duration::zero() && frame_time > frame_budget && now - last_dump >= dump_interval) {
+        last_dump = now;
+        std::string path(get_trace_path());
+        LOG(WARNING) << "Profiler: Frame " << frames.back().index << " took " << to_milliseconds(frame_time)
+                     << " ms, over the budget of " << to_milliseconds(frame_budget) << " ms; "
+                     << "writing the last frames to " << path;
+
+        // Writing the file could take longer than the frame did
+        std::shared_ptr<Trace> trace(std::make_shared<Trace>(copy_trace()));
+        AssetLoader::get_instance().run<void>([trace, path] () { write_trace(*trace, path); });
+    }
+
+    if (now - report_start >= report_interval) {
+        report();
+        histograms.clear();
+        histograms_by_address.clear();
+        frame_histogram = Histogram();
+        report_start = now;
+    }
+}
+
+Profiler::Trace Profiler::copy_trace() {
+    Trace trace;
+    trace.epoch = epoch;
+    trace.frames.assign(std::begin(frames), std::end(frames));
+
+    clock::time_point since(frames.empty() ? epoch : frames.front().start);
+
+    std::lock_guard<std::mutex> buffers_lock(buffers_mutex);
+    for (std::shared_ptr<ThreadBuffer> &buffer : buffers) {
+        std::lock_guard<std::mutex> lock(buffer->mutex);
+        trace.threads.push_back(std::make_pair(buffer->thread_id, buffer->thread_name));
+
+        uint64_t first(buffer->recorded > samples_per_thread ? buffer->recorded - samples_per_thread : 0);
+        for (uint64_t i = first; i < buffer->recorded; ++i) {
+            const Sample &sample(buffer->samples[i % samples_per_thread]);
+            if (sample.start >= since) {
+                trace.samples.push_back(std::make_pair(buffer->thread_id, sample));
+            }
+        }
+    }
+
+    return trace;
+}
+
+bool Profiler::write_trace(const Trace &trace, const std::string &path) {
+    std::ofstream file(path);
+    if (file.fail()) {
+        LOG(ERROR) << "Profiler: Could not open \"" << path << "\" to write a trace";
+        return false;
+    }
+
+    bool first_event(true);
+    auto begin_event([&] () -> std::ostream & {
+        file << (first_event ? "\n" : ",\n");
+        first_event = false;
+        return file;
+    });
+
+    file << std::fixed << std::setprecision(3) << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+    begin_event() << "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": 1, \"args\": {\"name\": \"pyland\"}}";
+
+    for (const std::pair<int, std::string> &thread : trace.threads) {
+        begin_event() << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << thread.first
+                      << ", \"args\": {\"name\": " << quote(thread.second) << "}}";
+    }
+
+    for (const std::pair<int, Sample> &thread_sample : trace.samples) {
+        const Sample &sample(thread_sample.second);
+        begin_event() << "{\"name\": " << quote(sample.name) << ", \"ph\": \"X\", \"pid\": 1, "
+                      << "\"tid\": " << thread_sample.first << ", "
+                      << "\"ts\": " << to_microseconds(sample.start - trace.epoch) << ", "
+                      << "\"dur\": " << to_microseconds(sample.duration) << ", "
+                      << "\"args\": {\"depth\": " << sample.depth << "}}";
+    }
+
+    for (const Frame &frame : trace.frames) {
+        begin_event() << "{\"name\": \"Frame " << frame.index << "\", \"ph\": \"i\", \"s\": \"g\", \"pid\": 1, "
+                      << "\"ts\": " << to_microseconds(frame.end - trace.epoch) << "}";
+    }
+
+    file << "\n]}\n";
+    if (file.fail()) {
+        return false;
+    }
+
+    LOG(INFO) << "Profiler: Wrote " << trace.frames.size() << " frames to " << path;
+    return true;
+}
+
+bool Profiler::write_trace(const std::string &path) {
+    return write_trace(copy_trace(), path);
+}
+
+std::string Profiler::get_trace_path() {
+    return "pyland_trace_" + std::to_string(std::time(nullptr)) + "_" + std::to_string(traces_written++) + ".json";
+}
+
+std::string Profiler::write_trace() {
+    std::string path(get_trace_path());
+    return write_trace(path) ? path : "";
+}
+
+void Profiler::report() {
+    if (frame_histogram.count == 0) {
+        return;
+    }
+
+    LOG(INFO) << "Profiler: " << frame_histogram.count << " frames, mean "
+              << to_milliseconds(frame_histogram.total) / double(frame_histogram.count) << " ms, "
+              << "p99 under " << to_milliseconds(frame_histogram.get_percentile(99.0f)) << " ms, "
+              << "max " << to_milliseconds(frame_histogram.max) << " ms";
+
+    // Most total time first
+    std::vector<std::pair<std::string, Histogram *>> phases;
+    for (auto &histogram : histograms) {
+        phases.push_back(std::make_pair(histogram.first, &histogram.second));
+    }
+    std::sort(std::begin(phases), std::end(phases),
+              [] (const std::pair<std::string, Histogram *> &a, const std::pair<std::string, Histogram *> &b) {
+                  return a.second->total > b.second->total;
+              });
+
+    for (auto &phase : phases) {
+        Histogram &histogram(*phase.second);
+        LOG(INFO) << "Profiler:   " << phase.first << ": " << histogram.count << " calls, "
+                  << "total " << to_milliseconds(histogram.total) << " ms, "
+                  << "mean " << to_microseconds(histogram.total) / double(histogram.count) << " us, "
+                  << "p50 under " << to_microseconds(histogram.get_percentile(50.0f)) << " us, "
+                  << "p99 under " << to_microseconds(histogram.get_percentile(99.0f)) << " us, "
+                  << "max " << to_microseconds(histogram.max) << " us";
+    }
+}
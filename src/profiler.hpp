@@ -0,0 +1,303 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+///
+/// A hierarchical profiler of the main loop and the Python API.
+///
+/// Code marks what it does with Scope objects, which record their name,
+/// start and duration into a ring buffer belonging to the thread, so
+/// that threads never wait for each other to record. Scopes nest, and
+/// the nesting is kept in the trace.
+///
+/// The main loop calls end_frame once a frame. This gathers the new
+/// samples into a histogram for each name, which is logged and reset
+/// periodically, and has a trace of the last frames written on an asset
+/// loader worker whenever a frame takes longer than the budget.
+/// write_trace writes the same trace on demand, as Chrome trace event
+/// JSON for chrome://tracing or Perfetto.
+///
+/// Profiling is off until enabled, and then costs two clock reads and
+/// an uncontended lock a scope.
+///
+class Profiler {
+private:
+    struct ThreadBuffer;
+
+public:
+    using clock = std::chrono::steady_clock;
+
+    ///
+    /// Times the scope it is declared in, when the profiler is enabled.
+    ///
+    class Scope {
+    private:
+        const char *name;
+        clock::time_point start;
+
+        ///
+        /// The thread's buffer, or nullptr if the profiler was disabled
+        /// when the scope started
+        ///
+        ThreadBuffer *buffer;
+
+    public:
+        ///
+        /// @param name what is being timed, which must be a string
+        ///        literal as only the pointer is kept. Scopes of the same
+        ///        name are counted together, wherever they are.
+        ///
+        Scope(const char *name);
+        ~Scope();
+
+        Scope(const Scope &) = delete;
+        Scope &operator=(const Scope &) = delete;
+    };
+
+private:
+    struct Sample {
+        const char *name;
+        clock::time_point start;
+        clock::duration duration;
+        int depth;
+    };
+
+    ///
+    /// The samples of one thread
+    ///
+    struct ThreadBuffer {
+        ///
+        /// Guards the samples against the main thread reading them
+        ///
+        std::mutex mutex;
+
+        ///
+        /// The newest samples, overwritten oldest first
+        ///
+        std::vector<Sample> samples;
+
+        ///
+        /// The number of samples ever recorded
+        ///
+        uint64_t recorded = 0;
+
+        ///
+        /// The number of samples added to the histograms
+        ///
+        uint64_t aggregated = 0;
+
+        ///
+        /// The number of scopes open, only touched by the thread
+        ///
+        int depth = 0;
+
+        int thread_id;
+        std::string thread_name;
+
+        ///
+        /// Set when the thread exits
+        ///
+        bool finished = false;
+    };
+
+    ///
+    /// Durations in power-of-two buckets of microseconds
+    ///
+    struct Histogram {
+        static const int bucket_count = 32;
+
+        uint64_t buckets[bucket_count] = {};
+        uint64_t count = 0;
+        clock::duration total = clock::duration::zero();
+        clock::duration max = clock::duration::zero();
+
+        void add(clock::duration duration);
+
+        ///
+        /// Get an upper bound on a percentile, from the buckets
+        ///
+        clock::duration get_percentile(float percentile);
+    };
+
+    struct Frame {
+        uint64_t index;
+        clock::time_point start;
+        clock::time_point end;
+    };
+
+    ///
+    /// A copy of the samples of the last frames, which can be written
+    /// out whilst recording goes on
+    ///
+    struct Trace {
+        clock::time_point epoch;
+
+        ///
+        /// The id and name of each thread
+        ///
+        std::vector<std::pair<int, std::string>> threads;
+
+        ///
+        /// The samples, each with the id of its thread
+        ///
+        std::vector<std::pair<int, Sample>> samples;
+
+        std::vector<Frame> frames;
+    };
+
+    static std::atomic<bool> enabled;
+
+    ///
+    /// The number of samples kept a thread
+    ///
+    static const size_t samples_per_thread = 16384;
+
+    ///
+    /// How often the histograms are logged and reset
+    ///
+    static constexpr std::chrono::seconds report_interval = std::chrono::seconds(10);
+
+    ///
+    /// The shortest time between traces written for frames over budget,
+    /// so that a slow patch does not flood the disk
+    ///
+    static constexpr std::chrono::seconds dump_interval = std::chrono::seconds(10);
+
+    ///
+    /// When the profiler was created, which traces count from
+    ///
+    clock::time_point epoch;
+
+    ///
+    /// The buffers of every thread which has recorded, guarded by
+    /// buffers_mutex
+    ///
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+    std::mutex buffers_mutex;
+    int next_thread_id = 1;
+
+    ///
+    /// Keyed by the scopes' names. The same name may be at more than one
+    /// address, so each address is looked up by name only once.
+    ///
+    std::map<std::string, Histogram> histograms;
+    std::map<const char *, Histogram *> histograms_by_address;
+    Histogram frame_histogram;
+
+    ///
+    /// The last frames, oldest first
+    ///
+    std::deque<Frame> frames;
+    size_t frames_kept = 120;
+    uint64_t frame_index = 0;
+    clock::time_point frame_start;
+
+    clock::duration frame_budget = clock::duration::zero();
+
+    clock::time_point report_start;
+    clock::time_point last_dump;
+    int traces_written = 0;
+
+    Profiler();
+
+    static ThreadBuffer *get_thread_buffer();
+
+    ///
+    /// Add the samples recorded since the last call to the histograms,
+    /// and drop the buffers of threads which have finished.
+    ///
+    void aggregate();
+
+    ///
+    /// Copy the samples of the last frames
+    ///
+    Trace copy_trace();
+
+    ///
+    /// Write a trace as Chrome trace event JSON. This only touches the
+    /// trace, so can run on any thread.
+    ///
+    /// @param path the file to write
+    /// @return whether it was written
+    ///
+    static bool write_trace(const Trace &trace, const std::string &path);
+
+    ///
+    /// Get the path of a new file in the working directory for a trace
+    ///
+    std::string get_trace_path();
+
+public:
+    static Profiler &get_instance();
+
+    ///
+    /// Start or stop recording scopes
+    ///
+    static void set_enabled(bool enabled);
+
+    static bool is_enabled() { return enabled.load(std::memory_order_relaxed); }
+
+    ///
+    /// Name the calling thread in traces
+    ///
+    void set_thread_name(const std::string &name);
+
+    ///
+    /// Set how long a frame may take before a trace is written. Zero,
+    /// the default, never writes one.
+    ///
+    void set_frame_budget(clock::duration budget) { frame_budget = budget; }
+
+    ///
+    /// Set how many of the last frames traces cover
+    ///
+    void set_frames_kept(size_t frames) { frames_kept = frames > 0 ? frames : 1; }
+
+    ///
+    /// Mark the end of a frame. Must be called on the main thread.
+    ///
+    /// Traces of frames over budget are written by an asset loader
+    /// worker, at most once every dump_interval.
+    ///
+    void end_frame();
+
+    ///
+    /// Start the next frame now, without recording the time since the
+    /// last one. Must be called on the main thread. Call this after
+    /// loading, so the first frame does not count the load.
+    ///
+    void reset_frame() { frame_start = clock::now(); }
+
+    ///
+    /// Write the samples of the last frames as Chrome trace event JSON.
+    ///
+    /// @param path the file to write
+    /// @return whether it was written
+    ///
+    bool write_trace(const std::string &path);
+
+    ///
+    /// Write the samples of the last frames to a new file in the
+    /// working directory.
+    ///
+    /// @return the file's path, or "" if it could not be written
+    ///
+    std::string write_trace();
+
+    ///
+    /// Log the histograms
+    ///
+    void report();
+};
+
+#endif
@@ -14,11 +14,13 @@
 #include <vector>
 
 #include "api.hpp"
+#include "api_stats.hpp"
 #include "engine.hpp"
 #include "event_manager.hpp"
 #include "game_time.hpp"
 #include "gil_safe_future.hpp"
 #include "object_manager.hpp"
+#include "profiler.hpp"
 #include "sprite.hpp"
 
 
@@ -28,6 +30,8 @@ Entity::Entity(glm::vec2 start, std::string name, int id):
 }
 
 bool Entity::move(int x, int y) {
+    ApiStats::Scope call("Entity::move");
+
     ++call_number;
 
     auto id = this->id;
@@ -40,6 +44,8 @@ bool Entity::move(int x, int y) {
 }
 
 bool Entity::walkable(int x, int y) {
+    ApiStats::Scope call("Entity::walkable");
+
     ++call_number;
 
     auto id = this->id;
@@ -61,7 +67,26 @@ bool Entity::walkable(int x, int y) {
     //
 }
 
+py::tuple Entity::get_position() {
+    ApiStats::Scope call("Entity::get_position");
+
+    ++call_number;
+
+    auto id = this->id;
+    glm::ivec2 position(GilSafeFuture<glm::ivec2>::execute(
+        [id] (GilSafeFuture<glm::ivec2> position_return) {
+            position_return.set(glm::ivec2(Engine::find_object(id)));
+        },
+        glm::ivec2(start)
+    ));
+
+    // Made on this thread, which holds the GIL
+    return py::make_tuple(position.x, position.y);
+}
+
 void Entity::monologue() {
+    ApiStats::Scope call("Entity::monologue");
+
     auto id = this->id;
     auto name = this->name;
     return GilSafeFuture<void>::execute([id, name] (GilSafeFuture<void>) {
@@ -76,6 +101,8 @@ void Entity::monologue() {
 }
 
 bool Entity::cut(int x, int y) {
+    ApiStats::Scope call("Entity::cut");
+
     ++call_number;
 
     auto id = this->id;
@@ -90,6 +117,8 @@ bool Entity::cut(int x, int y) {
 }
 
 py::list Entity::look(int search_range) {
+    ApiStats::Scope call("Entity::look");
+
     ++call_number;
 
     auto id = this->id;
@@ -114,6 +143,8 @@ py::list Entity::look(int search_range) {
 }
 
 std::string Entity::get_instructions() {
+    ApiStats::Scope call("Entity::get_instructions");
+
     auto id(this->id);
     return GilSafeFuture<std::string>::execute([id] (GilSafeFuture<std::string> instructions_return) {
         auto sprite(ObjectManager::get_instance().get_object<Sprite>(id));
@@ -129,10 +160,14 @@ std::string Entity::get_instructions() {
 
 // Not thread safe for efficiency reasons...
 void Entity::py_print_debug(std::string text) {
+    Profiler::Scope profile("Entity::py_print_debug");
+
     LOG(INFO) << text;
 }
 
 void Entity::py_print_dialogue(std::string text) {
+    ApiStats::Scope call("Entity::py_print_dialogue");
+
     auto name = this->name;
     return GilSafeFuture<void>::execute([name, text] (GilSafeFuture<void>) {
         Engine::print_dialogue(name, text);
@@ -140,12 +175,16 @@ void Entity::py_print_dialogue(std::string text) {
 }
 
 void Entity::__set_game_speed(float game_seconds_per_real_second) {
+    ApiStats::Scope call("Entity::__set_game_speed");
+
     return GilSafeFuture<void>::execute([game_seconds_per_real_second] (GilSafeFuture<void>) {
         EventManager::get_instance().time.set_game_seconds_per_real_second(game_seconds_per_real_second);
     });
 }
 
 void Entity::py_update_status(std::string status){
+    ApiStats::Scope call("Entity::py_update_status");
+
     auto id(this->id);
     return GilSafeFuture<void>::execute([id, status] (GilSafeFuture<void>) {
         Engine::update_status(id, status);
@@ -156,6 +195,8 @@ void Entity::py_update_status(std::string status){
 //
 // but I blame C++
 py::list Entity::get_retrace_steps() {
+    ApiStats::Scope call("Entity::get_retrace_steps");
+
     auto id(this->id);
     return GilSafeFuture<py::list>::execute([id] (GilSafeFuture<py::list> retrace_steps_return) {
         py::list retrace_steps;
@@ -186,6 +227,8 @@ py::list Entity::get_retrace_steps() {
 }
 
 py::object Entity::read_message() {
+    ApiStats::Scope call("Entity::read_message");
+
     auto id(this->id);
     return GilSafeFuture<py::object>::execute([id] (GilSafeFuture<py::object> read_message_return) {
         auto object(ObjectManager::get_instance().get_object<MapObject>(id));
@@ -4,6 +4,7 @@
 #include <boost/python/base_type_traits.hpp>
 #include <boost/python/object_core.hpp>
 #include <boost/python/list.hpp>
+#include <boost/python/tuple.hpp>
 #include <stdint.h>
 
 #include <glm/vec2.hpp>
@@ -85,6 +86,14 @@ class Entity {
         ///
         bool walkable(int x, int y);
 
+        ///
+        /// Get the entity's position.
+        ///
+        /// @return
+        ///     An (x, y) tuple, in tiles from bottom-left.
+        ///
+        py::tuple get_position();
+
         ///
         /// Prints to standard output the name and position of entity.
         ///
@@ -0,0 +1,96 @@
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "api_stats.hpp"
+
+std::atomic<bool> ApiStats::enabled(false);
+
+// The innermost timing scope of each thread
+static thread_local ApiStats::Scope *current_scope(nullptr);
+
+
+
+ApiStats::Scope::Scope(const char *name):
+    profile(name),
+    name(name),
+    timing(ApiStats::is_enabled()),
+    outer(current_scope) {
+
+    if (!timing) {
+        return;
+    }
+
+    current_scope = this;
+    start = clock::now();
+}
+
+ApiStats::Scope::~Scope() {
+    if (!timing) {
+        return;
+    }
+
+    current_scope = outer;
+    ApiStats::get_instance().record(Call{name, queue_wait, run_time, gil_wait, clock::now() - start});
+}
+
+ApiStats::Scope *ApiStats::Scope::get_current() {
+    return current_scope;
+}
+
+std::function<void ()> ApiStats::Scope::time_event(std::function<void ()> event) {
+    run_start = std::make_shared<std::atomic<clock::rep>>(0);
+    queued = clock::now();
+
+    std::shared_ptr<std::atomic<clock::rep>> event_run_start(run_start);
+    return [event, event_run_start] () {
+        event_run_start->store(clock::now().time_since_epoch().count());
+        event();
+    };
+}
+
+void ApiStats::Scope::mark_ready() {
+    ready = clock::now();
+}
+
+void ApiStats::Scope::mark_resumed() {
+    clock::time_point resumed(clock::now());
+
+    // The result is set on the main thread after the event starts, so
+    // its start is visible here. If the event was dropped instead, it
+    // never ran, and the whole wait was in the queue.
+    clock::rep run_start_ticks(run_start ? run_start->load() : 0);
+    clock::time_point started(run_start_ticks != 0 ? clock::time_point(clock::duration(run_start_ticks)) : ready);
+
+    queue_wait += started - queued;
+    run_time += ready - started;
+    gil_wait += resumed - ready;
+}
+
+
+
+ApiStats &ApiStats::get_instance() {
+    // Lazy instantiation of the global instance
+    static ApiStats global_instance;
+
+    return global_instance;
+}
+
+void ApiStats::set_enabled(bool enabled) {
+    ApiStats::enabled = enabled;
+}
+
+void ApiStats::record(const Call &call) {
+    std::lock_guard<std::mutex> lock(calls_mutex);
+    calls.push_back(call);
+}
+
+std::vector<ApiStats::Call> ApiStats::take_calls() {
+    std::lock_guard<std::mutex> lock(calls_mutex);
+    std::vector<Call> taken;
+    taken.swap(calls);
+    return taken;
+}
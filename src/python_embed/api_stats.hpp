@@ -0,0 +1,161 @@
+#ifndef API_STATS_H
+#define API_STATS_H
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "profiler.hpp"
+
+///
+/// Times the calls of the Python API, and where they wait.
+///
+/// A call queues an event for the main loop, releases the GIL and
+/// blocks until the main loop has run the event and set the result,
+/// then takes the GIL back. Each call's time is split into:
+///
+///     queue wait: from being queued until the main loop runs it
+///     run time:   from then until the caller wakes with the result,
+///                 which for a move includes the walk
+///     GIL wait:   from the caller waking until it has the GIL again
+///
+/// Timing is off until enabled, and then costs a few clock reads and a
+/// lock a call.
+///
+class ApiStats {
+public:
+    using clock = std::chrono::steady_clock;
+
+    struct Call {
+        ///
+        /// The method, such as "Entity::move"
+        ///
+        const char *name;
+
+        clock::duration queue_wait;
+        clock::duration run_time;
+        clock::duration gil_wait;
+
+        ///
+        /// The whole call, including converting its arguments and
+        /// result
+        ///
+        clock::duration total;
+    };
+
+    ///
+    /// Profiles an API method, and times it if the API is being timed.
+    /// GilSafeFuture finds the innermost scope on its thread to record
+    /// its waits into.
+    ///
+    class Scope {
+    private:
+        Profiler::Scope profile;
+
+        const char *name;
+        bool timing;
+
+        ///
+        /// The scope this one is nested in, on the same thread
+        ///
+        Scope *outer;
+
+        clock::time_point start;
+        clock::time_point queued;
+        clock::time_point ready;
+
+        ///
+        /// When the main loop started the event, in ticks of the
+        /// clock, or zero if it has not. Shared with the event, which
+        /// may outlive the scope.
+        ///
+        std::shared_ptr<std::atomic<clock::rep>> run_start;
+
+        clock::duration queue_wait = clock::duration::zero();
+        clock::duration run_time = clock::duration::zero();
+        clock::duration gil_wait = clock::duration::zero();
+
+    public:
+        ///
+        /// @param name the method, which must be a string literal as
+        ///        only the pointer is kept
+        ///
+        Scope(const char *name);
+        ~Scope();
+
+        Scope(const Scope &) = delete;
+        Scope &operator=(const Scope &) = delete;
+
+        ///
+        /// @return the innermost scope on this thread which is timing,
+        ///         or nullptr
+        ///
+        static Scope *get_current();
+
+        ///
+        /// Mark an event as queued, and wrap it to mark when it is run.
+        ///
+        std::function<void ()> time_event(std::function<void ()> event);
+
+        ///
+        /// Mark the result as having arrived
+        ///
+        void mark_ready();
+
+        ///
+        /// Mark the GIL as taken back, ending the wait
+        ///
+        void mark_resumed();
+    };
+
+    ///
+    /// Calls a mark of a scope on destruction, if there is a scope, so
+    /// that waits ended by other destructors can be timed.
+    ///
+    class Mark {
+    private:
+        Scope *scope;
+        void (Scope::*mark)();
+
+    public:
+        Mark(Scope *scope, void (Scope::*mark)()): scope(scope), mark(mark) {}
+        ~Mark() { if (scope) { (scope->*mark)(); } }
+
+        Mark(const Mark &) = delete;
+        Mark &operator=(const Mark &) = delete;
+    };
+
+private:
+    static std::atomic<bool> enabled;
+
+    std::mutex calls_mutex;
+
+    ///
+    /// The calls recorded since they were last taken
+    ///
+    std::vector<Call> calls;
+
+    ApiStats() {}
+
+public:
+    static ApiStats &get_instance();
+
+    ///
+    /// Start or stop timing calls
+    ///
+    static void set_enabled(bool enabled);
+
+    static bool is_enabled() { return enabled.load(std::memory_order_relaxed); }
+
+    void record(const Call &call);
+
+    ///
+    /// Take the calls recorded so far, oldest first
+    ///
+    std::vector<Call> take_calls();
+};
+
+#endif
@@ -2,6 +2,7 @@
 #include <future>
 #include <memory>
 
+#include "api_stats.hpp"
 #include "event_manager.hpp"
 #include "lifeline.hpp"
 #include "locks.hpp"
@@ -47,16 +48,27 @@ template <typename T>
 static T _gsf_execute(std::function<void (GilSafeFuture<T>)> callback,
                       std::function<GilSafeFuture<T> (std::shared_ptr<std::promise<T>>)> get_gsf) {
 
+    // Where the call waits is timed when the API is being timed
+    ApiStats::Scope *stats(ApiStats::Scope::get_current());
+
     auto return_value_promise = std::make_shared<std::promise<T>>();
     auto return_value_future = return_value_promise->get_future();
 
     {
         auto gil_safe_return_value = get_gsf(return_value_promise);
-        EventManager::get_instance().add_event(std::bind(callback, gil_safe_return_value));
+        std::function<void ()> event(std::bind(callback, gil_safe_return_value));
+        if (stats) {
+            event = stats->time_event(event);
+        }
+        EventManager::get_instance().add_event(event);
     }
 
     {
+        // Destroyed in reverse, so the GIL is taken back between the
+        // result arriving and the wait ending
+        ApiStats::Mark mark_resumed(stats, &ApiStats::Scope::mark_resumed);
         lock::ThreadGILRelease unlock_thread;
+        ApiStats::Mark mark_ready(stats, &ApiStats::Scope::mark_ready);
         return return_value_future.get();
     }
 }
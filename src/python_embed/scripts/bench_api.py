@@ -0,0 +1,12 @@
+# Calls the API as fast as it answers, for bench/api_throughput.bin.
+# Walking back and forth keeps the character near where it started.
+
+step = east
+
+while True:
+    look(5)
+    get_position()
+    walkable(step)
+    move(step)
+
+    step = (-step[0], -step[1])
@@ -78,6 +78,14 @@ def create_execution_scope(entity, RESTART, STOP, KILL):
 
         return entity.get_retrace_steps()
 
+    def get_position() -> (int, int):
+        """
+        Return the (x, y) position of the calling character,
+        in tiles from the bottom-left of the map.
+        """
+
+        return entity.get_position()
+
     def look(search_range: [(str, int, int)]):
         """
         Return a list of (name, x, y) tuples, representing the
@@ -140,6 +148,7 @@ def create_execution_scope(entity, RESTART, STOP, KILL):
 
         "cut": cut,
         "help": help,
+        "get_position": get_position,
         "get_retrace_steps": get_retrace_steps,
         "look": look,
         "move": move,
@@ -14,6 +14,7 @@ BOOST_PYTHON_MODULE(wrapper_functions) {
         .def("__set_game_speed",  &Entity::__set_game_speed)
         .def("cut",               &Entity::cut)
         .def("get_instructions",  &Entity::get_instructions)
+        .def("get_position",      &Entity::get_position)
         .def("get_retrace_steps", &Entity::get_retrace_steps)
         .def("look",              &Entity::look)
         .def("monologue",         &Entity::monologue)
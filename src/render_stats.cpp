@@ -0,0 +1,378 @@
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <glog/logging.h>
+#include <iomanip>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+extern "C" {
+#ifdef USE_GLES
+#include <EGL/egl.h>
+#include <GLES2/gl2.h>
+#endif
+
+#ifdef USE_GL
+#define GL_GLEXT_PROTOTYPES
+#include <GL/gl.h>
+#endif
+}
+
+#include "callback.hpp"
+#include "gl_state.hpp"
+#include "graphics_context.hpp"
+#include "render_stats.hpp"
+#include "report_format.hpp"
+
+#ifndef GL_TIME_ELAPSED_EXT
+#define GL_TIME_ELAPSED_EXT 0x88BF
+#endif
+
+#ifndef GL_QUERY_RESULT_EXT
+#define GL_QUERY_RESULT_EXT 0x8866
+#endif
+
+#ifndef GL_QUERY_RESULT_AVAILABLE_EXT
+#define GL_QUERY_RESULT_AVAILABLE_EXT 0x8867
+#endif
+
+#ifndef GL_GPU_DISJOINT_EXT
+#define GL_GPU_DISJOINT_EXT 0x8FBB
+#endif
+
+const int RenderStats::phase_count;
+const size_t RenderStats::frames_kept;
+const size_t RenderStats::max_pending_frames;
+
+// The query entry points, which GLES only has as an extension
+static void (*gen_queries)(GLsizei, GLuint *) = nullptr;
+static void (*delete_queries)(GLsizei, const GLuint *) = nullptr;
+static void (*begin_query)(GLenum, GLuint) = nullptr;
+static void (*end_query)(GLenum) = nullptr;
+static void (*get_query_object_uiv)(GLuint, GLenum, GLuint *) = nullptr;
+static void (*get_query_object_ui64v)(GLuint, GLenum, uint64_t *) = nullptr;
+
+#ifdef USE_GLES
+template <typename Function>
+static bool load_function(Function &function, const char *name) {
+    function = reinterpret_cast<Function>(eglGetProcAddress(name));
+    return function != nullptr;
+}
+#endif
+
+using report_format::to_kib;
+using report_format::to_milliseconds;
+
+RenderStats &RenderStats::get_instance() {
+    // Lazy instantiation of the global instance
+    static RenderStats global_instance;
+
+    return global_instance;
+}
+
+const char *RenderStats::get_phase_name(Phase phase) {
+    switch (phase) {
+    case Phase::MAP_LAYERS:
+        return "map layers";
+    case Phase::OBJECTS:
+        return "objects and sprites";
+    case Phase::TEXT:
+        return "text";
+    case Phase::GUI:
+        return "GUI";
+    }
+    return "unknown";
+}
+
+void RenderStats::choose_timing() {
+    timing_chosen = true;
+
+    const GLubyte *extensions_string(glGetString(GL_EXTENSIONS));
+    std::string extensions(extensions_string ? reinterpret_cast<const char *>(extensions_string) : "");
+    extensions = " " + extensions + " ";
+
+#ifdef USE_GLES
+    bool supported(extensions.find(" GL_EXT_disjoint_timer_query ") != std::string::npos
+                   && load_function(gen_queries,            "glGenQueriesEXT")
+                   && load_function(delete_queries,         "glDeleteQueriesEXT")
+                   && load_function(begin_query,            "glBeginQueryEXT")
+                   && load_function(end_query,              "glEndQueryEXT")
+                   && load_function(get_query_object_uiv,   "glGetQueryObjectuivEXT")
+                   && load_function(get_query_object_ui64v, "glGetQueryObjectui64vEXT"));
+#endif
+#ifdef USE_GL
+    bool supported(extensions.find(" GL_ARB_timer_query ") != std::string::npos);
+    if (supported) {
+        gen_queries = glGenQueries;
+        delete_queries = glDeleteQueries;
+        begin_query = glBeginQuery;
+        end_query = glEndQuery;
+        get_query_object_uiv = glGetQueryObjectuiv;
+        get_query_object_ui64v = glGetQueryObjectui64v;
+    }
+#endif
+
+    timing = supported ? Timing::TIMER_QUERY : Timing::FINISH;
+    LOG(INFO) << "Render stats: Timing the GPU with " << (supported ? "timer queries" : "glFinish");
+
+    // Queries belong to the context
+    GraphicsContext::get_current()->register_resource_releaser(Callback<void>([this] () {
+        abandon_queries();
+        if (!free_queries.empty()) {
+            delete_queries(GLsizei(free_queries.size()), free_queries.data());
+            free_queries.clear();
+        }
+        phase_open = false;
+        timing_chosen = false;
+        timing = Timing::NONE;
+    }));
+}
+
+void RenderStats::set_gpu_timing_enabled(bool enabled) {
+    if (!enabled) {
+        end_phase();
+        abandon_queries();
+        gpu_time_known = false;
+    }
+    gpu_timing_enabled = enabled;
+}
+
+void RenderStats::begin_frame() {
+    frame_start = clock::now();
+    texture_binds_at_start = GLState::get_current().get_texture_binds();
+}
+
+void RenderStats::begin_phase(Phase next) {
+    if (!gpu_timing_enabled) {
+        return;
+    }
+    if (!timing_chosen) {
+        choose_timing();
+    }
+
+    end_phase();
+    phase = next;
+    phase_open = true;
+
+    if (timing == Timing::TIMER_QUERY) {
+        GLuint query(0);
+        if (free_queries.empty()) {
+            gen_queries(1, &query);
+        }
+        else {
+            query = free_queries.back();
+            free_queries.pop_back();
+        }
+        begin_query(GL_TIME_ELAPSED_EXT, query);
+        frame_queries.push_back(Query{query, phase});
+    }
+    else {
+        // Wait for the last phase, so only this one is timed
+        glFinish();
+        phase_start = clock::now();
+    }
+}
+
+void RenderStats::end_phase() {
+    if (!phase_open) {
+        return;
+    }
+    phase_open = false;
+
+    if (timing == Timing::TIMER_QUERY) {
+        end_query(GL_TIME_ELAPSED_EXT);
+    }
+    else {
+        glFinish();
+        current.gpu_time[int(phase)] += clock::now() - phase_start;
+    }
+}
+
+void RenderStats::resolve_queries() {
+    while (!pending_queries.empty()) {
+        std::vector<Query> &queries(pending_queries.front());
+
+        // Results arrive in order, so once the frame's last query has
+        // one, they all do
+        if (!queries.empty()) {
+            GLuint available(0);
+            get_query_object_uiv(queries.back().query, GL_QUERY_RESULT_AVAILABLE_EXT, &available);
+            if (!available) {
+                break;
+            }
+        }
+
+        // A disjoint operation, such as the GPU changing clock speed,
+        // spoils the results
+        GLint disjoint(0);
+#ifdef USE_GLES
+        glGetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint);
+#endif
+
+        if (!disjoint) {
+            std::fill(std::begin(gpu_time), std::end(gpu_time), clock::duration::zero());
+            for (const Query &query : queries) {
+                uint64_t nanoseconds(0);
+                get_query_object_ui64v(query.query, GL_QUERY_RESULT_EXT, &nanoseconds);
+                gpu_time[int(query.phase)] +=
+                    std::chrono::duration_cast<clock::duration>(std::chrono::nanoseconds(nanoseconds));
+            }
+            gpu_time_known = true;
+        }
+
+        for (const Query &query : queries) {
+            free_queries.push_back(query.query);
+        }
+        pending_queries.pop_front();
+    }
+}
+
+void RenderStats::abandon_queries() {
+    // A query can be begun again before its result is read
+    for (const Query &query : frame_queries) {
+        free_queries.push_back(query.query);
+    }
+    frame_queries.clear();
+
+    for (const std::vector<Query> &queries : pending_queries) {
+        for (const Query &query : queries) {
+            free_queries.push_back(query.query);
+        }
+    }
+    pending_queries.clear();
+}
+
+void RenderStats::end_frame() {
+    end_phase();
+
+    if (gpu_timing_enabled && timing == Timing::TIMER_QUERY) {
+        pending_queries.push_back(frame_queries);
+        frame_queries.clear();
+
+        while (pending_queries.size() > max_pending_frames) {
+            for (const Query &query : pending_queries.front()) {
+                free_queries.push_back(query.query);
+            }
+            pending_queries.pop_front();
+        }
+        resolve_queries();
+    }
+    else if (gpu_timing_enabled && timing == Timing::FINISH) {
+        std::copy(std::begin(current.gpu_time), std::end(current.gpu_time), std::begin(gpu_time));
+        gpu_time_known = true;
+    }
+
+    current.render_time = clock::now() - frame_start;
+    current.texture_binds = GLState::get_current().get_texture_binds() - texture_binds_at_start;
+    current.gpu_time_known = gpu_time_known;
+    std::copy(std::begin(gpu_time), std::end(gpu_time), std::begin(current.gpu_time));
+
+    frames.push_back(current);
+    while (frames.size() > frames_kept) {
+        frames.pop_front();
+    }
+    current = Frame();
+}
+
+RenderStats::Frame RenderStats::get_last_frame() {
+    return frames.empty() ? Frame() : frames.back();
+}
+
+RenderStats::clock::duration RenderStats::get_render_time_percentile(float percentile) {
+    std::vector<clock::duration> render_times;
+    for (const Frame &frame : frames) {
+        render_times.push_back(frame.render_time);
+    }
+    return report_format::get_percentile(render_times, percentile);
+}
+
+std::string RenderStats::get_summary() {
+    Frame last(get_last_frame());
+
+    std::ostringstream summary;
+    summary << std::fixed << std::setprecision(2)
+            << "Render: " << to_milliseconds(get_render_time_percentile(50.0f)) << " ms p50, "
+            << to_milliseconds(get_render_time_percentile(95.0f)) << " ms p95, "
+            << to_milliseconds(get_render_time_percentile(99.0f)) << " ms p99\n"
+            << last.draw_calls << " draws, " << last.vertices << " vertices\n"
+            << last.texture_binds << " texture binds, " << to_kib(last.upload_bytes) << " uploaded";
+
+    if (!gpu_timing_enabled || !last.gpu_time_known) {
+        summary << "\nGPU: not timed";
+        return summary.str();
+    }
+
+    summary << "\nGPU (" << (timing == Timing::TIMER_QUERY ? "timer queries" : "glFinish") << "):";
+    for (int phase = 0; phase < phase_count; ++phase) {
+        summary << "\n" << get_phase_name(Phase(phase)) << " " << std::setprecision(3)
+                << to_milliseconds(last.gpu_time[phase]) << " ms";
+    }
+    return summary.str();
+}
+
+std::string RenderStats::to_json() {
+    Frame last(get_last_frame());
+
+    // Means over the frames kept
+    double count(double(std::max<size_t>(frames.size(), 1)));
+    double draw_calls(0.0), vertices(0.0), texture_binds(0.0), upload_bytes(0.0);
+    double gpu_frames(0.0), gpu_times[phase_count] = {};
+    for (const Frame &frame : frames) {
+        draw_calls += double(frame.draw_calls);
+        vertices += double(frame.vertices);
+        texture_binds += double(frame.texture_binds);
+        upload_bytes += double(frame.upload_bytes);
+        if (frame.gpu_time_known) {
+            gpu_frames += 1.0;
+            for (int phase = 0; phase < phase_count; ++phase) {
+                gpu_times[phase] += to_milliseconds(frame.gpu_time[phase]);
+            }
+        }
+    }
+
+    std::ostringstream json;
+    json << std::fixed << std::setprecision(3)
+         << "{\n"
+         << "  \"frames\": " << frames.size() << ",\n"
+         << "  \"last_frame\": {"
+         << "\"draw_calls\": " << last.draw_calls << ", "
+         << "\"vertices\": " << last.vertices << ", "
+         << "\"texture_binds\": " << last.texture_binds << ", "
+         << "\"upload_bytes\": " << last.upload_bytes << ", "
+         << "\"render_time_ms\": " << to_milliseconds(last.render_time) << "},\n"
+         << "  \"mean\": {"
+         << "\"draw_calls\": " << draw_calls / count << ", "
+         << "\"vertices\": " << vertices / count << ", "
+         << "\"texture_binds\": " << texture_binds / count << ", "
+         << "\"upload_bytes\": " << upload_bytes / count << "},\n"
+         << "  \"render_time_ms\": {"
+         << "\"p50\": " << to_milliseconds(get_render_time_percentile(50.0f)) << ", "
+         << "\"p95\": " << to_milliseconds(get_render_time_percentile(95.0f)) << ", "
+         << "\"p99\": " << to_milliseconds(get_render_time_percentile(99.0f)) << ", "
+         << "\"max\": " << to_milliseconds(get_render_time_percentile(100.0f)) << "},\n"
+         << "  \"gpu_timing\": \""
+         << (!gpu_timing_enabled ? "none" : timing == Timing::TIMER_QUERY ? "timer query" : "glFinish") << "\",\n"
+         << "  \"gpu_time_ms\": {";
+    for (int phase = 0; phase < phase_count; ++phase) {
+        json << (phase ? ", " : "") << "\"" << get_phase_name(Phase(phase)) << "\": "
+             << (gpu_frames > 0.0 ? gpu_times[phase] / gpu_frames : 0.0);
+    }
+    json << "}\n}\n";
+
+    return json.str();
+}
+
+bool RenderStats::write_json(const std::string &path) {
+    std::ofstream file(path);
+    file << to_json();
+    if (file.fail()) {
+        LOG(ERROR) << "Render stats: Could not write \"" << path << "\"";
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,234 @@
+#ifndef RENDER_STATS_H
+#define RENDER_STATS_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+
+#ifdef USE_GLES
+#include <GLES2/gl2.h>
+#endif
+
+#ifdef USE_GL
+#define GL_GLEXT_PROTOTYPES
+#include <GL/gl.h>
+#endif
+
+///
+/// Counts what each frame asks of GL, and times the phases of drawing
+/// it on the GPU.
+///
+/// Draw calls, vertices and uploads are recorded by the code making
+/// them, and texture binds are read from GLState. These are always
+/// counted, as they cost next to nothing.
+///
+/// GPU timing is only done while enabled. It uses timer queries
+/// (GL_EXT_disjoint_timer_query on GLES, GL_ARB_timer_query on desktop)
+/// where there are any, whose results arrive a few frames late, and
+/// otherwise calls glFinish around each phase and times it on the CPU,
+/// which stalls the pipeline.
+///
+/// The last frames are kept, so that the overlay and automated checks
+/// can read the counters and percentiles of the render time.
+///
+class RenderStats {
+public:
+    using clock = std::chrono::steady_clock;
+
+    ///
+    /// What part of the frame is being drawn. Phases do not nest;
+    /// starting one ends the last.
+    ///
+    enum class Phase {
+        MAP_LAYERS,
+        ///
+        /// Map objects and sprites, which are drawn in one batch
+        ///
+        OBJECTS,
+        TEXT,
+        GUI
+    };
+
+    static const int phase_count = 4;
+
+    ///
+    /// How the GPU time of the phases is measured
+    ///
+    enum class Timing {
+        NONE,
+        TIMER_QUERY,
+        FINISH
+    };
+
+    struct Frame {
+        uint64_t draw_calls = 0;
+        uint64_t vertices = 0;
+        uint64_t texture_binds = 0;
+        uint64_t upload_bytes = 0;
+
+        ///
+        /// The time from begin_frame to end_frame on the CPU
+        ///
+        clock::duration render_time = clock::duration::zero();
+
+        ///
+        /// Whether gpu_time holds anything. With timer queries, it is
+        /// that of the latest frame whose results have arrived.
+        ///
+        bool gpu_time_known = false;
+        clock::duration gpu_time[phase_count] = {};
+    };
+
+private:
+    struct Query {
+        GLuint query;
+        Phase phase;
+    };
+
+    ///
+    /// How many frames are kept
+    ///
+    static const size_t frames_kept = 240;
+
+    ///
+    /// The most frames of queries waiting for their results, after
+    /// which the oldest are abandoned
+    ///
+    static const size_t max_pending_frames = 8;
+
+    Frame current;
+    std::deque<Frame> frames;
+
+    clock::time_point frame_start;
+    uint64_t texture_binds_at_start = 0;
+
+    bool gpu_timing_enabled = false;
+    Timing timing = Timing::NONE;
+    bool timing_chosen = false;
+
+    bool phase_open = false;
+    Phase phase = Phase::MAP_LAYERS;
+    clock::time_point phase_start;
+
+    ///
+    /// The queries of this frame, and of earlier frames waiting for
+    /// their results, oldest first
+    ///
+    std::vector<Query> frame_queries;
+    std::deque<std::vector<Query>> pending_queries;
+    std::vector<GLuint> free_queries;
+
+    ///
+    /// The latest GPU times measured
+    ///
+    bool gpu_time_known = false;
+    clock::duration gpu_time[phase_count] = {};
+
+    RenderStats() {}
+
+    ///
+    /// Find out how the GPU can be timed, once there is a context
+    ///
+    void choose_timing();
+
+    ///
+    /// Collect the results of the queries which have them
+    ///
+    void resolve_queries();
+
+    ///
+    /// Return queries waiting for results to the free list
+    ///
+    void abandon_queries();
+
+public:
+    static RenderStats &get_instance();
+
+    static const char *get_phase_name(Phase phase);
+
+    ///
+    /// Count a draw call
+    ///
+    void record_draw(uint64_t vertices) {
+        ++current.draw_calls;
+        current.vertices += vertices;
+    }
+
+    ///
+    /// Count bytes sent to a buffer or texture
+    ///
+    void record_upload(size_t bytes) { current.upload_bytes += bytes; }
+
+    ///
+    /// Start or stop timing the phases on the GPU
+    ///
+    void set_gpu_timing_enabled(bool enabled);
+
+    bool is_gpu_timing_enabled() { return gpu_timing_enabled; }
+
+    ///
+    /// Get how the GPU is timed, which is only known once timing has
+    /// been enabled with a context current
+    ///
+    Timing get_timing() { return timing; }
+
+    ///
+    /// Start drawing a frame. The counts made since the last frame
+    /// ended are included in it.
+    ///
+    void begin_frame();
+
+    ///
+    /// Start timing a phase, ending the one before
+    ///
+    void begin_phase(Phase phase);
+
+    ///
+    /// Stop timing the current phase
+    ///
+    void end_phase();
+
+    ///
+    /// Finish a frame, after its buffers are swapped
+    ///
+    void end_frame();
+
+    ///
+    /// Get the counts of the last frame finished
+    ///
+    Frame get_last_frame();
+
+    ///
+    /// Get the number of frames kept, which percentiles are over
+    ///
+    size_t get_frame_count() { return frames.size(); }
+
+    ///
+    /// Get a percentile of the render time of the frames kept
+    ///
+    clock::duration get_render_time_percentile(float percentile);
+
+    ///
+    /// Get the counters on one line each, for drawing on screen
+    ///
+    std::string get_summary();
+
+    ///
+    /// Get the counters as JSON, for automated checks: the last frame's
+    /// counts, their means over the frames kept, the render time
+    /// percentiles and the GPU time of each phase
+    ///
+    std::string to_json();
+
+    ///
+    /// Write to_json to a file
+    ///
+    /// @return whether it was written
+    ///
+    bool write_json(const std::string &path);
+};
+
+#endif
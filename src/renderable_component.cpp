@@ -1,8 +1,17 @@
+#include <algorithm>
 #include <memory>
+#include <new>
 #include <ostream>
+#include <tuple>
+#include <vector>
 
 #include <glog/logging.h>
 
+#include "callback.hpp"
+#include "gl_state.hpp"
+#include "gpu_memory.hpp"
+#include "graphics_context.hpp"
+#include "render_stats.hpp"
 #include "shader.hpp"
 #include "texture_atlas.hpp"
 #include "renderable_component.hpp"
@@ -10,150 +19,219 @@
 #define VERTEX_POS_INDX 0
 #define VERTEX_TEXCOORD0_INDX 1
 
+const int RenderableComponent::floats_per_vertex;
+const int RenderableComponent::vertices_per_quad;
+const int RenderableComponent::floats_per_quad;
+const int RenderableComponent::indices_per_quad;
+const int RenderableComponent::max_quads_per_draw;
+
 RenderableComponent::RenderableComponent() {
 
-    //Generate the vertex buffers
-    glGenBuffers(1, &vbo_vertex_id);
-    glGenBuffers(1, &vbo_texture_id);
-    LOG(INFO) << "RenderableComponent::RenderableComponent: Buffers "<< vbo_vertex_id;
-    LOG(INFO) << "RenderableComponent::RenderableComponent: Buffers " << vbo_texture_id;
+    //Generate the vertex buffer
+    glGenBuffers(1, &vbo_quad_id);
+    LOG(INFO) << "RenderableComponent::RenderableComponent: Buffer " << vbo_quad_id;
 }
 
 RenderableComponent::~RenderableComponent() {
-    //Delete the vertex buffers
-    glDeleteBuffers(1, &vbo_vertex_id);
-    glDeleteBuffers(1, &vbo_texture_id);
-
-    delete[] vertex_data;
-    delete[] texture_coords_data;
+    //Delete the vertex buffer
+    if (GraphicsContext::get_current()) {
+        GLState::get_current().forget_buffer(vbo_quad_id);
+        GPUMemory::get_current().forget_buffer(vbo_quad_id);
+    }
+    glDeleteBuffers(1, &vbo_quad_id);
+
+    delete[] quad_data;
 }
-void RenderableComponent::set_vertex_data(GLfloat* new_vertex_data, size_t data_size, bool is_dynamic) {
-    delete[] vertex_data;
-    vertex_data = new_vertex_data;
-    vertex_data_size = data_size;
-
-    //Get current shader
-    GLint id;
-    glGetIntegerv(GL_CURRENT_PROGRAM, &id);
 
-    //Bind our shader
-    bind_shader();
+void RenderableComponent::set_quad_data(GLfloat* new_quad_data, size_t data_size, bool is_dynamic) {
+    delete[] quad_data;
+    quad_data = new_quad_data;
+    quad_data_size = data_size;
 
     //Set up buffer usage
     GLenum usage = GL_STATIC_DRAW;
     if(is_dynamic)
         usage = GL_DYNAMIC_DRAW;
 
-    //Pass in data to the buffer buffer
-    glBindBuffer(GL_ARRAY_BUFFER, vbo_vertex_id);
-    glBufferData(GL_ARRAY_BUFFER, vertex_data_size, vertex_data, usage);
+    //Pass in data to the buffer buffer. Buffer data does not depend on the program.
+    GLState::get_current().bind_array_buffer(vbo_quad_id);
+    glBufferData(GL_ARRAY_BUFFER, quad_data_size, quad_data, usage);
+    GPUMemory::get_current().set_buffer(vbo_quad_id, memory_category, quad_data_size);
+    RenderStats::get_instance().record_upload(quad_data_size);
+}
+
+void RenderableComponent::set_memory_category(GPUMemory::Category category) {
+    memory_category = category;
 
-    //Restore previous program
-    glUseProgram(id);
+    // Move what is already allocated to the new category
+    if (quad_data_size > 0) {
+        GPUMemory::get_current().set_buffer(vbo_quad_id, memory_category, quad_data_size);
+    }
 }
 
 void RenderableComponent::set_texture(std::shared_ptr<TextureAtlas> texture_atlas) {
     this->texture_atlas = texture_atlas;
 }
 
-void RenderableComponent::set_texture_coords_data(GLfloat* new_texture_data, size_t data_size, bool is_dynamic) {
-    delete[] texture_coords_data;
-    texture_coords_data = new_texture_data;
-    texture_coords_data_size = data_size;
-    //Get current shader
-    GLint id;
-    glGetIntegerv(GL_CURRENT_PROGRAM, &id);
-
-    //Bind our shader
-    bind_shader();
+void RenderableComponent::bind_vbos() {
+    GLState &gl_state(GLState::get_current());
 
-    //Set up buffer usage
-    GLenum usage = GL_STATIC_DRAW;
-    if(is_dynamic)
-        usage = GL_DYNAMIC_DRAW;
+    //Bind the quad data and the indices to draw it with.
+    //The attribute pointers are set when drawing.
+    gl_state.bind_array_buffer(vbo_quad_id);
+    gl_state.bind_element_array_buffer(get_quad_index_buffer());
+    gl_state.enable_attribute(VERTEX_POS_INDX);
+    gl_state.enable_attribute(VERTEX_TEXCOORD0_INDX);
 
-    //Pass in data to the buffer buffer
-    glBindBuffer(GL_ARRAY_BUFFER, vbo_texture_id);
-    glBufferData(GL_ARRAY_BUFFER, texture_coords_data_size, texture_coords_data, usage);
+    //set sampler texture to unit 0
+    shader->set_uniform("s_texture", 0);
+}
 
-    //Release shader
-    glUseProgram(id);
+void RenderableComponent::draw_quads(GLint first_quad, GLsizei num_quads) {
+    GLState::get_current().bind_array_buffer(vbo_quad_id);
+    draw_quad_range(first_quad, num_quads);
 }
 
-void RenderableComponent::bind_vbos() {
+void RenderableComponent::draw_quad_range(GLint first_quad, GLsizei num_quads) {
+    GLState::get_current().bind_element_array_buffer(get_quad_index_buffer());
 
-    //Bind the vertex data buffer
-    glBindBuffer(GL_ARRAY_BUFFER, vbo_vertex_id);
-    glVertexAttribPointer(0 /*VERTEX_POS_INDX*/, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
-    glEnableVertexAttribArray(0 /* VERTEX_POS_INDX */);
+    GLsizei stride(floats_per_vertex * GLsizei(sizeof(GLfloat)));
 
-    glBindBuffer(GL_ARRAY_BUFFER, vbo_texture_id);
-    glVertexAttribPointer(1 /* VERTEX_TEXCOORD0_INDX */, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
-    glEnableVertexAttribArray( 1 /*VERTEX_TEXCOORD0_INDX*/);
-    //    glBindAttribLocation(shader->get_program(), glGetAttribLocation(shader->get_program(), "a_position") /*VERTEX_POS_INDX*/, "a_position");
+    // GLES has no base vertex, so long ranges are drawn in pieces
+    // with the attribute pointers moved to the start of each piece
+    while (num_quads > 0) {
+        GLsizei draw_quads(std::min(num_quads, GLsizei(max_quads_per_draw)));
+        size_t first_byte(size_t(first_quad) * vertices_per_quad * size_t(stride));
 
-    //    glBindAttribLocation(shader->get_program(), glGetAttribLocation(shader->get_program(), "a_texCoord")                         /*VERTEX_TEXCOORD0_INDX*/, "a_texCoord");
+        glVertexAttribPointer(VERTEX_POS_INDX,       2, GL_FLOAT, GL_FALSE, stride,
+                              reinterpret_cast<GLvoid *>(first_byte));
+        glVertexAttribPointer(VERTEX_TEXCOORD0_INDX, 2, GL_FLOAT, GL_FALSE, stride,
+                              reinterpret_cast<GLvoid *>(first_byte + 2 * sizeof(GLfloat)));
 
+        glDrawElements(GL_TRIANGLES, draw_quads * indices_per_quad, GL_UNSIGNED_SHORT, nullptr);
+        RenderStats::get_instance().record_draw(uint64_t(draw_quads) * vertices_per_quad);
 
-    //set sampler texture to unit 0
-    glUniform1i(glGetUniformLocation(shader->get_program(), "s_texture"), 0);
+        first_quad += draw_quads;
+        num_quads  -= draw_quads;
+    }
 }
-void RenderableComponent::bind_textures() {
-    glActiveTexture(GL_TEXTURE0);
 
-    //Bind tiles texture
-    glBindTexture(GL_TEXTURE_2D, texture_atlas->get_gl_texture());
+GLuint RenderableComponent::get_quad_index_buffer() {
+    GraphicsContext *context(GraphicsContext::get_current());
+    GLuint index_buffer(context->get_quad_index_buffer());
+
+    if (index_buffer != 0) {
+        return index_buffer;
+    }
+
+    // Two triangles per quad, sharing the top left and bottom right:
+    // 1   3
+    // *---*
+    // | / |
+    // *---*
+    // 0   2
+    std::vector<GLushort> indices(size_t(max_quads_per_draw * indices_per_quad));
+    for (int quad = 0; quad < max_quads_per_draw; ++quad) {
+        GLushort base(GLushort(quad * vertices_per_quad));
+        GLushort *quad_indices(&indices[size_t(quad * indices_per_quad)]);
+
+        quad_indices[0] = GLushort(base + 0);
+        quad_indices[1] = GLushort(base + 1);
+        quad_indices[2] = GLushort(base + 2);
+        quad_indices[3] = GLushort(base + 1);
+        quad_indices[4] = GLushort(base + 3);
+        quad_indices[5] = GLushort(base + 2);
+    }
+
+    glGenBuffers(1, &index_buffer);
+    GLState::get_current().bind_element_array_buffer(index_buffer);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLushort), indices.data(), GL_STATIC_DRAW);
+    context->get_gpu_memory().set_buffer(index_buffer, GPUMemory::Category::SHARED, indices.size() * sizeof(GLushort));
+    RenderStats::get_instance().record_upload(indices.size() * sizeof(GLushort));
+    context->set_quad_index_buffer(index_buffer);
+
+    context->register_resource_releaser(Callback<void>([context] () {
+        GLuint index_buffer(context->get_quad_index_buffer());
+        context->get_gpu_memory().forget_buffer(index_buffer);
+        glDeleteBuffers(1, &index_buffer);
+        context->set_quad_index_buffer(0);
+    }));
+
+    return index_buffer;
 }
 
-void RenderableComponent::release_textures() {
-    glBindTexture(GL_TEXTURE_2D, 0);
+void RenderableComponent::write_quad(GLfloat *data, float left, float right, float bottom, float top,
+                                     std::tuple<float,float,float,float> tex_bounds) {
+    //bottom left
+    data[ 0] = left;
+    data[ 1] = bottom;
+    data[ 2] = std::get<0>(tex_bounds);
+    data[ 3] = std::get<2>(tex_bounds);
+
+    //top left
+    data[ 4] = left;
+    data[ 5] = top;
+    data[ 6] = std::get<0>(tex_bounds);
+    data[ 7] = std::get<3>(tex_bounds);
+
+    //bottom right
+    data[ 8] = right;
+    data[ 9] = bottom;
+    data[10] = std::get<1>(tex_bounds);
+    data[11] = std::get<2>(tex_bounds);
+
+    //top right
+    data[12] = right;
+    data[13] = top;
+    data[14] = std::get<1>(tex_bounds);
+    data[15] = std::get<3>(tex_bounds);
 }
-void RenderableComponent::release_vbos() {
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
 
+GLfloat *RenderableComponent::quads_from_triangles(GLfloat *vertices, GLfloat *tex_coords, size_t num_quads) {
+    GLfloat *data(nullptr);
+    try {
+        data = new GLfloat[num_quads * floats_per_quad];
+    }
+    catch(std::bad_alloc &) {
+        LOG(ERROR) << "RenderableComponent::quads_from_triangles: Cannot allocate memory";
+        return nullptr;
+    }
+
+    // The triangles' vertices 0, 1, 2 and 4 are the quad's corners
+    const int corners[vertices_per_quad] = {0, 1, 2, 4};
+    for (size_t quad = 0; quad < num_quads; ++quad) {
+        for (int corner = 0; corner < vertices_per_quad; ++corner) {
+            size_t src(quad * 12 + size_t(corners[corner]) * 2);
+            size_t dst(quad * floats_per_quad + size_t(corner) * floats_per_vertex);
+
+            data[dst + 0] = vertices[src + 0];
+            data[dst + 1] = vertices[src + 1];
+            data[dst + 2] = tex_coords[src + 0];
+            data[dst + 3] = tex_coords[src + 1];
+        }
+    }
+
+    return data;
 }
 
-void RenderableComponent::bind_shader() {
-    if(!shader)
-        return;
-    glUseProgram(shader->get_program());
-}
+void RenderableComponent::bind_textures() {
+    GLState &gl_state(GLState::get_current());
+    gl_state.active_texture(GL_TEXTURE0);
 
-void RenderableComponent::release_shader() {
-    glUseProgram(0);
+    //Bind tiles texture
+    gl_state.bind_texture(texture_atlas->get_gl_texture(texture_page));
 }
 
-void RenderableComponent::update_vertex_buffer(GLintptr offset, size_t size, GLfloat* data) {
-    //Get current shader
-    GLint id;
-    glGetIntegerv(GL_CURRENT_PROGRAM, &id);
-
-    //Bind our shader
-    bind_shader();
-
-    glBindBuffer(GL_ARRAY_BUFFER, vbo_vertex_id);
-
-    //Update the buffer
-    glBufferSubData(GL_ARRAY_BUFFER, offset, size, data);
-
-    //Release shader
-    glUseProgram(id);
+void RenderableComponent::bind_shader() {
+    if(!shader)
+        return;
+    GLState::get_current().use_program(shader->get_program());
 }
 
-void RenderableComponent::update_texture_buffer(GLintptr offset, size_t size, GLfloat* data) {
-    //Get current shader
-    GLint id;
-    glGetIntegerv(GL_CURRENT_PROGRAM, &id);
-
-    //Bind our shader
-    bind_shader();
-
-    glBindBuffer(GL_ARRAY_BUFFER, vbo_texture_id);
+void RenderableComponent::update_quad_buffer(GLintptr offset, size_t size, GLfloat* data) {
+    GLState::get_current().bind_array_buffer(vbo_quad_id);
 
     //Update the buffer
     glBufferSubData(GL_ARRAY_BUFFER, offset, size, data);
-    LOG(INFO) << " BUF " << vbo_texture_id;
-    //Release shader
-    glUseProgram(id);
+    RenderStats::get_instance().record_upload(size);
 }
-
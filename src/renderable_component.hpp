@@ -2,6 +2,7 @@
 #define RENDERABLE_COMPONENT_H
 
 #include <memory>
+#include <tuple>
 
 //Include GLM
 #define GLM_FORCE_RADIANS
@@ -18,6 +19,8 @@
 #include <GL/gl.h>
 #endif
 
+#include "gpu_memory.hpp"
+
 class Shader;
 class TextureAtlas;
 
@@ -40,30 +43,49 @@ class TextureAtlas;
 ///
 ///
 class RenderableComponent {
+public:
+    ///
+    /// The number of floats per vertex: (x, y, u, v), interleaved.
+    ///
+    static const int floats_per_vertex = 4;
+
+    ///
+    /// The number of vertices per quad: bottom left, top left, bottom
+    /// right, top right.
+    ///
+    static const int vertices_per_quad = 4;
+
+    ///
+    /// The number of floats per quad
+    ///
+    static const int floats_per_quad = floats_per_vertex * vertices_per_quad;
+
     ///
-    /// The buffer holding the vertex data
+    /// The number of indices drawn per quad, as two triangles
     ///
-    GLfloat* vertex_data = nullptr;
+    static const int indices_per_quad = 6;
 
     ///
-    /// The size of the vertex data in bytes
+    /// The most quads one draw call can reach with GL_UNSIGNED_SHORT
+    /// indices. Longer ranges are split.
     ///
-    size_t vertex_data_size = 0;
+    static const int max_quads_per_draw = 65536 / vertices_per_quad;
 
+private:
     ///
-    /// The number of vertices to render
+    /// The buffer holding the interleaved quad data
     ///
-    GLsizei num_vertices_render = 0;
+    GLfloat* quad_data = nullptr;
 
     ///
-    /// The buffer holding the texture coordinate data
+    /// The size of the quad data in bytes
     ///
-    GLfloat* texture_coords_data = nullptr;
+    size_t quad_data_size = 0;
 
     ///
-    /// The size of the texture coordinate buffer in bytes
+    /// The number of quads to render
     ///
-    size_t texture_coords_data_size = 0;
+    GLsizei num_quads_render = 0;
 
     ///
     /// Texture atlas holding abstracted and managed gl texture.
@@ -71,14 +93,19 @@ class RenderableComponent {
     std::shared_ptr<TextureAtlas> texture_atlas;
 
     ///
-    /// The vertex buffer object identifier for the vertex buffer
+    /// The page of the texture atlas the quads are drawn from
     ///
-    GLuint vbo_vertex_id = 0;
+    int texture_page = 0;
 
     ///
-    /// The vertex buffer object identifier for the texture buffer
+    /// The vertex buffer object identifier for the interleaved quad buffer
     ///
-    GLuint vbo_texture_id = 0;
+    GLuint vbo_quad_id = 0;
+
+    ///
+    /// What the vertex buffer's memory is counted as
+    ///
+    GPUMemory::Category memory_category = GPUMemory::Category::MAP_OBJECT;
 
     ///
     /// The width of this component
@@ -140,11 +167,6 @@ public:
     ///
     void bind_shader();
 
-    ///
-    /// Release the shader program from the Opengl pipeline
-    ///
-    void release_shader();
-
     ///
     /// Sets the shader to use for this component
     ///
@@ -156,50 +178,36 @@ public:
     std::shared_ptr<Shader> get_shader() { return shader; }
 
     ///
-    /// Bind the vertex buffers
+    /// Bind the quad buffer and the shared index buffer
     ///
     void bind_vbos();
 
     ///
-    /// Release the vertex buffers
+    /// Get a pointer to the interleaved quad data
     ///
-    void release_vbos();
+    GLfloat* get_quad_data() { return quad_data; }
 
     ///
-    /// Get a pointer to the vertex data
+    /// Get the size of the quad data in bytes
     ///
-    GLfloat* get_vertex_data() { return vertex_data; }
+    size_t get_quad_data_size() { return quad_data_size; }
 
     ///
-    /// Get the size of the vertex data
+    /// Set what the vertex buffer's memory is counted as. Components
+    /// are counted as map objects unless their owner says otherwise.
     ///
-    size_t get_vertex_data_size() { return vertex_data_size; }
+    void set_memory_category(GPUMemory::Category category);
 
     ///
-    /// Set the vertex data to use for this component.
-    /// @param new_vertex_data The new data to use for ther vertices of this object
-    /// @param the size of the data in bytes
+    /// Set the quad data to use for this component. Each quad is four
+    /// interleaved (x, y, u, v) vertices: bottom left, top left,
+    /// bottom right, top right.
+    /// @param new_quad_data The new data to use for the quads of this object
+    /// @param data_size the size of the data in bytes
     /// @param is_dynamic If true, then the data for this buffer will be changed often. If false, it is static geometry
     ///
-    void set_vertex_data(GLfloat* new_vertex_data, size_t data_size,  bool is_dynamic);
-
-    ///
-    /// Get a pointer to the texture coordinate data
-    ///
-    GLfloat* get_texture_coords_data() { return texture_coords_data; }
-
-    ///
-    /// Set the texture coordinate data to use for this component
-    /// @param new_texture_data The new data to use for ther tehadxture coordinates of this object
-    /// @param data_size The size of the data in bytes
-    /// @param is_dynamic If true, then the data for this buffer will be changed often. If false, it is static
-    ///
-    void set_texture_coords_data(GLfloat* new_texture_data, size_t data_size, bool is_dynamic);
+    void set_quad_data(GLfloat* new_quad_data, size_t data_size, bool is_dynamic);
 
-    ///
-    /// Get the texture coords data size
-    ///
-    size_t get_texture_coords_data_size() { return texture_coords_data_size; }
     ///
     /// Set the texture atlas.
     ///
@@ -213,6 +221,14 @@ public:
     ///
     std::shared_ptr<TextureAtlas> get_texture() { return texture_atlas; }
 
+    ///
+    /// Set the page of the texture atlas which bind_textures binds, for
+    /// atlases which spill onto several pages.
+    ///
+    void set_texture_page(int page) { texture_page = page; }
+
+    int get_texture_page() { return texture_page; }
+
 
     ///
     /// Get the width of the component
@@ -232,35 +248,74 @@ public:
     void bind_textures();
 
     ///
-    /// Release the texture objects
+    /// Get the number of quads to render
     ///
-    void release_textures();
+    GLsizei get_num_quads_render() { return num_quads_render; }
 
     ///
-    /// Get the number of vertices to render
+    /// Set the number of quads we need to render
     ///
-    GLsizei get_num_vertices_render() { return num_vertices_render; }
+    void set_num_quads_render(GLsizei num_quads) { num_quads_render = num_quads; }
 
     ///
-    /// Set the number of vertices we need to render
+    /// Draw quads from this component's buffer. The shader, buffers
+    /// and textures must be bound.
+    /// @param first_quad the first quad to draw
+    /// @param num_quads the number of quads to draw
     ///
-    void set_num_vertices_render(GLsizei num_vertices) { num_vertices_render = num_vertices; }
+    void draw_quads(GLint first_quad, GLsizei num_quads);
 
     ///
-    /// Update the texture buffer
-    /// @param offset the byte offset into the buffer
-    /// @param size the size of the data to put into the buffer in bytes
-    /// @param data the data to put into the buffer
+    /// Draw all the quads to render
     ///
-    void update_texture_buffer(GLintptr offset, size_t size, GLfloat* data);
+    void draw_quads() { draw_quads(0, num_quads_render); }
 
     ///
-    /// Update the vertex buffer
+    /// Update the quad buffer
     /// @param offset the byte offset into the buffer
     /// @param size the size of the data to put into the buffer in bytes
     /// @param data the data to put into the buffer
     ///
-    void update_vertex_buffer(GLintptr offset, size_t size, GLfloat* data);
+    void update_quad_buffer(GLintptr offset, size_t size, GLfloat* data);
+
+    ///
+    /// Draw quads from the interleaved quad buffer bound to
+    /// GL_ARRAY_BUFFER, using the shared index buffer.
+    /// @param first_quad the first quad to draw
+    /// @param num_quads the number of quads to draw
+    ///
+    static void draw_quad_range(GLint first_quad, GLsizei num_quads);
+
+    ///
+    /// Get the static index buffer shared by the current context's
+    /// renderables, creating it in that context if needed. Its indices
+    /// draw quads as two triangles.
+    ///
+    static GLuint get_quad_index_buffer();
+
+    ///
+    /// Write one quad into an interleaved buffer.
+    /// @param data where to write the quad's floats_per_quad floats
+    /// @param left the left of the quad
+    /// @param right the right of the quad
+    /// @param bottom the bottom of the quad
+    /// @param top the top of the quad
+    /// @param tex_bounds the texture coordinates (left, right, bottom, top),
+    ///        as given by TextureAtlas::index_to_coords
+    ///
+    static void write_quad(GLfloat *data, float left, float right, float bottom, float top,
+                           std::tuple<float,float,float,float> tex_bounds);
+
+    ///
+    /// Convert the 6-vertex triangle pairs used by the GUI into quads.
+    /// The triangles must be wound bottom left, top left, bottom right,
+    /// top left, top right, bottom right.
+    /// @param vertices 12 position floats per quad
+    /// @param tex_coords 12 texture coordinate floats per quad
+    /// @param num_quads the number of quads
+    /// @return A new[]-allocated buffer of num_quads quads, or nullptr
+    ///
+    static GLfloat *quads_from_triangles(GLfloat *vertices, GLfloat *tex_coords, size_t num_quads);
 
 };
 
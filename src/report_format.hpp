@@ -0,0 +1,107 @@
+#ifndef REPORT_FORMAT_H
+#define REPORT_FORMAT_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+
+///
+/// Helpers for the statistics the profiler, RenderStats, GPUMemory and
+/// the benchmark programs log and write.
+///
+namespace report_format {
+    ///
+    /// Quote text as a JSON string, escaping quotes, backslashes and
+    /// control characters.
+    ///
+    inline std::string quote(const std::string &text) {
+        std::string quoted("\"");
+        for (char c : text) {
+            switch (c) {
+            case '"':
+                quoted += "\\\"";
+                break;
+            case '\\':
+                quoted += "\\\\";
+                break;
+            case '\b':
+                quoted += "\\b";
+                break;
+            case '\f':
+                quoted += "\\f";
+                break;
+            case '\n':
+                quoted += "\\n";
+                break;
+            case '\r':
+                quoted += "\\r";
+                break;
+            case '\t':
+                quoted += "\\t";
+                break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    char escaped[7];
+                    std::snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned char>(c));
+                    quoted += escaped;
+                }
+                else {
+                    quoted += c;
+                }
+                break;
+            }
+        }
+        return quoted + "\"";
+    }
+
+    ///
+    /// @return The duration in milliseconds.
+    ///
+    template <typename Rep, typename Period>
+    double to_milliseconds(std::chrono::duration<Rep, Period> duration) {
+        return std::chrono::duration<double, std::milli>(duration).count();
+    }
+
+    ///
+    /// @return The duration in microseconds.
+    ///
+    template <typename Rep, typename Period>
+    double to_microseconds(std::chrono::duration<Rep, Period> duration) {
+        return std::chrono::duration<double, std::micro>(duration).count();
+    }
+
+    ///
+    /// @return A size in bytes as KiB to one decimal place, such as
+    /// "1.5 KiB".
+    ///
+    inline std::string to_kib(uint64_t bytes) {
+        std::ostringstream kib;
+        kib << std::fixed << std::setprecision(1) << double(bytes) / 1024.0 << " KiB";
+        return kib.str();
+    }
+
+    ///
+    /// Get a percentile of some values, by the nearest rank.
+    ///
+    /// @param values the values, in any order
+    /// @param percentile from 0 to 100
+    /// @return the value, or a value-initialised one if there are none
+    ///
+    template <typename T>
+    T get_percentile(std::vector<T> values, float percentile) {
+        if (values.empty()) {
+            return T();
+        }
+        std::sort(std::begin(values), std::end(values));
+        size_t index(size_t(float(values.size() - 1) * percentile / 100.0f + 0.5f));
+        return values[std::min(index, values.size() - 1)];
+    }
+}
+
+#endif
@@ -1,8 +1,12 @@
 #ifndef RESOURCE_CACHE_H
 #define RESOURCE_CACHE_H
 
+#include <cstddef>
+#include <cstdint>
 #include <exception>
 #include <glog/logging.h>
+#include <iterator>
+#include <list>
 #include <map>
 #include <memory>
 #include <ostream>
@@ -19,6 +23,13 @@ class GraphicsContext;
 ///
 /// Res must be a sub-class of CacheableResource.
 ///
+/// So that resources survive between their users, such as the tilesets
+/// of one challenge and the next, the cache keeps the ones it has handed
+/// out most recently alive. Retained resources which nothing else uses
+/// are released, least recently used first, once their memory exceeds
+/// the retention budget. Resources can also be pinned, to keep them
+/// alive until unpinned whatever the budget.
+///
 template<typename Res>
 class ResourceCache {
 private:
@@ -28,9 +39,50 @@ private:
     ///
     std::weak_ptr<ResourceCache<Res>> weak_this;
     ///
+    /// The context the resources belong to, for reporting.
+    ///
+    GraphicsContext *context;
+    ///
     /// Map from names to resource pointers.
     ///
     std::map<std::string, std::weak_ptr<Res>> resources;
+    ///
+    /// Resources kept alive by the cache, most recently used first.
+    ///
+    std::list<std::shared_ptr<Res>> retained;
+    ///
+    /// The place of each retained resource in retained, by name.
+    ///
+    std::map<std::string, typename std::list<std::shared_ptr<Res>>::iterator> retained_by_name;
+    ///
+    /// Resources kept alive until unpinned.
+    ///
+    std::map<std::string, std::shared_ptr<Res>> pinned;
+
+    ///
+    /// The number of requests for a resource which was loaded, which
+    /// was not, and the number of resources released by the budget.
+    ///
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;
+
+    ///
+    /// The most memory, in bytes, the cache keeps alive for resources
+    /// nothing else uses.
+    ///
+    static size_t retention_budget;
+
+    ///
+    /// Mark a resource as the most recently used, keeping it alive.
+    ///
+    void retain(const std::shared_ptr<Res> &resource);
+
+    ///
+    /// Release the least recently used resources which nothing else
+    /// uses until the rest are within the budget.
+    ///
+    void trim();
 public:
     ///
     /// Creates a cache and registers it with the context for clean-up.
@@ -38,6 +90,11 @@ public:
     ResourceCache(GraphicsContext* context);
     ~ResourceCache();
 
+    ///
+    /// Create a cache which its resources can point back to.
+    ///
+    static std::shared_ptr<ResourceCache<Res>> create(GraphicsContext* context);
+
     ///
     /// Get a resource from a resource name.
     ///
@@ -50,12 +107,51 @@ public:
     ///
     std::shared_ptr<Res> get_resource(const std::string resource_name);
 
+    ///
+    /// Check whether a resource is loaded, without loading it.
+    ///
+    bool has_resource(const std::string resource_name);
+
     ///
     /// Removes a resource from the cache. Does not destroy it.
     ///
     void remove_resource(const std::string resource_name);
+
+    ///
+    /// Load a resource, if needed, and keep it alive until unpinned.
+    ///
+    void pin(const std::string resource_name);
+
+    ///
+    /// Let a pinned resource be released like any other.
+    ///
+    void unpin(const std::string resource_name);
+
+    ///
+    /// Log the hit, miss and eviction counts and retained memory.
+    ///
+    /// @param kind the kind of resource held, such as "texture atlas"
+    ///
+    void report(const std::string &kind);
+
+    ///
+    /// Set the most memory each cache of this kind of resource keeps
+    /// alive for resources nothing else uses.
+    ///
+    static void set_retention_budget(size_t bytes) { retention_budget = bytes; }
+
+    static size_t get_retention_budget() { return retention_budget; }
 };
 
+// The Pi shares its memory with the GPU
+#ifdef USE_GLES
+template<typename Res>
+size_t ResourceCache<Res>::retention_budget(16 * 1024 * 1024);
+#else
+template<typename Res>
+size_t ResourceCache<Res>::retention_budget(64 * 1024 * 1024);
+#endif
+
 // //////////////////////////////////////////////////////////////
 // //////////////////////// CURRENT BUGS ////////////////////////
 // //////////////////////////////////////////////////////////////
@@ -64,16 +160,27 @@ public:
 //      it's just weird.
 
 template<typename Res>
-ResourceCache<Res>::ResourceCache(GraphicsContext*):
-    weak_this() {
+ResourceCache<Res>::ResourceCache(GraphicsContext* context):
+    weak_this(),
+    context(context) {
     LOG(INFO) << "Created resource cache " << this;
 }
 
 template<typename Res>
 ResourceCache<Res>::~ResourceCache() {
     // We do not clean up the resources here. This will be done by
-    // shared pointers after they are no longer needed.
-    VLOG(1) << "Destroyed resource cache " << this;
+    // shared pointers after they are no longer needed, which for the
+    // retained and pinned ones is now.
+    VLOG(1) << "Destroyed resource cache " << this << ": "
+            << hits << " hits, " << misses << " misses, " << evictions << " evictions";
+}
+
+template<typename Res>
+std::shared_ptr<ResourceCache<Res>> ResourceCache<Res>::create(GraphicsContext* context) {
+    std::shared_ptr<ResourceCache<Res>> resource_cache = std::make_shared<ResourceCache<Res>>(context);
+    // Tell it who it is.
+    resource_cache->weak_this = std::weak_ptr<ResourceCache<Res>>(resource_cache);
+    return resource_cache;
 }
 
 template<typename Res>
@@ -82,10 +189,12 @@ std::shared_ptr<Res> ResourceCache<Res>::get_resource(const std::string resource
 
     if (resources.count(resource_name) == 0) {
         // First-time load.
+        ++misses;
         try {
             std::shared_ptr<Res> resource = Res::new_shared(resource_name);
             resources.insert(std::make_pair(resource_name, std::weak_ptr<Res>(resource)));
             resource->resource_cache = weak_this;
+            retain(resource);
             return resource;
         }
         catch (std::exception &e) {
@@ -100,14 +209,89 @@ std::shared_ptr<Res> ResourceCache<Res>::get_resource(const std::string resource
 
         // Some say we should check the pointer, but we don't keep dead
         // weak pointers lying around for us to care about.
+        ++hits;
+        retain(resource);
         return resource;
     }
 }
 
+template<typename Res>
+bool ResourceCache<Res>::has_resource(const std::string resource_name) {
+    return resources.count(resource_name) != 0;
+}
+
 template<typename Res>
 void ResourceCache<Res>::remove_resource(const std::string resource_name) {
     LOG(INFO) << "Removing resource \"" << resource_name << "\" from cache " << this;
     resources.erase(resource_name);
 }
 
+template<typename Res>
+void ResourceCache<Res>::retain(const std::shared_ptr<Res> &resource) {
+    auto place(retained_by_name.find(resource->resource_name));
+    if (place != std::end(retained_by_name)) {
+        retained.splice(std::begin(retained), retained, place->second);
+    }
+    else {
+        retained.push_front(resource);
+        retained_by_name[resource->resource_name] = std::begin(retained);
+    }
+
+    trim();
+}
+
+template<typename Res>
+void ResourceCache<Res>::trim() {
+    // Only resources held by nothing else count, as releasing the others
+    // would not free anything. Their sizes can change after they are
+    // loaded, such as when atlases are merged, so are measured afresh.
+    size_t idle_bytes(0);
+    for (const std::shared_ptr<Res> &resource : retained) {
+        if (resource.use_count() == 1) {
+            idle_bytes += resource->get_resource_bytes();
+        }
+    }
+
+    auto place(std::end(retained));
+    while (idle_bytes > retention_budget && place != std::begin(retained)) {
+        --place;
+        if (place->use_count() != 1) {
+            continue;
+        }
+
+        std::shared_ptr<Res> evicted(*place);
+        idle_bytes -= evicted->get_resource_bytes();
+        retained_by_name.erase(evicted->resource_name);
+        place = retained.erase(place);
+        ++evictions;
+
+        VLOG(1) << "Evicting resource \"" << evicted->resource_name << "\" from cache " << this;
+    }
+}
+
+template<typename Res>
+void ResourceCache<Res>::pin(const std::string resource_name) {
+    pinned[resource_name] = get_resource(resource_name);
+}
+
+template<typename Res>
+void ResourceCache<Res>::unpin(const std::string resource_name) {
+    pinned.erase(resource_name);
+}
+
+template<typename Res>
+void ResourceCache<Res>::report(const std::string &kind) {
+    trim();
+
+    size_t retained_bytes(0);
+    for (const std::shared_ptr<Res> &resource : retained) {
+        retained_bytes += resource->get_resource_bytes();
+    }
+
+    LOG(INFO) << "Context " << context << " " << kind << " cache: "
+              << hits << " hits, " << misses << " misses, " << evictions << " evictions, "
+              << retained.size() << " retained (" << retained_bytes / 1024 << " KiB), "
+              << pinned.size() << " pinned";
+}
+
 #endif
@@ -15,6 +15,8 @@
 #endif
 
 #include "cacheable_resource.hpp"
+#include "gl_state.hpp"
+#include "graphics_context.hpp"
 #include "resource_cache.hpp"
 #include "shader.hpp"
 
@@ -102,11 +104,18 @@ Shader::Shader(const std::string vs, const std::string fs): CacheableResource()
         throw Shader::LoadException("Unable to link shader program");
     }
 
+    resolve_uniform_locations();
+
     loaded = true;
 }
 
 
 Shader::~Shader() {
+    // The context is gone if this is run by its resource releasers
+    if (GraphicsContext::get_current()) {
+        GLState::get_current().forget_program(program_obj);
+    }
+
     glDeleteShader(fragment_shader);
     glDeleteShader(vertex_shader);
     glDeleteProgram(program_obj);
@@ -163,4 +172,59 @@ void Shader::bind_location_to_attribute(GLuint location, const char* variable) {
 
 void Shader::link() {
     glLinkProgram(program_obj);
+    resolve_uniform_locations();
+}
+
+
+void Shader::resolve_uniform_locations() {
+    uniform_locations.clear();
+    uniform_int_values.clear();
+
+    GLint num_uniforms(0);
+    GLint max_name_length(0);
+    glGetProgramiv(program_obj, GL_ACTIVE_UNIFORMS,           &num_uniforms);
+    glGetProgramiv(program_obj, GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_name_length);
+
+    std::string name_buffer(std::string::size_type(max_name_length + 1), '\0');
+    for (GLint i = 0; i < num_uniforms; ++i) {
+        GLsizei name_length(0);
+        GLint size;
+        GLenum type;
+        glGetActiveUniform(program_obj, GLuint(i), max_name_length + 1, &name_length, &size, &type, &name_buffer[0]);
+
+        std::string name(name_buffer, 0, std::string::size_type(name_length));
+        uniform_locations[name] = glGetUniformLocation(program_obj, name.c_str());
+    }
+}
+
+
+GLint Shader::get_uniform_location(const std::string &name) {
+    auto location(uniform_locations.find(name));
+
+    if (location != std::end(uniform_locations)) {
+        GLState::get_current().record_avoided();
+        return location->second;
+    }
+
+    // Not active, or not reported as such (arrays); remember either way
+    GLint new_location(glGetUniformLocation(program_obj, name.c_str()));
+    uniform_locations[name] = new_location;
+    return new_location;
+}
+
+
+void Shader::set_uniform(const std::string &name, GLint value) {
+    GLint location(get_uniform_location(name));
+    if (location == -1) {
+        return;
+    }
+
+    auto old_value(uniform_int_values.find(location));
+    if (old_value != std::end(uniform_int_values) && old_value->second == value) {
+        GLState::get_current().record_avoided();
+        return;
+    }
+
+    glUniform1i(location, value);
+    uniform_int_values[location] = value;
 }
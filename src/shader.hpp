@@ -1,6 +1,7 @@
 #ifndef SHADER_H
 #define SHADER_H
 
+#include <map>
 #include <memory>
 #include <stdexcept>
 #include <string>
@@ -51,6 +52,22 @@ private:
     ///
     GLuint vertex_shader = 0;
 
+    ///
+    /// Uniform locations, resolved when the program is linked.
+    /// Names which are not active uniforms map to -1.
+    ///
+    std::map<std::string, GLint> uniform_locations;
+
+    ///
+    /// The last value given to each integer (sampler) uniform, by location.
+    ///
+    std::map<GLint, GLint> uniform_int_values;
+
+    ///
+    /// Look up and store the locations of all active uniforms.
+    ///
+    void resolve_uniform_locations();
+
     /// This function loads the shaders
     /// @param type The type of the shader: fragment or vertex
     /// @param src The source file for the shader's source
@@ -117,6 +134,23 @@ public:
     /// Wrapper around glLinkProgram
     ///
     void link();
+
+    ///
+    /// Cached replacement for glGetUniformLocation.
+    ///
+    /// @param name The name of the uniform.
+    /// @return The location of the uniform, or -1 if it is not active.
+    ///
+    GLint get_uniform_location(const std::string &name);
+
+    ///
+    /// Set an integer uniform, such as a sampler's texture unit, skipping
+    /// the call if it already holds the value. The program must be in use.
+    ///
+    /// @param name The name of the uniform.
+    /// @param value The value to set.
+    ///
+    void set_uniform(const std::string &name, GLint value);
 };
 
 
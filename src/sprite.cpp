@@ -21,8 +21,6 @@
 #include "map_viewer.hpp"
 #include "object_manager.hpp"
 #include "sprite.hpp"
-#include "text.hpp"
-#include "text_font.hpp"
 #include "texture_atlas.hpp"
 #include "walkability.hpp"
 
@@ -31,6 +29,11 @@ glm::vec2 pos_to_status (glm::vec2 position) {
     return glm::vec2(position.x + 0.05, position.y + 0.75);
 }
 
+// The label hangs from the middle of the bottom of the sprite
+glm::vec2 pos_to_label (glm::vec2 position) {
+    return glm::vec2(position.x + 0.5, position.y);
+}
+
 Sprite::Sprite(glm::ivec2 position,
                std::string name,
                Walkability walkability,
@@ -43,16 +46,7 @@ Sprite::Sprite(glm::ivec2 position,
     instructions("Try thinking about the problem in a different way.") {
 
         // Setting up sprite text
-        TextFont myfont = Engine::get_game_font();
-
-        object_text = new Text(Engine::get_map_viewer()->get_window(), myfont, true);
-        object_text->set_bloom_radius(6);
-        object_text->set_text(name);
-        object_text->resize(100,100);
-
-        object_text->align_centre();
-        object_text->align_at_origin(true);
-        object_text->vertical_align_top();
+        Engine::get_map_viewer()->get_label_layer().set_label(get_id(), name, pos_to_label(position));
 
         auto status_icon(std::make_shared<MapObject>(
             pos_to_status(position),
@@ -93,8 +87,9 @@ Sprite::Sprite(glm::ivec2 position,
 
 Sprite::~Sprite() {
     ObjectManager::get_instance().remove_object(focus_icon_id);
-    // TODO: Smart pointers
-    delete object_text;
+    if (Engine::get_map_viewer()) {
+        Engine::get_map_viewer()->get_label_layer().remove_label(get_id());
+    }
     ObjectManager::get_instance().remove_object(status_icon_id);
     LOG(INFO) << "Sprite destructed";
 }
@@ -118,6 +113,7 @@ bool Sprite::add_to_inventory(int new_object_id) {
 
 void Sprite::set_position(glm::vec2 position) {
     MapObject::set_position(position);
+    Engine::get_map_viewer()->get_label_layer().move_label(get_id(), pos_to_label(position));
 
     for (int item_id : get_inventory()) {
         ObjectManager::get_instance().get_object<MapObject>(item_id)->set_position(position);
@@ -11,8 +11,6 @@
 #include "map_object.hpp"
 #include "walkability.hpp"
 
-class Text;
-
 enum class Sprite_Status {NOTHING, RUNNING, STOPPED, FAILED, KILLED};
 
 ///
@@ -27,11 +25,6 @@ private:
     unsigned int inventory_limit = 1;
 
 protected:
-    ///
-    /// The text to display above the object
-    ///
-    Text *object_text = nullptr;
-
     ///
     /// The status text for the object
     ///
@@ -93,18 +86,6 @@ public:
 
     virtual ~Sprite();
 
-    ///
-    /// Get the object's text to display
-    /// @return the object's text
-    ///
-    Text* get_object_text() { return object_text; }
-
-    ///
-    /// Set the object's text to be displayed
-    /// @param _object_text the object's text
-    ///
-    void set_object_text(Text* _object_text) {object_text = _object_text; }
-
     ///
     /// add map_object to sprites inventory
     ///
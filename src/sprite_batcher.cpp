@@ -0,0 +1,107 @@
+#define GLM_FORCE_RADIANS
+
+#include <exception>
+#include <glm/gtc/type_ptr.hpp>
+#include <glog/logging.h>
+#include <memory>
+#include <ostream>
+
+#include "gl_state.hpp"
+#include "gpu_memory.hpp"
+#include "graphics_context.hpp"
+#include "render_stats.hpp"
+#include "renderable_component.hpp"
+#include "shader.hpp"
+#include "sprite_batcher.hpp"
+#include "texture_atlas.hpp"
+
+SpriteBatcher::SpriteBatcher() {
+    glGenBuffers(1, &vbo_id);
+    LOG(INFO) << "SpriteBatcher::SpriteBatcher: Buffer " << vbo_id;
+
+    try {
+        shader = Shader::get_shared("tile_shader");
+    }
+    catch (std::exception &e) {
+        LOG(ERROR) << "SpriteBatcher::SpriteBatcher: Failed to create the shader";
+    }
+}
+
+SpriteBatcher::~SpriteBatcher() {
+    if (GraphicsContext::get_current()) {
+        GLState::get_current().forget_buffer(vbo_id);
+        GPUMemory::get_current().forget_buffer(vbo_id);
+    }
+    glDeleteBuffers(1, &vbo_id);
+}
+
+void SpriteBatcher::add(RenderableComponent *renderable_component, glm::vec2 position) {
+    GLfloat *quads(renderable_component->get_quad_data());
+    auto texture_atlas(renderable_component->get_texture());
+
+    if (!quads || !texture_atlas) {
+        return;
+    }
+
+    GLsizei num_quads(renderable_component->get_num_quads_render());
+    GLuint gl_texture(texture_atlas->get_gl_texture(renderable_component->get_texture_page()));
+
+    // Extend the last run if the texture is unchanged, so that order is kept
+    if (batches.empty() || batches.back().gl_texture != gl_texture) {
+        GLint first_quad(GLint(quad_data.size() / RenderableComponent::floats_per_quad));
+        batches.push_back(Batch{gl_texture, first_quad, 0});
+    }
+    batches.back().num_quads += num_quads;
+
+    GLsizei num_vertices(num_quads * RenderableComponent::vertices_per_quad);
+    for (GLsizei i = 0; i < num_vertices; ++i) {
+        GLfloat *vertex(&quads[i * RenderableComponent::floats_per_vertex]);
+
+        quad_data.push_back(vertex[0] + position.x);
+        quad_data.push_back(vertex[1] + position.y);
+        quad_data.push_back(vertex[2]);
+        quad_data.push_back(vertex[3]);
+    }
+}
+
+void SpriteBatcher::render(glm::mat4 projection_matrix, glm::mat4 modelview_matrix) {
+    if (batches.empty()) {
+        return;
+    }
+
+    if (!shader) {
+        LOG(ERROR) << "SpriteBatcher::render: Shader should not be null";
+        quad_data.clear();
+        batches.clear();
+        return;
+    }
+
+    GLState &gl_state(GLState::get_current());
+    gl_state.use_program(shader->get_program());
+
+    glUniformMatrix4fv(shader->get_uniform_location("mat_projection"), 1, GL_FALSE, glm::value_ptr(projection_matrix));
+    glUniformMatrix4fv(shader->get_uniform_location("mat_modelview"),  1, GL_FALSE, glm::value_ptr(modelview_matrix));
+    shader->set_uniform("s_texture", 0);
+
+    // Respecifying the whole store lets the driver orphan last frame's
+    // buffer rather than wait for its draws to finish
+    gl_state.bind_array_buffer(vbo_id);
+    glBufferData(GL_ARRAY_BUFFER, quad_data.size() * sizeof(GLfloat), quad_data.data(), GL_STREAM_DRAW);
+    GPUMemory::get_current().set_buffer(vbo_id, GPUMemory::Category::MAP_OBJECT, quad_data.size() * sizeof(GLfloat));
+    RenderStats::get_instance().record_upload(quad_data.size() * sizeof(GLfloat));
+
+    gl_state.enable_attribute(0 /* VERTEX_POS_INDX */);
+    gl_state.enable_attribute(1 /* VERTEX_TEXCOORD0_INDX */);
+
+    gl_state.active_texture(GL_TEXTURE0);
+    for (auto &batch : batches) {
+        gl_state.bind_texture(batch.gl_texture);
+        RenderableComponent::draw_quad_range(batch.first_quad, batch.num_quads);
+    }
+
+    VLOG(3) << "SpriteBatcher::render: " << quad_data.size() / RenderableComponent::floats_per_quad
+            << " quads in " << batches.size() << " draw calls";
+
+    quad_data.clear();
+    batches.clear();
+}
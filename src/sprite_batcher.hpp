@@ -0,0 +1,108 @@
+#ifndef SPRITE_BATCHER_H
+#define SPRITE_BATCHER_H
+
+#include <memory>
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+#include <glm/mat4x4.hpp>
+#include <glm/vec2.hpp>
+
+#ifdef USE_GLES
+#include <GLES2/gl2.h>
+#endif
+
+#ifdef USE_GL
+#define GL_GLEXT_PROTOTYPES
+#include <GL/gl.h>
+#endif
+
+class RenderableComponent;
+class Shader;
+
+///
+/// Collects the geometry of many small renderables (sprites and map
+/// objects) into one streaming vertex buffer so that they can be drawn
+/// with a handful of draw calls instead of one per object.
+///
+/// Quads are stored in RenderableComponent's interleaved layout, with
+/// the positions already offset by the object's position in tiles, and
+/// drawn with the shared quad index buffer. This replaces the
+/// per-object modelview matrix: a single modelview is used to scale
+/// tiles to pixels and scroll the map for the whole batch.
+///
+/// Draw order is preserved. Consecutive quads which share a GL texture
+/// are merged into one draw call, so a map whose objects all come from
+/// the merged super atlas draws in a single call.
+///
+class SpriteBatcher {
+    ///
+    /// A run of consecutive quads which share a texture.
+    ///
+    struct Batch {
+        GLuint gl_texture;
+        GLint first_quad;
+        GLsizei num_quads;
+    };
+
+    ///
+    /// Interleaved quad data queued for this frame.
+    ///
+    std::vector<GLfloat> quad_data;
+
+    ///
+    /// Runs of quads, in draw order.
+    ///
+    std::vector<Batch> batches;
+
+    ///
+    /// The streaming vertex buffer object the batch is uploaded into.
+    ///
+    GLuint vbo_id = 0;
+
+    ///
+    /// The shader used to draw the batch. This uses the same tile shader
+    /// as the individual objects.
+    ///
+    std::shared_ptr<Shader> shader;
+
+public:
+    SpriteBatcher();
+    ~SpriteBatcher();
+
+    SpriteBatcher(const SpriteBatcher &) = delete;
+    SpriteBatcher &operator=(const SpriteBatcher &) = delete;
+
+    ///
+    /// Queue a renderable's geometry for drawing.
+    ///
+    /// @param renderable_component
+    ///     The component holding the object's quad data, in tiles
+    ///     relative to the object.
+    ///
+    /// @param position
+    ///     The position of the object, in tiles from the bottom-left
+    ///     of the map.
+    ///
+    void add(RenderableComponent *renderable_component, glm::vec2 position);
+
+    ///
+    /// Upload and draw everything queued since the last call,
+    /// then clear the queue.
+    ///
+    /// @param projection_matrix
+    ///     The projection matrix to draw with.
+    ///
+    /// @param modelview_matrix
+    ///     The modelview matrix to draw with, shared by the whole batch.
+    ///
+    void render(glm::mat4 projection_matrix, glm::mat4 modelview_matrix);
+
+    ///
+    /// @return The number of draw calls the next render() will make.
+    ///
+    size_t get_num_batches() { return batches.size(); }
+};
+
+#endif
@@ -0,0 +1,170 @@
+#include <boost/filesystem.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "asset_cache.hpp"
+#include "catch.hpp"
+#include "image.hpp"
+
+static void write_file(const std::string &path, const std::string &contents) {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file << contents;
+}
+
+///
+/// A temporary directory holding a source image and name file, which is
+/// also used as the cache directory
+///
+struct CacheDirectory {
+    std::string path;
+    std::string image_path;
+
+    CacheDirectory() {
+        char pattern[] = "/tmp/pyland-asset-cache-XXXXXX";
+        path = mkdtemp(pattern);
+        image_path = path + "/tiles.png";
+
+        write_file(image_path, "not really a PNG, but only its bytes are hashed");
+        write_file(AssetCache::get_names_path(image_path), "grass: 0\nwall: 1\n");
+        AssetCache::set_directory(path);
+
+        // As if they were made long ago, so they are not hashed on load
+        // unless they change
+        std::time_t made(std::time(nullptr) - 3600);
+        boost::filesystem::last_write_time(image_path, made);
+        boost::filesystem::last_write_time(AssetCache::get_names_path(image_path), made);
+    }
+
+    ~CacheDirectory() {
+        AssetCache::set_directory("../cache");
+        boost::filesystem::remove_all(path);
+    }
+};
+
+static AssetCache::Atlas make_atlas(const std::string &image_path) {
+    AssetCache::Atlas atlas;
+    atlas.unit_w = 16;
+    atlas.unit_h = 16;
+    atlas.unit_columns = 2;
+    atlas.unit_rows = 1;
+    atlas.max_texture_size = 2048;
+
+    AssetCache::Source source;
+    source.image_path = image_path;
+    source.width = 32;
+    source.height = 16;
+    source.index_offset = 3;
+    source.names_to_indexes["grass"] = 0;
+    source.names_to_indexes["wall"] = 1;
+    atlas.sources.push_back(source);
+
+    for (int page = 0; page < 2; ++page) {
+        Image image(32, 16, true);
+        for (int y = 0; y < image.store_height; ++y) {
+            for (int x = 0; x < image.store_width; ++x) {
+                image[y][x].r = uint8_t(x);
+                image[y][x].g = uint8_t(y);
+                image[y][x].b = uint8_t(page);
+                image[y][x].a = 255;
+            }
+        }
+        atlas.pages.push_back(image);
+    }
+    return atlas;
+}
+
+SCENARIO("Baked atlases are mapped back while their sources are unchanged", "[asset_cache]" ) {
+
+    GIVEN("an atlas baked from a source") {
+        CacheDirectory directory;
+        AssetCache::Atlas saved(make_atlas(directory.image_path));
+        REQUIRE(AssetCache::save(saved));
+
+        std::vector<std::string> image_paths{directory.image_path};
+
+        WHEN("loaded again") {
+            AssetCache::Atlas loaded;
+            bool hit(AssetCache::load(image_paths, 16, 16, 2048, loaded));
+
+            THEN("the layout and names are as saved") {
+                REQUIRE(hit);
+                REQUIRE(loaded.unit_columns == 2);
+                REQUIRE(loaded.unit_rows == 1);
+                REQUIRE(loaded.sources.size() == 1);
+                REQUIRE(loaded.sources[0].image_path == directory.image_path);
+                REQUIRE(loaded.sources[0].width == 32);
+                REQUIRE(loaded.sources[0].index_offset == 3);
+                REQUIRE(loaded.sources[0].names_to_indexes == saved.sources[0].names_to_indexes);
+            }
+
+            THEN("the pages hold the saved pixels") {
+                REQUIRE(hit);
+                REQUIRE(loaded.pages.size() == 2);
+                for (size_t page = 0; page < loaded.pages.size(); ++page) {
+                    Image &image(loaded.pages[page]);
+                    REQUIRE(image.width == 32);
+                    REQUIRE(image.height == 16);
+
+                    size_t mismatches(0);
+                    for (int y = 0; y < image.store_height; ++y) {
+                        for (int x = 0; x < image.store_width; ++x) {
+                            mismatches += image[y][x].r != saved.pages[page][y][x].r;
+                            mismatches += image[y][x].g != saved.pages[page][y][x].g;
+                            mismatches += image[y][x].b != saved.pages[page][y][x].b;
+                        }
+                    }
+                    REQUIRE(mismatches == 0);
+                }
+            }
+        }
+
+        WHEN("loaded for another texture size") {
+            AssetCache::Atlas loaded;
+
+            THEN("it misses") {
+                REQUIRE(!AssetCache::load(image_paths, 16, 16, 4096, loaded));
+            }
+        }
+
+        WHEN("the source image is edited") {
+            write_file(directory.image_path, "a different image");
+            AssetCache::Atlas loaded;
+
+            THEN("it misses") {
+                REQUIRE(!AssetCache::load(image_paths, 16, 16, 2048, loaded));
+            }
+        }
+
+        WHEN("the name file is edited without changing its size") {
+            write_file(AssetCache::get_names_path(directory.image_path), "grass: 1\nwall: 0\n");
+            AssetCache::Atlas loaded;
+
+            THEN("it misses") {
+                REQUIRE(!AssetCache::load(image_paths, 16, 16, 2048, loaded));
+            }
+        }
+
+        WHEN("the source image is rewritten unchanged") {
+            write_file(directory.image_path, "not really a PNG, but only its bytes are hashed");
+            AssetCache::Atlas loaded;
+
+            THEN("it still hits") {
+                REQUIRE(AssetCache::load(image_paths, 16, 16, 2048, loaded));
+            }
+        }
+
+        WHEN("the source image is removed") {
+            boost::filesystem::remove(directory.image_path);
+            AssetCache::Atlas loaded;
+
+            THEN("it misses") {
+                REQUIRE(!AssetCache::load(image_paths, 16, 16, 2048, loaded));
+            }
+        }
+    }
+}
@@ -0,0 +1,160 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+
+#include "catch.hpp"
+#include "etc1.hpp"
+
+// Decode ETC1 blocks as a GL driver would, following the
+// OES_compressed_ETC1_RGB8_texture specification
+static std::vector<uint8_t> decode(const std::vector<uint8_t> &encoded, int width, int height) {
+    static const int modifier_tables[8][2] = {
+        { 2,   8}, { 5,  17}, { 9,  29}, {13,  42},
+        {18,  60}, {24,  80}, {33, 106}, {47, 183}
+    };
+
+    std::vector<uint8_t> rgb(std::size_t(width * height * 3));
+    const uint8_t *block_bytes(encoded.data());
+
+    for (int block_y = 0; block_y < height; block_y += 4) {
+        for (int block_x = 0; block_x < width; block_x += 4) {
+            uint64_t bits(0);
+            for (int byte = 0; byte < 8; ++byte) {
+                bits = bits << 8 | *block_bytes++;
+            }
+
+            int bases[2][3];
+            for (int channel = 0; channel < 3; ++channel) {
+                int shift(59 - channel * 8);
+                if (bits >> 33 & 1) {
+                    int first(int(bits >> shift & 31));
+                    int delta(int(bits >> (shift - 3) & 7));
+                    int second(first + (delta >= 4 ? delta - 8 : delta));
+                    bases[0][channel] = first  << 3 | first  >> 2;
+                    bases[1][channel] = second << 3 | second >> 2;
+                }
+                else {
+                    int first (int(bits >> (shift + 1) & 15));
+                    int second(int(bits >> (shift - 3) & 15));
+                    bases[0][channel] = first  << 4 | first;
+                    bases[1][channel] = second << 4 | second;
+                }
+            }
+            int tables[2] = {int(bits >> 37 & 7), int(bits >> 34 & 7)};
+            bool flip(bits >> 32 & 1);
+
+            for (int x = 0; x < 4 && block_x + x < width; ++x) {
+                for (int y = 0; y < 4 && block_y + y < height; ++y) {
+                    int pixel(x * 4 + y);
+                    int half(flip ? y / 2 : x / 2);
+                    int modifier(modifier_tables[tables[half]][bits >> pixel & 1]);
+                    if (bits >> (16 + pixel) & 1) {
+                        modifier = -modifier;
+                    }
+
+                    uint8_t *out(&rgb[std::size_t(((block_y + y) * width + block_x + x) * 3)]);
+                    for (int channel = 0; channel < 3; ++channel) {
+                        out[channel] = uint8_t(std::min(std::max(bases[half][channel] + modifier, 0), 255));
+                    }
+                }
+            }
+        }
+    }
+
+    return rgb;
+}
+
+// The largest difference of any channel of any pixel
+static int max_error(const std::vector<uint8_t> &rgba, const std::vector<uint8_t> &rgb) {
+    int error(0);
+    for (std::size_t i = 0; i < rgb.size() / 3; ++i) {
+        for (std::size_t channel = 0; channel < 3; ++channel) {
+            error = std::max(error, std::abs(int(rgba[i * 4 + channel]) - int(rgb[i * 3 + channel])));
+        }
+    }
+    return error;
+}
+
+static std::vector<uint8_t> encode(const std::vector<uint8_t> &rgba, int width, int height) {
+    std::vector<uint8_t> encoded(etc1::get_encoded_size(width, height));
+    etc1::encode(rgba.data(), width * 4, width, height, encoded.data());
+    return encoded;
+}
+
+SCENARIO("ETC1 images take 8 bytes a block", "[etc1]" ) {
+
+    GIVEN("images of whole and partial blocks") {
+
+        THEN("partial blocks take a whole block") {
+            REQUIRE(etc1::get_encoded_size(8, 8) == 32);
+            REQUIRE(etc1::get_encoded_size(5, 3) == 16);
+            REQUIRE(etc1::get_encoded_size(1, 1) == 8);
+            REQUIRE(etc1::get_encoded_size(1024, 512) == 1024 * 512 / 2);
+        }
+    }
+}
+
+SCENARIO("ETC1 encoding decodes close to the original", "[etc1]" ) {
+
+    GIVEN("a flat colour") {
+        std::vector<uint8_t> rgba(8 * 8 * 4);
+        for (std::size_t i = 0; i < rgba.size(); i += 4) {
+            rgba[i] = 100; rgba[i + 1] = 150; rgba[i + 2] = 200; rgba[i + 3] = 255;
+        }
+
+        WHEN("encoded and decoded") {
+            std::vector<uint8_t> rgb(decode(encode(rgba, 8, 8), 8, 8));
+
+            THEN("every pixel is nearly the colour") {
+                REQUIRE(max_error(rgba, rgb) <= 4);
+            }
+        }
+    }
+
+    GIVEN("blocks split between far apart colours") {
+        // Left and right halves of the first block row, top and bottom
+        // halves of the second
+        std::vector<uint8_t> rgba(4 * 8 * 4);
+        for (int y = 0; y < 8; ++y) {
+            for (int x = 0; x < 4; ++x) {
+                bool first(y < 4 ? x < 2 : y < 6);
+                uint8_t *pixel(&rgba[std::size_t((y * 4 + x) * 4)]);
+                pixel[0] = first ? 230 : 20;
+                pixel[1] = first ?  40 : 90;
+                pixel[2] = first ?  10 : 240;
+                pixel[3] = 255;
+            }
+        }
+
+        WHEN("encoded and decoded") {
+            std::vector<uint8_t> rgb(decode(encode(rgba, 4, 8), 4, 8));
+
+            THEN("each half keeps its colour") {
+                REQUIRE(max_error(rgba, rgb) <= 12);
+            }
+        }
+    }
+
+    GIVEN("a gradient which is not a whole number of blocks") {
+        std::vector<uint8_t> rgba(6 * 5 * 4);
+        for (int y = 0; y < 5; ++y) {
+            for (int x = 0; x < 6; ++x) {
+                uint8_t *pixel(&rgba[std::size_t((y * 6 + x) * 4)]);
+                pixel[0] = uint8_t(60 + x * 6);
+                pixel[1] = uint8_t(80 + y * 6);
+                pixel[2] = 120;
+                pixel[3] = 255;
+            }
+        }
+
+        WHEN("encoded and decoded") {
+            std::vector<uint8_t> rgb(decode(encode(rgba, 6, 5), 6, 5));
+
+            THEN("the pixels within the image are close") {
+                REQUIRE(max_error(rgba, rgb) <= 16);
+            }
+        }
+    }
+}
@@ -0,0 +1,88 @@
+#include <string>
+
+#include "game_window.hpp"
+#include "image.hpp"
+
+extern "C" {
+#ifdef USE_GLES
+#include <GLES2/gl2.h>
+#endif
+
+#ifdef USE_GL
+#define GL_GLEXT_PROTOTYPES
+#include <GL/gl.h>
+#endif
+}
+
+// glog's CHECK, from the window's headers, would clash with Catch's
+#undef CHECK
+#include "catch.hpp"
+
+// Fill a rectangle of the window, in GL's bottom-up coordinates
+static void fill(int x, int y, int w, int h, float r, float g, float b) {
+    glScissor(x, y, w, h);
+    glClearColor(r, g, b, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+}
+
+static bool is_colour(const Image::Pixel &pixel, int r, int g, int b) {
+    return pixel.r == r && pixel.g == g && pixel.b == b && pixel.a == 255;
+}
+
+SCENARIO("Headless windows read back what was drawn, top row first", "[game_window]" ) {
+
+    GIVEN("a headless window whose width is not a multiple of 4") {
+        const int width(37);
+        const int height(5);
+
+        GameWindow *window(nullptr);
+        try {
+            window = new GameWindow(width, height, false, true);
+        }
+        catch (GameWindow::InitException &e) {
+            WARN("No headless window, so read_frame is not tested: " << e.what());
+        }
+
+        if (window) {
+            window->use_context();
+
+            WHEN("the top row, the right column and the bottom left pixel are drawn") {
+                glEnable(GL_SCISSOR_TEST);
+                fill(0, 0, width, height, 0.0f, 0.0f, 0.0f);
+                fill(0, height - 1, width, 1, 1.0f, 0.0f, 0.0f);
+                fill(width - 1, 0, 1, height, 0.0f, 1.0f, 0.0f);
+                fill(0, 0, 1, 1, 0.0f, 0.0f, 1.0f);
+                glDisable(GL_SCISSOR_TEST);
+
+                Image frame(window->read_frame());
+
+                THEN("the frame is the window's size") {
+                    REQUIRE(frame.width == width);
+                    REQUIRE(frame.height == height);
+                }
+
+                THEN("the top row is first") {
+                    REQUIRE(is_colour(frame.row(0)[0], 255, 0, 0));
+                    REQUIRE(is_colour(frame.row(0)[width - 2], 255, 0, 0));
+                    REQUIRE(is_colour(frame.row(0)[width - 1], 0, 255, 0));
+                }
+
+                THEN("the bottom row is last") {
+                    REQUIRE(is_colour(frame.row(height - 1)[0], 0, 0, 255));
+                    REQUIRE(is_colour(frame.row(height - 1)[1], 0, 0, 0));
+                    REQUIRE(is_colour(frame.row(height - 1)[width - 1], 0, 255, 0));
+                }
+
+                THEN("every row keeps its columns in place") {
+                    for (int y = 1; y < height - 1; ++y) {
+                        REQUIRE(is_colour(frame.row(y)[0], 0, 0, 0));
+                        REQUIRE(is_colour(frame.row(y)[width - 2], 0, 0, 0));
+                        REQUIRE(is_colour(frame.row(y)[width - 1], 0, 255, 0));
+                    }
+                }
+            }
+
+            delete window;
+        }
+    }
+}
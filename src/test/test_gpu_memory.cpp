@@ -0,0 +1,86 @@
+#include <cstddef>
+
+#include "gpu_memory.hpp"
+
+// glog's CHECK would clash with Catch's
+#undef CHECK
+#include "catch.hpp"
+
+SCENARIO("GPU memory is totalled by category", "[gpu_memory]" ) {
+
+    GIVEN("buffers and textures in different categories") {
+        GPUMemory memory;
+        memory.set_buffer(1, GPUMemory::Category::MAP_LAYER, 100);
+        memory.set_buffer(2, GPUMemory::Category::SHARED, 20);
+        memory.set_texture(1, GPUMemory::Category::ATLAS, 1000);
+
+        THEN("each category counts only its own") {
+            REQUIRE(memory.get_bytes(GPUMemory::Category::MAP_LAYER) == 100);
+            REQUIRE(memory.get_bytes(GPUMemory::Category::SHARED) == 20);
+            REQUIRE(memory.get_bytes(GPUMemory::Category::ATLAS) == 1000);
+            REQUIRE(memory.get_bytes(GPUMemory::Category::TEXT) == 0);
+            REQUIRE(memory.get_total_bytes() == 1120);
+        }
+
+        WHEN("a buffer is set again") {
+            memory.set_buffer(1, GPUMemory::Category::MAP_OBJECT, 40);
+
+            THEN("its new size and category replace the old") {
+                REQUIRE(memory.get_bytes(GPUMemory::Category::MAP_LAYER) == 0);
+                REQUIRE(memory.get_bytes(GPUMemory::Category::MAP_OBJECT) == 40);
+                REQUIRE(memory.get_total_bytes() == 1060);
+            }
+        }
+
+        WHEN("a buffer is forgotten") {
+            memory.forget_buffer(1);
+
+            THEN("only the buffer with that name is removed") {
+                REQUIRE(memory.get_bytes(GPUMemory::Category::MAP_LAYER) == 0);
+                REQUIRE(memory.get_bytes(GPUMemory::Category::ATLAS) == 1000);
+                REQUIRE(memory.get_total_bytes() == 1020);
+            }
+        }
+
+        WHEN("names that were never set are forgotten") {
+            memory.forget_buffer(3);
+            memory.forget_texture(2);
+
+            THEN("nothing changes") {
+                REQUIRE(memory.get_bytes(GPUMemory::Category::MAP_LAYER) == 100);
+                REQUIRE(memory.get_bytes(GPUMemory::Category::ATLAS) == 1000);
+                REQUIRE(memory.get_total_bytes() == 1120);
+            }
+        }
+    }
+}
+
+SCENARIO("GPU memory keeps the most allocated at once", "[gpu_memory]" ) {
+
+    GIVEN("a record with nothing allocated") {
+        GPUMemory memory;
+
+        REQUIRE(memory.get_peak_bytes() == 0);
+
+        WHEN("allocations grow and then shrink") {
+            memory.set_texture(1, GPUMemory::Category::ATLAS, 500);
+            memory.set_texture(2, GPUMemory::Category::ATLAS, 300);
+            memory.forget_texture(1);
+            memory.set_texture(2, GPUMemory::Category::ATLAS, 100);
+
+            THEN("the peak stays at the largest total") {
+                REQUIRE(memory.get_total_bytes() == 100);
+                REQUIRE(memory.get_peak_bytes() == 800);
+            }
+        }
+
+        WHEN("an allocation is replaced by a larger one") {
+            memory.set_buffer(1, GPUMemory::Category::GUI, 200);
+            memory.set_buffer(1, GPUMemory::Category::GUI, 300);
+
+            THEN("the old size is not counted towards the peak") {
+                REQUIRE(memory.get_peak_bytes() == 300);
+            }
+        }
+    }
+}
@@ -0,0 +1,121 @@
+#include <cstdint>
+
+#include "catch.hpp"
+#include "image.hpp"
+
+// Fill an image with pixels numbered by their position from the top left
+static void number_pixels(Image &image, uint8_t tag) {
+    for (int y = 0; y < image.height; ++y) {
+        for (int x = 0; x < image.width; ++x) {
+            Image::Pixel &pixel(image.row(y)[x]);
+            pixel.r = uint8_t(x);
+            pixel.g = uint8_t(y);
+            pixel.b = tag;
+            pixel.a = 255;
+        }
+    }
+}
+
+// Whether a pixel of the destination came from (x, y) of the source
+static bool is_from(Image &image, int dst_x, int dst_y, int src_x, int src_y) {
+    Image::Pixel &pixel(image.row(dst_y)[dst_x]);
+    return pixel.r == src_x && pixel.g == src_y && pixel.b == 1;
+}
+
+// Whether a pixel of the destination has not been written
+static bool is_untouched(Image &image, int x, int y) {
+    return image.row(y)[x].b == 0;
+}
+
+SCENARIO("Images are blitted with clipping", "[image][blit]" ) {
+
+    GIVEN("a 6x4 source and an 8x5 destination") {
+        Image src(6, 4, false);
+        Image dst(8, 5, false);
+        number_pixels(src, 1);
+        number_pixels(dst, 0);
+
+        WHEN("a rectangle inside both is copied") {
+            dst.blit(src, 1, 1, 3, 2, 4, 2);
+
+            THEN("it lands at the destination and nothing else changes") {
+                for (int y = 0; y < dst.height; ++y) {
+                    for (int x = 0; x < dst.width; ++x) {
+                        if (x >= 4 && x < 7 && y >= 2 && y < 4) {
+                            REQUIRE(is_from(dst, x, y, x - 3, y - 1));
+                        }
+                        else {
+                            REQUIRE(is_untouched(dst, x, y));
+                        }
+                    }
+                }
+            }
+        }
+
+        WHEN("the rectangle starts before the source") {
+            dst.blit(src, -2, -1, 4, 3, 0, 0);
+
+            THEN("the part outside the source is skipped") {
+                REQUIRE(is_untouched(dst, 1, 0));
+                REQUIRE(is_untouched(dst, 0, 1));
+                REQUIRE(is_from(dst, 2, 1, 0, 0));
+                REQUIRE(is_from(dst, 3, 2, 1, 1));
+                REQUIRE(is_untouched(dst, 4, 1));
+                REQUIRE(is_untouched(dst, 2, 3));
+            }
+        }
+
+        WHEN("the rectangle starts before the destination") {
+            dst.blit(src, 0, 0, 4, 3, -2, -1);
+
+            THEN("the part outside the destination is skipped") {
+                REQUIRE(is_from(dst, 0, 0, 2, 1));
+                REQUIRE(is_from(dst, 1, 1, 3, 2));
+                REQUIRE(is_untouched(dst, 2, 0));
+                REQUIRE(is_untouched(dst, 0, 2));
+            }
+        }
+
+        WHEN("the rectangle runs past the source and destination") {
+            dst.blit(src, 4, 2, 10, 10, 7, 4);
+
+            THEN("it is cut at the nearer edge") {
+                REQUIRE(is_from(dst, 7, 4, 4, 2));
+                REQUIRE(is_untouched(dst, 6, 4));
+                REQUIRE(is_untouched(dst, 7, 3));
+            }
+        }
+
+        WHEN("the rectangle misses the destination") {
+            dst.blit(src, 0, 0, 3, 3, 8, 0);
+            dst.blit(src, 0, 0, 3, 3, -3, 0);
+
+            THEN("nothing changes") {
+                for (int y = 0; y < dst.height; ++y) {
+                    for (int x = 0; x < dst.width; ++x) {
+                        REQUIRE(is_untouched(dst, x, y));
+                    }
+                }
+            }
+        }
+    }
+
+    GIVEN("a source and destination flipped differently") {
+        Image src(4, 3, false);
+        Image dst(4, 3, true);
+        number_pixels(src, 1);
+        number_pixels(dst, 0);
+
+        WHEN("the source is copied") {
+            dst.blit(src, 0, 0, 4, 3, 0, 0);
+
+            THEN("rows count from the top of both") {
+                for (int y = 0; y < 3; ++y) {
+                    for (int x = 0; x < 4; ++x) {
+                        REQUIRE(is_from(dst, x, y, x, y));
+                    }
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,259 @@
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "catch.hpp"
+#include "pixel_ops.hpp"
+
+// Enough pixels for the SIMD loops, with some left over for the tails
+static const std::size_t pixel_count = 37;
+
+static std::vector<uint8_t> make_pixels(std::size_t count) {
+    std::vector<uint8_t> pixels(count * 4);
+    for (std::size_t i = 0; i < pixels.size(); ++i) {
+        pixels[i] = uint8_t(i * 7 + 3);
+    }
+    return pixels;
+}
+
+SCENARIO("Rectangles of bytes are copied row by row", "[pixel_ops][copy]" ) {
+
+    GIVEN("a source of 3 rows of 5 bytes, padded to 8") {
+        std::vector<uint8_t> src(8 * 3);
+        for (std::size_t i = 0; i < src.size(); ++i) {
+            src[i] = uint8_t(i);
+        }
+
+        WHEN("copied to a destination padded to 6") {
+            std::vector<uint8_t> dst(6 * 3, 0xff);
+            pixel_ops::copy_rect(dst.data(), 6, src.data(), 8, 5, 3);
+
+            THEN("each row is copied and the padding is left alone") {
+                for (int y = 0; y < 3; ++y) {
+                    for (int x = 0; x < 5; ++x) {
+                        REQUIRE(dst[std::size_t(y * 6 + x)] == src[std::size_t(y * 8 + x)]);
+                    }
+                    REQUIRE(dst[std::size_t(y * 6 + 5)] == 0xff);
+                }
+            }
+        }
+
+        WHEN("copied with a negative destination pitch") {
+            std::vector<uint8_t> dst(5 * 3, 0);
+            pixel_ops::copy_rect(&dst[5 * 2], -5, src.data(), 8, 5, 3);
+
+            THEN("the rows are flipped") {
+                for (int y = 0; y < 3; ++y) {
+                    for (int x = 0; x < 5; ++x) {
+                        REQUIRE(dst[std::size_t((2 - y) * 5 + x)] == src[std::size_t(y * 8 + x)]);
+                    }
+                }
+            }
+        }
+
+        WHEN("copied from a negative source pitch") {
+            std::vector<uint8_t> dst(5 * 3, 0);
+            pixel_ops::copy_rect(dst.data(), 5, &src[8 * 2], -8, 5, 3);
+
+            THEN("the rows are flipped") {
+                for (int y = 0; y < 3; ++y) {
+                    for (int x = 0; x < 5; ++x) {
+                        REQUIRE(dst[std::size_t(y * 5 + x)] == src[std::size_t((2 - y) * 8 + x)]);
+                    }
+                }
+            }
+        }
+
+        WHEN("no rows are copied") {
+            std::vector<uint8_t> dst(5 * 3, 0xff);
+            pixel_ops::copy_rect(dst.data(), 5, src.data(), 8, 5, 0);
+
+            THEN("nothing changes") {
+                REQUIRE(dst == std::vector<uint8_t>(5 * 3, 0xff));
+            }
+        }
+    }
+
+    GIVEN("tightly packed rows") {
+        std::vector<uint8_t> src(make_pixels(pixel_count));
+
+        WHEN("copied to tightly packed rows") {
+            std::vector<uint8_t> dst(src.size(), 0);
+            pixel_ops::copy_rect(dst.data(), 4, src.data(), 4, 4, int(pixel_count));
+
+            THEN("everything is copied") {
+                REQUIRE(dst == src);
+            }
+        }
+    }
+}
+
+SCENARIO("Red and blue are swapped", "[pixel_ops][convert]" ) {
+
+    GIVEN("some pixels") {
+        std::vector<uint8_t> src(make_pixels(pixel_count));
+
+        WHEN("swapped") {
+            std::vector<uint8_t> dst(src.size(), 0);
+            pixel_ops::swap_red_blue(dst.data(), src.data(), pixel_count);
+
+            THEN("only the first and third bytes of each pixel trade places") {
+                for (std::size_t i = 0; i < pixel_count; ++i) {
+                    REQUIRE(dst[i * 4    ] == src[i * 4 + 2]);
+                    REQUIRE(dst[i * 4 + 1] == src[i * 4 + 1]);
+                    REQUIRE(dst[i * 4 + 2] == src[i * 4    ]);
+                    REQUIRE(dst[i * 4 + 3] == src[i * 4 + 3]);
+                }
+            }
+        }
+
+        WHEN("swapped in place twice") {
+            std::vector<uint8_t> pixels(src);
+            pixel_ops::swap_red_blue(pixels.data(), pixels.data(), pixel_count);
+            pixel_ops::swap_red_blue(pixels.data(), pixels.data(), pixel_count);
+
+            THEN("they are unchanged") {
+                REQUIRE(pixels == src);
+            }
+        }
+    }
+}
+
+SCENARIO("Colours are premultiplied by alpha", "[pixel_ops][convert]" ) {
+
+    GIVEN("every colour with every alpha, and a few more for the tail") {
+        std::size_t count(256 * 256 + 3);
+        std::vector<uint8_t> src(count * 4);
+        for (std::size_t i = 0; i < count; ++i) {
+            unsigned int colour(i % 256);
+            unsigned int alpha(i / 256 % 256);
+            src[i * 4    ] = uint8_t(colour);
+            src[i * 4 + 1] = uint8_t(255 - colour);
+            src[i * 4 + 2] = uint8_t(colour / 2);
+            src[i * 4 + 3] = uint8_t(alpha);
+        }
+
+        // Rounded to nearest, which is never a tie as 255 is odd
+        auto reference([] (unsigned int colour, unsigned int alpha) {
+            return uint8_t((colour * alpha + 127) / 255);
+        });
+
+        WHEN("premultiplied in place") {
+            std::vector<uint8_t> pixels(src);
+            pixel_ops::premultiply_alpha(pixels.data(), pixels.data(), count);
+
+            THEN("every channel matches the reference and alpha is kept") {
+                std::size_t mismatches(0);
+                for (std::size_t i = 0; i < count; ++i) {
+                    unsigned int alpha(src[i * 4 + 3]);
+                    mismatches += pixels[i * 4    ] != reference(src[i * 4    ], alpha);
+                    mismatches += pixels[i * 4 + 1] != reference(src[i * 4 + 1], alpha);
+                    mismatches += pixels[i * 4 + 2] != reference(src[i * 4 + 2], alpha);
+                    mismatches += pixels[i * 4 + 3] != alpha;
+                }
+                REQUIRE(mismatches == 0);
+            }
+        }
+    }
+}
+
+SCENARIO("Rows are checked for transparency", "[pixel_ops][opaque]" ) {
+
+    GIVEN("opaque pixels") {
+        std::vector<uint8_t> pixels(make_pixels(pixel_count));
+        for (std::size_t i = 0; i < pixel_count; ++i) {
+            pixels[i * 4 + 3] = 255;
+        }
+
+        THEN("they are opaque") {
+            REQUIRE(pixel_ops::is_opaque(pixels.data(), pixel_count));
+        }
+
+        THEN("an empty row is opaque") {
+            REQUIRE(pixel_ops::is_opaque(pixels.data(), 0));
+        }
+
+        WHEN("any one pixel is slightly transparent") {
+            THEN("they are not opaque") {
+                for (std::size_t i = 0; i < pixel_count; ++i) {
+                    std::vector<uint8_t> changed(pixels);
+                    changed[i * 4 + 3] = 254;
+                    REQUIRE(!pixel_ops::is_opaque(changed.data(), pixel_count));
+                }
+            }
+        }
+    }
+}
+
+SCENARIO("Pixels are packed into 16 bits", "[pixel_ops][pack]" ) {
+
+    GIVEN("every value of every channel, and a few more for the tail") {
+        std::size_t count(256 + 3);
+        std::vector<uint8_t> src(count * 4);
+        for (std::size_t i = 0; i < count; ++i) {
+            src[i * 4    ] = uint8_t(i);
+            src[i * 4 + 1] = uint8_t(255 - i);
+            src[i * 4 + 2] = uint8_t(i * 3);
+            src[i * 4 + 3] = uint8_t(i * 5);
+        }
+
+        // Rounded to nearest
+        auto scale([] (unsigned int value, unsigned int max) {
+            return uint16_t((value * max + 127) / 255);
+        });
+
+        WHEN("packed to RGBA4444") {
+            std::vector<uint16_t> packed(count);
+            pixel_ops::pack_rgba4444(packed.data(), src.data(), count);
+
+            THEN("each channel is scaled into its nibble, red highest") {
+                std::size_t mismatches(0);
+                for (std::size_t i = 0; i < count; ++i) {
+                    uint16_t expected(uint16_t(scale(src[i * 4    ], 15) << 12 |
+                                               scale(src[i * 4 + 1], 15) <<  8 |
+                                               scale(src[i * 4 + 2], 15) <<  4 |
+                                               scale(src[i * 4 + 3], 15)));
+                    mismatches += packed[i] != expected;
+                }
+                REQUIRE(mismatches == 0);
+            }
+        }
+
+        WHEN("packed to RGB565") {
+            std::vector<uint16_t> packed(count);
+            pixel_ops::pack_rgb565(packed.data(), src.data(), count);
+
+            THEN("each colour is scaled into its bits and alpha is dropped") {
+                std::size_t mismatches(0);
+                for (std::size_t i = 0; i < count; ++i) {
+                    uint16_t expected(uint16_t(scale(src[i * 4    ], 31) << 11 |
+                                               scale(src[i * 4 + 1], 63) <<  5 |
+                                               scale(src[i * 4 + 2], 31)));
+                    mismatches += packed[i] != expected;
+                }
+                REQUIRE(mismatches == 0);
+            }
+        }
+    }
+
+    GIVEN("pure colours") {
+        std::vector<uint8_t> src = {
+            255,   0,   0, 255,
+              0, 255,   0, 255,
+              0,   0, 255, 255,
+            255, 255, 255,   0
+        };
+
+        WHEN("packed") {
+            std::vector<uint16_t> rgb565(4);
+            std::vector<uint16_t> rgba4444(4);
+            pixel_ops::pack_rgb565(rgb565.data(), src.data(), 4);
+            pixel_ops::pack_rgba4444(rgba4444.data(), src.data(), 4);
+
+            THEN("they fill their channels") {
+                REQUIRE(rgb565 == std::vector<uint16_t>({0xf800, 0x07e0, 0x001f, 0xffff}));
+                REQUIRE(rgba4444 == std::vector<uint16_t>({0xf00f, 0x0f0f, 0x00ff, 0xfff0}));
+            }
+        }
+    }
+}
@@ -0,0 +1,75 @@
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "report_format.hpp"
+
+#include "catch.hpp"
+
+SCENARIO("Text is quoted as a JSON string", "[report_format]" ) {
+
+    GIVEN("plain text") {
+        THEN("it is only wrapped in quotes") {
+            REQUIRE(report_format::quote("Main") == "\"Main\"");
+        }
+    }
+
+    GIVEN("text with quotes and backslashes") {
+        THEN("they are escaped") {
+            REQUIRE(report_format::quote("a \"b\" \\c") == "\"a \\\"b\\\" \\\\c\"");
+        }
+    }
+
+    GIVEN("text with control characters") {
+        THEN("they are escaped, by name where JSON has one") {
+            REQUIRE(report_format::quote("a\nb\tc\r") == "\"a\\nb\\tc\\r\"");
+            REQUIRE(report_format::quote(std::string("\x01\x1f", 2)) == "\"\\u0001\\u001f\"");
+            REQUIRE(report_format::quote(std::string("a\0b", 3)) == "\"a\\u0000b\"");
+        }
+    }
+
+    GIVEN("UTF-8 text") {
+        THEN("it is left as it is") {
+            REQUIRE(report_format::quote("caf\xc3\xa9") == "\"caf\xc3\xa9\"");
+        }
+    }
+}
+
+SCENARIO("Percentiles are taken by the nearest rank", "[report_format]" ) {
+
+    GIVEN("no values") {
+        THEN("the percentile is zero") {
+            REQUIRE(report_format::get_percentile(std::vector<double>(), 50.0f) == 0.0);
+            REQUIRE(report_format::get_percentile(std::vector<std::chrono::milliseconds>(), 50.0f).count() == 0);
+        }
+    }
+
+    GIVEN("values out of order") {
+        std::vector<double> values{5.0, 1.0, 4.0, 2.0, 3.0};
+
+        THEN("the extremes are the smallest and largest") {
+            REQUIRE(report_format::get_percentile(values, 0.0f) == 1.0);
+            REQUIRE(report_format::get_percentile(values, 100.0f) == 5.0);
+        }
+
+        THEN("the median is the middle value") {
+            REQUIRE(report_format::get_percentile(values, 50.0f) == 3.0);
+        }
+    }
+}
+
+SCENARIO("Sizes and durations are converted for reports", "[report_format]" ) {
+
+    GIVEN("a size in bytes") {
+        THEN("it is written in KiB") {
+            REQUIRE(report_format::to_kib(1536) == "1.5 KiB");
+        }
+    }
+
+    GIVEN("a duration") {
+        THEN("it is converted to milliseconds and microseconds") {
+            REQUIRE(report_format::to_milliseconds(std::chrono::microseconds(2500)) == 2.5);
+            REQUIRE(report_format::to_microseconds(std::chrono::nanoseconds(1500)) == 1.5);
+        }
+    }
+}
@@ -0,0 +1,132 @@
+#include <cstddef>
+#include <initializer_list>
+#include <memory>
+#include <set>
+#include <string>
+
+#include "cacheable_resource.hpp"
+#include "resource_cache.hpp"
+
+// glog's CHECK, from the cache's headers, would clash with Catch's
+#undef CHECK
+#include "catch.hpp"
+
+///
+/// A resource of 100 bytes which counts its loads
+///
+class TestResource : public CacheableResource<TestResource> {
+private:
+    friend class CacheableResource<TestResource>;
+
+    static std::shared_ptr<TestResource> new_resource(const std::string resource_name) {
+        ++loads;
+        live.insert(resource_name);
+        return std::make_shared<TestResource>(resource_name);
+    }
+
+public:
+    static int loads;
+    static std::set<std::string> live;
+
+    std::string name;
+
+    TestResource(const std::string name): name(name) {}
+
+    ~TestResource() { live.erase(name); }
+
+    size_t get_resource_bytes() { return 100; }
+};
+
+int TestResource::loads(0);
+std::set<std::string> TestResource::live;
+
+// Use each resource in turn, holding none of them
+static void use(ResourceCache<TestResource> &cache, std::initializer_list<std::string> names) {
+    for (const std::string &name : names) {
+        cache.get_resource(name);
+    }
+    // The cache trims whilst the last is still held, so counts it idle
+    // only from the next trim, which reporting does
+    cache.report("test");
+}
+
+SCENARIO("Resources nothing uses are released least recently used first", "[resource_cache]" ) {
+
+    GIVEN("a cache with a budget of two idle resources") {
+        ResourceCache<TestResource>::set_retention_budget(250);
+        std::shared_ptr<ResourceCache<TestResource>> cache(ResourceCache<TestResource>::create(nullptr));
+        TestResource::loads = 0;
+
+        use(*cache, {"a", "b"});
+
+        THEN("both are kept") {
+            REQUIRE(cache->has_resource("a"));
+            REQUIRE(cache->has_resource("b"));
+            REQUIRE(TestResource::live == std::set<std::string>({"a", "b"}));
+        }
+
+        WHEN("the first is used again, then a third goes over the budget") {
+            use(*cache, {"a", "c"});
+
+            THEN("the least recently used is released") {
+                REQUIRE(!cache->has_resource("b"));
+                REQUIRE(TestResource::live == std::set<std::string>({"a", "c"}));
+                REQUIRE(TestResource::loads == 3);
+            }
+
+            WHEN("the released one is used again") {
+                std::shared_ptr<TestResource> b(cache->get_resource("b"));
+
+                THEN("it is loaded afresh") {
+                    REQUIRE(b);
+                    REQUIRE(b->name == "b");
+                    REQUIRE(TestResource::loads == 4);
+                }
+
+                THEN("once it is idle, the next least recently used makes room for it") {
+                    b.reset();
+                    cache->report("test");
+                    REQUIRE(!cache->has_resource("a"));
+                    REQUIRE(TestResource::live == std::set<std::string>({"b", "c"}));
+                }
+            }
+        }
+
+        WHEN("resources in use go over the budget") {
+            std::shared_ptr<TestResource> c(cache->get_resource("c"));
+            std::shared_ptr<TestResource> d(cache->get_resource("d"));
+
+            THEN("only the idle ones count against it") {
+                REQUIRE(TestResource::live == std::set<std::string>({"a", "b", "c", "d"}));
+            }
+        }
+    }
+}
+
+SCENARIO("Pinned resources are kept whatever the budget", "[resource_cache]" ) {
+
+    GIVEN("a cache with a budget of two idle resources and one pinned") {
+        ResourceCache<TestResource>::set_retention_budget(250);
+        std::shared_ptr<ResourceCache<TestResource>> cache(ResourceCache<TestResource>::create(nullptr));
+        cache->pin("pinned");
+
+        WHEN("more idle resources are used than the budget holds") {
+            use(*cache, {"a", "b", "c"});
+
+            THEN("the pinned one is kept and the others trimmed") {
+                REQUIRE(cache->has_resource("pinned"));
+                REQUIRE(TestResource::live == std::set<std::string>({"pinned", "b", "c"}));
+            }
+
+            WHEN("it is unpinned") {
+                cache->unpin("pinned");
+                cache->report("test");
+
+                THEN("it is released as the least recently used") {
+                    REQUIRE(!cache->has_resource("pinned"));
+                    REQUIRE(TestResource::live == std::set<std::string>({"b", "c"}));
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,100 @@
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "catch.hpp"
+#include "text_layout_cache.hpp"
+
+static TextLayoutCache::Key make_key(const std::string &text) {
+    return TextLayoutCache::Key{text, nullptr, 100, 20, 0, 0, 0};
+}
+
+// A layout of over a third of the cache's budget, so three do not fit
+static TextLayoutCache::Layout make_layout(int revision) {
+    TextLayoutCache::Layout layout{10, 10, 10, 10, {}, 0, revision};
+    layout.glyph_quads.resize(100000, 1.0f);
+    return layout;
+}
+
+SCENARIO("TextLayoutCache drops the least recently used layouts", "[text][cache]" ) {
+
+    GIVEN("a cache holding two large layouts, the first used since") {
+        TextLayoutCache &cache(TextLayoutCache::get_instance());
+        cache.clear();
+
+        cache.insert(make_key("first"), make_layout(1));
+        cache.insert(make_key("second"), make_layout(1));
+        REQUIRE(cache.find(make_key("first"), 1) != nullptr);
+
+        size_t evictions(cache.get_evictions());
+
+        WHEN("a third layout goes over the budget") {
+            cache.insert(make_key("third"), make_layout(1));
+
+            THEN("the least recently used is dropped") {
+                REQUIRE(cache.get_evictions() == evictions + 1);
+                REQUIRE(cache.get_num_entries() == 2);
+                REQUIRE(cache.find(make_key("second"), 1) == nullptr);
+            }
+
+            THEN("the others are kept") {
+                REQUIRE(cache.find(make_key("first"), 1) != nullptr);
+                REQUIRE(cache.find(make_key("third"), 1) != nullptr);
+            }
+        }
+
+        WHEN("a layout is replaced") {
+            size_t used_bytes(cache.get_used_bytes());
+            cache.insert(make_key("first"), make_layout(2));
+
+            THEN("it is not counted twice") {
+                REQUIRE(cache.get_num_entries() == 2);
+                REQUIRE(cache.get_used_bytes() == used_bytes);
+                REQUIRE(cache.get_evictions() == evictions);
+            }
+        }
+    }
+}
+
+SCENARIO("TextLayoutCache drops layouts of older glyph atlas revisions", "[text][cache]" ) {
+
+    GIVEN("a cache holding a layout at revision 3") {
+        TextLayoutCache &cache(TextLayoutCache::get_instance());
+        cache.clear();
+
+        TextLayoutCache::Layout layout(make_layout(3));
+        layout.used_width = 42;
+        cache.insert(make_key("label"), layout);
+
+        WHEN("found at the same revision") {
+            const TextLayoutCache::Layout *found(cache.find(make_key("label"), 3));
+
+            THEN("the layout is returned") {
+                REQUIRE(found != nullptr);
+                REQUIRE(found->used_width == 42);
+                REQUIRE(found->glyph_quads.size() == layout.glyph_quads.size());
+            }
+        }
+
+        WHEN("found at a later revision") {
+            const TextLayoutCache::Layout *found(cache.find(make_key("label"), 4));
+
+            THEN("it misses and the layout is dropped") {
+                REQUIRE(found == nullptr);
+                REQUIRE(cache.get_num_entries() == 0);
+                REQUIRE(cache.get_used_bytes() == 0);
+                REQUIRE(cache.find(make_key("label"), 3) == nullptr);
+            }
+        }
+
+        WHEN("found with a different key") {
+            TextLayoutCache::Key key(make_key("label"));
+            key.width = 200;
+
+            THEN("it misses") {
+                REQUIRE(cache.find(key, 3) == nullptr);
+                REQUIRE(cache.get_num_entries() == 1);
+            }
+        }
+    }
+}
@@ -0,0 +1,169 @@
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "image.hpp"
+#include "texture_atlas.hpp"
+
+// glog's CHECK, from the atlas's headers, would clash with Catch's
+#undef CHECK
+#include "catch.hpp"
+
+SCENARIO("Texture atlas pages are near-square powers of two", "[texture_atlas][layout]" ) {
+
+    GIVEN("units which fit on one page") {
+
+        WHEN("laid out") {
+            THEN("the page is the smallest which holds them") {
+                REQUIRE(TextureAtlas::page_layout( 1, 64, 64, 2048) == std::make_pair(1, 1));
+                REQUIRE(TextureAtlas::page_layout( 3, 64, 64, 2048) == std::make_pair(2, 2));
+                REQUIRE(TextureAtlas::page_layout(10, 64, 64, 2048) == std::make_pair(4, 4));
+                REQUIRE(TextureAtlas::page_layout(17, 64, 64, 2048) == std::make_pair(8, 4));
+            }
+
+            THEN("units which are not powers of two are padded") {
+                REQUIRE(TextureAtlas::page_layout(4, 48, 48, 2048) == std::make_pair(2, 2));
+                REQUIRE(TextureAtlas::page_layout(5, 48, 48, 2048) == std::make_pair(5, 2));
+            }
+        }
+    }
+
+    GIVEN("more units than fit on the largest texture") {
+
+        WHEN("laid out") {
+            THEN("the pages are as large as they can be") {
+                REQUIRE(TextureAtlas::page_layout( 40, 64, 64, 256) == std::make_pair(4, 4));
+                REQUIRE(TextureAtlas::page_layout(317, 64, 64, 512) == std::make_pair(8, 8));
+            }
+        }
+    }
+
+    GIVEN("units larger than the largest texture") {
+
+        WHEN("laid out") {
+            THEN("it fails") {
+                REQUIRE_THROWS_AS(TextureAtlas::page_layout(1, 128, 64, 64), TextureAtlas::LoadException &);
+            }
+        }
+    }
+}
+
+SCENARIO("Texture atlas units are found on their pages", "[texture_atlas][layout]" ) {
+
+    GIVEN("one page of units, padded to a power of two") {
+        // Five units in a row, stored 512 wide
+        Image page(512, 64, true);
+        page.width = 320;
+        std::tuple<float,float,float,float> coords;
+
+        WHEN("a unit is found") {
+            int page_index(TextureAtlas::locate_unit(2, 64, 64, 5, 1, page, coords));
+
+            THEN("it is on the first page") {
+                REQUIRE(page_index == 0);
+            }
+
+            THEN("its coordinates are within the used area") {
+                REQUIRE(std::get<0>(coords) == Approx(0.25f));
+                REQUIRE(std::get<1>(coords) == Approx(0.375f));
+                REQUIRE(std::get<2>(coords) == Approx(0.0f));
+                REQUIRE(std::get<3>(coords) == Approx(1.0f));
+            }
+        }
+    }
+
+    GIVEN("units spilling onto several pages") {
+        std::pair<int,int> layout(TextureAtlas::page_layout(100, 64, 64, 256));
+        Image page(64 * layout.first, 64 * layout.second, true);
+        std::tuple<float,float,float,float> coords;
+
+        WHEN("the first unit of each page is found") {
+            THEN("it is at the top left of its page") {
+                for (int page_index = 0; page_index < 7; ++page_index) {
+                    int index(page_index * layout.first * layout.second);
+                    REQUIRE(TextureAtlas::locate_unit(index, 64, 64, layout.first, layout.second, page, coords) == page_index);
+                    REQUIRE(std::get<0>(coords) == Approx(0.0f));
+                    REQUIRE(std::get<3>(coords) == Approx(1.0f));
+                }
+            }
+        }
+
+        WHEN("a unit within a later page is found") {
+            int page_index(TextureAtlas::locate_unit(37, 64, 64, layout.first, layout.second, page, coords));
+
+            THEN("its page and coordinates are counted from that page") {
+                REQUIRE(page_index == 2);
+                REQUIRE(std::get<0>(coords) == Approx(0.25f));
+                REQUIRE(std::get<1>(coords) == Approx(0.5f));
+                REQUIRE(std::get<2>(coords) == Approx(0.5f));
+                REQUIRE(std::get<3>(coords) == Approx(0.75f));
+            }
+        }
+
+        WHEN("the last unit is found") {
+            int page_index(TextureAtlas::locate_unit(99, 64, 64, layout.first, layout.second, page, coords));
+
+            THEN("it is on the last page") {
+                REQUIRE(page_index == 6);
+                REQUIRE(std::get<0>(coords) == Approx(0.75f));
+                REQUIRE(std::get<2>(coords) == Approx(0.75f));
+            }
+        }
+    }
+}
+
+SCENARIO("Opaque atlases are merged onto pages of their own", "[texture_atlas][layout]" ) {
+
+    GIVEN("atlases with no opaque ones") {
+        TextureAtlas::Arrangement arrangement(TextureAtlas::arrange({10, 20}, {false, false}, 64, 64, 2048));
+
+        THEN("they follow each other on shared pages") {
+            REQUIRE(arrangement.index_offsets == std::vector<int>({0, 10}));
+            REQUIRE(arrangement.page_count == 1);
+            REQUIRE(arrangement.opaque_pages == std::vector<bool>({false}));
+        }
+    }
+
+    GIVEN("atlases which are all opaque") {
+        TextureAtlas::Arrangement arrangement(TextureAtlas::arrange({30, 20}, {true, true}, 64, 64, 256));
+
+        THEN("every page is opaque, including the part-filled last one") {
+            REQUIRE(arrangement.index_offsets == std::vector<int>({0, 30}));
+            REQUIRE(arrangement.page_count == 4);
+            REQUIRE(arrangement.opaque_pages == std::vector<bool>(4, true));
+        }
+    }
+
+    GIVEN("opaque and other atlases which fill pages of the same size") {
+        TextureAtlas::Arrangement arrangement(TextureAtlas::arrange({40, 64, 24}, {false, true, false}, 64, 64, 2048));
+
+        THEN("the opaque ones come first, on a page of their own") {
+            REQUIRE(std::make_pair(arrangement.unit_columns, arrangement.unit_rows) == std::make_pair(8, 8));
+            REQUIRE(arrangement.page_count == 2);
+            REQUIRE(arrangement.index_offsets == std::vector<int>({64, 0, 104}));
+            REQUIRE(arrangement.opaque_pages == std::vector<bool>({true, false}));
+        }
+    }
+
+    GIVEN("a few opaque units among many others") {
+        TextureAtlas::Arrangement arrangement(TextureAtlas::arrange({95, 6}, {false, true}, 64, 64, 2048));
+
+        THEN("they share a page rather than double the area") {
+            REQUIRE(std::make_pair(arrangement.unit_columns, arrangement.unit_rows) == std::make_pair(16, 8));
+            REQUIRE(arrangement.page_count == 1);
+            REQUIRE(arrangement.index_offsets == std::vector<int>({6, 0}));
+            REQUIRE(arrangement.opaque_pages == std::vector<bool>({false}));
+        }
+    }
+
+    GIVEN("opaque units which fill whole pages before the others") {
+        TextureAtlas::Arrangement arrangement(TextureAtlas::arrange({20, 20}, {true, false}, 64, 64, 256));
+
+        THEN("only the pages without other units are opaque") {
+            REQUIRE(arrangement.page_count == 3);
+            REQUIRE(arrangement.index_offsets == std::vector<int>({0, 20}));
+            REQUIRE(arrangement.opaque_pages == std::vector<bool>({true, false, false}));
+        }
+    }
+}
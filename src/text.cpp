@@ -2,19 +2,13 @@
 // //////////////////////// CURRENT BUGS ////////////////////////
 // //////////////////////////////////////////////////////////////
 // Possible SDL_ttf bug when rendering certain first characters.
-//      Workaround is to append and prepend a space character to lines.
-//      See render(): border, safe, safe_str.
+//      Workaround is to prepend a space character to glyphs, and lay
+//      out lines as if they had a space on each side.
+//      See layout(): border, and GlyphAtlas::rasterise.
 //
 
-// Behaviour modifiers (defines):
-//  TEXT_SAFE_SURFACE
-//      Text can be rendered less directly by defining this. This will
-//      copy the surface into another surface of an explicitly defined
-//      format - which is slow, but is safer use. In theory, disabling
-//      this also works perfectly though, giving a performance boost by
-//      directly reading off the text.
-
-#include <cmath>
+#include <algorithm>
+#include <cstdint>
 #include <cstdio>
 #include <functional>
 #include <iostream>
@@ -22,12 +16,12 @@
 #include <memory>
 #include <sstream>
 #include <stdexcept>
+#include <tuple>
+#include <vector>
 
 #include <glog/logging.h>
 
 extern "C" {
-#include <SDL2/SDL_ttf.h>
-
 #ifdef USE_GL
 #define GL_GLEXT_PROTOTYPES
 #include <GL/gl.h>
@@ -40,15 +34,25 @@ extern "C" {
 
 #include "callback.hpp"
 #include "game_window.hpp"
-#include "image.hpp"
+#include "gl_state.hpp"
+#include "glyph_atlas.hpp"
+#include "gpu_memory.hpp"
+#include "graphics_context.hpp"
+#include "profiler.hpp"
+#include "render_stats.hpp"
+#include "renderable_component.hpp"
 #include "shader.hpp"
 #include "text.hpp"
 #include "text_font.hpp"
+#include "text_layout_cache.hpp"
 
 
 
 #define SHADER_VARIABLE_POSITION "position"
 #define SHADER_VARIABLE_TEXTURE  "texture_coord"
+#define SHADER_VARIABLE_COLOUR   "colour"
+#define SHADER_VARIABLE_GLOW_RADIUS "glow_radius"
+#define SHADER_VARIABLE_GLOW_SPREAD "glow_spread"
 #define SHADER_LOCATION_POSITION 0
 #define SHADER_LOCATION_TEXTURE  1
 
@@ -89,12 +93,14 @@ Text::RenderException::RenderException(const std::string &message): std::runtime
 
 
 Text::Text(GameWindow* window, TextFont font, bool smooth):
-    dirty_texture(true),
+    dirty_layout(true),
     dirty_vbo(true),
     text(""),
     position_from_alignment(false),
     alignment_h(Text::Alignment::LEFT),
     alignment_v(Text::Alignment::TOP),
+    used_width(0),
+    used_height(0),
     smooth(smooth),
     glow_radius(0),
     width(0),
@@ -107,9 +113,13 @@ Text::Text(GameWindow* window, TextFont font, bool smooth):
     y_ratio(0),
     ratio_size(false),
     ratio_position(true),
-    texture(0),
+    rendered_width(0),
+    rendered_height(0),
+    num_glow_quads(0),
     vbo(0),
     font(font),
+    glyph_atlas(GlyphAtlas::get_shared(font, smooth)),
+    glyph_atlas_revision(0),
     window(window),
     resize_callback([this] (GameWindow*) {
             dirty_vbo = true;
@@ -129,7 +139,10 @@ Text::Text(GameWindow* window, TextFont font, bool smooth):
 
 Text::~Text() {
     resize_callback.unregister_everywhere();
-    glDeleteTextures(1, &texture);
+    if (GraphicsContext::get_current()) {
+        GLState::get_current().forget_buffer(vbo);
+        GPUMemory::get_current().forget_buffer(vbo);
+    }
     glDeleteBuffers(1, &vbo);
 }
 
@@ -138,7 +151,7 @@ Text::~Text() {
 //      This function contains an unusual amount of raw pointers, and is
 //      the most C-like function you can get without being C++.
 //      Sorry Joshua.
-void Text::render() {
+void Text::layout() {
     int width = this->width;
     int height = this->height;
     std::pair<int,int> window_size = window->get_size();
@@ -179,14 +192,31 @@ void Text::render() {
         throw Text::RenderException("Invalid dimensions after auto-sizing.");
     }
 
+    // Strings are often shown again, so reuse their layout if possible.
+    TextLayoutCache &layout_cache(TextLayoutCache::get_instance());
+    TextLayoutCache::Key layout_key{text, glyph_atlas.get(), width, height,
+                                    int(alignment_h), int(alignment_v), glow_radius};
+    const TextLayoutCache::Layout *cached(layout_cache.find(layout_key, glyph_atlas->get_revision()));
+    if (cached) {
+        used_width = cached->used_width;
+        used_height = cached->used_height;
+        rendered_width = cached->rendered_width;
+        rendered_height = cached->rendered_height;
+        glyph_quads = cached->glyph_quads;
+        num_glow_quads = cached->num_glow_quads;
+        glyph_atlas_revision = cached->glyph_atlas_revision;
+        dirty_layout = false;
+        dirty_vbo = true;
+        return;
+    }
+
     int available_width = width - glow_radius * 2;
     // It took a whole day to discover that there was a bug in
     // SDL_ttf. Starting with certain characters on certain
     // fonts seems to break it. :(
-    // As a hack, prepend and (for balance) append a space.
-    int border;
-    TTF_SizeUTF8(font.font, " ", &border, NULL);
-    border *= 2;
+    // As a hack, lines were drawn with a space prepended and (for
+    // balance) appended, and are still laid out that way.
+    int border = glyph_atlas->get_space_width() * 2;
     
     // If they are still zero, don't continue.
     if (available_width <= 0) {
@@ -194,9 +224,8 @@ void Text::render() {
     }
     
     // int available_height = height - glow_radius * 2;
-    int line_height = TTF_FontHeight(font.font);
+    int line_height = glyph_atlas->get_line_height();
     int line_number = 0;
-    int lost_lines = 0;
 
     int used_width = 0;
 
@@ -255,7 +284,7 @@ void Text::render() {
             }
             line[l - t] = '\0';
             // Test line length.
-            TTF_SizeUTF8(font.font, line, &line_width, NULL);
+            line_width = glyph_atlas->measure(line);
             // Part of SDL_ttf bug workaround.
             line_width+=border;
             if (line_width <= available_width) {
@@ -297,7 +326,7 @@ void Text::render() {
                         ll = ls;
                         c = line[ls];
                         line[ls] = 0;
-                        TTF_SizeUTF8(font.font, line, &line_width, NULL);
+                        line_width = glyph_atlas->measure(line);
                         // Part of SDL_ttf bug workaround.
                         line_width+=border;
                         if (line_width <= available_width) {
@@ -344,86 +373,92 @@ void Text::render() {
         }
     }
     int line_count = line_number;
-
     int used_height = line_count * line_height + 2 * glow_radius;
-    
+
     used_width += glow_radius * 2 + border;
 
-    image = Image(used_width, (used_height < height) ? used_height : height, true);
-    uint8_t clear_colour[4] = {rgba[0], rgba[1], rgba[2], 0x00};
-    uint8_t clear_mask[4] = {0xff, 0xff, 0xff, 0xff};
-    image.clear(clear_colour, clear_mask);
-    // image.clear(0xffffff00, 0xffffffff);
-
-    // Render all lines of text.
-    SDL_Color blank;
-    blank.r = blank.g = blank.b = blank.a = 0;
-    SDL_Color colour;
-    colour.r = rgba[0];
-    colour.g = rgba[1];
-    colour.b = rgba[2];
-    colour.a = rgba[3];
-    lines_scan = lines;
+    this->used_width  = used_width;
+    this->used_height = used_height;
+    rendered_width  = used_width;
+    rendered_height = (used_height < height) ? used_height : height;
+
+    // Laying out can fill the atlas, which moves the glyphs laid out
+    // before, so try again if that happens.
+    for (int attempt = 0; attempt < 2; ++attempt) {
+        glyph_atlas_revision = glyph_atlas->get_revision();
+        generate_glyph_quads(lines, line_count);
+        if (glyph_atlas->get_revision() == glyph_atlas_revision) {
+            break;
+        }
+    }
+
+    delete[] line;
+    delete[] lines;
+    dirty_layout = false;
+    dirty_vbo = true;
+
+    layout_cache.insert(layout_key, TextLayoutCache::Layout{
+        this->used_width, this->used_height, rendered_width, rendered_height,
+        glyph_quads, num_glow_quads, glyph_atlas_revision
+    });
+}
+
+
+// Add a glyph's quad, clipped to the text area, in pixels from the top
+// left of the area with y going up.
+static void add_glyph_quad(std::vector<GLfloat> &quads, const GlyphAtlas::Glyph &glyph,
+                           int pen_x, int line_y, int area_width, int area_height,
+                           int atlas_width, int atlas_height) {
+    int left(pen_x + glyph.offset_x);
+    int top(line_y + glyph.offset_y);
+
+    int clipped_left  (std::max(left, 0));
+    int clipped_top   (std::max(top,  0));
+    int clipped_right (std::min(left + glyph.width,  area_width));
+    int clipped_bottom(std::min(top  + glyph.height, area_height));
+    if (clipped_left >= clipped_right || clipped_top >= clipped_bottom) {
+        return;
+    }
+
+    float u_scale(1.0f / float(atlas_width));
+    float v_scale(1.0f / float(atlas_height));
+    std::tuple<float,float,float,float> tex_bounds(
+        float(glyph.x + clipped_left   - left) * u_scale,
+        float(glyph.x + clipped_right  - left) * u_scale,
+        float(glyph.y + clipped_bottom - top)  * v_scale,
+        float(glyph.y + clipped_top    - top)  * v_scale
+    );
+
+    size_t offset(quads.size());
+    quads.resize(offset + RenderableComponent::floats_per_quad);
+    RenderableComponent::write_quad(&quads[offset],
+                                    float(clipped_left), float(clipped_right),
+                                    float(-clipped_bottom), float(-clipped_top),
+                                    tex_bounds);
+}
+
+
+void Text::generate_glyph_quads(const char *lines, int line_count) {
+    int border = glyph_atlas->get_space_width() * 2;
+    int line_height = glyph_atlas->get_line_height();
+    int atlas_width = glyph_atlas->get_width();
+    int atlas_height = glyph_atlas->get_height();
+
+    glyph_quads.clear();
+    std::vector<GLfloat> text_quads;
+
+    const char *lines_scan = lines;
     for (int line_number = 0; line_number < line_count; ++line_number) {
-        // Render line
-        VLOG(2) << "Rendering line of text: \"" << lines_scan << "\".";
+        VLOG(2) << "Laying out line of text: \"" << lines_scan << "\".";
         if (lines_scan[0] == '\0') {
             // Skip it - it's a new line.
             lines_scan = &lines_scan[1];
             continue;
         }
 
-        SDL_Surface* rendered_line;
-        {
-            // It took a whole day to discover that there was a bug in
-            // SDL_ttf. Starting with certain characters on certain
-            // fonts seems to break it. :(
-            // As a hack, prepend and (for balance) append a space.
-            std::stringstream safe;
-            safe << " " << lines_scan << " ";
-            std::string safe_str(safe.str());
-            if (smooth) {
-                rendered_line = TTF_RenderUTF8_Shaded(font.font, safe_str.c_str(), colour, blank);
-            }
-            else {
-                rendered_line = TTF_RenderUTF8_Solid(font.font, safe_str.c_str(), colour);
-            }
-        }
+        // The width the line was rendered at, with its spaces.
+        int line_width = glyph_atlas->measure(lines_scan) + border;
 
-        if (rendered_line == nullptr) {
-            LOG(WARNING) << "Cannot render line of text: \"" << lines_scan << "\".";
-            delete[] line;
-            delete[] lines;
-            throw Text::RenderException("Cannot render line of text");
-        }
-
-#ifdef TEXT_SAFE_SURFACE
-        // This surface has a known format.
-        SDL_Surface* compatible = SDL_CreateRGBSurface(0, // Unsed
-                                                       rendered_line->w,
-                                                       rendered_line->h,
-                                                       32,
-                                                       0x00,
-                                                       0x00,
-                                                       0x00,
-                                                       0xff
-                                                       );
-        SDL_FillRect(compatible, NULL, 0);
-        SDL_SetSurfaceBlendMode(rendered_line, SDL_BLENDMODE_NONE);
-        SDL_BlitSurface(rendered_line, NULL, compatible, NULL);
-        SDL_LockSurface(compatible);
-        // pitch is in bytes, not pixels. RGBA = 4 bytes.
-        int jump = compatible->pitch / 4;
-#else
-        SDL_LockSurface(rendered_line);
-        int jump = rendered_line->pitch;
-#endif
-        // "What is this pointless copy?" you might ask.
-        //   Well, it is a suggestion to the c++ compiler that smooth
-        //   will not change throughout this function, so it can
-        //   optimise the if containing _smooth out of the for loop
-        //   entirely, rather than checking it every single iteration.
-        int _smooth = smooth;
         int x_offset;
         int y_offset;
         switch (alignment_h) {
@@ -432,10 +467,10 @@ void Text::render() {
             x_offset = glow_radius;
             break;
         case Alignment::CENTRE:
-            x_offset = (used_width - rendered_line->w) / 2;
+            x_offset = (used_width - line_width) / 2;
             break;
         case Alignment::RIGHT:
-            x_offset = used_width - rendered_line->w - glow_radius;
+            x_offset = used_width - line_width - glow_radius;
             break;
         }
         switch (alignment_v) {
@@ -444,49 +479,45 @@ void Text::render() {
             y_offset = line_number * line_height;
             break;
         case Alignment::CENTRE:
-            y_offset = line_number * line_height - (used_height - image.height) / 2;
+            y_offset = line_number * line_height - (used_height - rendered_height) / 2;
             break;
         case Alignment::BOTTOM:
-            y_offset = line_number * line_height - (used_height - image.height);
+            y_offset = line_number * line_height - (used_height - rendered_height);
             break;
         }
         y_offset += glow_radius;
-        // x surface
-        int xs;
-        // y surface
-        int ys;
-        for (ys = 0; ys < rendered_line->h; ++ys) {
-            int yi = ys + y_offset;
-            if (yi >= image.height) {
-                lost_lines++;
-                break;
-            }
-            else if (yi < 0) {
+
+        if (y_offset >= rendered_height) {
+            LOG(WARNING) << "Text overflow.";
+            break;
+        }
+
+        // Skip the leading space.
+        int pen_x = x_offset + border / 2;
+        for (const char *scan = lines_scan; *scan != '\0';) {
+            uint32_t codepoint(GlyphAtlas::next_codepoint(scan));
+
+            // Copied, as getting the glow can clear the atlas.
+            const GlyphAtlas::Glyph *found(glyph_atlas->get_glyph(codepoint));
+            if (!found) {
                 continue;
             }
-            int begin_xs((x_offset >= 0) ? 0 : -x_offset);
-            int end_xs((rendered_line->w < image.width - x_offset) ? rendered_line->w : image.width - x_offset);
-            for (xs = begin_xs; xs < end_xs; ++xs) {
-#ifdef TEXT_SAFE_SURFACE
-                image.flipped_pixels[yi][xs + x_offset].a = (((Uint32*)compatible->pixels)[(ys*jump + xs)]);
-#else
-                if (_smooth) {
-                    image.flipped_pixels[yi][xs + x_offset].a = (((Uint8*)rendered_line->pixels)[(ys*jump + xs)]);
-                }
-                else {
-                    image.flipped_pixels[yi][xs + x_offset].a = (((Uint8*)rendered_line->pixels)[(ys*jump + xs)]) ? 255 : 0;
+            GlyphAtlas::Glyph glyph(*found);
+
+            if (glow_radius > 0) {
+                const GlyphAtlas::Glyph *glow(glyph_atlas->get_glyph(codepoint, glow_radius));
+                if (glow) {
+                    add_glyph_quad(glyph_quads, *glow, pen_x, y_offset,
+                                   rendered_width, rendered_height, atlas_width, atlas_height);
                 }
-#endif
             }
+            add_glyph_quad(text_quads, glyph, pen_x, y_offset,
+                           rendered_width, rendered_height, atlas_width, atlas_height);
+
+            pen_x += glyph.advance;
         }
-#ifdef TEXT_SAFE_SURFACE
-        SDL_UnlockSurface(compatible);
-        SDL_FreeSurface(compatible);
-#else
-        SDL_UnlockSurface(rendered_line);
-#endif
-        SDL_FreeSurface(rendered_line);
-        if (ys < line_height) {
+
+        if (y_offset + line_height > rendered_height) {
             LOG(WARNING) << "Text overflow.";
             break;
         }
@@ -498,179 +529,13 @@ void Text::render() {
         lines_scan = &lines_scan[1];
     }
 
-    this->used_width  = used_width;
-    this->used_height = used_height;
-    delete[] line;
-    delete[] lines;
-    if (glow_radius > 0) {
-        apply_newson_bloom();
-    }
-    generate_texture();
-    dirty_texture = false;
-    dirty_vbo = true;
-}
-
-
-// My own spicy algorithm for creating a cheap bloom effect.
-//
-// Perform a vertical scan, to create a list of vertical distances from
-// seed points.
-// Perform a horizontal scan and calculate a winning radiance from the
-// distances in the vertical scan.
-//
-// We perform vertical scan and then horizontal to enable better
-// optimisation.
-void Text::apply_newson_bloom() {
-    // Stores distance information from the first pass.
-    int* vertical_scan(new int[image.width*image.height]);
-    int width = image.width;
-    int height = image.height;
-    int grpo = glow_radius + 1;
-
-    // Vertical Scan.
-    int i = 0;
-    for (int x = 0; x < width; ++x) {
-        int seed_y = 0;
-        for (; seed_y < height && image[seed_y][x].a == 0; ++seed_y);
-        if (seed_y == height) {
-            // It's a blank line, so move on.
-            for (int y = 0; y < height; ++y) {
-                vertical_scan[i] = 0;
-                i += width;
-            }
-        } else {
-            int seed_y_prev = -1;
-            for (int y = 0; y < height; ++y) {
-                if (y == seed_y) {
-                    // Find the next seed (or go outside of image).
-                    for (++seed_y; seed_y < height && image[seed_y][x].a == 0; ++seed_y);
-                    seed_y_prev = y;
-                }
-            
-                int r(0);
-                if (seed_y_prev != -1) {
-                    // Calculate radius from distance from last seed.
-                    r = glow_radius - (y - seed_y_prev);
-                }
-                if (seed_y != height) {
-                    // Calculate radius from distance from next seed.
-                    int r2(glow_radius - (seed_y - y));
-                    if (r2 > r) {
-                        r = r2;
-                    }
-                }
-                if (r > 0) {
-                    vertical_scan[i] = r;
-                }
-                else {
-                    // If it's too far away, set radiance to 0.
-                    vertical_scan[i] = 0;
-                }
-                i += width;
-            }
-        }
-        i += 1 - (width * height);
-    }
-
-    // Pre-compute pythagoras's theorem and 0-255 scale strength.
-    int* pythag(new int[(grpo)*(grpo)]);
-    for (int y = 0; y <= glow_radius; ++y) {
-        int ry = glow_radius - y;
-        for (int x = 0; x <= glow_radius; ++x) {
-            int rx = x;
-            int score(int((float(glow_radius) - sqrt(float(rx*rx + ry*ry))) * 255.0f / float(glow_radius)));
-            pythag[x+y*grpo] = (score > 0) ? score*score/255 : 0;
-        }
-    }
-
-    // Pre-compute merge colours.
-    uint8_t merge_rgba[4][256];
-    for (int a = 0; a < 256; ++a) {
-        merge_rgba[0][a] = uint8_t(((255-a) * glow_rgba[0] + a * rgba[0]) / 255);
-        merge_rgba[1][a] = uint8_t(((255-a) * glow_rgba[1] + a * rgba[1]) / 255);
-        merge_rgba[2][a] = uint8_t(((255-a) * glow_rgba[2] + a * rgba[2]) / 255);
-        merge_rgba[3][a] = uint8_t(((255-a) * glow_rgba[3] + a * rgba[3]) / 255);
-    }
-
-    // Pre-compute radiance alpha.
-    uint8_t radiance[256];
-    for (int r = 0; r < 256; ++r) {
-        radiance[r] = uint8_t(int(glow_rgba[3]) * r / 255);
-    }
-    // uint8_t* radiance(new uint8_t[glow_radius+1]);
-    // for (int r = 0; r <= glow_radius; ++r) {
-    //     radiance[r] = uint8_t(int(glow_rgba[3]) * r / glow_radius);
-    // }
-
-    // Horizontal Scan.
-    i = 0;
-    for (int y = 0; y < height; ++y) {
-        for (int x = 0; x < width; ++x) {
-            int winner = pythag[vertical_scan[i]*grpo];
-
-            // Don't go over solid text.
-            if (image[y][x].a == 0) {
-                for (int dx = 1; dx < glow_radius; ++dx) {
-                    int candidate(0);
-                    if (x - dx >= 0) {
-                        candidate = pythag[dx+vertical_scan[i - dx]*grpo];
-                    }
-                    if (x + dx < width) {
-                        int candidate2(pythag[dx+vertical_scan[i + dx]*grpo]);
-                        if (candidate2 > candidate) {
-                            candidate = candidate2;
-                        }
-                    }
-                    if (candidate > winner) {
-                        winner = candidate;
-                    }
-                }
-                image[y][x].r = glow_rgba[0];
-                image[y][x].g = glow_rgba[1];
-                image[y][x].b = glow_rgba[2];
-                image[y][x].a = radiance[winner];
-            }
-            else {
-                    image[y][x].r = merge_rgba[0][image[y][x].a];
-                    image[y][x].g = merge_rgba[1][image[y][x].a];
-                    image[y][x].b = merge_rgba[2][image[y][x].a];
-                    image[y][x].a = merge_rgba[3][image[y][x].a];
-            }
-            ++i;
-        }
-    }
-
-    delete[] vertical_scan;
-    delete[] pythag;
-}
-
-
-void Text::generate_texture() {
-    if (texture != 0) {
-        glDeleteTextures(1, &texture);
-    }
-
-    glGenTextures(1, &texture);
-
-    if (texture == 0) {
-        LOG(ERROR) << "Error rendering text: Unable to generate GL texture.";
-        throw Text::RenderException("Unable to generate GL texture");
-    }
-
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, texture);
-    // For some STUPID reason, GL ES seems to be forcing me to waster
-    // RGB channels for padding, on a system with little memory.
-    // Look into this later.
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, image.store_width, image.store_height, 0, GL_RGBA, GL_UNSIGNED_BYTE, image.pixels);
-    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glBindTexture(GL_TEXTURE_2D, 0);
+    num_glow_quads = GLsizei(glyph_quads.size() / RenderableComponent::floats_per_quad);
+    glyph_quads.insert(std::end(glyph_quads), std::begin(text_quads), std::end(text_quads));
 }
 
 
 void Text::generate_vbo() {
-    if (dirty_texture) {
+    if (dirty_layout) {
         return;
     }
     if (vbo == 0) {
@@ -682,49 +547,26 @@ void Text::generate_vbo() {
         }
     }
 
-    std::pair<float, float> ratio_xy = get_top_left_ratio();
-    std::pair<float, float> ratio_wh = get_rendered_size_ratio();
     // We are working with opengl coordinates where we strech from -1.0
     // to 1.0 across the window.
-    float rx = ratio_xy.first * 2.0f - 1.0f;
-    float ry = ratio_xy.second * 2.0f - 1.0f;
-    float rw = ratio_wh.first * 2.0f;
-    float rh = ratio_wh.second * 2.0f;
-    float tw = (float)image.width  / (float)image.store_width;
-    float th = 1.0f - ((float)image.height / (float)image.store_height);
-
-    // float rx = -1.0f;
-    // float ry = -1.0f;
-    // float rw = 2.0f;
-    // float rh = 2.0f;
-    // float tw = 1.0f;
-    // float th = 1.0f;
-
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    // There are 4 vertices in a rectangle, but we use 6 vertices in 2
-    // triangles to make the rectangle.
-    // Each vertex has 2 floats for position, and 2 floats for texture
-    // coordinates.
+    std::pair<int,int> top_left = get_top_left();
+    std::pair<int,int> window_size = window->get_size();
+    float scale_x = 2.0f / float(window_size.first);
+    float scale_y = 2.0f / float(window_size.second);
+    float rx = float(top_left.first)  * scale_x - 1.0f;
+    float ry = float(top_left.second) * scale_y - 1.0f;
+
     // Format: vertex_x, vertex_y, texture_x, texture_y, ...
-    GLfloat vbo_data[] = {
-        // Triangle 1:
-        //     Bottom-left  (0, 0)
-        rx     , ry - rh, 0.0f, th  ,
-        //     Top-left     (0, 1)
-        rx     , ry     , 0.0f, 1.0f,
-        //     Top-right    (1, 1)
-        rx + rw, ry     , tw  , 1.0f,
-        // Triangle 2:
-        //     Bottom-left  (0, 0)
-        rx     , ry - rh, 0.0f, th  ,
-        //     Top-right    (1, 1)
-        rx + rw, ry     , tw  , 1.0f,
-        //     Bottom-right (1, 0)
-        rx + rw, ry - rh, tw  , th  ,
-    };
-
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vbo_data), vbo_data, GL_STATIC_DRAW);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    std::vector<GLfloat> vbo_data(glyph_quads);
+    for (size_t i = 0; i < vbo_data.size(); i += RenderableComponent::floats_per_vertex) {
+        vbo_data[i    ] = rx + vbo_data[i    ] * scale_x;
+        vbo_data[i + 1] = ry + vbo_data[i + 1] * scale_y;
+    }
+
+    GLState::get_current().bind_array_buffer(vbo);
+    glBufferData(GL_ARRAY_BUFFER, vbo_data.size() * sizeof(GLfloat), vbo_data.data(), GL_STATIC_DRAW);
+    GPUMemory::get_current().set_buffer(vbo, GPUMemory::Category::TEXT, vbo_data.size() * sizeof(GLfloat));
+    RenderStats::get_instance().record_upload(vbo_data.size() * sizeof(GLfloat));
 
     dirty_vbo = false;
 }
@@ -732,17 +574,18 @@ void Text::generate_vbo() {
 
 void Text::set_text(std::string text) {
     this->text = text;
-    dirty_texture = true;
+    dirty_layout = true;
+    window->request_redraw();
 }
 
 
 std::pair<int,int> Text::get_rendered_size() {
-    // Needed to update image size.
-    if (dirty_texture) {
-        render();
+    // Needed to update the laid out size.
+    if (dirty_layout) {
+        layout();
     }
 
-    return std::make_pair(image.width, image.height);
+    return std::make_pair(rendered_width, rendered_height);
 }
 
 std::pair<float,float> Text::get_rendered_size_ratio() {
@@ -751,9 +594,9 @@ std::pair<float,float> Text::get_rendered_size_ratio() {
 
 
 std::pair<int,int> Text::get_text_size() {
-    // Needed to update image size.
-    if (dirty_texture) {
-        render();
+    // Needed to update the laid out size.
+    if (dirty_layout) {
+        layout();
     }
 
     return std::make_pair(used_width, used_height);
@@ -781,9 +624,9 @@ std::pair<float,float> Text::get_origin_ratio() {
 }
 
 std::pair<int,int> Text::get_top_left() {
-    // Needed to update image size.
-    if (dirty_texture) {
-        render();
+    // Needed to update the laid out size.
+    if (dirty_layout) {
+        layout();
     }
 
     int x_final;
@@ -794,10 +637,10 @@ std::pair<int,int> Text::get_top_left() {
             x_final = x;
             break;
         case Alignment::CENTRE:
-            x_final = x - (image.width / 2);
+            x_final = x - (rendered_width / 2);
             break;
         case Alignment::RIGHT:
-            x_final = x - image.width;
+            x_final = x - rendered_width;
             break;
         }
     } else {
@@ -812,10 +655,10 @@ std::pair<int,int> Text::get_top_left() {
             y_final = y;
             break;
         case Alignment::CENTRE:
-            y_final = y + (image.height / 2);
+            y_final = y + (rendered_height / 2);
             break;
         case Alignment::BOTTOM:
-            y_final = y + image.height;
+            y_final = y + rendered_height;
             break;
         }
     } else {
@@ -833,42 +676,48 @@ std::pair<float,float> Text::get_top_left_ratio() {
 void Text::align_left() {
     if (alignment_h != Alignment::LEFT) {
         alignment_h = Alignment::LEFT;
-        dirty_texture = true;
+        dirty_layout = true;
+        window->request_redraw();
     }
 }
 
 void Text::align_centre() {
     if (alignment_h != Alignment::CENTRE) {
         alignment_h = Alignment::CENTRE;
-        dirty_texture = true;
+        dirty_layout = true;
+        window->request_redraw();
     }
 }
 
 void Text::align_right() {
     if (alignment_h != Alignment::RIGHT) {
         alignment_h = Alignment::RIGHT;
-        dirty_texture = true;
+        dirty_layout = true;
+        window->request_redraw();
     }
 }
 
 void Text::vertical_align_top() {
     if (alignment_v != Alignment::TOP) {
         alignment_v = Alignment::TOP;
-        dirty_texture = true;
+        dirty_layout = true;
+        window->request_redraw();
     }
 }
 
 void Text::vertical_align_centre() {
     if (alignment_v != Alignment::CENTRE) {
         alignment_v = Alignment::CENTRE;
-        dirty_texture = true;
+        dirty_layout = true;
+        window->request_redraw();
     }
 }
 
 void Text::vertical_align_bottom() {
     if (alignment_v != Alignment::BOTTOM) {
         alignment_v = Alignment::BOTTOM;
-        dirty_texture = true;
+        dirty_layout = true;
+        window->request_redraw();
     }
 }
 
@@ -877,6 +726,7 @@ void Text::align_at_origin(bool aao) {
     if (aao != position_from_alignment) {
         position_from_alignment = aao;
         dirty_vbo = true;
+        window->request_redraw();
     }
 }
 
@@ -886,13 +736,14 @@ void Text::set_colour(uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
     rgba[1] = g;
     rgba[2] = b;
     rgba[3] = a;
-    dirty_texture = true;
+    window->request_redraw();
 }
 
 
 void Text::set_bloom_radius(int radius) {
     glow_radius = (radius >= 0) ? radius : 0;
-    dirty_texture = true;
+    dirty_layout = true;
+    window->request_redraw();
 }
 
 
@@ -901,7 +752,7 @@ void Text::set_bloom_colour(uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
     glow_rgba[1] = g;
     glow_rgba[2] = b;
     glow_rgba[3] = a;
-    dirty_texture = true;
+    window->request_redraw();
 }
 
 
@@ -917,8 +768,9 @@ void Text::resize(int w, int h) {
     if (width != w || height != h) {
         width = w;
         height = h;
-        dirty_texture = true;
+        dirty_layout = true;
         dirty_vbo = true;
+        window->request_redraw();
     }
 }
 
@@ -940,8 +792,9 @@ void Text::resize_ratio(float w, float h) {
     if (width != iw || height != ih) {
         width = iw;
         height = ih;
-        dirty_texture = true;
+        dirty_layout = true;
         dirty_vbo = true;
+        window->request_redraw();
     }
 }
 
@@ -951,6 +804,7 @@ void Text::move(int x, int y) {
 
     if (this->x != x || this->y != y) {
         dirty_vbo = true;
+        window->request_redraw();
     }
     this->x = x;
     this->y = y;
@@ -969,14 +823,21 @@ void Text::move_ratio(float x, float y) {
         this->x = ix;
         this->y = iy;
         dirty_vbo = true;
+        window->request_redraw();
     }
 }
 
 void Text::display() {
+    Profiler::Scope profile("Text::display");
+
     window->use_context();
-    if (dirty_texture) {
+    if (glyph_atlas->get_revision() != glyph_atlas_revision) {
+        // The glyphs have moved in the atlas.
+        dirty_layout = true;
+    }
+    if (dirty_layout) {
         try {
-            render();
+            layout();
         }
         catch (Text::RenderException e) {
             LOG(WARNING) << e.what();
@@ -1001,27 +862,43 @@ void Text::display() {
         return;
     }
 
+    GLsizei num_quads(GLsizei(glyph_quads.size() / RenderableComponent::floats_per_quad));
+    if (num_quads == 0) {
+        return;
+    }
+
     std::shared_ptr<Shader> shader = shaders.find(window)->second;
-    glUseProgram(shader->get_program());
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, texture);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    GLState &gl_state(GLState::get_current());
+    gl_state.use_program(shader->get_program());
+    gl_state.active_texture(GL_TEXTURE0);
+    glyph_atlas->get_gl_texture();
+    gl_state.bind_array_buffer(vbo);
     glDisable(GL_DEPTH_TEST);
 
-    // Position data.
-    glVertexAttribPointer(SHADER_LOCATION_POSITION, 2, GL_FLOAT, GL_FALSE, 4 * (GLsizei)sizeof(GLfloat), (GLvoid*)(0 * sizeof(GLfloat)));
-    // Texture data.
-    glVertexAttribPointer(SHADER_LOCATION_TEXTURE, 2, GL_FLOAT, GL_FALSE, 4 * (GLsizei)sizeof(GLfloat), (GLvoid*)(2 * sizeof(GLfloat)));
-    glEnableVertexAttribArray(SHADER_LOCATION_POSITION);
-    glEnableVertexAttribArray(SHADER_LOCATION_TEXTURE);
+    gl_state.enable_attribute(SHADER_LOCATION_POSITION);
+    gl_state.enable_attribute(SHADER_LOCATION_TEXTURE);
 
     glEnable(GL_BLEND);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
-    glDrawArrays(GL_TRIANGLES, 0, 6);
+    GLint colour_location(shader->get_uniform_location(SHADER_VARIABLE_COLOUR));
+    GLint glow_radius_location(shader->get_uniform_location(SHADER_VARIABLE_GLOW_RADIUS));
+    glUniform1f(shader->get_uniform_location(SHADER_VARIABLE_GLOW_SPREAD), float(GlyphAtlas::max_distance));
+
+    // The glows go under all of the glyphs, so are drawn first. Small
+    // glows are drawn from the glyphs' distance fields by the shader;
+    // larger ones were worked out when laid out.
+    if (num_glow_quads > 0) {
+        glUniform4f(colour_location, float(glow_rgba[0]) / 255.0f, float(glow_rgba[1]) / 255.0f,
+                                     float(glow_rgba[2]) / 255.0f, float(glow_rgba[3]) / 255.0f);
+        glUniform1f(glow_radius_location, glow_radius <= GlyphAtlas::max_distance ? float(glow_radius) : 0.0f);
+        RenderableComponent::draw_quad_range(0, num_glow_quads);
+    }
+
+    glUniform4f(colour_location, float(rgba[0]) / 255.0f, float(rgba[1]) / 255.0f,
+                                 float(rgba[2]) / 255.0f, float(rgba[3]) / 255.0f);
+    glUniform1f(glow_radius_location, 0.0f);
+    RenderableComponent::draw_quad_range(num_glow_quads, num_quads - num_glow_quads);
 
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindTexture(GL_TEXTURE_2D, 0);
-    glUseProgram(0);
     glEnable(GL_DEPTH_TEST);
 }
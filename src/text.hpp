@@ -12,20 +12,26 @@ extern "C" {
 #endif
 }
 
+#include <memory>
 #include <stdexcept>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "text_font.hpp"
-#include "image.hpp"
 #include "callback.hpp"
 
 class GameWindow;
+class GlyphAtlas;
 
 
 
 ///
-/// Text (box) which uses an image as its display method.
+/// Text (box) which is drawn as a quad per glyph from the font's shared
+/// glyph atlas.
+///
+/// Changing the text only lays it out again; glyphs are rasterised once
+/// per font.
 ///
 /// Must be passed around by reference or pointer.
 ///
@@ -35,9 +41,9 @@ private:
         LEFT, RIGHT, TOP, BOTTOM, CENTRE
     };
     ///
-    /// If true, the text needs to be re-rendered.
+    /// If true, the text needs to be laid out again.
     ///
-    bool dirty_texture;
+    bool dirty_layout;
     ///
     /// If true, the text vbo needs to be re-generated.
     ///
@@ -128,13 +134,22 @@ private:
     ///
     bool ratio_position;
     ///
-    /// Image used to store the rendered text
+    /// The width of the laid out text area.
+    ///
+    int rendered_width;
+    ///
+    /// The height of the laid out text area.
+    ///
+    int rendered_height;
+    ///
+    /// The quads of the glyphs' glows followed by the glyphs, in pixels
+    /// from the top left of the text area.
     ///
-    Image image;
+    std::vector<GLfloat> glyph_quads;
     ///
-    /// Texture used in opengl.
+    /// The number of glow quads at the start of glyph_quads.
     ///
-    GLuint texture;
+    GLsizei num_glow_quads;
     ///
     /// Vertex buffer object used in opengl.
     ///
@@ -155,6 +170,14 @@ private:
     ///
     TextFont font;
     ///
+    /// The glyphs of the font.
+    ///
+    std::shared_ptr<GlyphAtlas> glyph_atlas;
+    ///
+    /// The revision of the glyph atlas the text was laid out at.
+    ///
+    int glyph_atlas_revision;
+    ///
     /// The game window to draw on.
     ///
     GameWindow* window;
@@ -164,19 +187,17 @@ private:
     Callback<void,GameWindow*> resize_callback;
 
     ///
-    /// Re-render the text.
+    /// Wrap the text into lines and lay out its glyphs.
     ///
-    void render();
+    void layout();
 
     ///
-    /// Applies a bloom effect to text.
-    ///
-    void apply_newson_bloom();
-
+    /// Lay out the glyphs of wrapped lines into glyph_quads.
     ///
-    /// Create an OpenGL texture from the image.
+    /// @param lines null-terminator separated lines of text
+    /// @param line_count the number of lines
     ///
-    void generate_texture();
+    void generate_glyph_quads(const char *lines, int line_count);
 
     ///
     /// Creates text-specific vertex buffer object.
@@ -319,16 +340,14 @@ public:
     void set_bloom_colour(uint8_t r, uint8_t g, uint8_t b, uint8_t a);
 
     ///
-    /// Render the text to an image, and subsequently to an OpenGL
-    /// texture, give size information.
+    /// Set the size of the text area.
     ///
     /// Width and height are given in pixels. If a dimension is 0, then
     /// it is automatically sized.
     ///
     void resize(int w, int h);
     ///
-    /// Render the text to an image, and subsequently to an OpenGL
-    /// texture, give size information.
+    /// Set the size of the text area.
     ///
     /// Width and height are given in screen ratios. If a dimension is
     /// 0, then it is automatically sized.
@@ -17,7 +17,10 @@ TextFont::LoadException::LoadException(const char *message): std::runtime_error(
 TextFont::LoadException::LoadException(const std::string &message): std::runtime_error(message) {}
 
 
-TextFont::TextFont(Typeface face, int size) {
+TextFont::TextFont(Typeface face, int size):
+    filename(face.filename),
+    size(size) {
+
     TTF_Font* font = TTF_OpenFont(face.filename.c_str(), size);
 
     if (font == nullptr) {
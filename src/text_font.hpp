@@ -19,6 +19,7 @@ class Typeface;
 ///
 class TextFont {
 private:
+    friend class GlyphAtlas;
     friend class Text;
     ///
     /// Destroy font when there are no more instances left.
@@ -28,6 +29,14 @@ private:
     /// Underlying SDL font.
     ///
     TTF_Font* font;
+    ///
+    /// The ttf file the font was opened from.
+    ///
+    std::string filename;
+    ///
+    /// The point size the font was opened at.
+    ///
+    int size;
 public:
     ///
     /// Represents a failure in loading
@@ -0,0 +1,78 @@
+#include <glog/logging.h>
+#include <iterator>
+#include <ostream>
+#include <tuple>
+#include <utility>
+
+#include "text_layout_cache.hpp"
+
+const size_t TextLayoutCache::max_bytes;
+
+bool TextLayoutCache::Key::operator<(const Key &other) const {
+    return std::tie(      text,       glyph_atlas,       width,       height,
+                          alignment_h,       alignment_v,       glow_radius)
+         < std::tie(other.text, other.glyph_atlas, other.width, other.height,
+                    other.alignment_h, other.alignment_v, other.glow_radius);
+}
+
+TextLayoutCache &TextLayoutCache::get_instance() {
+    // Lazy instantiation of the global instance
+    static TextLayoutCache global_instance;
+
+    return global_instance;
+}
+
+size_t TextLayoutCache::entry_bytes(const Key &key, const Layout &layout) {
+    return sizeof(Key) + key.text.size() + sizeof(Layout) + layout.glyph_quads.size() * sizeof(GLfloat);
+}
+
+void TextLayoutCache::erase(EntryList::iterator entry) {
+    used_bytes -= entry_bytes(entry->first, entry->second);
+    index.erase(entry->first);
+    entries.erase(entry);
+}
+
+const TextLayoutCache::Layout *TextLayoutCache::find(const Key &key, int glyph_atlas_revision) {
+    auto found(index.find(key));
+    if (found == std::end(index)) {
+        ++misses;
+        return nullptr;
+    }
+
+    // The glyphs have moved since it was laid out
+    if (found->second->second.glyph_atlas_revision != glyph_atlas_revision) {
+        erase(found->second);
+        ++misses;
+        return nullptr;
+    }
+
+    ++hits;
+    entries.splice(std::begin(entries), entries, found->second);
+    return &found->second->second;
+}
+
+void TextLayoutCache::insert(const Key &key, const Layout &layout) {
+    auto found(index.find(key));
+    if (found != std::end(index)) {
+        erase(found->second);
+    }
+
+    entries.emplace_front(key, layout);
+    index[key] = std::begin(entries);
+    used_bytes += entry_bytes(key, layout);
+
+    // Always keep the newest entry, even if it is over budget alone
+    while (used_bytes > max_bytes && entries.size() > 1) {
+        erase(std::prev(std::end(entries)));
+        ++evictions;
+    }
+
+    VLOG(3) << "TextLayoutCache: " << entries.size() << " layouts in " << used_bytes << " bytes, "
+            << hits << " hits, " << misses << " misses, " << evictions << " evictions";
+}
+
+void TextLayoutCache::clear() {
+    entries.clear();
+    index.clear();
+    used_bytes = 0;
+}
@@ -0,0 +1,149 @@
+#ifndef TEXT_LAYOUT_CACHE_H
+#define TEXT_LAYOUT_CACHE_H
+
+#include <cstddef>
+#include <list>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+extern "C" {
+#ifdef USE_GL
+#define GL_GLEXT_PROTOTYPES
+#include <GL/gl.h>
+#endif
+
+#ifdef USE_GLES
+#include <GLES2/gl2.h>
+#endif
+}
+
+class GlyphAtlas;
+
+///
+/// A process-wide cache of laid out text, so that strings which are
+/// shown again, such as button labels, notifications being paged
+/// through and the tile readout, are not wrapped and laid out again.
+///
+/// The glyphs themselves are shared through the GlyphAtlas, so only
+/// the glyph quads are stored. The least recently used layouts are
+/// dropped when the cache holds more than max_bytes.
+///
+class TextLayoutCache {
+public:
+    ///
+    /// Everything a layout depends on. Colours are not included, as
+    /// they are applied when drawing.
+    ///
+    struct Key {
+        std::string text;
+        const GlyphAtlas *glyph_atlas;
+
+        ///
+        /// The size of the text area after automatic sizing
+        ///
+        int width;
+        int height;
+
+        int alignment_h;
+        int alignment_v;
+        int glow_radius;
+
+        bool operator<(const Key &other) const;
+    };
+
+    ///
+    /// Laid out text, as kept by Text
+    ///
+    struct Layout {
+        int used_width;
+        int used_height;
+        int rendered_width;
+        int rendered_height;
+
+        ///
+        /// The quads of the glyphs' glows followed by the glyphs
+        ///
+        std::vector<GLfloat> glyph_quads;
+        GLsizei num_glow_quads;
+
+        ///
+        /// The revision of the glyph atlas the quads refer to
+        ///
+        int glyph_atlas_revision;
+    };
+
+private:
+    ///
+    /// The most memory the layouts may use
+    ///
+    static const size_t max_bytes = 1024 * 1024;
+
+    typedef std::list<std::pair<Key, Layout>> EntryList;
+
+    ///
+    /// Layouts from most to least recently used
+    ///
+    EntryList entries;
+
+    ///
+    /// The entries by key
+    ///
+    std::map<Key, EntryList::iterator> index;
+
+    ///
+    /// The memory used by the entries
+    ///
+    size_t used_bytes = 0;
+
+    size_t hits = 0;
+    size_t misses = 0;
+    size_t evictions = 0;
+
+    TextLayoutCache() {}
+
+    ///
+    /// The memory used by an entry, roughly
+    ///
+    static size_t entry_bytes(const Key &key, const Layout &layout);
+
+    ///
+    /// Drop an entry
+    ///
+    void erase(EntryList::iterator entry);
+
+public:
+    static TextLayoutCache &get_instance();
+
+    TextLayoutCache(const TextLayoutCache &) = delete;
+    TextLayoutCache &operator=(const TextLayoutCache &) = delete;
+
+    ///
+    /// Find a layout, marking it as recently used
+    /// @param key what the layout depends on
+    /// @param glyph_atlas_revision the current revision of the atlas;
+    ///        older layouts are dropped
+    /// @return the layout, or nullptr if there is none
+    ///
+    const Layout *find(const Key &key, int glyph_atlas_revision);
+
+    ///
+    /// Add a layout, replacing any with the same key, and drop the least
+    /// recently used layouts until the cache fits its budget
+    ///
+    void insert(const Key &key, const Layout &layout);
+
+    ///
+    /// Drop every layout
+    ///
+    void clear();
+
+    size_t get_num_entries() { return entries.size(); }
+    size_t get_used_bytes() { return used_bytes; }
+    size_t get_hits() { return hits; }
+    size_t get_misses() { return misses; }
+    size_t get_evictions() { return evictions; }
+};
+
+#endif
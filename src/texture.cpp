@@ -73,7 +73,7 @@ Texture::Texture(std::shared_ptr<TextureAtlas> atlas, int index):
 
 
 GLuint Texture::get_gl_texture() {
-    return atlas->get_gl_texture();
+    return atlas->get_gl_texture(atlas->index_to_page(index));
 }
 
 
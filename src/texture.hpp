@@ -91,7 +91,7 @@ public:
     Texture(std::shared_ptr<TextureAtlas> atlas, int index);
 
     ///
-    /// Get the underlying GL texture id.
+    /// Get the underlying GL texture id of the page holding the texture.
     ///
     GLuint get_gl_texture();
     ///
@@ -1,12 +1,21 @@
 // Try funky initialization in if.
 
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
 #include <exception>
 #include <fstream>
+#include <future>
 #include <glog/logging.h>
+#include <iterator>
+#include <map>
 #include <memory>
 #include <set>
 #include <sstream>
 #include <stdexcept>
+#include <string>
 #include <tuple>
 #include <utility>
 #include <vector>
@@ -22,10 +31,26 @@ extern "C" {
 #endif
 }
 
+#ifndef GL_ETC1_RGB8_OES
+#define GL_ETC1_RGB8_OES 0x8D64
+#endif
+
+#ifndef GL_COMPRESSED_RGB8_ETC2
+#define GL_COMPRESSED_RGB8_ETC2 0x9274
+#endif
+
+#include "asset_cache.hpp"
+#include "asset_loader.hpp"
 #include "cacheable_resource.hpp"
 #include "engine.hpp"
+#include "etc1.hpp"
 #include "fml.hpp"
+#include "gl_state.hpp"
+#include "gpu_memory.hpp"
+#include "graphics_context.hpp"
 #include "image.hpp"
+#include "pixel_ops.hpp"
+#include "render_stats.hpp"
 #include "resource_cache.hpp"
 #include "texture_atlas.hpp"
 
@@ -47,6 +72,22 @@ std::map<std::string, std::string> const &TextureAtlas::names_to_tilesets() {
 
 // std::map<GraphicsContext*, std::shared_ptr<ResourceCache<TextureAtlas>>> TextureAtlas::atlas_caches;
 
+std::map<std::string, const AssetCache::Source *> TextureAtlas::baked_sources;
+
+std::map<std::string, const AssetLoader::DecodedImage *> TextureAtlas::decoded_images;
+
+bool TextureAtlas::upload_deferred(false);
+int TextureAtlas::max_page_size(0);
+
+std::deque<TextureAtlas::QueuedUpload> TextureAtlas::queued_uploads;
+
+// The Pi has little GPU memory to spare
+#ifdef USE_GLES
+TextureAtlas::Quality TextureAtlas::quality(TextureAtlas::Quality::REDUCED);
+#else
+TextureAtlas::Quality TextureAtlas::quality(TextureAtlas::Quality::FULL);
+#endif
+
 
 
 // Need to inherit constructors manually.
@@ -57,6 +98,16 @@ TextureAtlas::LoadException::LoadException(const std::string &message): std::run
 
 
 std::shared_ptr<TextureAtlas> TextureAtlas::new_resource(const std::string resource_name) {
+    auto baked_source(baked_sources.find(resource_name));
+    if (baked_source != std::end(baked_sources)) {
+        return std::shared_ptr<TextureAtlas>(new TextureAtlas(*baked_source->second));
+    }
+
+    auto decoded_image(decoded_images.find(resource_name));
+    if (decoded_image != std::end(decoded_images)) {
+        return std::shared_ptr<TextureAtlas>(new TextureAtlas(*decoded_image->second));
+    }
+
     std::shared_ptr<TextureAtlas> atlas = std::make_shared<TextureAtlas>(resource_name);
 
     try {
@@ -116,29 +167,156 @@ void TextureAtlas::merge(const std::vector<std::shared_ptr<TextureAtlas>> &atlas
     }
     
     for (auto atlas : atlases) {
+        // Baked atlases have not been decoded.
+        atlas->load_image();
         // Free up the old textures, reset layout.
         atlas->deinit_texture();
         // Remove old super atlas(es).
         atlas->super_atlas.reset();
         atlas->reset_layout();
     }
-    // Create images with allocation.
+    // Create images with allocation. This sets the atlases' offsets.
     std::shared_ptr<TextureAtlas> super_atlas = std::shared_ptr<TextureAtlas>(new TextureAtlas(atlases));
 
+    attach_sub_atlases(super_atlas, std::vector<std::shared_ptr<TextureAtlas>>(std::begin(atlases), std::end(atlases)));
+}
+
+
+void TextureAtlas::attach_sub_atlases(std::shared_ptr<TextureAtlas> super_atlas,
+                                      const std::vector<std::shared_ptr<TextureAtlas>> &atlases) {
     // Update references between super and sub atlases.
-    int sub_offset = 0;
     for (auto atlas : atlases) {
-        atlas->index_offset = sub_offset;
         atlas->super_atlas = super_atlas;
         super_atlas->sub_atlases.push_back(std::weak_ptr<TextureAtlas>(atlas));
-        sub_offset += atlas->get_texture_count();
     }
 }
 
 
+std::vector<std::shared_ptr<TextureAtlas>> TextureAtlas::load_merged(std::vector<std::string> image_paths,
+                                                                     const AssetLoader::DecodedAtlases *decoded) {
+    std::sort(std::begin(image_paths), std::end(image_paths));
+    image_paths.erase(std::unique(std::begin(image_paths), std::end(image_paths)), std::end(image_paths));
+
+    // Atlases which are already loaded may be merged with others, so
+    // only sets loaded afresh are taken from or written to the cache.
+    bool any_shared(std::any_of(std::begin(image_paths), std::end(image_paths),
+                                [] (const std::string &image_path) { return is_shared(image_path); }));
+
+    int max_texture_size(get_max_page_size());
+
+    std::vector<std::shared_ptr<TextureAtlas>> atlases;
+
+    // Atlases kept loaded, such as by the resource cache between
+    // challenges, may already be merged together
+    if (!image_paths.empty() && std::all_of(std::begin(image_paths), std::end(image_paths),
+                                            [] (const std::string &image_path) { return is_shared(image_path); })) {
+        for (const std::string &image_path : image_paths) {
+            atlases.push_back(TextureAtlas::get_shared(image_path));
+        }
+
+        std::shared_ptr<TextureAtlas> super_atlas(atlases.front()->super_atlas);
+        if (super_atlas && std::all_of(std::begin(atlases), std::end(atlases),
+                                       [&] (const std::shared_ptr<TextureAtlas> &atlas) { return atlas->super_atlas == super_atlas; })) {
+            VLOG(1) << "Atlases already merged into " << super_atlas;
+            return atlases;
+        }
+
+        TextureAtlas::merge(atlases);
+        return atlases;
+    }
+
+    // The asset loader has already looked in the cache
+    AssetCache::Atlas loaded;
+    const AssetCache::Atlas *baked(nullptr);
+    if (!image_paths.empty() && !any_shared) {
+        if (decoded) {
+            baked = decoded->is_baked ? &decoded->baked : nullptr;
+        }
+        else if (AssetCache::load(image_paths, Engine::get_tile_size(), Engine::get_tile_size(), max_texture_size, loaded)) {
+            baked = &loaded;
+        }
+    }
+
+    if (baked) {
+        for (const AssetCache::Source &source : baked->sources) {
+            baked_sources[source.image_path] = &source;
+        }
+
+        try {
+            for (const AssetCache::Source &source : baked->sources) {
+                atlases.push_back(TextureAtlas::get_shared(source.image_path));
+            }
+        }
+        catch (...) {
+            baked_sources.clear();
+            throw;
+        }
+        baked_sources.clear();
+
+        attach_sub_atlases(std::shared_ptr<TextureAtlas>(new TextureAtlas(*baked)), atlases);
+        return atlases;
+    }
+
+    if (decoded) {
+        for (const AssetLoader::DecodedImage &image : decoded->images) {
+            decoded_images[image.image_path] = &image;
+        }
+    }
+
+    try {
+        for (const std::string &image_path : image_paths) {
+            atlases.push_back(TextureAtlas::get_shared(image_path));
+        }
+    }
+    catch (...) {
+        decoded_images.clear();
+        throw;
+    }
+    decoded_images.clear();
+
+    TextureAtlas::merge(atlases);
+
+    if (!image_paths.empty() && !any_shared) {
+        bake(*atlases.front()->super_atlas, max_texture_size);
+    }
+
+    return atlases;
+}
+
+
+void TextureAtlas::bake(const TextureAtlas &super_atlas, int max_texture_size) {
+    AssetCache::Atlas baked;
+    baked.unit_w = super_atlas.unit_w;
+    baked.unit_h = super_atlas.unit_h;
+    baked.unit_columns = super_atlas.unit_columns;
+    baked.unit_rows = super_atlas.unit_rows;
+    baked.max_texture_size = max_texture_size;
+    baked.pages = super_atlas.gl_images;
+
+    for (auto sub_atlas : super_atlas.sub_atlases) {
+        std::shared_ptr<TextureAtlas> atlas(sub_atlas.lock());
+        if (!atlas) {
+            return;
+        }
+
+        AssetCache::Source source;
+        source.image_path = atlas->resource_name;
+        source.width = atlas->image.width;
+        source.height = atlas->image.height;
+        source.index_offset = atlas->index_offset;
+        source.names_to_indexes = atlas->names_to_indexes;
+        baked.sources.push_back(source);
+    }
+
+    // Hashing the sources and writing the file can be done whilst the
+    // map loads. The pages are shared, and no longer change.
+    AssetLoader::get_instance().run<void>([baked] () mutable { AssetCache::save(baked); });
+}
+
+
 
 TextureAtlas::TextureAtlas(const std::set<std::shared_ptr<TextureAtlas>, std::owner_less<std::shared_ptr<TextureAtlas>>> &atlases):
-    gl_texture(0),
+    gl_textures(),
     reshaped(true),
     unit_w(Engine::get_tile_size()),
     unit_h(Engine::get_tile_size()),
@@ -146,53 +324,37 @@ TextureAtlas::TextureAtlas(const std::set<std::shared_ptr<TextureAtlas>, std::ow
     super_atlas(),
     names_to_indexes()
 {
+    int max_texture_size(get_max_page_size());
+
     int texture_count = 0;
+    std::vector<int> texture_counts;
+    std::vector<bool> opaque;
     // Assume all tiles are the same size. They should be...
     for (auto atlas : atlases) {
         texture_count += atlas->get_texture_count();
+        texture_counts.push_back(atlas->get_texture_count());
+        opaque.push_back(atlas->is_opaque());
     }
 
-    int max_texture_size;
-    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_texture_size);
-    int max_columns = max_texture_size / unit_w;
+    Arrangement arrangement(arrange(texture_counts, opaque, unit_w, unit_h, max_texture_size));
+    allocate_pages(arrangement);
 
-    // Naive method for getting a fitting atlas size.
-    if (max_columns >= texture_count) {
-        unit_columns = texture_count;
-        unit_rows    = 1;
-    }
-    else {
-        unit_columns = max_columns;
-        // Round up divide.
-        unit_rows    = (texture_count + max_columns - 1) / max_columns;
-    }
-    gl_image = image = Image(unit_w * unit_columns, unit_h * unit_rows, true);
-
-    indexes_to_names = std::vector<std::string>(unit_columns * unit_rows);
+    indexes_to_names = std::vector<std::string>(get_texture_count());
 
-    LOG(INFO) << "Generating super atlas: textures: " << texture_count << " = (" << unit_columns << ", " << unit_rows << ") => pixels: (" << gl_image.width << ", " << gl_image.height << ")";
+    LOG(INFO) << "Generating super atlas: textures: " << texture_count << " = (" << unit_columns << ", " << unit_rows << ") x " << gl_images.size() << " pages => pixels: (" << gl_images[0].width << ", " << gl_images[0].height << ")";
+    LOG(INFO) << "  Opaque atlases: " << std::count(std::begin(opaque), std::end(opaque), true) << " / " << opaque.size()
+              << ", opaque pages: " << std::count(std::begin(arrangement.opaque_pages), std::end(arrangement.opaque_pages), true);
 
-    textures = std::vector<std::weak_ptr<Texture>>(unit_columns * unit_rows);
+    textures = std::vector<std::weak_ptr<Texture>>(get_texture_count());
 
 
-    int super_i = 0;
+    size_t atlas_i = 0;
     for (auto atlas : atlases) {
         VLOG(1) << "Merging: " << this << " << " << atlas;
-        // Cached dereference.
-        Image* src = &atlas->image;
-        for (int i = 0, end = atlas->get_texture_count(); i < end; ++i, ++super_i) {
-            std::pair<int,int> super_units(index_to_units(super_i));
-            int dst_x_offset = super_units.first  * unit_w;
-            int dst_y_offset = super_units.second * unit_h;
-            std::pair<int,int> units(atlas->index_to_units(i));
-            int src_x_offset = units.first  * unit_w;
-            int src_y_offset = units.second * unit_h;
-            VLOG(2) << "Sub-super mapping: " << i << ": (" << src_x_offset << ", " << src_y_offset << ") -> " << super_i << ": (" << dst_x_offset << ", " << dst_y_offset << ")";
-            for (int y = 0; y < unit_h; ++y) {
-                for (int x = 0; x < unit_w; ++x) {
-                    gl_image.flipped_pixels[dst_y_offset + y][dst_x_offset + x] = src->flipped_pixels[src_y_offset + y][src_x_offset + x];
-                }
-            }
+        atlas->index_offset = arrangement.index_offsets[atlas_i++];
+        // Sub atlases have been reset to the layout of their images.
+        for (int i = 0, end = atlas->get_texture_count(); i < end; ++i) {
+            copy_unit(atlas->image, std::make_pair(i % atlas->unit_columns, i / atlas->unit_columns), atlas->index_offset + i);
         }
     }
 
@@ -201,8 +363,8 @@ TextureAtlas::TextureAtlas(const std::set<std::shared_ptr<TextureAtlas>, std::ow
 
 TextureAtlas::TextureAtlas(const std::string image_path):
     image(image_path, true),
-    gl_image(image),
-    gl_texture(0),
+    gl_images(1, image),
+    gl_textures(),
     reshaped(false),
     unit_w(Engine::get_tile_size()),
     unit_h(Engine::get_tile_size()),
@@ -218,91 +380,464 @@ TextureAtlas::TextureAtlas(const std::string image_path):
 }
 
 
+TextureAtlas::TextureAtlas(const AssetCache::Source &source):
+    image(),
+    gl_images(),
+    gl_textures(),
+    reshaped(false),
+    unit_w(Engine::get_tile_size()),
+    unit_h(Engine::get_tile_size()),
+    unit_columns(source.width  / unit_w),
+    unit_rows   (source.height / unit_h),
+    textures(unit_columns * unit_rows),
+    sub_atlases(),
+    super_atlas(),
+    index_offset(source.index_offset),
+    names_to_indexes(source.names_to_indexes),
+    indexes_to_names(unit_columns * unit_rows)
+{
+    // Sized as it would be when loaded, but without pixels. It shares
+    // the super atlas's texture, so never needs its own.
+    image.width = image.store_width = source.width;
+    image.height = image.store_height = source.height;
+    image.power_of_two = image.flipped = true;
+    gl_images.assign(1, image);
+
+    for (const auto &mapping : names_to_indexes) {
+        if (mapping.second >= 0 && size_t(mapping.second) < indexes_to_names.size()) {
+            indexes_to_names[size_t(mapping.second)] = mapping.first;
+        }
+    }
+}
+
+TextureAtlas::TextureAtlas(const AssetLoader::DecodedImage &decoded):
+    image(decoded.image),
+    gl_images(1, image),
+    gl_textures(),
+    reshaped(false),
+    unit_w(Engine::get_tile_size()),
+    unit_h(Engine::get_tile_size()),
+    unit_columns(image.width  / unit_w),
+    unit_rows   (image.height / unit_h),
+    textures(unit_columns * unit_rows),
+    sub_atlases(),
+    super_atlas(),
+    names_to_indexes(decoded.names_to_indexes),
+    indexes_to_names(unit_columns * unit_rows)
+{
+    // It is merged straight away, so never needs its own texture
+    for (const auto &mapping : names_to_indexes) {
+        if (mapping.second >= 0 && size_t(mapping.second) < indexes_to_names.size()) {
+            indexes_to_names[size_t(mapping.second)] = mapping.first;
+        }
+    }
+}
+
+TextureAtlas::TextureAtlas(const AssetCache::Atlas &baked):
+    gl_images(baked.pages),
+    gl_textures(),
+    reshaped(true),
+    unit_w(baked.unit_w),
+    unit_h(baked.unit_h),
+    unit_columns(baked.unit_columns),
+    unit_rows(baked.unit_rows),
+    textures(),
+    sub_atlases(),
+    super_atlas(),
+    names_to_indexes(),
+    indexes_to_names()
+{
+    textures = std::vector<std::weak_ptr<Texture>>(get_texture_count());
+    indexes_to_names = std::vector<std::string>(get_texture_count());
+
+    LOG(INFO) << "Loaded baked super atlas: (" << unit_columns << ", " << unit_rows << ") x " << gl_images.size() << " pages";
+
+    init_texture();
+}
+
+
 TextureAtlas::~TextureAtlas() {
     deinit_texture();
 }
 
+void TextureAtlas::load_image() {
+    if (image.pixels || resource_name.empty()) {
+        return;
+    }
+
+    VLOG(1) << "Decoding baked atlas " << this << ": " << resource_name;
+    image = Image(resource_name, true);
+    if (!reshaped) {
+        gl_images.assign(1, image);
+    }
+}
+
+
+
+std::pair<int,int> TextureAtlas::page_layout(int texture_count, int unit_w, int unit_h, int max_texture_size) {
+    if (unit_w > max_texture_size || unit_h > max_texture_size) {
+        throw TextureAtlas::LoadException("Texture atlas units are larger than the largest texture.");
+    }
+
+    int page_width;
+    int page_height;
+    for (page_width  = 1; page_width  < unit_w; page_width  <<= 1);
+    for (page_height = 1; page_height < unit_h; page_height <<= 1);
+
+    // Grow the width and height in turn, to keep the page near square,
+    // until every unit fits or the page is as large as it can be
+    while ((page_width / unit_w) * (page_height / unit_h) < texture_count) {
+        bool can_widen  (page_width  * 2 <= max_texture_size);
+        bool can_heighten(page_height * 2 <= max_texture_size);
+
+        if (can_widen && (page_width <= page_height || !can_heighten)) {
+            page_width <<= 1;
+        }
+        else if (can_heighten) {
+            page_height <<= 1;
+        }
+        else {
+            break;
+        }
+    }
+
+    return std::make_pair(page_width / unit_w, page_height / unit_h);
+}
+
+int TextureAtlas::locate_unit(int index, int unit_w, int unit_h, int unit_columns, int unit_rows,
+                              const Image &page, std::tuple<float,float,float,float> &coords) {
+    int units_per_page(unit_columns * unit_rows);
+
+    // Rows count from the top of the page, and texture coordinates from
+    // the bottom of its allocated area
+    int column(index % units_per_page % unit_columns);
+    int row   (index % units_per_page / unit_columns);
+    coords = std::make_tuple(float((column    ) * unit_w) / float(page.store_width),
+                             float((column + 1) * unit_w) / float(page.store_width),
+                             float(page.height - (row + 1) * unit_h) / float(page.store_height),
+                             float(page.height - (row    ) * unit_h) / float(page.store_height));
+
+    return index / units_per_page;
+}
+
+TextureAtlas::Arrangement TextureAtlas::arrange(const std::vector<int> &texture_counts, const std::vector<bool> &opaque,
+                                                int unit_w, int unit_h, int max_texture_size) {
+    int opaque_count(0);
+    int translucent_count(0);
+    for (size_t i = 0; i < texture_counts.size(); ++i) {
+        (opaque[i] ? opaque_count : translucent_count) += texture_counts[i];
+    }
+
+    // Round up divide, with at least one page.
+    auto count_pages([] (int texture_count, std::pair<int,int> layout) {
+        int units_per_page(layout.first * layout.second);
+        return std::max((texture_count + units_per_page - 1) / units_per_page, 1);
+    });
+    auto count_area([&] (int page_count, std::pair<int,int> layout) {
+        return int64_t(page_count) * int64_t(layout.first * unit_w) * int64_t(layout.second * unit_h);
+    });
+
+    Arrangement arrangement;
+    std::pair<int,int> layout(page_layout(opaque_count + translucent_count, unit_w, unit_h, max_texture_size));
+    int page_count(count_pages(opaque_count + translucent_count, layout));
+    // The first index of the others
+    int translucent_offset(opaque_count);
+
+    if (opaque_count > 0 && translucent_count > 0) {
+        std::pair<int,int> apart_layout(page_layout(std::max(opaque_count, translucent_count), unit_w, unit_h, max_texture_size));
+        int opaque_pages(count_pages(opaque_count, apart_layout));
+        int apart_page_count(opaque_pages + count_pages(translucent_count, apart_layout));
+
+        if (count_area(apart_page_count, apart_layout) <= count_area(page_count, layout)) {
+            layout = apart_layout;
+            page_count = apart_page_count;
+            translucent_offset = opaque_pages * layout.first * layout.second;
+        }
+    }
+
+    std::tie(arrangement.unit_columns, arrangement.unit_rows) = layout;
+    arrangement.page_count = page_count;
+
+    int units_per_page(layout.first * layout.second);
+    int first_translucent(translucent_count > 0 ? translucent_offset : page_count * units_per_page);
+
+    int opaque_offset(0);
+    for (size_t i = 0; i < texture_counts.size(); ++i) {
+        int &offset(opaque[i] ? opaque_offset : translucent_offset);
+        arrangement.index_offsets.push_back(offset);
+        offset += texture_counts[i];
+    }
 
+    // Pages before the first of the others hold opaque units or none
+    for (int page = 0; page < page_count; ++page) {
+        arrangement.opaque_pages.push_back((page + 1) * units_per_page <= first_translucent);
+    }
+
+    return arrangement;
+}
+
+void TextureAtlas::allocate_pages(const Arrangement &arrangement) {
+    unit_columns = arrangement.unit_columns;
+    unit_rows = arrangement.unit_rows;
+
+    // Images share their pixels when copied, so each page is made anew
+    gl_images.clear();
+    for (int page = 0; page < arrangement.page_count; ++page) {
+        gl_images.emplace_back(unit_w * unit_columns, unit_h * unit_rows, true);
+        if (arrangement.opaque_pages[size_t(page)]) {
+            gl_images.back().clear(0x000000ff, 0xffffffff);
+        }
+    }
+
+    if (arrangement.page_count > 1) {
+        LOG(WARNING) << "Texture atlas " << this << " spills onto " << arrangement.page_count << " pages";
+    }
+}
+
+bool TextureAtlas::is_opaque() {
+    // Anything right of or below the last whole unit is never shown
+    for (int y = 0; y < unit_rows * unit_h; ++y) {
+        if (!pixel_ops::is_opaque(reinterpret_cast<const uint8_t *>(image.row(y)), size_t(unit_columns * unit_w))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void TextureAtlas::copy_unit(Image &src, std::pair<int,int> src_units, int index) {
+    int units_per_page(unit_columns * unit_rows);
+    Image &dst(gl_images[size_t(index / units_per_page)]);
+
+    int dst_x_offset = (index % units_per_page % unit_columns) * unit_w;
+    int dst_y_offset = (index % units_per_page / unit_columns) * unit_h;
+
+    int src_x_offset = src_units.first  * unit_w;
+    int src_y_offset = src_units.second * unit_h;
+
+    VLOG(2) << "Moving: " << index << ": (" << src_x_offset << ", " << src_y_offset << ") -> (" << dst_x_offset << ", " << dst_y_offset << ")";
+    dst.blit(src, src_x_offset, src_y_offset, unit_w, unit_h, dst_x_offset, dst_y_offset);
+}
 
 void TextureAtlas::init_texture() {
-    int max_texture_size;
-    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_texture_size);
+    int max_texture_size(get_max_page_size());
 
     deinit_texture();
 
-    if (image.store_width > max_texture_size || image.store_height > max_texture_size) {
-        // Turns out that the atlas is too wide or tall. Reshape it.
+    if (!reshaped && (image.store_width > max_texture_size || image.store_height > max_texture_size)) {
+        // Turns out that the atlas is too wide or tall. Repack it.
 
         int texture_count = get_texture_count();
-        int max_columns = max_texture_size / unit_w;
-
         int old_unit_columns = unit_columns;
         int old_unit_rows = unit_rows;
 
-        // Naive method for getting a fitting atlas size.
-        if (max_columns >= texture_count) {
-            unit_columns = texture_count;
-            unit_rows    = 1;
-        }
-        else {
-            unit_columns = max_columns;
-            // Round up divide.
-            unit_rows    = (texture_count + max_columns - 1) / max_columns;
+        allocate_pages(arrange(std::vector<int>(1, texture_count), std::vector<bool>(1, is_opaque()),
+                               unit_w, unit_h, max_texture_size));
+
+        LOG(INFO) << "Reshaping: " << this << ": (" << image.width << ", " << image.height << ") -> (" << gl_images[0].width << ", " << gl_images[0].height << ") x " << gl_images.size() << " pages";
+        LOG(INFO) << "  (Units): " << this << ": (" << old_unit_columns << ", " << old_unit_rows << ") -> (" << unit_columns << ", " << unit_rows << ")";
+        for (int i = 0; i < texture_count; ++i) {
+            copy_unit(image, std::make_pair(i % old_unit_columns, i / old_unit_columns), i);
         }
-        gl_image = Image(unit_w * unit_columns, unit_h * unit_rows, true);
+        textures = std::vector<std::weak_ptr<Texture>>(get_texture_count());
+        indexes_to_names.resize(size_t(get_texture_count()));
+        reshaped = true;
+    }
 
-        LOG(INFO) << "Reshaping: " << this << ": (" << image.width << ", " << image.height << ") -> (" << gl_image.width << ", " << gl_image.height << ")";;
-        LOG(INFO) << "  (Units): " << this << ": (" << old_unit_columns << ", " << old_unit_rows << ") -> (" << unit_columns << ", " << unit_rows << ")";;
-        for (int i = 0, end = old_unit_columns * old_unit_rows; i < end; ++i) {
-            int dst_x_offset = (i % unit_columns) * unit_w;
-            int dst_y_offset = (i / unit_columns) * unit_h;
+    GLenum etc1_format(quality == Quality::COMPRESSED ? get_etc1_format() : 0);
 
-            int src_x_offset = (i % old_unit_columns) * unit_w;
-            int src_y_offset = (i / old_unit_columns) * unit_h;
+    GLState &gl_state(GLState::get_current());
+    gl_state.active_texture(GL_TEXTURE0);
+    for (Image &gl_image : gl_images) {
+        GLuint gl_texture(0);
+        glGenTextures(1, &gl_texture);
 
-            VLOG(2) << "Moving: " << i << ": (" << src_x_offset << ", " << src_y_offset << ") -> (" << dst_x_offset << ", " << dst_y_offset << ")";
-            for (int y = 0; y < unit_h; ++y) {
-                for (int x = 0; x < unit_w; ++x) {
-                    gl_image.flipped_pixels[dst_y_offset + y][dst_x_offset + x] = image.flipped_pixels[src_y_offset + y][src_x_offset + x];
-                }
-            }
+        if (gl_texture == 0) {
+            LOG(ERROR) << "Unable to generate GL texture.";
+            deinit_texture();
+            throw TextureAtlas::LoadException("Unable to generate GL texture");
         }
-        textures = std::vector<std::weak_ptr<Texture>>(unit_columns * unit_rows);
-        reshaped = true;
+        gl_textures.push_back(gl_texture);
+
+        if (upload_deferred) {
+            // Converted on a worker, and uploaded by upload_queued
+            Image page(gl_image);
+            Quality page_quality(quality);
+            queued_uploads.push_back(QueuedUpload{this, gl_texture, AssetLoader::get_instance().run<PreparedPage>(
+                [page, page_quality, etc1_format] () { return prepare_page(page, page_quality, etc1_format); }
+            )});
+            continue;
+        }
+
+        gl_state.bind_texture(gl_texture);
+        glGetError();
+        upload_page(gl_texture, prepare_page(gl_image, quality, etc1_format));
+        if (int e = glGetError()) {
+            std::stringstream hex_error_code;
+            hex_error_code << std::hex << e;
+            deinit_texture();
+            throw TextureAtlas::LoadException("Unable to load texture into GPU: " + hex_error_code.str());
+        }
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
     }
-    
-    glGenTextures(1, &gl_texture);
+}
 
-    if (gl_texture == 0) {
-        LOG(ERROR) << "Unable to generate GL texture.";
-        throw TextureAtlas::LoadException("Unable to generate GL texture");
+int TextureAtlas::get_max_page_size() {
+    int max_texture_size;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_texture_size);
+
+    if (max_page_size > 0) {
+        return std::min(max_page_size, max_texture_size);
     }
+    return max_texture_size;
+}
 
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, gl_texture);
-    glGetError();
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, gl_image.store_width, gl_image.store_height, 0, GL_RGBA, GL_UNSIGNED_BYTE, gl_image.pixels);
-    if (int e = glGetError()) {
-        std::stringstream hex_error_code;
-        hex_error_code << std::hex << e;
-        glDeleteTextures(1, &gl_texture);
-        throw TextureAtlas::LoadException("Unable to load texture into GPU: " + hex_error_code.str());
+GLenum TextureAtlas::get_etc1_format() {
+    const GLubyte *extensions_string(glGetString(GL_EXTENSIONS));
+    std::string extensions(extensions_string ? reinterpret_cast<const char *>(extensions_string) : "");
+    extensions = " " + extensions + " ";
+
+    if (extensions.find(" GL_OES_compressed_ETC1_RGB8_texture ") != std::string::npos) {
+        return GL_ETC1_RGB8_OES;
+    }
+    // ETC2 decoders read ETC1 data as it is
+    if (extensions.find(" GL_ARB_ES3_compatibility ") != std::string::npos) {
+        return GL_COMPRESSED_RGB8_ETC2;
+    }
+
+    LOG(INFO) << "ETC1 textures are not supported; using RGB565";
+    return 0;
+}
+
+TextureAtlas::PreparedPage TextureAtlas::prepare_page(const Image &page, Quality quality, GLenum etc1_format) {
+    const uint8_t *rgba(reinterpret_cast<const uint8_t *>(page.pixels));
+    size_t pixel_count(size_t(page.store_width) * size_t(page.store_height));
+
+    PreparedPage prepared;
+    prepared.width = page.store_width;
+    prepared.height = page.store_height;
+    prepared.compressed_format = 0;
+
+    if (quality == Quality::FULL) {
+        prepared.internal_format = GL_RGBA;
+        prepared.format = GL_RGBA;
+        prepared.type = GL_UNSIGNED_BYTE;
+        prepared.description = "RGBA8888";
+        prepared.page = page;
+        return prepared;
+    }
+
+    // Padding beyond the used area is never shown, so may be clear
+    bool opaque(true);
+    for (int y = 0; y < page.height && opaque; ++y) {
+        opaque = pixel_ops::is_opaque(rgba + std::ptrdiff_t(y) * page.store_width * 4, size_t(page.width));
+    }
+
+    if (opaque && etc1_format) {
+        prepared.compressed_format = etc1_format;
+        prepared.description = "ETC1";
+        prepared.data.resize(etc1::get_encoded_size(page.store_width, page.store_height));
+        etc1::encode(rgba, std::ptrdiff_t(page.store_width) * 4, page.store_width, page.store_height, prepared.data.data());
+        return prepared;
+    }
+
+    // Desktop GL can be asked to keep 16 bits a pixel; GLES keeps the
+    // format it is given
+    prepared.data.resize(pixel_count * sizeof(uint16_t));
+    uint16_t *packed(reinterpret_cast<uint16_t *>(prepared.data.data()));
+    if (opaque) {
+        pixel_ops::pack_rgb565(packed, rgba, pixel_count);
+#ifdef USE_GLES
+        prepared.internal_format = GL_RGB;
+#else
+        prepared.internal_format = GL_RGB5;
+#endif
+        prepared.format = GL_RGB;
+        prepared.type = GL_UNSIGNED_SHORT_5_6_5;
+        prepared.description = "RGB565";
+    }
+    else {
+        pixel_ops::pack_rgba4444(packed, rgba, pixel_count);
+#ifdef USE_GLES
+        prepared.internal_format = GL_RGBA;
+#else
+        prepared.internal_format = GL_RGBA4;
+#endif
+        prepared.format = GL_RGBA;
+        prepared.type = GL_UNSIGNED_SHORT_4_4_4_4;
+        prepared.description = "RGBA4444";
+    }
+    return prepared;
+}
+
+void TextureAtlas::upload_page(GLuint gl_texture, const PreparedPage &page) {
+    size_t bytes(page.compressed_format ? page.data.size()
+                                        : GPUMemory::get_texture_bytes(page.width, page.height, page.format, page.type));
+    GPUMemory::get_current().set_texture(gl_texture, GPUMemory::Category::ATLAS, bytes);
+    RenderStats::get_instance().record_upload(bytes);
+
+    if (page.compressed_format) {
+        glCompressedTexImage2D(GL_TEXTURE_2D, 0, page.compressed_format, page.width, page.height, 0,
+                               GLsizei(page.data.size()), page.data.data());
+    }
+    else if (page.data.empty()) {
+        glTexImage2D(GL_TEXTURE_2D, 0, page.internal_format, page.width, page.height, 0, page.format, page.type, page.page.pixels);
+    }
+    else {
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 2);
+        glTexImage2D(GL_TEXTURE_2D, 0, page.internal_format, page.width, page.height, 0, page.format, page.type, page.data.data());
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
     }
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glBindTexture(GL_TEXTURE_2D, 0);
+    VLOG(1) << "Uploaded atlas " << this << " page as " << page.description;
+}
+
+size_t TextureAtlas::upload_queued(std::chrono::steady_clock::time_point deadline, bool wait) {
+    while (!queued_uploads.empty() && std::chrono::steady_clock::now() < deadline) {
+        QueuedUpload &queued(queued_uploads.front());
+        if (!wait && queued.page.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+            break;
+        }
+
+        TextureAtlas *atlas(queued.atlas);
+        GLuint gl_texture(queued.gl_texture);
+        PreparedPage page(queued.page.get());
+        queued_uploads.pop_front();
+
+        GLState &gl_state(GLState::get_current());
+        gl_state.active_texture(GL_TEXTURE0);
+        gl_state.bind_texture(gl_texture);
+        glGetError();
+        atlas->upload_page(gl_texture, page);
+        if (int e = glGetError()) {
+            LOG(ERROR) << "Unable to load texture " << gl_texture << " into GPU: " << std::hex << e;
+        }
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    }
+
+    return queued_uploads.size();
 }
 
 void TextureAtlas::deinit_texture() {
-    if (gl_texture != 0) {
+    // Queued pages no longer have a texture to go to
+    queued_uploads.erase(std::remove_if(std::begin(queued_uploads), std::end(queued_uploads),
+                                        [this] (const QueuedUpload &queued) { return queued.atlas == this; }),
+                         std::end(queued_uploads));
+
+    for (GLuint gl_texture : gl_textures) {
+        if (GraphicsContext::get_current()) {
+            GLState::get_current().forget_texture(gl_texture);
+            GPUMemory::get_current().forget_texture(gl_texture);
+        }
         glDeleteTextures(1, &gl_texture);
-        gl_texture = 0;
     }
+    gl_textures.clear();
 }
 
 
 
 void TextureAtlas::set_tile_size(int unit_w, int unit_h) {
+    load_image();
     this->unit_w = unit_w;
     this->unit_h = unit_h;
     reset_layout();
@@ -314,18 +849,39 @@ void TextureAtlas::reset_layout() {
     unit_rows    = image.height / unit_h;
     if (reshaped) {
         reshaped = false;
-        gl_image = image;
+        gl_images.assign(1, image);
     }
     textures = std::vector<std::weak_ptr<Texture>>(unit_columns * unit_rows);
 }
 
 
 
-GLuint TextureAtlas::get_gl_texture() {
+GLuint TextureAtlas::get_gl_texture(int page) {
     if (super_atlas) {
-        return super_atlas->get_gl_texture();
+        return super_atlas->get_gl_texture(page);
+    } else if (page >= 0 && page < int(gl_textures.size())) {
+        return gl_textures[size_t(page)];
     } else {
-        return gl_texture;
+        return 0;
+    }
+}
+
+
+int TextureAtlas::get_page_count() {
+    if (super_atlas) {
+        return super_atlas->get_page_count();
+    } else {
+        return int(gl_images.size());
+    }
+}
+
+
+int TextureAtlas::index_to_page(int index) {
+    if (super_atlas) {
+        return super_atlas->index_to_page(offset_index(index));
+    } else {
+        std::tuple<float,float,float,float> coords;
+        return locate_unit(index, unit_w, unit_h, unit_columns, unit_rows, gl_images[0], coords);
     }
 }
 
@@ -349,12 +905,31 @@ GLuint TextureAtlas::deoffset_index(int index) {
 
 
 std::pair<int,int> TextureAtlas::get_atlas_size() {
-    return std::make_pair(gl_image.width, gl_image.height);
+    return std::make_pair(gl_images[0].width, gl_images[0].height);
+}
+
+
+size_t TextureAtlas::get_resource_bytes() {
+    auto image_bytes([] (const Image &image) {
+        return image.pixels ? size_t(image.store_width) * size_t(image.store_height) * sizeof(Image::Pixel) : 0;
+    });
+
+    size_t bytes(image_bytes(image));
+    // Otherwise the one page is the image
+    if (reshaped) {
+        for (const Image &gl_image : gl_images) {
+            bytes += image_bytes(gl_image);
+        }
+    }
+    if (super_atlas) {
+        bytes += super_atlas->get_resource_bytes() / std::max(super_atlas->sub_atlases.size(), size_t(1));
+    }
+    return bytes;
 }
 
 
 int TextureAtlas::get_texture_count() {
-    return unit_columns * unit_rows;
+    return unit_columns * unit_rows * int(gl_images.size());
 }
 
 
@@ -370,15 +945,17 @@ std::pair<float,float> TextureAtlas::get_unit_size_ratio() {
 
 int TextureAtlas::units_to_index(std::pair<int,int> units) {
     if (super_atlas) {
-        return deoffset_index(units_to_index(units));
+        return deoffset_index(super_atlas->units_to_index(units));
     } else {
         return units.first + unit_columns * units.second;
     }
 }
 std::pair<int,int> TextureAtlas::index_to_units(int index) {
     if (super_atlas) {
-        return index_to_units(offset_index(index));
+        return super_atlas->index_to_units(offset_index(index));
     } else {
+        // Within the unit's page
+        index %= unit_columns * unit_rows;
         return std::make_pair(index % unit_columns,
                               index / unit_columns);
     }
@@ -389,6 +966,7 @@ std::pair<float,float> TextureAtlas::units_to_floats(std::pair<int,int> units) {
     if (super_atlas) {
         return super_atlas->units_to_floats(units);
     } else {
+        const Image &gl_image(gl_images[0]);
         return std::make_pair(float(units.first  * unit_w) / float(gl_image.store_width),
                               float(gl_image.height - units.second * unit_h) / float(gl_image.store_height));
     }
@@ -399,14 +977,10 @@ std::tuple<float,float,float,float> TextureAtlas::index_to_coords(int index) {
     if (super_atlas) {
         return super_atlas->index_to_coords(offset_index(index));
     } else {
-        std::pair<int,int> units = index_to_units(index);
-        return std::make_tuple<float,float,float,float>
-            (
-             float((units.first    ) * unit_w) / float(gl_image.store_width),
-             float((units.first + 1) * unit_w) / float(gl_image.store_width),
-             float(gl_image.height - (units.second + 1) * unit_h) / float(gl_image.store_height),
-             float(gl_image.height - (units.second    ) * unit_h) / float(gl_image.store_height)
-             );
+        // Every page is the same size
+        std::tuple<float,float,float,float> coords;
+        locate_unit(index, unit_w, unit_h, unit_columns, unit_rows, gl_images[0], coords);
+        return coords;
     }
 }
 
@@ -1,6 +1,11 @@
 #ifndef TEXTURE_ATLAS_H
 #define TEXTURE_ATLAS_H
 
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <future>
 #include <map>
 #include <memory>
 #include <set>
@@ -20,6 +25,8 @@ extern "C" {
 #endif
 }
 
+#include "asset_cache.hpp"
+#include "asset_loader.hpp"
 #include "cacheable_resource.hpp"
 #include "image.hpp"
 
@@ -37,7 +44,56 @@ class Texture;
 /// refered to as units where simple using 'texture' may confuse. These
 /// units may be addressed using indexes or coordinates.
 ///
+/// Atlases which are merged, or too large for one GL texture, are packed
+/// onto near-square power-of-two pages. When the units do not fit on one
+/// page of the largest texture size, they spill onto more pages, each
+/// with its own GL texture. Units are numbered through the pages in
+/// order, and coordinates are within a unit's page.
+///
+/// Fully opaque atlases are merged first, so that their pages can be
+/// held without alpha, and are given pages of their own when that costs
+/// no more texture area.
+///
 class TextureAtlas : public CacheableResource<TextureAtlas> {
+public:
+    ///
+    /// How precisely atlases are held on the GPU.
+    ///
+    enum class Quality {
+        ///
+        /// 32-bit RGBA
+        ///
+        FULL,
+        ///
+        /// 16-bit RGB565 for fully opaque pages, such as those of solid
+        /// ground tilesets, and RGBA4444 for any others, such as sprites
+        /// and the GUI
+        ///
+        REDUCED,
+        ///
+        /// As REDUCED, but with fully opaque pages compressed to ETC1
+        /// where the driver can show it
+        ///
+        COMPRESSED
+    };
+
+    ///
+    /// Where the units of atlases being merged go on the pages.
+    ///
+    struct Arrangement {
+        int unit_columns;
+        int unit_rows;
+        int page_count;
+        ///
+        /// The index of each atlas's first unit
+        ///
+        std::vector<int> index_offsets;
+        ///
+        /// Whether each page holds units of opaque atlases only
+        ///
+        std::vector<bool> opaque_pages;
+    };
+
 private:
     friend class CacheableResource<TextureAtlas>;
     friend class Texture;
@@ -46,20 +102,21 @@ private:
     ///
     Image image;
     ///
-    /// Image used to store the GL ready pixel data in main memory.
+    /// Images used to store the GL ready pixel data in main memory, one
+    /// per page. Every page is the same size.
     ///
-    /// This may have a different tile arrangement to image.
+    /// These may have a different tile arrangement to image.
     ///
-    Image gl_image;
+    std::vector<Image> gl_images;
     ///
-    /// The GL texture id
+    /// The GL texture ids, one per page
     ///
-    GLuint gl_texture;
+    std::vector<GLuint> gl_textures;
     ///
-    /// Whether the tiles have been rearranged when creating gl_image.
+    /// Whether the tiles have been rearranged when creating gl_images.
     ///
     /// If this is true, an update to layout information will require
-    /// the regeneration of the gl_image, unit_columns, and unit_rows.
+    /// the regeneration of the gl_images, unit_columns, and unit_rows.
     ///
     bool reshaped;
     ///
@@ -71,11 +128,11 @@ private:
     ///
     int unit_h;
     ///
-    /// The number of columns of units in the texture.
+    /// The number of columns of units on each page.
     ///
     int unit_columns;
     ///
-    /// The number of rows of units in the texture.
+    /// The number of rows of units on each page.
     ///
     int unit_rows;
     ///
@@ -131,15 +188,40 @@ private:
     TextureAtlas(const std::set<std::shared_ptr<TextureAtlas>, std::owner_less<std::shared_ptr<TextureAtlas>>> &atlases);
 
     ///
-    /// Allocates the gl texture from the image member.
+    /// Check whether every pixel of the units in the image is fully
+    /// opaque.
+    ///
+    bool is_opaque();
+
+    ///
+    /// Lay out the units on new, blank pages. Pages holding only opaque
+    /// units are filled with opaque black, so that they stay opaque.
+    ///
+    /// Sets unit_columns and unit_rows and replaces gl_images.
+    ///
+    /// @param arrangement where the units go
+    ///
+    void allocate_pages(const Arrangement &arrangement);
+
+    ///
+    /// Copy one unit of an image onto its place on the pages.
     ///
-    /// If there is already an allocated texture, it is first
+    /// @param src the image to copy from
+    /// @param src_units the unit in src, from the top left
+    /// @param index the index of the unit in this atlas
+    ///
+    void copy_unit(Image &src, std::pair<int,int> src_units, int index);
+
+    ///
+    /// Allocates the gl textures from the image member.
+    ///
+    /// If there are already allocated textures, they are first
     /// deallocated.
     ///
     void init_texture();
 
     ///
-    /// Deallocates the gl texture from the image member (if needed).
+    /// Deallocates the gl textures from the image member (if needed).
     ///
     void deinit_texture();
 
@@ -150,6 +232,141 @@ private:
     ///
     void reset_layout();
 
+    ///
+    /// Create a sub atlas from a baked atlas. Only the size of its image
+    /// is known until load_image is called.
+    ///
+    TextureAtlas(const AssetCache::Source &source);
+
+    ///
+    /// Create a super atlas from the pages of a baked atlas.
+    ///
+    TextureAtlas(const AssetCache::Atlas &baked);
+
+    ///
+    /// Decode the image of an atlas made from a baked atlas, so that it
+    /// can be merged or laid out again.
+    ///
+    void load_image();
+
+    ///
+    /// Link atlases to the super atlas they have been merged into.
+    ///
+    /// @param atlases the sub atlases, whose index offsets are already
+    ///        set
+    ///
+    static void attach_sub_atlases(std::shared_ptr<TextureAtlas> super_atlas,
+                                   const std::vector<std::shared_ptr<TextureAtlas>> &atlases);
+
+    ///
+    /// Write a super atlas to the asset cache.
+    ///
+    static void bake(const TextureAtlas &super_atlas, int max_texture_size);
+
+    ///
+    /// How precisely new textures are held on the GPU
+    ///
+    static Quality quality;
+
+    ///
+    /// The largest width and height of new pages, or 0 for the
+    /// driver's largest texture
+    ///
+    static int max_page_size;
+
+    ///
+    /// Get the compressed format ETC1 data can be uploaded as, or 0 if
+    /// the driver cannot show it.
+    ///
+    static GLenum get_etc1_format();
+
+    ///
+    /// A page converted to the format the quality calls for, ready to
+    /// give to GL.
+    ///
+    struct PreparedPage {
+        int width;
+        int height;
+        ///
+        /// The compressed format, or 0 if the page is not compressed
+        ///
+        GLenum compressed_format;
+        GLint internal_format;
+        GLenum format;
+        GLenum type;
+        ///
+        /// The name of the format, for logging
+        ///
+        const char *description;
+        ///
+        /// The page, when it is uploaded as it is
+        ///
+        Image page;
+        ///
+        /// The converted pixels, when it is not
+        ///
+        std::vector<uint8_t> data;
+    };
+
+    ///
+    /// Convert a page to the format a quality calls for. Opaque pages
+    /// drop their alpha channel.
+    ///
+    /// This does not touch GL, so can run on the asset loader's threads.
+    ///
+    /// @param page the page
+    /// @param quality the quality to convert for
+    /// @param etc1_format the format from get_etc1_format, or 0 not to
+    ///        compress the page
+    ///
+    static PreparedPage prepare_page(const Image &page, Quality quality, GLenum etc1_format);
+
+    ///
+    /// Upload a prepared page to the bound texture, and record its size
+    /// in GPUMemory.
+    ///
+    /// @param gl_texture the bound texture
+    ///
+    void upload_page(GLuint gl_texture, const PreparedPage &page);
+
+    ///
+    /// A page whose texture has been created, waiting to be uploaded
+    /// by upload_queued.
+    ///
+    struct QueuedUpload {
+        TextureAtlas *atlas;
+        GLuint gl_texture;
+        std::future<PreparedPage> page;
+    };
+
+    ///
+    /// Whether init_texture queues pages rather than uploading them
+    ///
+    static bool upload_deferred;
+
+    ///
+    /// Pages waiting to be uploaded, in the order they were queued
+    ///
+    static std::deque<QueuedUpload> queued_uploads;
+
+    ///
+    /// Create an atlas to be merged from an image the asset loader has
+    /// decoded.
+    ///
+    TextureAtlas(const AssetLoader::DecodedImage &decoded);
+
+    ///
+    /// Sources for new_resource to make sub atlases from whilst
+    /// load_merged is creating them, by image path.
+    ///
+    static std::map<std::string, const AssetCache::Source *> baked_sources;
+
+    ///
+    /// Decoded images for new_resource to make atlases from whilst
+    /// load_merged is creating them, by image path.
+    ///
+    static std::map<std::string, const AssetLoader::DecodedImage *> decoded_images;
+
     ///
     /// Map of all known tile names to their tileset's name,
     /// pre-generated from the job files.
@@ -171,6 +388,110 @@ public:
         LoadException(const std::string &message);
     };
 
+    ///
+    /// Set how precisely atlases are held on the GPU. This only affects
+    /// atlases whose textures are created afterwards.
+    ///
+    static void set_quality(Quality quality) { TextureAtlas::quality = quality; }
+
+    static Quality get_quality() { return quality; }
+
+    ///
+    /// Limit the width and height of the pages of atlases created
+    /// afterwards, below the driver's largest texture, so that tiles
+    /// spread over several pages as they do on smaller GPUs.
+    ///
+    /// @param size the largest width and height, or 0 for no limit
+    ///
+    static void set_max_page_size(int size) { max_page_size = size; }
+
+    ///
+    /// Get the largest width and height of new pages. There must be a
+    /// current GraphicsContext.
+    ///
+    static int get_max_page_size();
+
+    ///
+    /// Set whether new textures are uploaded straight away or queued.
+    ///
+    /// Queued pages are converted to the quality's format on the asset
+    /// loader's threads and uploaded by upload_queued, so that the main
+    /// thread can spread the uploads over several frames. Their textures
+    /// exist, but are blank until then.
+    ///
+    static void set_upload_deferred(bool deferred) { upload_deferred = deferred; }
+
+    ///
+    /// Get the number of pages waiting to be uploaded
+    ///
+    static size_t get_queued_upload_count() { return queued_uploads.size(); }
+
+    ///
+    /// Upload queued pages, in order, until the deadline.
+    ///
+    /// @param deadline when to stop uploading
+    /// @param wait whether to wait for pages which are still being
+    ///        converted, rather than stopping at them
+    /// @return the number of pages still queued
+    ///
+    static size_t upload_queued(std::chrono::steady_clock::time_point deadline, bool wait);
+
+    ///
+    /// Work out the grid of units on each page: the smallest near-square
+    /// power-of-two page holding all of the units, or the largest
+    /// texture if they do not fit on one.
+    ///
+    /// Units are all the same size, so packing them from the bottom of
+    /// the skyline is filling the grid row by row.
+    ///
+    /// @param texture_count the number of units to hold
+    /// @param unit_w the width of a unit in pixels
+    /// @param unit_h the height of a unit in pixels
+    /// @param max_texture_size the largest width and height of a page
+    /// @return the number of columns and rows of units on each page
+    ///
+    static std::pair<int,int> page_layout(int texture_count, int unit_w, int unit_h, int max_texture_size);
+
+    ///
+    /// Arrange the units of atlases on pages laid out by page_layout.
+    ///
+    /// Opaque atlases come first. When there are both opaque and other
+    /// atlases, and a smaller page holding the larger kind takes no more
+    /// area in all than sharing the pages, the others start on a page of
+    /// their own.
+    ///
+    /// @param texture_counts the number of units in each atlas
+    /// @param opaque whether each atlas is fully opaque
+    /// @param unit_w the width of a unit in pixels
+    /// @param unit_h the height of a unit in pixels
+    /// @param max_texture_size the largest width and height of a page
+    ///
+    static Arrangement arrange(const std::vector<int> &texture_counts, const std::vector<bool> &opaque,
+                               int unit_w, int unit_h, int max_texture_size);
+
+    ///
+    /// Find a unit on pages which each hold a grid of units.
+    ///
+    /// @param index the index of the unit, counting through the pages
+    /// @param unit_w the width of a unit in pixels
+    /// @param unit_h the height of a unit in pixels
+    /// @param unit_columns the number of columns of units on each page
+    /// @param unit_rows the number of rows of units on each page
+    /// @param page any of the pages, which are all the same size
+    /// @param coords set to the left, right, bottom and top texture
+    ///        coordinates of the unit on its page
+    /// @return the page the unit is on
+    ///
+    static int locate_unit(int index, int unit_w, int unit_h, int unit_columns, int unit_rows,
+                           const Image &page, std::tuple<float,float,float,float> &coords);
+
+    ///
+    /// Get the memory held by the atlas's pixels, which its textures
+    /// mirror on the GPU. Merged atlases count an even share of their
+    /// super atlas's pages.
+    ///
+    size_t get_resource_bytes();
+
     ///
     /// Merge the resources of multiple texture atlases into one.
     ///
@@ -185,6 +506,24 @@ public:
     ///
     static void merge(const std::vector<std::shared_ptr<TextureAtlas>> &atlases);
 
+    ///
+    /// Load the atlases of a set of images, merged into one texture.
+    ///
+    /// When the same set has been merged before and none of the images
+    /// or their name files have changed, the merged atlas is mapped from
+    /// the asset cache, skipping decoding and merging. Otherwise the
+    /// atlases are loaded and merged as normal, and the result is baked
+    /// for next time.
+    ///
+    /// @param image_paths the images, as given to get_shared
+    /// @param decoded the images as decoded by the asset loader, which
+    ///        has already checked the asset cache, or nullptr to decode
+    ///        them here
+    /// @return the atlases, which share a super atlas
+    ///
+    static std::vector<std::shared_ptr<TextureAtlas>> load_merged(std::vector<std::string> image_paths,
+                                                                  const AssetLoader::DecodedAtlases *decoded = nullptr);
+
     ///
     /// Map of all known tile names to their tileset's name,
     /// pre-generated from the job files.   
@@ -206,9 +545,22 @@ public:
     void set_tile_size(int unit_w, int unit_h);
 
     ///
-    /// Gets the underlying GL texture.
+    /// Gets the underlying GL texture of a page.
+    ///
+    /// @param page the page, from index_to_page.
+    /// @return the texture, or 0 if there is no such page.
+    ///
+    GLuint get_gl_texture(int page = 0);
+    ///
+    /// Gets the number of pages, and so GL textures, the units are on.
+    ///
+    int get_page_count();
+    ///
+    /// Gets the page a unit is on.
+    ///
+    /// @param index The index of the texture for this atlas.
     ///
-    GLuint get_gl_texture();
+    int index_to_page(int index);
     ///
     /// Translates the index in a sub atlas to the super atlas index.
     ///
@@ -218,7 +570,7 @@ public:
     ///
     GLuint deoffset_index(int index);
     ///
-    /// Gets the size of the image in pixels.
+    /// Gets the size of a page of the image in pixels.
     ///
     std::pair<int,int> get_atlas_size();
     ///
@@ -237,7 +589,7 @@ public:
     ///
     std::pair<GLfloat,GLfloat> get_unit_size_ratio();
     ///
-    /// Converts a coordinate into the image to an index.
+    /// Converts a coordinate into the first page to an index.
     ///
     /// The coordinate is the number of units from the bottom left.
     /// The index is that for the sub atlas, whilst the units are for
@@ -245,7 +597,7 @@ public:
     ///
     int units_to_index(std::pair<int,int> units);
     ///
-    /// Converts an index to a coordinate into the image.
+    /// Converts an index to a coordinate into its page.
     ///
     /// The coordinate is the number of units from the bottom left.
     /// The index is that for the sub atlas, whilst the units are for
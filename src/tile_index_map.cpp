@@ -0,0 +1,90 @@
+#include <glog/logging.h>
+#include <ostream>
+#include <utility>
+
+#include "gl_state.hpp"
+#include "gpu_memory.hpp"
+#include "graphics_context.hpp"
+#include "render_stats.hpp"
+#include "tile_index_map.hpp"
+
+const int TileIndexMap::max_unit;
+
+TileIndexMap::TileIndexMap(int width, int height):
+    width(width),
+    height(height),
+    texels(size_t(width) * size_t(height) * 4, 0) {
+}
+
+TileIndexMap::~TileIndexMap() {
+    release_gl_texture();
+}
+
+bool TileIndexMap::set_tile(int x_pos, int y_pos, std::pair<int,int> units) {
+    if (units.first  < 0 || units.first  > max_unit ||
+        units.second < 0 || units.second > max_unit) {
+        clear_tile(x_pos, y_pos);
+        return false;
+    }
+
+    GLubyte *texel(&texels[(size_t(y_pos) * size_t(width) + size_t(x_pos)) * 4]);
+    texel[0] = GLubyte(units.first);
+    texel[1] = GLubyte(units.second);
+    texel[2] = 0;
+    texel[3] = 255;
+
+    if (gl_texture) {
+        GLState::get_current().bind_texture(gl_texture);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, x_pos, y_pos, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, texel);
+        RenderStats::get_instance().record_upload(4);
+    }
+
+    return true;
+}
+
+void TileIndexMap::clear_tile(int x_pos, int y_pos) {
+    GLubyte *texel(&texels[(size_t(y_pos) * size_t(width) + size_t(x_pos)) * 4]);
+    texel[0] = texel[1] = texel[2] = texel[3] = 0;
+
+    if (gl_texture) {
+        GLState::get_current().bind_texture(gl_texture);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, x_pos, y_pos, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, texel);
+        RenderStats::get_instance().record_upload(4);
+    }
+}
+
+GLuint TileIndexMap::get_gl_texture() {
+    if (gl_texture) {
+        return gl_texture;
+    }
+
+    glGenTextures(1, &gl_texture);
+    GLState::get_current().bind_texture(gl_texture);
+
+    // Each texel must be read exactly, and the map need not be a power of two
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, texels.data());
+    GPUMemory::get_current().set_texture(gl_texture, GPUMemory::Category::MAP_LAYER,
+                                         GPUMemory::get_texture_bytes(width, height, GL_RGBA, GL_UNSIGNED_BYTE));
+    RenderStats::get_instance().record_upload(texels.size());
+
+    VLOG(1) << "TileIndexMap: Created " << width << "x" << height << " index texture " << gl_texture;
+
+    return gl_texture;
+}
+
+void TileIndexMap::release_gl_texture() {
+    if (!gl_texture) {
+        return;
+    }
+
+    if (GraphicsContext::get_current()) {
+        GLState::get_current().forget_texture(gl_texture);
+        GPUMemory::get_current().forget_texture(gl_texture);
+    }
+    glDeleteTextures(1, &gl_texture);
+    gl_texture = 0;
+}
@@ -0,0 +1,102 @@
+#ifndef TILE_INDEX_MAP_H
+#define TILE_INDEX_MAP_H
+
+#include <utility>
+#include <vector>
+
+#ifdef USE_GLES
+#include <GLES2/gl2.h>
+#endif
+
+#ifdef USE_GL
+#define GL_GLEXT_PROTOTYPES
+#include <GL/gl.h>
+#endif
+
+///
+/// A texture holding a layer's tiles, with one texel per tile, for
+/// drawing the layer in a single quad with the tile index shader.
+///
+/// Each texel holds the column and row of the tile's unit in the
+/// texture atlas in its red and green channels. The alpha channel is 0
+/// for blank tiles and 255 otherwise. Units are limited to 256 columns
+/// and rows.
+///
+/// The texels are kept in main memory too, so that the texture can be
+/// created lazily and recreated with the context.
+///
+class TileIndexMap {
+private:
+    ///
+    /// The width of the map in tiles
+    ///
+    int width;
+
+    ///
+    /// The height of the map in tiles
+    ///
+    int height;
+
+    ///
+    /// RGBA texels, row by row from the bottom
+    ///
+    std::vector<GLubyte> texels;
+
+    ///
+    /// The GL texture, or 0 if it has not been created
+    ///
+    GLuint gl_texture = 0;
+
+public:
+    ///
+    /// The largest unit column or row which can be stored
+    ///
+    static const int max_unit = 255;
+
+    ///
+    /// Create a map with every tile blank.
+    /// @param width the width in tiles
+    /// @param height the height in tiles
+    ///
+    TileIndexMap(int width, int height);
+    ~TileIndexMap();
+
+    TileIndexMap(const TileIndexMap &) = delete;
+    TileIndexMap &operator=(const TileIndexMap &) = delete;
+
+    ///
+    /// Set the atlas unit of a tile. If the texture has been created,
+    /// the texel is updated in place.
+    /// @param x_pos the x position of the tile
+    /// @param y_pos the y position of the tile
+    /// @param units the column and row of the unit, from the top left
+    ///        of the atlas, as given by TextureAtlas::index_to_units
+    /// @return false if the unit is out of range, in which case the
+    ///         tile is made blank
+    ///
+    bool set_tile(int x_pos, int y_pos, std::pair<int,int> units);
+
+    ///
+    /// Make a tile blank.
+    /// @param x_pos the x position of the tile
+    /// @param y_pos the y position of the tile
+    ///
+    void clear_tile(int x_pos, int y_pos);
+
+    ///
+    /// Get the GL texture, creating it if needed. It is bound to the
+    /// active texture unit when created.
+    ///
+    GLuint get_gl_texture();
+
+    ///
+    /// Delete the GL texture. It is recreated by the next
+    /// get_gl_texture().
+    ///
+    void release_gl_texture();
+
+    int get_width() { return width; }
+    int get_height() { return height; }
+};
+
+#endif